@@ -19,6 +19,8 @@
 #include "server.h"
 #include "http_response.h"
 #include "http_request.h"
+#include "http_chunked_output.h"
+#include "async_buffer.h"
 
 std::shared_ptr<vds::json_object> vds::api_controller::channel_serialize(
   const vds::user_channel & channel) {
@@ -98,29 +100,25 @@ vds::async_task<std::shared_ptr<vds::json_value>> vds::api_controller::login(
 
   auto item = std::make_shared<json_object>();
 
-  for (;;) {
-    co_await session->update();
-
-    switch (session->get_login_state()) {
-    case user_manager::login_state_t::waiting:
-      continue;
-
-    case user_manager::login_state_t::login_failed:
-      item->add_property("state", "failed");
-      break;
+  switch (co_await session->wait_login_state(LOGIN_TIMEOUT)) {
+  case user_manager::login_state_t::waiting:
+    item->add_property("state", "100");
+    break;
 
-    case user_manager::login_state_t::login_sucessful:
-      item->add_property("state", "sucessful");
-      item->add_property("session", session_id);
-      item->add_property("user_name", session->user_name());
+  case user_manager::login_state_t::login_failed:
+    item->add_property("state", "failed");
+    break;
 
-      owner->add_auth_session(session_id, session);
-      break;
+  case user_manager::login_state_t::login_sucessful:
+    item->add_property("state", "sucessful");
+    item->add_property("session", session_id);
+    item->add_property("user_name", session->user_name());
 
-    default:
-      throw std::runtime_error("Invalid program");
-    }
+    owner->add_auth_session(session_id, session);
     break;
+
+  default:
+    throw std::runtime_error("Invalid program");
   }
 
   co_return item;
@@ -138,20 +136,43 @@ vds::api_controller::create_channel(
         "application/json; charset=utf-8");
 }
 
-vds::async_task<std::shared_ptr<vds::json_value>> vds::api_controller::channel_feed(
+vds::async_task<vds::http_message> vds::api_controller::channel_feed(
   const vds::service_provider * sp,
   const std::shared_ptr<user_manager> & user_mng,
-  const const_data_buffer & channel_id) {
-  auto result = std::make_shared<json_array>();
-  co_await sp->get<db_model>()->async_transaction([user_mng, channel_id, result](database_transaction & t)->bool {
-    user_mng->walk_messages(
+  const const_data_buffer & channel_id,
+  int64_t after_order_no,
+  size_t limit,
+  const std::string & mime_type,
+  const std::string & file_name) {
+
+  if (!user_mng->get_channel(channel_id)) {
+    co_return http_response::status_response(http_response::HTTP_Not_Found, "Channel not found");
+  }
+
+  auto records = std::make_shared<std::list<std::shared_ptr<json_value>>>();
+  co_await sp->get<db_model>()->async_read_transaction(
+    [user_mng, channel_id, after_order_no, limit, mime_type, file_name, records](database_read_transaction & t) {
+    int64_t last_order_no = -1;
+    user_mng->walk_channel_messages(
       channel_id,
       t,
-      [result](const transactions::user_message_transaction& message)-> bool {
-      auto record = std::make_shared<json_object>();
-      record->add_property("message", message.message);
-      auto files = std::make_shared<json_array>();
-        for(const auto & file : message.files) {
+      after_order_no,
+      [&records, &last_order_no, limit, &mime_type, &file_name](int64_t order_no, const const_data_buffer & data)-> bool {
+      //Finish the messages of the same order_no because the next page starts after it
+      if (limit <= records->size() && order_no != last_order_no) {
+        return false;
+      }
+
+      auto handler = [&records, &last_order_no, order_no, &mime_type, &file_name](const transactions::user_message_transaction& message)-> bool {
+        auto files = std::make_shared<json_array>();
+        for (const auto & file : message.files) {
+          if (!mime_type.empty() && 0 != file.mime_type.compare(0, mime_type.length(), mime_type)) {
+            continue;
+          }
+          if (!file_name.empty() && std::string::npos == file.name.find(file_name)) {
+            continue;
+          }
+
           auto item = std::make_shared<json_object>();
           item->add_property("object_id", base64::from_bytes(file.file_id));
           item->add_property("name", file.name);
@@ -159,14 +180,47 @@ vds::async_task<std::shared_ptr<vds::json_value>> vds::api_controller::channel_f
           item->add_property("size", file.size);
           files->add(item);
         }
+
+        if ((!mime_type.empty() || !file_name.empty()) && 0 == files->size()) {
+          return true;
+        }
+
+        auto record = std::make_shared<json_object>();
+        record->add_property("order_no", static_cast<uint64_t>(order_no));
+        record->add_property("message", message.message);
         record->add_property("files", files);
-        result->add(record);
-      return true;
+        records->push_back(record);
+        last_order_no = order_no;
+        return true;
+      };
+
+      transactions::channel_messages_walker_lambdas<decltype(handler)> walker(std::move(handler));
+      return walker.process(data);
     });
-    return true;
   });
 
-  co_return result;
+  auto buffer = std::make_shared<continuous_buffer<uint8_t>>(sp);
+  write_feed(
+    std::make_shared<http_chunked_output_async>(std::make_shared<continuous_stream_output_async<uint8_t>>(buffer)),
+    records).detach();
+
+  co_return http_response::chunked_response(
+    std::make_shared<continuous_stream_input_async<uint8_t>>(buffer),
+    "application/json; charset=utf-8");
+}
+
+vds::async_task<void> vds::api_controller::write_feed(
+  std::shared_ptr<http_chunked_output_async> output,
+  std::shared_ptr<std::list<std::shared_ptr<json_value>>> records) {
+
+  std::string separator = "[";
+  for (const auto & record : *records) {
+    co_await output->write_async(separator + record->str());
+    separator = ",";
+  }
+
+  co_await output->write_async(records->empty() ? std::string("[]") : std::string("]"));
+  co_await output->write_async(nullptr, 0);
 }
 
 vds::async_task<vds::file_manager::file_operations::download_result_t>
@@ -31,6 +31,11 @@ vds::async_task<void> vds::auth_session::update() {
   return this->user_mng_->update();
 }
 
+vds::async_task<vds::user_manager::login_state_t> vds::auth_session::wait_login_state(
+  const std::chrono::steady_clock::duration & timeout) {
+  return this->user_mng_->wait_login_state(timeout);
+}
+
 vds::user_manager::login_state_t vds::auth_session::get_login_state() const {
   return this->user_mng_->get_login_state();
 }
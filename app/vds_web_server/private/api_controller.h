@@ -13,6 +13,7 @@ All rights reserved
 #include "web_server_p.h"
 #include "user_channel.h"
 #include "file_operations.h"
+#include "http_chunked_output.h"
 
 namespace vds {
   class api_controller {
@@ -40,10 +41,22 @@ namespace vds {
       const std::shared_ptr<user_manager> & user_mng,
       const std::string & name);
 
-    static vds::async_task<std::shared_ptr<json_value>> channel_feed(
+    //The client repeats the login request after the timeout
+    static constexpr std::chrono::seconds LOGIN_TIMEOUT = std::chrono::seconds(60);
+
+    static constexpr size_t DEFAULT_FEED_PAGE_SIZE = 100;
+    static constexpr size_t MAX_FEED_PAGE_SIZE = 1000;
+
+    //Messages after after_order_no, the next page starts after order_no of the last message.
+    //If mime_type or file_name is set then only messages with the matching files are returned.
+    static vds::async_task<http_message> channel_feed(
       const vds::service_provider * sp,
       const std::shared_ptr<user_manager> & user_mng,
-      const const_data_buffer & channel_id);
+      const const_data_buffer & channel_id,
+      int64_t after_order_no,
+      size_t limit,
+      const std::string & mime_type,
+      const std::string & file_name);
 
     static vds::async_task<file_manager::file_operations::download_result_t>
     download_file(
@@ -92,6 +105,10 @@ namespace vds {
   private:
     static std::shared_ptr<json_object> channel_serialize(const vds::user_channel & channel);
 
+    static vds::async_task<void> write_feed(
+      std::shared_ptr<http_chunked_output_async> output,
+      std::shared_ptr<std::list<std::shared_ptr<json_value>>> records);
+
   };
 }
 
@@ -23,6 +23,8 @@ namespace vds {
 
     vds::async_task<void> load(const service_provider * sp);
     vds::async_task<void> update();
+    vds::async_task<user_manager::login_state_t> wait_login_state(
+      const std::chrono::steady_clock::duration & timeout);
 
     const std::shared_ptr<user_manager> & get_secured_context(
         ) const {
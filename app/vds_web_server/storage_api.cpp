@@ -7,7 +7,6 @@ All rights reserved
 #include "db_model.h"
 #include "dht_network_client.h"
 #include "device_config_dbo.h"
-#include "device_record_dbo.h"
 #include "member_user.h"
 
 vds::async_task<std::shared_ptr<vds::json_value>> vds::storage_api::device_storages(
@@ -22,24 +21,20 @@ vds::async_task<std::shared_ptr<vds::json_value>> vds::storage_api::device_stora
     auto current_node = client->current_node_id();
 
     orm::device_config_dbo t1;
-    orm::device_record_dbo t2;
-    db_value<int64_t> used_size;
     auto st = t.get_reader(
       t1.select(
         t1.name,
         t1.node_id,
         t1.local_path,
         t1.reserved_size,
-        db_sum(t2.data_size).as(used_size))
-      .left_join(t2, t2.local_path == t1.local_path && t2.node_id == t1.node_id)
-      .where(t1.owner_id == user_mng->get_current_user().user_certificate()->subject())
-      .group_by(t1.name, t1.node_id, t1.local_path, t1.reserved_size));
+        t1.used_size)
+      .where(t1.owner_id == user_mng->get_current_user().user_certificate()->subject()));
     while (st.execute()) {
       auto item = std::make_shared<json_object>();
       item->add_property("name", t1.name.get(st));
       item->add_property("local_path", t1.local_path.get(st));
       item->add_property("reserved_size", t1.reserved_size.get(st));
-      item->add_property("used_size", std::to_string(used_size.get(st)));
+      item->add_property("used_size", std::to_string(t1.used_size.get(st)));
       if(t1.node_id.get(st) == current_node) {
         item->add_property("free_size", std::to_string(foldername(t1.local_path.get(st)).free_size()));
         item->add_property("current", "true");
@@ -113,15 +113,30 @@ router_({
   {"/api/channel_feed", "GET", [this](
     const vds::service_provider * sp,
     const std::shared_ptr<user_manager> & user_mng,
-    const http_request & request) -> async_task<std::shared_ptr<json_value>> {
+    const http_request & request) -> async_task<http_message> {
             const auto channel_id = base64::to_bytes(request.get_parameter("channel_id"));
 
+            const auto after = request.get_parameter("after");
+            const auto after_order_no = after.empty() ? -1 : std::atoll(after.c_str());
+
+            auto limit = safe_cast<size_t>(std::atoll(request.get_parameter("limit").c_str()));
+            if (0 == limit) {
+              limit = api_controller::DEFAULT_FEED_PAGE_SIZE;
+            }
+            else if (api_controller::MAX_FEED_PAGE_SIZE < limit) {
+              limit = api_controller::MAX_FEED_PAGE_SIZE;
+            }
+
             co_await request.get_message().ignore_empty_body();
             
       co_return co_await api_controller::channel_feed(
               sp,
               user_mng,
-              channel_id);
+              channel_id,
+              after_order_no,
+              limit,
+              request.get_parameter("mime_type"),
+              request.get_parameter("file_name"));
     }
   },
   {"/api/devices", "GET", &storage_api::device_storages },
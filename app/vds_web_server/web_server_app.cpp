@@ -54,6 +54,7 @@ void vds::web_server_app::register_services(vds::service_registrator& registrato
 {
   base_class::register_services(registrator);
   registrator.add(this->mt_service_);
+  registrator.add(this->file_service_);
   registrator.add(this->task_manager_);
   registrator.add(this->network_service_);
   registrator.add(this->crypto_service_);
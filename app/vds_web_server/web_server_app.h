@@ -38,6 +38,7 @@ namespace vds {
 
     task_manager task_manager_;
     mt_service mt_service_;
+    file_service file_service_;
     network_service network_service_;
     crypto_service crypto_service_;
     server server_;
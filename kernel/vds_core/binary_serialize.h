@@ -216,7 +216,7 @@ namespace vds {
 
     template <typename field_type>
     void operator ()(field_type & field) {
-      field = this->v_;
+      field = std::forward<field_init_type>(this->v_);
     }
 
   private:
@@ -228,18 +228,19 @@ namespace vds {
     using base_class = _message_init_visitor<rest_fields_init_types...>;
   public:
     _message_init_visitor(first_field_init_type v, rest_fields_init_types... values)
-      : base_class(std::forward<rest_fields_init_types>(values)...), v_(v) {
+      : base_class(std::forward<rest_fields_init_types>(values)...), v_(std::forward<first_field_init_type>(v)) {
     }
 
+    //Values passed as rvalues are moved into the message fields
     template <typename first_field_type, typename... rest_field_types>
     auto operator ()(first_field_type & first_field, rest_field_types &... rest_fields) {
-      first_field = this->v_;
+      first_field = std::forward<first_field_init_type>(this->v_);
       return base_class::operator()(rest_fields...);
     }
 
     template <typename last_field_type>
     auto & operator ()(last_field_type & last_field) {
-      last_field = this->v_;
+      last_field = std::forward<first_field_init_type>(this->v_);
       return *static_cast<base_class *>(this);
     }
 
@@ -4,15 +4,15 @@
 #include "file.h"
 
 vds::file::file()
-: handle_(0)
+: handle_(0), direct_io_(false)
 {
 }
 
 
-vds::file::file(const filename & filename, file_mode mode)
-: handle_(0)
+vds::file::file(const filename & filename, file_mode mode, bool direct_io)
+: handle_(0), direct_io_(false)
 {
-  this->open(filename, mode);
+  this->open(filename, mode, direct_io);
 }
 
 vds::file::~file()
@@ -29,12 +29,14 @@ void vds::file::close()
     ::_close(this->handle_);
 #endif
     this->handle_ = 0;
+    this->direct_io_ = false;
   }
 }
   
-void vds::file::open(const vds::filename& filename, vds::file::file_mode mode)
+void vds::file::open(const vds::filename& filename, vds::file::file_mode mode, bool direct_io)
 {
   this->filename_ = filename;
+  this->direct_io_ = false;
   
   int oflags;
   switch (mode) {
@@ -90,11 +92,31 @@ void vds::file::open(const vds::filename& filename, vds::file::file_mode mode)
   }
 
 #ifndef _WIN32
+#ifdef O_DIRECT
+  if (direct_io) {
+    this->handle_ = ::open(filename.local_name().c_str(), oflags | O_DIRECT, S_IREAD | S_IWRITE);
+    if (0 <= this->handle_) {
+      this->direct_io_ = true;
+      return;
+    }
+
+    //The file system does not support direct I/O
+    if (EINVAL != errno) {
+      auto error = errno;
+      throw std::system_error(error, std::system_category(), "Unable to open file " + this->filename_.str());
+    }
+  }
+#endif
   this->handle_ = ::open(filename.local_name().c_str(), oflags, S_IREAD | S_IWRITE);
   if (0 > this->handle_) {
     auto error = errno;
     throw std::system_error(error, std::system_category(), "Unable to open file " + this->filename_.str());
   }
+#ifdef __APPLE__
+  if (direct_io && -1 != fcntl(this->handle_, F_NOCACHE, 1)) {
+    this->direct_io_ = true;
+  }
+#endif
 #else
 
   this->handle_ = ::_open(this->filename_.local_name().c_str(), oflags | O_BINARY | O_SEQUENTIAL, _S_IREAD | _S_IWRITE);
@@ -106,6 +128,59 @@ void vds::file::open(const vds::filename& filename, vds::file::file_mode mode)
 }
 
 
+void vds::file::disable_direct_io()
+{
+  if (!this->direct_io_) {
+    return;
+  }
+
+#if defined(O_DIRECT)
+  const auto flags = fcntl(this->handle_, F_GETFL);
+  if (-1 == flags || -1 == fcntl(this->handle_, F_SETFL, flags & ~O_DIRECT)) {
+    auto error = errno;
+    throw std::system_error(error, std::system_category(), "Unable to disable direct I/O for file " + this->filename_.str());
+  }
+#elif defined(__APPLE__)
+  fcntl(this->handle_, F_NOCACHE, 0);
+#endif
+
+  this->direct_io_ = false;
+}
+
+void vds::file::advise_sequential()
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(this->handle_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#elif defined(__APPLE__)
+  fcntl(this->handle_, F_RDAHEAD, 1);
+#endif
+}
+
+uint8_t * vds::file::alloc_aligned(size_t size)
+{
+#ifdef _WIN32
+  auto result = static_cast<uint8_t *>(_aligned_malloc(size, DIRECT_IO_ALIGNMENT));
+  if (nullptr == result) {
+    throw std::bad_alloc();
+  }
+#else
+  void * result;
+  if (0 != posix_memalign(&result, DIRECT_IO_ALIGNMENT, size)) {
+    throw std::bad_alloc();
+  }
+#endif
+  return static_cast<uint8_t *>(result);
+}
+
+void vds::file::free_aligned(uint8_t * buffer)
+{
+#ifdef _WIN32
+  _aligned_free(buffer);
+#else
+  free(buffer);
+#endif
+}
+
 size_t vds::file::read(
   void * buffer,
   size_t buffer_len)
@@ -123,6 +198,54 @@ size_t vds::file::read(
   return (size_t)readed;
 }
 
+size_t vds::file::read_at(
+  size_t position,
+  void * buffer,
+  size_t buffer_len)
+{
+  size_t result = 0;
+  while (0 < buffer_len) {
+#ifndef _WIN32
+    auto readed = ::pread(this->handle_, buffer, buffer_len, position);
+#else
+    //The offset is a part of the request, so the readers of the same handle do not race on seek
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(position) >> 32);
+
+    DWORD readed_bytes = 0;
+    const int64_t readed = ReadFile((HANDLE)_get_osfhandle(this->handle_), buffer, safe_cast<DWORD>(buffer_len), &readed_bytes, &overlapped)
+      ? static_cast<int64_t>(readed_bytes)
+      : ((ERROR_HANDLE_EOF == GetLastError()) ? 0 : -1);
+#endif
+    if (0 > readed) {
+#ifdef _WIN32
+      auto error = GetLastError();
+#else
+      auto error = errno;
+#endif
+      throw std::system_error(error, std::system_category(), "Unable to read file " + this->filename_.str());
+    }
+
+    if (0 == readed) {
+      break;
+    }
+
+    result += readed;
+    position += readed;
+    buffer_len -= readed;
+    buffer = (uint8_t *)buffer + readed;
+
+    //Direct reads are short only at the end of file and the next position is not aligned
+    if (this->direct_io_) {
+      break;
+    }
+  }
+
+  return result;
+}
+
 void vds::file::write(
   const void * buffer,
   size_t buffer_len)
@@ -147,6 +270,44 @@ void vds::file::write(
   }
 }
 
+void vds::file::write_at(
+  size_t position,
+  const void * buffer,
+  size_t buffer_len)
+{
+  while (0 < buffer_len) {
+#ifndef _WIN32
+    auto written = ::pwrite(this->handle_, buffer, buffer_len, position);
+#else
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = static_cast<DWORD>(position);
+    overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(position) >> 32);
+
+    DWORD written_bytes = 0;
+    const int64_t written = WriteFile((HANDLE)_get_osfhandle(this->handle_), buffer, safe_cast<DWORD>(buffer_len), &written_bytes, &overlapped)
+      ? static_cast<int64_t>(written_bytes)
+      : -1;
+#endif
+    if (0 > written) {
+#ifdef _WIN32
+      auto error = GetLastError();
+#else
+      auto error = errno;
+#endif
+      throw std::system_error(error, std::system_category(), "Unable to write file " + this->filename_.full_name());
+    }
+
+    if (0 == written) {
+      throw std::runtime_error("No data has been written to file " + this->filename_.full_name());
+    }
+
+    position += written;
+    buffer_len -= written;
+    buffer = (const uint8_t *)buffer + written;
+  }
+}
+
 size_t vds::file::length() const
 {
   struct stat buffer;
@@ -169,6 +330,17 @@ size_t vds::file::length(const filename & fn)
   return buffer.st_size;
 }
 
+time_t vds::file::last_write_time(const filename & fn)
+{
+  struct stat buffer;
+  if (0 != stat(fn.local_name().c_str(), &buffer)) {
+    auto error = errno;
+    throw std::system_error(error, std::generic_category(), "Unable to get modification time of " + fn.name());
+  }
+
+  return buffer.st_mtime;
+}
+
 void vds::file::seek(size_t position)
 {
   if (-1L == lseek(this->handle_, position, SEEK_SET)) {
@@ -204,6 +376,21 @@ void vds::file::flush()
 #endif
 }
 
+void vds::file::truncate(size_t length)
+{
+#ifdef _WIN32
+  auto error = _chsize_s(this->handle_, length);
+  if (0 != error) {
+    throw std::system_error(error, std::generic_category(), "Unable to truncate file " + this->filename_.full_name());
+  }
+#else
+  if (0 != ::ftruncate(this->handle_, length)) {
+    auto error = errno;
+    throw std::system_error(error, std::generic_category(), "Unable to truncate file " + this->filename_.full_name());
+  }
+#endif
+}
+
 vds::output_text_stream::output_text_stream(file & f)
   : f_(f), written_(0)
 {
@@ -329,11 +516,28 @@ vds::const_data_buffer vds::file::read_all(const vds::filename& fn)
 {
   file f(fn, file::file_mode::open_read);
   
-  std::vector<uint8_t> buffer(f.length());
-  
-  f.read(buffer.data(), buffer.size());
-  
-  return const_data_buffer(buffer.data(), buffer.size());
+  const_data_buffer result;
+  result.resize(f.length());
+
+  if (result.size() != f.read_at(0, result.data(), result.size())) {
+    throw std::runtime_error("Unexpected end of file " + fn.full_name());
+  }
+
+  return result;
+}
+
+vds::const_data_buffer vds::file::read_range(const vds::filename& fn, size_t position, size_t size)
+{
+  file f(fn, file::file_mode::open_read);
+
+  const_data_buffer result;
+  result.resize(size);
+
+  if (size != f.read_at(position, result.data(), size)) {
+    throw std::runtime_error("Unexpected end of file " + fn.full_name());
+  }
+
+  return result;
 }
 
 void vds::file::write_all(const vds::filename &fn, const vds::const_data_buffer &data) {
@@ -45,17 +45,36 @@ namespace vds {
     };
 
 
+    //Alignment of buffers, positions and sizes for direct I/O
+    static constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
     file();
-    file(const filename & filename, file_mode mode);
+    file(const filename & filename, file_mode mode, bool direct_io = false);
     ~file();
 
-    void open(const filename & filename, file_mode mode);
+    //Direct I/O bypasses the page cache where the platform and the file system support it
+    void open(const filename & filename, file_mode mode, bool direct_io = false);
     void close();
+
+    bool is_direct_io() const { return this->direct_io_; }
+
+    //Switch back to buffered I/O, e.g. to write an unaligned tail
+    void disable_direct_io();
+
+    //Hint the operating system that the file will be read sequentially
+    void advise_sequential();
     
     size_t read(
       void * buffer,
       size_t buffer_len);
 
+    //Positional read (pread, ReadFile with the OVERLAPPED offset), the readers of the handle do not race on seek.
+    //Windows moves the file pointer as well
+    size_t read_at(
+      size_t position,
+      void * buffer,
+      size_t buffer_len);
+
     void write(
       const void * buffer,
       size_t buffer_len);
@@ -63,24 +82,41 @@ namespace vds {
     void write(
       const const_data_buffer & buf) { this->write(buf.data(), buf.size()); }
 
+    //Positional write, see read_at
+    void write_at(
+      size_t position,
+      const void * buffer,
+      size_t buffer_len);
+
     size_t length() const;
 
     void seek(size_t position);
 
     static size_t length(const filename & fn);
+    static time_t last_write_time(const filename & fn);
     static bool exists(const filename & fn);
 
     void flush();
 
+    //Drop the data after the position
+    void truncate(size_t length);
+
     static void move(const filename & source, const filename & target);
     static void delete_file(const filename & fn, bool ignore_error = false);
     static std::string read_all_text(const filename & fn);
     static const_data_buffer read_all(const filename & fn);
+    static const_data_buffer read_range(const filename & fn, size_t position, size_t size);
     static void write_all(const filename & fn, const const_data_buffer & data);
 
+    static uint8_t * alloc_aligned(size_t size);
+    static void free_aligned(uint8_t * buffer);
+
   private:
+    friend class _file_service;
+
     filename filename_;
     int handle_;
+    bool direct_io_;
   };
 
   class output_text_stream
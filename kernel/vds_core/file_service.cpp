@@ -0,0 +1,692 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "file_service.h"
+#include "mt_service.h"
+#include "logger.h"
+#include "private/file_service_p.h"
+
+#ifdef VDS_HAS_URING
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+vds::file_service::file_service(
+  bool use_uring,
+  size_t queue_depth,
+  size_t thread_count)
+: use_uring_(use_uring),
+  queue_depth_(queue_depth),
+  thread_count_(thread_count) {
+}
+
+vds::file_service::~file_service() {
+}
+
+void vds::file_service::register_services(service_registrator & registrator) {
+  registrator.add_service<ifile_service>(this);
+}
+
+void vds::file_service::start(const service_provider * sp) {
+  this->impl_.reset(new _file_service(sp, this->use_uring_, this->queue_depth_, this->thread_count_));
+  this->impl_->start();
+}
+
+void vds::file_service::stop() {
+  if (this->impl_) {
+    this->impl_->stop();
+  }
+}
+
+vds::async_task<void> vds::file_service::prepare_to_stop() {
+  co_return;
+}
+
+///////////////////////////////////////////////////////////
+vds::async_task<size_t> vds::ifile_service::read_at(
+  const std::shared_ptr<file> & f,
+  size_t position,
+  void * buffer,
+  size_t size) {
+
+  auto r = std::make_shared<async_result<size_t>>();
+
+  std::list<std::unique_ptr<_file_service::request_t>> requests;
+  requests.push_back(std::unique_ptr<_file_service::request_t>(new _file_service::request_t{
+    _file_service::operation_t::read,
+    f,
+    position,
+    static_cast<uint8_t *>(buffer),
+    size,
+    0,
+    [r](size_t result, const std::exception_ptr & error) {
+      if (error) {
+        r->set_exception(error);
+      }
+      else {
+        r->set_value(result);
+      }
+    }
+  }));
+
+  static_cast<file_service *>(this)->impl_->submit(std::move(requests));
+  return r->get_future();
+}
+
+vds::async_task<void> vds::ifile_service::write_at(
+  const std::shared_ptr<file> & f,
+  size_t position,
+  const void * buffer,
+  size_t size) {
+
+  auto r = std::make_shared<async_result<void>>();
+
+  std::list<std::unique_ptr<_file_service::request_t>> requests;
+  requests.push_back(std::unique_ptr<_file_service::request_t>(new _file_service::request_t{
+    _file_service::operation_t::write,
+    f,
+    position,
+    const_cast<uint8_t *>(static_cast<const uint8_t *>(buffer)),
+    size,
+    0,
+    [r](size_t /*result*/, const std::exception_ptr & error) {
+      if (error) {
+        r->set_exception(error);
+      }
+      else {
+        r->set_value();
+      }
+    }
+  }));
+
+  static_cast<file_service *>(this)->impl_->submit(std::move(requests));
+  return r->get_future();
+}
+
+vds::async_task<void> vds::ifile_service::fsync(
+  const std::shared_ptr<file> & f) {
+
+  auto r = std::make_shared<async_result<void>>();
+
+  std::list<std::unique_ptr<_file_service::request_t>> requests;
+  requests.push_back(std::unique_ptr<_file_service::request_t>(new _file_service::request_t{
+    _file_service::operation_t::fsync,
+    f,
+    0,
+    nullptr,
+    0,
+    0,
+    [r](size_t /*result*/, const std::exception_ptr & error) {
+      if (error) {
+        r->set_exception(error);
+      }
+      else {
+        r->set_value();
+      }
+    }
+  }));
+
+  static_cast<file_service *>(this)->impl_->submit(std::move(requests));
+  return r->get_future();
+}
+
+vds::async_task<std::vector<size_t>> vds::ifile_service::read_batch(
+  const std::vector<read_request_t> & requests) {
+
+  struct batch_state_t {
+    std::mutex mutex;
+    std::vector<size_t> result;
+    size_t pending;
+    std::exception_ptr error;
+    async_result<std::vector<size_t>> r;
+  };
+
+  auto state = std::make_shared<batch_state_t>();
+  state->result.resize(requests.size());
+  state->pending = requests.size();
+  auto f = state->r.get_future();
+
+  if (requests.empty()) {
+    state->r.set_value(std::vector<size_t>());
+    return f;
+  }
+
+  std::list<std::unique_ptr<_file_service::request_t>> batch;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    batch.push_back(std::unique_ptr<_file_service::request_t>(new _file_service::request_t{
+      _file_service::operation_t::read,
+      requests[i].f,
+      requests[i].position,
+      static_cast<uint8_t *>(requests[i].buffer),
+      requests[i].size,
+      0,
+      [state, i](size_t result, const std::exception_ptr & error) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        if (error) {
+          state->error = error;
+        }
+        else {
+          state->result[i] = result;
+        }
+
+        if (0 == --state->pending) {
+          lock.unlock();
+
+          if (state->error) {
+            state->r.set_exception(state->error);
+          }
+          else {
+            state->r.set_value(std::move(state->result));
+          }
+        }
+      }
+    }));
+  }
+
+  static_cast<file_service *>(this)->impl_->submit(std::move(batch));
+  return f;
+}
+
+vds::async_task<vds::const_data_buffer> vds::ifile_service::read_all(const filename & fn) {
+  auto f = std::make_shared<file>(fn, file::file_mode::open_read);
+
+  const_data_buffer result;
+  result.resize(f->length());
+
+  if (result.size() != co_await this->read_at(f, 0, result.data(), result.size())) {
+    throw std::runtime_error("Unexpected end of file " + fn.full_name());
+  }
+
+  co_return result;
+}
+
+vds::async_task<vds::const_data_buffer> vds::ifile_service::read_range(
+  const filename & fn,
+  size_t position,
+  size_t size) {
+
+  auto f = std::make_shared<file>(fn, file::file_mode::open_read);
+
+  const_data_buffer result;
+  result.resize(size);
+
+  if (size != co_await this->read_at(f, position, result.data(), size)) {
+    throw std::runtime_error("Unexpected end of file " + fn.full_name());
+  }
+
+  co_return result;
+}
+
+bool vds::ifile_service::is_uring() const {
+  return static_cast<const file_service *>(this)->impl_->is_uring();
+}
+
+///////////////////////////////////////////////////////////
+vds::_file_service::_file_service(
+  const service_provider * sp,
+  bool use_uring,
+  size_t queue_depth,
+  size_t thread_count)
+: sp_(sp),
+  use_uring_(use_uring),
+  queue_depth_(queue_depth),
+  thread_count_(thread_count),
+  is_shuting_down_(false)
+#ifdef VDS_HAS_URING
+  , ring_fd_(-1),
+  sq_ptr_(MAP_FAILED),
+  sq_ring_size_(0),
+  cq_ptr_(MAP_FAILED),
+  cq_ring_size_(0),
+  sqes_(static_cast<io_uring_sqe *>(MAP_FAILED)),
+  sqes_size_(0),
+  is_ring_failed_(false)
+#endif
+{
+}
+
+vds::_file_service::~_file_service() {
+#ifdef VDS_HAS_URING
+  this->close_uring();
+#endif
+}
+
+void vds::_file_service::start() {
+#ifdef VDS_HAS_URING
+  if (this->use_uring_) {
+    if (this->setup_uring()) {
+      this->completion_thread_ = std::thread(std::bind(&_file_service::completion_thread, this));
+    }
+    else {
+      this->sp_->get<logger>()->warning("file_service", "io_uring is not available, the thread pool is used");
+      this->use_uring_ = false;
+    }
+  }
+#else
+  this->use_uring_ = false;
+#endif
+
+  //The pool is also used when the ring is full
+  for (size_t i = 0; i < this->thread_count_; ++i) {
+    this->work_threads_.push_back(std::thread(std::bind(&_file_service::work_thread, this)));
+  }
+}
+
+void vds::_file_service::stop() {
+#ifdef VDS_HAS_URING
+  if (this->completion_thread_.joinable()) {
+    this->submit_shutdown();
+    this->completion_thread_.join();
+  }
+
+  this->close_uring();
+  this->use_uring_ = false;
+#endif
+
+  {
+    std::unique_lock<std::mutex> lock(this->mutex_);
+    this->is_shuting_down_ = true;
+    this->cond_.notify_all();
+  }
+
+  for (auto & t : this->work_threads_) {
+    t.join();
+  }
+  this->work_threads_.clear();
+}
+
+bool vds::_file_service::is_uring() const {
+  return this->use_uring_;
+}
+
+void vds::_file_service::submit(std::list<std::unique_ptr<request_t>> && requests) {
+#ifdef VDS_HAS_URING
+  if (this->use_uring_) {
+    requests = this->submit_uring(std::move(requests));
+    if (requests.empty()) {
+      return;
+    }
+  }
+#endif
+
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  for (auto & request : requests) {
+    this->queue_.push(std::move(request));
+  }
+  this->cond_.notify_all();
+}
+
+void vds::_file_service::work_thread() {
+  for (;;) {
+    std::unique_ptr<request_t> request;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex_);
+      this->cond_.wait(
+        lock,
+        [this]()->bool { return this->is_shuting_down_ || !this->queue_.empty(); });
+
+      if (this->queue_.empty()) {
+        return;
+      }
+
+      request = std::move(this->queue_.front());
+      this->queue_.pop();
+    }
+
+    std::exception_ptr error;
+    try {
+      this->execute(*request);
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+
+    this->complete(std::move(request), error);
+  }
+}
+
+void vds::_file_service::execute(request_t & request) {
+  switch (request.operation) {
+  case operation_t::read:
+    request.done = request.f->read_at(request.position, request.buffer, request.size);
+    break;
+
+  case operation_t::write:
+    request.f->write_at(request.position, request.buffer, request.size);
+    request.done = request.size;
+    break;
+
+  case operation_t::fsync:
+    request.f->flush();
+    break;
+
+  default:
+    throw std::runtime_error("Invalid file operation");
+  }
+}
+
+void vds::_file_service::complete(std::unique_ptr<request_t> && request, const std::exception_ptr & error) {
+  //Continuations run on mt_service so I/O threads are never blocked by them
+  std::shared_ptr<request_t> r(std::move(request));
+  imt_service::async(this->sp_, [r, error]() {
+    r->callback(r->done, error);
+  });
+}
+
+#ifdef VDS_HAS_URING
+bool vds::_file_service::setup_uring() {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  this->ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(this->queue_depth_), &params));
+  if (0 > this->ring_fd_) {
+    return false;
+  }
+
+  this->sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  this->cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  const bool single_mmap = (0 != (params.features & IORING_FEAT_SINGLE_MMAP));
+  if (single_mmap && this->sq_ring_size_ < this->cq_ring_size_) {
+    this->sq_ring_size_ = this->cq_ring_size_;
+  }
+
+  this->sq_ptr_ = mmap(nullptr, this->sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd_, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == this->sq_ptr_) {
+    this->close_uring();
+    return false;
+  }
+
+  if (single_mmap) {
+    this->cq_ptr_ = this->sq_ptr_;
+  }
+  else {
+    this->cq_ptr_ = mmap(nullptr, this->cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd_, IORING_OFF_CQ_RING);
+    if (MAP_FAILED == this->cq_ptr_) {
+      this->close_uring();
+      return false;
+    }
+  }
+
+  this->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  this->sqes_ = static_cast<io_uring_sqe *>(mmap(nullptr, this->sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd_, IORING_OFF_SQES));
+  if (MAP_FAILED == static_cast<void *>(this->sqes_)) {
+    this->close_uring();
+    return false;
+  }
+
+  auto sq = static_cast<uint8_t *>(this->sq_ptr_);
+  this->sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  this->sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  this->sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  this->sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  this->sq_entries_ = params.sq_entries;
+
+  auto cq = static_cast<uint8_t *>(this->cq_ptr_);
+  this->cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  this->cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  this->cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  this->cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  this->cq_entries_ = params.cq_entries;
+
+  if (!this->probe_uring_ops()) {
+    this->close_uring();
+    return false;
+  }
+
+  return true;
+}
+
+bool vds::_file_service::probe_uring_ops() const {
+  static constexpr unsigned ops_count = 256;
+  std::vector<uint8_t> buffer(sizeof(io_uring_probe) + ops_count * sizeof(io_uring_probe_op));
+  auto probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+
+  //IORING_REGISTER_PROBE is not supported before IORING_OP_READ and IORING_OP_WRITE were added
+  if (0 > syscall(__NR_io_uring_register, this->ring_fd_, IORING_REGISTER_PROBE, probe, ops_count)) {
+    return false;
+  }
+
+  for (const auto op : { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC }) {
+    if (op > probe->last_op || 0 == (probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void vds::_file_service::close_uring() {
+  if (MAP_FAILED != static_cast<void *>(this->sqes_)) {
+    munmap(this->sqes_, this->sqes_size_);
+    this->sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+  }
+
+  if (MAP_FAILED != this->cq_ptr_ && this->cq_ptr_ != this->sq_ptr_) {
+    munmap(this->cq_ptr_, this->cq_ring_size_);
+  }
+  this->cq_ptr_ = MAP_FAILED;
+
+  if (MAP_FAILED != this->sq_ptr_) {
+    munmap(this->sq_ptr_, this->sq_ring_size_);
+    this->sq_ptr_ = MAP_FAILED;
+  }
+
+  if (0 <= this->ring_fd_) {
+    ::close(this->ring_fd_);
+    this->ring_fd_ = -1;
+  }
+}
+
+std::list<std::unique_ptr<vds::_file_service::request_t>>
+vds::_file_service::submit_uring(std::list<std::unique_ptr<request_t>> && requests) {
+  std::unique_lock<std::mutex> lock(this->sq_mutex_);
+  if (this->is_ring_failed_) {
+    return std::move(requests);
+  }
+
+  auto tail = *this->sq_tail_;
+  const auto head = __atomic_load_n(this->sq_head_, __ATOMIC_ACQUIRE);
+
+  unsigned count = 0;
+  while (!requests.empty()
+    && tail - head < this->sq_entries_
+    //Keep the number of requests in flight below the size of the completion queue
+    && this->in_flight_.size() < this->cq_entries_) {
+
+    auto request = requests.front().release();
+    requests.pop_front();
+
+    const auto index = tail & *this->sq_mask_;
+    auto sqe = &this->sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->fd = request->f->handle_;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+
+    switch (request->operation) {
+    case operation_t::read:
+    case operation_t::write: {
+      auto size = request->size - request->done;
+      if (size > 0x40000000) {
+        size = 0x40000000;
+      }
+
+      sqe->opcode = (operation_t::read == request->operation) ? IORING_OP_READ : IORING_OP_WRITE;
+      sqe->off = request->position + request->done;
+      sqe->addr = reinterpret_cast<uint64_t>(request->buffer + request->done);
+      sqe->len = static_cast<uint32_t>(size);
+      break;
+    }
+
+    case operation_t::fsync:
+      sqe->opcode = IORING_OP_FSYNC;
+      break;
+    }
+
+    this->sq_array_[index] = index;
+    ++tail;
+    ++count;
+    this->in_flight_.insert(request);
+  }
+
+  if (0 < count) {
+    __atomic_store_n(this->sq_tail_, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    while (submitted < count) {
+      const auto result = syscall(__NR_io_uring_enter, this->ring_fd_, count - submitted, 0, 0, nullptr, 0);
+      if (0 > result) {
+        if (EINTR == errno || EAGAIN == errno || EBUSY == errno) {
+          continue;
+        }
+
+        const auto error = std::make_exception_ptr(
+          std::system_error(errno, std::system_category(), "Unable to submit file operation"));
+
+        //Release the entries which the kernel has not consumed and fail their requests
+        const auto rest = count - submitted;
+        __atomic_store_n(this->sq_tail_, tail - rest, __ATOMIC_RELEASE);
+        for (auto i = tail - rest; i != tail; ++i) {
+          std::unique_ptr<request_t> request(
+            reinterpret_cast<request_t *>(this->sqes_[i & *this->sq_mask_].user_data));
+          this->in_flight_.erase(request.get());
+          this->complete(std::move(request), error);
+        }
+        break;
+      }
+
+      submitted += static_cast<unsigned>(result);
+    }
+  }
+
+  return std::move(requests);
+}
+
+void vds::_file_service::submit_shutdown() {
+  std::unique_lock<std::mutex> lock(this->sq_mutex_);
+  if (this->is_ring_failed_) {
+    //The completion thread has already stopped
+    return;
+  }
+
+  //Entries are consumed by io_uring_enter in submit_uring, so the ring is full only for a moment
+  while (*this->sq_tail_ - __atomic_load_n(this->sq_head_, __ATOMIC_ACQUIRE) >= this->sq_entries_) {
+    lock.unlock();
+    std::this_thread::yield();
+    lock.lock();
+  }
+
+  auto tail = *this->sq_tail_;
+  const auto index = tail & *this->sq_mask_;
+  auto sqe = &this->sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_NOP;
+  sqe->user_data = 0;
+
+  this->sq_array_[index] = index;
+  __atomic_store_n(this->sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  while (0 > syscall(__NR_io_uring_enter, this->ring_fd_, 1, 0, 0, nullptr, 0) && EINTR == errno) {
+  }
+}
+
+void vds::_file_service::completion_thread() {
+  bool is_shuting_down = false;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(this->sq_mutex_);
+      if (is_shuting_down && this->in_flight_.empty()) {
+        return;
+      }
+    }
+
+    if (0 > syscall(__NR_io_uring_enter, this->ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0)) {
+      const auto error = errno;
+      if (EINTR == error) {
+        continue;
+      }
+
+      this->sp_->get<logger>()->error("file_service", "io_uring_enter failed with error %d", error);
+      this->fail_in_flight(error);
+      return;
+    }
+
+    auto head = *this->cq_head_;
+    const auto tail = __atomic_load_n(this->cq_tail_, __ATOMIC_ACQUIRE);
+
+    std::list<std::unique_ptr<request_t>> resubmit;
+    while (head != tail) {
+      const auto & cqe = this->cqes_[head & *this->cq_mask_];
+      ++head;
+
+      if (0 == cqe.user_data) {
+        is_shuting_down = true;
+        continue;
+      }
+
+      std::unique_ptr<request_t> request(reinterpret_cast<request_t *>(cqe.user_data));
+      {
+        std::unique_lock<std::mutex> lock(this->sq_mutex_);
+        this->in_flight_.erase(request.get());
+      }
+
+      if (0 > cqe.res) {
+        auto error = std::make_exception_ptr(
+          std::system_error(-cqe.res, std::system_category(), "Unable to access file " + request->f->filename_.full_name()));
+        this->complete(std::move(request), error);
+        continue;
+      }
+
+      //Zero only means the end of file for reads, a write which makes no progress would be resubmitted forever
+      if (operation_t::write == request->operation && 0 == cqe.res && request->done < request->size) {
+        auto error = std::make_exception_ptr(
+          std::runtime_error("No data has been written to file " + request->f->filename_.full_name()));
+        this->complete(std::move(request), error);
+        continue;
+      }
+
+      request->done += static_cast<size_t>(cqe.res);
+
+      //Partial transfer; direct reads are short only at the end of file
+      if (operation_t::fsync != request->operation
+        && 0 < cqe.res
+        && request->done < request->size
+        && (operation_t::write == request->operation || !request->f->is_direct_io())) {
+        resubmit.push_back(std::move(request));
+        continue;
+      }
+
+      this->complete(std::move(request), std::exception_ptr());
+    }
+
+    __atomic_store_n(this->cq_head_, head, __ATOMIC_RELEASE);
+
+    if (!resubmit.empty()) {
+      this->submit(std::move(resubmit));
+    }
+  }
+}
+
+void vds::_file_service::fail_in_flight(int error) {
+  std::list<std::unique_ptr<request_t>> requests;
+  {
+    std::unique_lock<std::mutex> lock(this->sq_mutex_);
+    this->is_ring_failed_ = true;
+
+    for (auto request : this->in_flight_) {
+      requests.push_back(std::unique_ptr<request_t>(request));
+    }
+    this->in_flight_.clear();
+  }
+
+  const auto ex = std::make_exception_ptr(
+    std::system_error(error, std::system_category(), "Unable to wait for file operations"));
+  for (auto & request : requests) {
+    this->complete(std::move(request), ex);
+  }
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef __VDS_CORE_FILE_SERVICE_H_
+#define __VDS_CORE_FILE_SERVICE_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <vector>
+#include "service_provider.h"
+#include "async_task.h"
+#include "file.h"
+
+namespace vds {
+  class _file_service;
+
+  /**
+   * \brief Asynchronous file I/O which does not hold mt_service threads while the disk is busy.
+   * Uses io_uring on Linux and a dedicated I/O thread pool elsewhere.
+   */
+  class ifile_service
+  {
+  public:
+    struct read_request_t {
+      std::shared_ptr<file> f;
+      size_t position;
+      void * buffer;
+      size_t size;
+    };
+
+    //Read from the position until the buffer is full or the end of file
+    async_task<size_t> read_at(
+      const std::shared_ptr<file> & f,
+      size_t position,
+      void * buffer,
+      size_t size);
+
+    async_task<void> write_at(
+      const std::shared_ptr<file> & f,
+      size_t position,
+      const void * buffer,
+      size_t size);
+
+    async_task<void> fsync(
+      const std::shared_ptr<file> & f);
+
+    //Submit several reads at once
+    async_task<std::vector<size_t>> read_batch(
+      const std::vector<read_request_t> & requests);
+
+    async_task<const_data_buffer> read_all(const filename & fn);
+
+    async_task<const_data_buffer> read_range(
+      const filename & fn,
+      size_t position,
+      size_t size);
+
+    bool is_uring() const;
+  };
+
+  class file_service : public iservice_factory, public ifile_service
+  {
+  public:
+    static constexpr size_t DEFAULT_QUEUE_DEPTH = 256;
+    static constexpr size_t DEFAULT_THREAD_COUNT = 4;
+
+    //Set use_uring to false to force the thread pool
+    file_service(
+      bool use_uring = true,
+      size_t queue_depth = DEFAULT_QUEUE_DEPTH,
+      size_t thread_count = DEFAULT_THREAD_COUNT);
+    ~file_service();
+
+    void register_services(service_registrator &) override;
+    void start(const service_provider *) override;
+    void stop() override;
+    vds::async_task<void> prepare_to_stop() override;
+
+  private:
+    friend class ifile_service;
+
+    bool use_uring_;
+    size_t queue_depth_;
+    size_t thread_count_;
+    std::unique_ptr<_file_service> impl_;
+  };
+}
+
+#endif // __VDS_CORE_FILE_SERVICE_H_
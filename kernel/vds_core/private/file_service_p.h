@@ -0,0 +1,124 @@
+#ifndef __VDS_CORE_FILE_SERVICE_P_H_
+#define __VDS_CORE_FILE_SERVICE_P_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <thread>
+#include <condition_variable>
+
+#include "service_provider.h"
+#include "file.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define VDS_HAS_URING
+#endif
+#endif
+
+#ifdef VDS_HAS_URING
+#include <linux/io_uring.h>
+#endif
+
+namespace vds {
+
+  class _file_service
+  {
+  public:
+    enum class operation_t {
+      read,
+      write,
+      fsync
+    };
+
+    struct request_t {
+      operation_t operation;
+      std::shared_ptr<file> f;
+      size_t position;
+      uint8_t * buffer;
+      size_t size;
+      size_t done;
+      std::function<void(size_t result, const std::exception_ptr & error)> callback;
+    };
+
+    _file_service(
+      const service_provider * sp,
+      bool use_uring,
+      size_t queue_depth,
+      size_t thread_count);
+    ~_file_service();
+
+    void start();
+    void stop();
+
+    //All requests are submitted with one system call if io_uring is available
+    void submit(std::list<std::unique_ptr<request_t>> && requests);
+
+    bool is_uring() const;
+
+  private:
+    const service_provider * sp_;
+    bool use_uring_;
+    size_t queue_depth_;
+    size_t thread_count_;
+    bool is_shuting_down_;
+
+    //Thread pool fallback
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::queue<std::unique_ptr<request_t>> queue_;
+    std::list<std::thread> work_threads_;
+
+    void work_thread();
+    void execute(request_t & request);
+    void complete(std::unique_ptr<request_t> && request, const std::exception_ptr & error);
+
+#ifdef VDS_HAS_URING
+    int ring_fd_;
+
+    void * sq_ptr_;
+    size_t sq_ring_size_;
+    void * cq_ptr_;
+    size_t cq_ring_size_;
+    io_uring_sqe * sqes_;
+    size_t sqes_size_;
+
+    unsigned * sq_head_;
+    unsigned * sq_tail_;
+    unsigned * sq_mask_;
+    unsigned * sq_array_;
+    unsigned sq_entries_;
+
+    unsigned * cq_head_;
+    unsigned * cq_tail_;
+    unsigned * cq_mask_;
+    io_uring_cqe * cqes_;
+    unsigned cq_entries_;
+
+    std::mutex sq_mutex_;
+    std::set<request_t *> in_flight_;
+    //io_uring_enter failed in the completion thread, new requests go to the thread pool
+    bool is_ring_failed_;
+    std::thread completion_thread_;
+
+    bool setup_uring();
+    //The kernel has to support all opcodes used by submit_uring
+    bool probe_uring_ops() const;
+    void close_uring();
+
+    //Returns requests which do not fit into the queue
+    std::list<std::unique_ptr<request_t>> submit_uring(std::list<std::unique_ptr<request_t>> && requests);
+    void submit_shutdown();
+    void completion_thread();
+    void fail_in_flight(int error);
+#endif
+  };
+}
+
+#endif // __VDS_CORE_FILE_SERVICE_P_H_
@@ -1,3 +1,270 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
 #include "stdafx.h"
 #include "stream.h"
+#include "mt_service.h"
+#include "file_service.h"
 
+namespace vds {
+  //Buffer aligned for direct I/O
+  class _file_stream_buffer {
+  public:
+    _file_stream_buffer(size_t size)
+      : data_(file::alloc_aligned(size)) {
+    }
+
+    ~_file_stream_buffer() {
+      file::free_aligned(this->data_);
+    }
+
+    uint8_t * data() const {
+      return this->data_;
+    }
+
+  private:
+    uint8_t * data_;
+  };
+}
+
+//The coroutine frame keeps the file and the buffer alive while the operation is in progress
+static vds::async_task<size_t> read_buffer(
+  vds::ifile_service * file_service,
+  std::shared_ptr<vds::file> f,
+  std::shared_ptr<vds::_file_stream_buffer> buffer,
+  size_t position,
+  size_t size) {
+  co_return co_await file_service->read_at(f, position, buffer->data(), size);
+}
+
+static vds::async_task<void> write_buffer(
+  vds::ifile_service * file_service,
+  std::shared_ptr<vds::file> f,
+  std::shared_ptr<vds::_file_stream_buffer> buffer,
+  size_t position,
+  size_t size) {
+  co_await file_service->write_at(f, position, buffer->data(), size);
+}
+
+static size_t align_buffer_size(size_t buffer_size) {
+  if (buffer_size < vds::file::DIRECT_IO_ALIGNMENT) {
+    return vds::file::DIRECT_IO_ALIGNMENT;
+  }
+
+  return (buffer_size + vds::file::DIRECT_IO_ALIGNMENT - 1) / vds::file::DIRECT_IO_ALIGNMENT * vds::file::DIRECT_IO_ALIGNMENT;
+}
+
+///////////////////////////////////////////////////////////
+vds::file_stream_input_async::file_stream_input_async(
+  const filename & fn,
+  size_t buffer_size,
+  bool direct_io,
+  const service_provider * sp)
+: sp_(sp),
+  f_(std::make_shared<file>(fn, file::file_mode::open_read, direct_io)),
+  buffer_size_(align_buffer_size(buffer_size)),
+  position_(0),
+  current_(std::make_shared<_file_stream_buffer>(this->buffer_size_)),
+  processed_(0),
+  readed_(0),
+  eof_(false) {
+
+  this->f_->advise_sequential();
+
+  if (nullptr != this->sp_) {
+    this->next_ = std::make_shared<_file_stream_buffer>(this->buffer_size_);
+  }
+}
+
+vds::file_stream_input_async::~file_stream_input_async() {
+  //The background read owns the buffer and the file
+  if (this->prefetch_) {
+    this->prefetch_->detach();
+  }
+}
+
+vds::async_task<size_t> vds::file_stream_input_async::read_async(
+  uint8_t * buffer,
+  size_t len) {
+  for (;;) {
+    if (this->readed_ > this->processed_) {
+      if (len > this->readed_ - this->processed_) {
+        len = this->readed_ - this->processed_;
+      }
+
+      memcpy(buffer, this->current_->data() + this->processed_, len);
+      this->processed_ += len;
+      co_return len;
+    }
+
+    if (this->eof_) {
+      co_return 0;
+    }
+
+    if (this->prefetch_) {
+      auto prefetch = std::move(*this->prefetch_);
+      this->prefetch_.reset();
+
+      this->readed_ = co_await std::move(prefetch);
+      std::swap(this->current_, this->next_);
+    }
+    else {
+      this->readed_ = this->f_->read_at(this->position_, this->current_->data(), this->buffer_size_);
+    }
+
+    this->processed_ = 0;
+    this->position_ += this->readed_;
+
+    if (this->readed_ < this->buffer_size_) {
+      this->eof_ = true;
+    }
+    else {
+      this->start_prefetch();
+    }
+  }
+}
+
+void vds::file_stream_input_async::start_prefetch() {
+  if (nullptr == this->sp_) {
+    return;
+  }
+
+  const auto file_service = this->sp_->get<ifile_service>(false);
+  if (nullptr != file_service) {
+    this->prefetch_.reset(new async_task<size_t>(
+      read_buffer(file_service, this->f_, this->next_, this->position_, this->buffer_size_)));
+    return;
+  }
+
+  auto r = std::make_shared<async_result<size_t>>();
+  this->prefetch_.reset(new async_task<size_t>(r->get_future()));
+
+  imt_service::async(
+    this->sp_,
+    [r, f = this->f_, buffer = this->next_, position = this->position_, size = this->buffer_size_]() {
+    try {
+      r->set_value(f->read_at(position, buffer->data(), size));
+    }
+    catch (...) {
+      r->set_exception(std::current_exception());
+    }
+  });
+}
+
+///////////////////////////////////////////////////////////
+vds::file_stream_output_async::file_stream_output_async(
+  const filename & fn,
+  file::file_mode mode,
+  size_t buffer_size,
+  bool direct_io,
+  const service_provider * sp)
+: sp_(sp),
+  f_(std::make_shared<file>(fn, mode, direct_io)),
+  buffer_size_(align_buffer_size(buffer_size)),
+  position_((file::file_mode::append == mode) ? this->f_->length() : 0),
+  current_(std::make_shared<_file_stream_buffer>(this->buffer_size_)),
+  filled_(0) {
+
+  if (nullptr != this->sp_) {
+    this->next_ = std::make_shared<_file_stream_buffer>(this->buffer_size_);
+  }
+}
+
+vds::file_stream_output_async::~file_stream_output_async() {
+  //The background write owns the buffer and the file
+  if (this->pending_) {
+    this->pending_->detach();
+  }
+}
+
+vds::async_task<void> vds::file_stream_output_async::write_async(
+  const uint8_t * data,
+  size_t len) {
+
+  if (0 == len) {
+    if (this->pending_) {
+      auto pending = std::move(*this->pending_);
+      this->pending_.reset();
+
+      co_await std::move(pending);
+    }
+
+    size_t offset = 0;
+    if (this->f_->is_direct_io()) {
+      offset = this->filled_ / file::DIRECT_IO_ALIGNMENT * file::DIRECT_IO_ALIGNMENT;
+      if (0 < offset) {
+        this->f_->write_at(this->position_, this->current_->data(), offset);
+      }
+
+      //Direct writes must be aligned, so the rest of data is written with buffered I/O
+      this->f_->disable_direct_io();
+    }
+
+    if (offset < this->filled_) {
+      this->f_->write_at(this->position_ + offset, this->current_->data() + offset, this->filled_ - offset);
+    }
+
+    this->position_ += this->filled_;
+    this->filled_ = 0;
+    this->f_->close();
+    co_return;
+  }
+
+  while (0 < len) {
+    auto size = this->buffer_size_ - this->filled_;
+    if (size > len) {
+      size = len;
+    }
+
+    memcpy(this->current_->data() + this->filled_, data, size);
+    this->filled_ += size;
+    data += size;
+    len -= size;
+
+    if (this->filled_ == this->buffer_size_) {
+      co_await this->write_buffer();
+    }
+  }
+}
+
+vds::async_task<void> vds::file_stream_output_async::write_buffer() {
+  if (this->pending_) {
+    auto pending = std::move(*this->pending_);
+    this->pending_.reset();
+
+    co_await std::move(pending);
+  }
+
+  const auto file_service = (nullptr == this->sp_) ? nullptr : this->sp_->get<ifile_service>(false);
+  if (nullptr != file_service) {
+    this->pending_.reset(new async_task<void>(
+      ::write_buffer(file_service, this->f_, this->current_, this->position_, this->filled_)));
+
+    std::swap(this->current_, this->next_);
+  }
+  else if (nullptr != this->sp_) {
+    auto r = std::make_shared<async_result<void>>();
+    this->pending_.reset(new async_task<void>(r->get_future()));
+
+    imt_service::async(
+      this->sp_,
+      [r, f = this->f_, buffer = this->current_, position = this->position_, size = this->filled_]() {
+      try {
+        f->write_at(position, buffer->data(), size);
+        r->set_value();
+      }
+      catch (...) {
+        r->set_exception(std::current_exception());
+      }
+    });
+
+    std::swap(this->current_, this->next_);
+  }
+  else {
+    this->f_->write_at(this->position_, this->current_->data(), this->filled_);
+  }
+
+  this->position_ += this->filled_;
+  this->filled_ = 0;
+}
@@ -11,6 +11,8 @@ All rights reserved
 #include "file.h"
 
 namespace vds {
+  class service_provider;
+
   template <typename item_type>
   class stream_output_async : public std::enable_shared_from_this<stream_output_async<item_type>> {
   public:
@@ -82,48 +84,74 @@ namespace vds {
     size_t readed_;
   };
 
+  class _file_stream_buffer;
+
   class file_stream_input_async : public stream_input_async<uint8_t> {
   public:
-    file_stream_input_async(const filename & fn)
-      : f_(fn, file::file_mode::open_read),
-    processed_(0),
-    readed_(0),
-    eof_(0) {
-    }
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+    //With the service provider the next buffer is read in background while the current one is processed.
+    //ifile_service is used for background reads if it is registered, otherwise imt_service.
+    file_stream_input_async(
+      const filename & fn,
+      size_t buffer_size = DEFAULT_BUFFER_SIZE,
+      bool direct_io = false,
+      const service_provider * sp = nullptr);
+    ~file_stream_input_async();
 
     vds::async_task<size_t> read_async(
-      
       uint8_t * buffer,
-      size_t len) override {
-      for (;;) {
-        if (this->readed_ > this->processed_) {
-          if (len > this->readed_ - this->processed_) {
-            len = this->readed_ - this->processed_;
-          }
-
-          memcpy(buffer, this->buffer_ + this->processed_, len);
-          this->processed_ += len;
-          co_return len;
-        }
-        if (this->eof_) {
-          co_return 0;
-        }
-        this->processed_ = 0;
-        this->readed_ = this->f_.read(this->buffer_, sizeof(this->buffer_));
-        if (0 == this->readed_) {
-          this->eof_ = true;
-          co_return 0;
-        }
-      }
-    }
+      size_t len) override;
 
   private:
-    file f_;
+    const service_provider * sp_;
+    std::shared_ptr<file> f_;
+    size_t buffer_size_;
+    size_t position_;
 
-    uint8_t buffer_[1024];
+    std::shared_ptr<_file_stream_buffer> current_;
     size_t processed_;
     size_t readed_;
     bool eof_;
+
+    std::shared_ptr<_file_stream_buffer> next_;
+    std::unique_ptr<async_task<size_t>> prefetch_;
+
+    void start_prefetch();
+  };
+
+  class file_stream_output_async : public stream_output_async<uint8_t> {
+  public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+    //With the service provider the full buffer is written in background while the next one is filled.
+    //ifile_service is used for background writes if it is registered, otherwise imt_service.
+    file_stream_output_async(
+      const filename & fn,
+      file::file_mode mode = file::file_mode::truncate,
+      size_t buffer_size = DEFAULT_BUFFER_SIZE,
+      bool direct_io = false,
+      const service_provider * sp = nullptr);
+    ~file_stream_output_async();
+
+    //Empty data flushes the buffer and closes the file
+    vds::async_task<void> write_async(
+      const uint8_t * data,
+      size_t len) override;
+
+  private:
+    const service_provider * sp_;
+    std::shared_ptr<file> f_;
+    size_t buffer_size_;
+    size_t position_;
+
+    std::shared_ptr<_file_stream_buffer> current_;
+    size_t filled_;
+
+    std::shared_ptr<_file_stream_buffer> next_;
+    std::unique_ptr<async_task<void>> pending_;
+
+    vds::async_task<void> write_buffer();
   };
 
   ///////////////////////////////////////////////////////////
@@ -5,6 +5,7 @@ All rights reserved
 
 #include "stdafx.h"
 #include <algorithm>
+#include <random>
 #include "task_manager.h"
 #include "mt_service.h"
 #include "shutdown_event.h"
@@ -33,11 +34,13 @@ vds::task_manager::~task_manager()
 void vds::timer::start(
   const service_provider * sp,
   const std::chrono::steady_clock::duration & period,
-  const std::function<async_task<bool>(void) >& callback)
+  const std::function<async_task<bool>(void) >& callback,
+  const std::chrono::steady_clock::duration & jitter)
 {
   this->sp_ = sp;
   this->current_state_->change_state(state_t::bof, state_t::scheduled).get();
   this->period_ = period;
+  this->jitter_ = jitter;
   this->handler_ = callback;
   
   this->schedule();
@@ -47,10 +50,14 @@ void vds::timer::stop()
 {
 	auto manager = static_cast<task_manager *>(this->sp_->get<task_manager>());
 
-	std::lock_guard<std::mutex> lock(manager->scheduled_mutex_);
-	manager->scheduled_.remove(this);
-  this->is_shuting_down_ = true;
-	this->current_state_->wait(state_t::eof).get();
+  {
+    std::lock_guard<std::mutex> lock(manager->scheduled_mutex_);
+    manager->scheduled_.remove(this);
+    this->is_shuting_down_ = true;
+  }
+
+  //Wait for the running handler, the timer is not scheduled anymore
+	this->current_state_->change_state(state_t::scheduled, state_t::eof).get();
 }
 
 void vds::timer::execute()
@@ -71,8 +78,17 @@ void vds::timer::schedule()
   }
   
   this->start_time_ = std::chrono::steady_clock::now() + this->period_;
+  if (this->jitter_ > std::chrono::steady_clock::duration::zero()) {
+    static thread_local std::minstd_rand generator(std::random_device{}());
+    std::uniform_int_distribution<std::chrono::steady_clock::rep> distribution(0, this->jitter_.count());
+    this->start_time_ += std::chrono::steady_clock::duration(distribution(generator));
+  }
 
   std::lock_guard<std::mutex> lock(manager->scheduled_mutex_);
+  if (this->is_shuting_down_) {
+    return;
+  }
+
   manager->scheduled_.push_back(this);
   this->sp_->get<logger>()->trace("tm", "Add Task %s", this->name_.c_str());
 
@@ -87,16 +103,12 @@ vds::async_task<void> vds::timer::execute_async() {
   try {
     if (!this->is_shuting_down_) {
       co_await this->current_state_->change_state(state_t::scheduled, state_t::in_handler);
-      if (co_await this->handler_()) {
-        co_await this->current_state_->change_state(state_t::in_handler, state_t::scheduled);
+      const auto is_continue = co_await this->handler_();
+      //The timer stays in the scheduled state to be stopped later
+      co_await this->current_state_->change_state(state_t::in_handler, state_t::scheduled);
+      if (is_continue) {
         this->schedule();
       }
-      else {
-        co_await this->current_state_->change_state(state_t::in_handler, state_t::eof);
-      }
-    }
-    else {
-      co_await this->current_state_->change_state(state_t::scheduled, state_t::eof);
     }
   }
   catch (...) {
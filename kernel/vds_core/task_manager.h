@@ -17,10 +17,12 @@ namespace vds {
   public:
     timer(const char * name);
     
+    //Each run is delayed by a random value up to jitter so the timers with equal period do not fire together
     void start(
       const service_provider * sp,
       const std::chrono::steady_clock::duration & period,
-      const std::function<async_task<bool>(void)> & callback);
+      const std::function<async_task<bool>(void)> & callback,
+      const std::chrono::steady_clock::duration & jitter = std::chrono::steady_clock::duration::zero());
     
     void stop();
     
@@ -30,6 +32,7 @@ namespace vds {
 
     friend class task_manager;
     std::chrono::steady_clock::duration period_;
+    std::chrono::steady_clock::duration jitter_;
     std::chrono::time_point<std::chrono::steady_clock> start_time_;
     std::function<async_task<bool>(void)> handler_;
 
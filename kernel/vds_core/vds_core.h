@@ -23,6 +23,7 @@ All rights reserved
 #include "file.h"
 #include "task_manager.h"
 #include "mt_service.h"
+#include "file_service.h"
 #include "simple_cache.h"
 #include "binary_serialize.h"
 #include "const_data_buffer.h"
@@ -119,7 +119,7 @@ namespace vds {
             s = input_buffer_size;
           }
 
-          memcpy(this->input_buffer_, input_buffer, s);
+          memcpy(this->input_buffer_ + this->input_buffer_offset_, input_buffer, s);
 
           this->input_buffer_offset_ += s;
           input_buffer += s;
@@ -237,7 +237,7 @@ namespace vds {
             s = input_buffer_size;
           }
 
-          memcpy(this->input_buffer_, input_buffer, s);
+          memcpy(this->input_buffer_ + this->input_buffer_offset_, input_buffer, s);
 
           this->input_buffer_offset_ += s;
           input_buffer += s;
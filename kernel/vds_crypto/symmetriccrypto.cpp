@@ -196,6 +196,12 @@ vds::symmetric_decrypt::~symmetric_decrypt() {
   delete this->impl_; 
 }
 
+vds::async_task<void> vds::symmetric_decrypt::write_async(
+  const uint8_t * data,
+  size_t len) {
+  return this->impl_->write_async(data, len);
+}
+
 vds::const_data_buffer vds::symmetric_decrypt::decrypt(
   const symmetric_key & key,
   const void * input_buffer,
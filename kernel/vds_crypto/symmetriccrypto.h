@@ -114,6 +114,10 @@ namespace vds {
 
     ~symmetric_decrypt();
 
+    vds::async_task<void> write_async(
+      const uint8_t * data,
+      size_t len) override;
+
     static const_data_buffer decrypt(
       const symmetric_key & key,
       const void * input_buffer,
@@ -11,6 +11,7 @@ All rights reserved
 
 #include "gf.h"
 #include "binary_serialize.h"
+#include "stream.h"
 #include "vds_debug.h"
 
 namespace vds {
@@ -102,6 +103,47 @@ namespace vds {
         cell_type k_;
         cell_type * multipliers_;
     };
+
+    //Horcruxes are added as they arrive, the data is decoded by tiles to the stream when k are present
+    template<typename cell_type>
+    class chunk_decoder
+    {
+    public:
+        static constexpr size_t TILE_SIZE = 64 * 1024;
+
+        chunk_decoder(cell_type k);
+
+        //false if the horcrux is added already or k are present
+        bool add(cell_type n, const const_data_buffer & data);
+
+        bool contains(cell_type n) const;
+
+        bool is_ready() const
+        {
+          return this->k_ <= this->replicas_.size();
+        }
+
+        size_t size() const
+        {
+          return this->replicas_.size();
+        }
+
+        //Size of the decoded data
+        uint64_t data_size() const;
+
+        //The end of stream is not written, so several blocks can be decoded to the same stream
+        async_task<void> restore(const std::shared_ptr<stream_output_async<uint8_t>> & target) const;
+
+    private:
+        cell_type k_;
+        std::vector<cell_type> replicas_;
+        std::vector<const_data_buffer> datas_;
+
+        static uint16_t padding(const const_data_buffer & data)
+        {
+          return uint16_t(data.data()[data.size() - 2] << 8) | data.data()[data.size() - 1];
+        }
+    };
 }
 
 template<typename cell_type>
@@ -359,4 +401,109 @@ inline void vds::chunk_restore<cell_type>::restore(
   }
 }
 
+template<typename cell_type>
+vds::chunk_decoder<cell_type>::chunk_decoder(cell_type k)
+: k_(k)
+{
+  this->replicas_.reserve(k);
+  this->datas_.reserve(k);
+}
+
+template<typename cell_type>
+inline bool vds::chunk_decoder<cell_type>::add(cell_type n, const const_data_buffer & data)
+{
+  if (this->is_ready() || this->contains(n)) {
+    return false;
+  }
+
+  if (data.size() < 2 || 0 != (data.size() - 2) % sizeof(cell_type)) {
+    throw std::runtime_error("Invalid horcrux size");
+  }
+
+  if (!this->datas_.empty()
+    && (this->datas_[0].size() != data.size() || padding(this->datas_[0]) != padding(data))) {
+    throw std::runtime_error("Horcrux does not match the others");
+  }
+
+  this->replicas_.push_back(n);
+  this->datas_.push_back(data);
+  return true;
+}
+
+template<typename cell_type>
+inline bool vds::chunk_decoder<cell_type>::contains(cell_type n) const
+{
+  for (const auto replica : this->replicas_) {
+    if (replica == n) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+template<typename cell_type>
+inline uint64_t vds::chunk_decoder<cell_type>::data_size() const
+{
+  vds_assert(!this->datas_.empty());
+
+  const auto & data = this->datas_[0];
+  uint64_t result = (data.size() - 2) * this->k_;
+
+  const auto data_padding = padding(data);
+  if (0 != data_padding) {
+    result -= sizeof(cell_type) * this->k_;
+    result += data_padding;
+  }
+
+  return result;
+}
+
+template<typename cell_type>
+inline vds::async_task<void> vds::chunk_decoder<cell_type>::restore(
+  const std::shared_ptr<stream_output_async<uint8_t>> & target) const
+{
+  vds_assert(this->is_ready());
+
+  const chunk_restore<cell_type> matrix(this->k_, this->replicas_.data());
+  const auto size = this->datas_[0].size() - 2;
+  const auto expected_size = this->data_size();
+
+  std::vector<uint8_t> tile(TILE_SIZE);
+  size_t tile_size = 0;
+  uint64_t written = 0;
+
+  for (size_t index = 0; index < size && written < expected_size; index += sizeof(cell_type)) {
+    auto m = matrix.multipliers();
+    for (cell_type i = 0; i < this->k_ && written < expected_size; ++i) {
+      cell_type value = 0;
+      for (cell_type j = 0; j < this->k_; ++j) {
+        cell_type cell = 0;
+        for (size_t offset = 0; offset < sizeof(cell_type); ++offset) {
+          cell <<= 8;
+          cell |= this->datas_[j][index + offset];
+        }
+        value = chunk<cell_type>::math().add(value,
+          chunk<cell_type>::math().mul(
+            *m++,
+            cell));
+      }
+
+      for (size_t offset = sizeof(cell_type); offset > 0 && written < expected_size; --offset) {
+        tile[tile_size++] = uint8_t(value >> (8 * (offset - 1)));
+        ++written;
+      }
+    }
+
+    if (TILE_SIZE < tile_size + sizeof(cell_type) * this->k_) {
+      co_await target->write_async(tile.data(), tile_size);
+      tile_size = 0;
+    }
+  }
+
+  if (0 < tile_size) {
+    co_await target->write_async(tile.data(), tile_size);
+  }
+}
+
 #endif//__VDS_DATA_CHUNK_H_
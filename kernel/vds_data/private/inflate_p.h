@@ -46,8 +46,11 @@ namespace vds {
           throw std::runtime_error("inflate failed");
         }
 
+        //Empty write is the end of stream for the target
         auto written = sizeof(buffer) - this->strm_.avail_out;
-        co_await this->target_->write_async(buffer, written);
+        if (0 < written) {
+          co_await this->target_->write_async(buffer, written);
+        }
       } while(0 == this->strm_.avail_out);
     }
 
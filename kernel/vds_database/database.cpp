@@ -57,6 +57,27 @@ int vds::database_transaction::last_insert_rowid() const {
   return this->impl_->last_insert_rowid();
 }
 
+void vds::database_transaction::on_commit(const std::function<void(void)> & handler) {
+  this->commit_handlers_.push_back(handler);
+}
+
+void vds::database_transaction::before_commit(const std::function<void(void)> & handler) {
+  this->before_commit_handlers_.push_back(handler);
+}
+
+void vds::database_transaction::on_rollback(const std::function<void(void)> & handler) {
+  //Undo in the reverse order
+  this->rollback_handlers_.push_front(handler);
+}
+
+void vds::database_transaction::savepoint(const std::function<void(void)> & handler) {
+  this->impl_->savepoint(*this, handler);
+}
+
+uint64_t vds::database_read_transaction::rollback_count() const {
+  return this->impl_->rollback_count();
+}
+
 vds::sql_statement vds::database_read_transaction::parse(const char * sql) const
 {
   return this->impl_->parse(sql);
@@ -9,6 +9,7 @@ All rights reserved
 #include <map>
 #include <string>
 #include <mutex>
+#include <functional>
 
 #include "filename.h"
 #include "const_data_buffer.h"
@@ -57,6 +58,9 @@ namespace vds {
   public:
     sql_statement parse(const char * sql) const;
 
+    //Number of the rolled back transactions, lets in-memory caches drop changes which were not committed
+    uint64_t rollback_count() const;
+
     template <typename command_type>
     sql_statement get_reader(const command_type & command) const
     {
@@ -89,10 +93,24 @@ namespace vds {
     int rows_modified() const;
     int last_insert_rowid() const;
 
+    //Handlers keep in-memory state in step with the transaction outcome
+    void on_commit(const std::function<void(void)> & handler);
+    void on_rollback(const std::function<void(void)> & handler);
+
+    //Called before the commit, an exception rolls the transaction back
+    void before_commit(const std::function<void(void)> & handler);
+
+    //The changes of the handler are rolled back alone if it throws, the exception is passed on
+    void savepoint(const std::function<void(void)> & handler);
+
   private:
     friend class _database;
     friend class database;
 
+    std::list<std::function<void(void)>> before_commit_handlers_;
+    std::list<std::function<void(void)>> commit_handlers_;
+    std::list<std::function<void(void)>> rollback_handlers_;
+
     database_transaction(const std::shared_ptr<_database> & impl)
       : database_read_transaction(impl) {
     }
@@ -6,6 +6,7 @@ Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
 All rights reserved
 */
 
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -199,7 +200,8 @@ namespace vds {
     _database(const service_provider * sp)
     : sp_(sp),
       db_(nullptr),
-      execute_queue_(std::make_shared<thread_apartment>(sp))
+      execute_queue_(std::make_shared<thread_apartment>(sp)),
+      rollback_count_(0)
     {
     }
 
@@ -302,25 +304,37 @@ namespace vds {
         bool result;
         try {
           result = callback(tr);
+          if (result) {
+            for (const auto & handler : tr.before_commit_handlers_) {
+              handler();
+            }
+          }
         }
         catch (const std::exception & ex) {
           pthis->sp_->get<logger>()->trace("DB", "%s at transaction", ex.what());
           pthis->execute("ROLLBACK TRANSACTION");
+          ++pthis->rollback_count_;
+          pthis->run_handlers(tr.rollback_handlers_);
           r->set_exception(std::current_exception());
           return;
         }
         catch (...) {
           pthis->sp_->get<logger>()->trace("DB", "Unexpected error at transaction");
           pthis->execute("ROLLBACK TRANSACTION");
+          ++pthis->rollback_count_;
+          pthis->run_handlers(tr.rollback_handlers_);
           r->set_exception(std::current_exception());
           return;
         }
 
         if (result) {
           pthis->execute("COMMIT TRANSACTION");
+          pthis->run_handlers(tr.commit_handlers_);
         }
         else {
           pthis->execute("ROLLBACK TRANSACTION");
+          ++pthis->rollback_count_;
+          pthis->run_handlers(tr.rollback_handlers_);
         }
 
         r->set_value();
@@ -329,6 +343,53 @@ namespace vds {
       return r->get_future();
     }
 
+    void run_handlers(const std::list<std::function<void(void)>> & handlers) {
+      for (const auto & handler : handlers) {
+        try {
+          handler();
+        }
+        catch (const std::exception & ex) {
+          this->sp_->get<logger>()->warning("DB", "%s at transaction handler", ex.what());
+        }
+        catch (...) {
+          this->sp_->get<logger>()->warning("DB", "Unexpected error at transaction handler");
+        }
+      }
+    }
+
+    void savepoint(
+      database_transaction & tr,
+      const std::function<void(void)> & handler) {
+
+      const auto before_commit_count = tr.before_commit_handlers_.size();
+      const auto commit_count = tr.commit_handlers_.size();
+      const auto rollback_count = tr.rollback_handlers_.size();
+
+      this->execute("SAVEPOINT nested_transaction");
+      try {
+        handler();
+      }
+      catch (...) {
+        this->execute("ROLLBACK TO SAVEPOINT nested_transaction");
+        this->execute("RELEASE SAVEPOINT nested_transaction");
+        ++this->rollback_count_;
+
+        //Only the handlers registered after the savepoint belong to the rolled back changes
+        std::list<std::function<void(void)>> rollback_handlers;
+        rollback_handlers.splice(
+          rollback_handlers.end(),
+          tr.rollback_handlers_,
+          tr.rollback_handlers_.begin(),
+          std::next(tr.rollback_handlers_.begin(), tr.rollback_handlers_.size() - rollback_count));
+        tr.before_commit_handlers_.resize(before_commit_count);
+        tr.commit_handlers_.resize(commit_count);
+        this->run_handlers(rollback_handlers);
+        throw;
+      }
+
+      this->execute("RELEASE SAVEPOINT nested_transaction");
+    }
+
     vds::async_task<void> prepare_to_stop(){
       return this->execute_queue_->prepare_to_stop();
     }
@@ -361,10 +422,15 @@ namespace vds {
       return this->execute_queue_->size();
     }
 
+    uint64_t rollback_count() const {
+      return this->rollback_count_;
+    }
+
   private:
     const service_provider * sp_;
     sqlite3 * db_;    
     std::shared_ptr<thread_apartment> execute_queue_;
+    std::atomic<uint64_t> rollback_count_;
   };
 }
 
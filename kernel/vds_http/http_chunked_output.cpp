@@ -0,0 +1,31 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "stdafx.h"
+#include "http_chunked_output.h"
+
+vds::http_chunked_output_async::http_chunked_output_async(
+  const std::shared_ptr<stream_output_async<uint8_t>>& target)
+: target_(target) {
+}
+
+vds::async_task<void> vds::http_chunked_output_async::write_async(
+  const uint8_t* data,
+  size_t len) {
+
+  if (0 == len) {
+    static const char last_chunk[] = "0\r\n\r\n";
+    co_await this->target_->write_async(reinterpret_cast<const uint8_t *>(last_chunk), sizeof(last_chunk) - 1);
+    co_await this->target_->write_async(nullptr, 0);
+    co_return;
+  }
+
+  char header[32];
+  const auto header_size = snprintf(header, sizeof(header), "%zx\r\n", len);
+
+  co_await this->target_->write_async(reinterpret_cast<const uint8_t *>(header), header_size);
+  co_await this->target_->write_async(data, len);
+  co_await this->target_->write_async(reinterpret_cast<const uint8_t *>("\r\n"), 2);
+}
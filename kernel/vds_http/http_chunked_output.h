@@ -0,0 +1,35 @@
+#ifndef __VDS_HTTP_HTTP_CHUNKED_OUTPUT_H_
+#define __VDS_HTTP_HTTP_CHUNKED_OUTPUT_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "stream.h"
+
+namespace vds {
+  /**
+   * \brief Writes the body with "Transfer-Encoding: chunked", one chunk per write.
+   * Empty write sends the last chunk and closes the target.
+   */
+  class http_chunked_output_async : public stream_output_async<uint8_t>
+  {
+  public:
+    http_chunked_output_async(
+      const std::shared_ptr<stream_output_async<uint8_t>> & target);
+
+    vds::async_task<void> write_async(
+      const uint8_t *data,
+      size_t len) override;
+
+    vds::async_task<void> write_async(const std::string & data) {
+      return this->write_async(reinterpret_cast<const uint8_t *>(data.c_str()), data.length());
+    }
+
+  private:
+    std::shared_ptr<stream_output_async<uint8_t>> target_;
+  };
+}
+
+#endif // __VDS_HTTP_HTTP_CHUNKED_OUTPUT_H_
@@ -66,6 +66,13 @@ namespace vds {
       int result_code = HTTP_OK,
       const std::string & message = "OK");
 
+    //The body has to be written with http_chunked_output_async
+    static http_message chunked_response(
+      const std::shared_ptr<stream_input_async<uint8_t>> & body,
+      const std::string & content_type,
+      int result_code = HTTP_OK,
+      const std::string & message = "OK");
+
     static http_message redirect(
       const std::string & location);
 
@@ -8,6 +8,7 @@ All rights reserved
 #include "http_response.h"
 #include "http_outgoing_stream.h"
 #include "http_request.h"
+#include "file_service.h"
 
 
 vds::async_task<vds::http_message> vds::http_route_handler::static_handler::process(
@@ -41,7 +42,16 @@ vds::async_task<vds::http_message> vds::http_route_handler::file_handler::proces
   }
 
   co_await request.get_message().ignore_empty_body();
-  co_return http_response::simple_text_response(file::read_all_text(this->fn_), content_type);
+
+  const auto file_service = sp->get<ifile_service>(false);
+  if (nullptr == file_service) {
+    co_return http_response::simple_text_response(file::read_all_text(this->fn_), content_type);
+  }
+
+  const auto body = co_await file_service->read_all(this->fn_);
+  co_return http_response::simple_text_response(
+    std::string(reinterpret_cast<const char *>(body.data()), body.size()),
+    content_type);
 }
 
 vds::async_task<vds::http_message> vds::http_route_handler::auth_handler::process(
@@ -0,0 +1,39 @@
+#ifndef __VDS_DB_MODEL_CHANNEL_MESSAGE_DBO_H_
+#define __VDS_DB_MODEL_CHANNEL_MESSAGE_DBO_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "database_orm.h"
+#include "const_data_buffer.h"
+
+namespace vds {
+  namespace orm {
+    //Channel messages of the applied transaction blocks, indexed by (channel_id, order_no)
+    class channel_message_dbo : public database_table {
+    public:
+      channel_message_dbo()
+          : database_table("channel_message"),
+            block_id(this, "block_id"),
+            message_index(this, "message_index"),
+            channel_id(this, "channel_id"),
+            order_no(this, "order_no"),
+            read_cert_subject(this, "read_cert_subject"),
+            crypted_key(this, "crypted_key"),
+            crypted_data(this, "crypted_data") {
+      }
+
+      database_column<const_data_buffer, std::string> block_id;
+      database_column<int> message_index;
+      database_column<const_data_buffer, std::string> channel_id;
+      database_column<int64_t> order_no;
+      database_column<std::string> read_cert_subject;
+      database_column<const_data_buffer> crypted_key;
+      database_column<const_data_buffer> crypted_data;
+    };
+  }
+}
+
+#endif //__VDS_DB_MODEL_CHANNEL_MESSAGE_DBO_H_
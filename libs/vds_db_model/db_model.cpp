@@ -47,6 +47,16 @@ void vds::db_model::start(const service_provider * sp)
 	}
 }
 
+void vds::db_model::start_in_memory(const service_provider * sp)
+{
+	this->db_.open(sp, filename(":memory:"));
+
+	this->db_.async_transaction([this](database_transaction & t) {
+		this->migrate(t, 0);
+		return true;
+	}).get();
+}
+
 void vds::db_model::stop()
 {
 	this->db_.close();
@@ -235,6 +245,97 @@ void vds::db_model::migrate(
 
     t.execute("INSERT INTO module(id, version, installed) VALUES('kernel', 1, datetime('now'))");
 	}
+
+  if (2 > db_version) {
+    t.execute("ALTER TABLE device_config ADD COLUMN used_size INTEGER NOT NULL DEFAULT 0");
+
+    t.execute("UPDATE module SET version=2 WHERE id='kernel'");
+  }
+
+  if (3 > db_version) {
+    t.execute("ALTER TABLE device_record ADD COLUMN data_offset INTEGER NOT NULL DEFAULT -1");
+
+    t.execute("CREATE TABLE replica_segment(\
+      local_path VARCHAR(254) PRIMARY KEY NOT NULL,\
+      storage_path VARCHAR(254) NOT NULL,\
+      data_size INTEGER NOT NULL,\
+      live_size INTEGER NOT NULL,\
+      state INTEGER NOT NULL)");
+
+    t.execute("CREATE INDEX fk_device_record_local_path ON device_record(local_path)");
+
+    t.execute("UPDATE module SET version=3 WHERE id='kernel'");
+  }
+
+  if (4 > db_version) {
+    t.execute("CREATE TABLE channel_message(\
+      block_id VARCHAR(64) NOT NULL,\
+      message_index INTEGER NOT NULL,\
+      channel_id VARCHAR(64) NOT NULL,\
+      order_no INTEGER NOT NULL,\
+      read_cert_subject VARCHAR(64) NOT NULL,\
+      crypted_key BLOB NOT NULL,\
+      crypted_data BLOB NOT NULL,\
+      CONSTRAINT pk_channel_message PRIMARY KEY(block_id,message_index))");
+
+    t.execute("CREATE INDEX fk_channel_message_channel ON channel_message(channel_id,order_no)");
+
+    //The index of the existing blocks is built by transaction_log::build_channel_index
+    t.execute("INSERT INTO module(id, version, installed) VALUES('channel_message', 0, datetime('now'))");
+
+    t.execute("UPDATE module SET version=4 WHERE id='kernel'");
+  }
+
+  if (5 > db_version) {
+    t.execute("CREATE TABLE file_catalog(\
+      channel_id VARCHAR(64) NOT NULL,\
+      file_id VARCHAR(64) NOT NULL,\
+      block_id VARCHAR(64) NOT NULL,\
+      name VARCHAR(254) NOT NULL,\
+      mime_type VARCHAR(254) NOT NULL,\
+      file_size INTEGER NOT NULL,\
+      file_blocks BLOB NOT NULL,\
+      CONSTRAINT pk_file_catalog PRIMARY KEY(channel_id,file_id))");
+
+    t.execute("CREATE INDEX fk_file_catalog_block ON file_catalog(block_id)");
+
+    t.execute("UPDATE module SET version=5 WHERE id='kernel'");
+  }
+
+  if (6 > db_version) {
+    t.execute("CREATE TABLE transaction_log_checkpoint(\
+      id VARCHAR(64) PRIMARY KEY NOT NULL,\
+      order_no INTEGER NOT NULL,\
+      state_data BLOB NOT NULL)");
+
+    t.execute("UPDATE module SET version=6 WHERE id='kernel'");
+  }
+
+  if (7 > db_version) {
+    t.execute("ALTER TABLE device_record ADD COLUMN last_verified INTEGER NOT NULL DEFAULT 0");
+
+    t.execute("CREATE INDEX fk_device_record_last_verified ON device_record(node_id,last_verified)");
+
+    t.execute("UPDATE module SET version=7 WHERE id='kernel'");
+  }
+
+  if (8 > db_version) {
+    t.execute("ALTER TABLE sync_state ADD COLUMN next_check INTEGER NOT NULL DEFAULT 0");
+
+    t.execute("CREATE INDEX fk_sync_state_next_check ON sync_state(state,next_check)");
+    t.execute("CREATE INDEX fk_chunk_last_sync ON chunk(last_sync)");
+
+    t.execute("UPDATE module SET version=8 WHERE id='kernel'");
+  }
+
+  if (9 > db_version) {
+    //NULL until the leader has counted the replicas of the object
+    t.execute("ALTER TABLE sync_state ADD COLUMN redundancy INTEGER");
+
+    t.execute("CREATE INDEX fk_sync_state_redundancy ON sync_state(state,redundancy,next_check)");
+
+    t.execute("UPDATE module SET version=9 WHERE id='kernel'");
+  }
 }
 
 vds::async_task<void> vds::db_model::prepare_to_stop() {
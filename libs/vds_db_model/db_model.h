@@ -21,6 +21,8 @@ namespace vds {
 				const std::function<void(class database_read_transaction & t)> & handler);
 
 	void start(const service_provider * sp);
+	//The database is not saved, many nodes are simulated in one process
+	void start_in_memory(const service_provider * sp);
 	void stop();
 	vds::async_task<void> prepare_to_stop();
 
@@ -19,6 +19,7 @@ namespace vds {
         owner_id(this, "owner_id"),
         name(this, "name"),
         reserved_size(this, "reserved_size"),
+        used_size(this, "used_size"),
         cert(this, "cert"),
         private_key(this, "private_key") {
       }
@@ -30,6 +31,7 @@ namespace vds {
 
       database_column<std::string> name;
       database_column<int64_t> reserved_size;
+      database_column<int64_t> used_size;
 
       database_column<const_data_buffer, std::string> cert;
       database_column<const_data_buffer, std::string> private_key;
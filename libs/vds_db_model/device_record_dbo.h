@@ -18,7 +18,9 @@ namespace vds {
         storage_path(this, "storage_path"),
         local_path(this, "local_path"),
         data_hash(this, "data_hash"),
-        data_size(this, "data_size"){
+        data_offset(this, "data_offset"),
+        data_size(this, "data_size"),
+        last_verified(this, "last_verified"){
       }
 
       database_column<const_data_buffer, std::string> node_id;
@@ -27,7 +29,13 @@ namespace vds {
       database_column<std::string> local_path;
 
       database_column<const_data_buffer, std::string> data_hash;
+
+      //Offset inside the segment file or -1 if the replica is stored in a separate file
+      database_column<int64_t> data_offset;
       database_column<int64_t> data_size;
+
+      //Time of the last hash check by the background scrubber
+      database_column<std::chrono::system_clock::time_point> last_verified;
     };
   }
 }
@@ -0,0 +1,39 @@
+#ifndef __VDS_DB_MODEL_FILE_CATALOG_DBO_H_
+#define __VDS_DB_MODEL_FILE_CATALOG_DBO_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "database_orm.h"
+#include "const_data_buffer.h"
+
+namespace vds {
+  namespace orm {
+    //Files of the user messages: file_blocks is the serialized list of user_message_transaction::file_block_t
+    class file_catalog_dbo : public database_table {
+    public:
+      file_catalog_dbo()
+          : database_table("file_catalog"),
+            channel_id(this, "channel_id"),
+            file_id(this, "file_id"),
+            block_id(this, "block_id"),
+            name(this, "name"),
+            mime_type(this, "mime_type"),
+            file_size(this, "file_size"),
+            file_blocks(this, "file_blocks") {
+      }
+
+      database_column<const_data_buffer, std::string> channel_id;
+      database_column<const_data_buffer, std::string> file_id;
+      database_column<const_data_buffer, std::string> block_id;
+      database_column<std::string> name;
+      database_column<std::string> mime_type;
+      database_column<int64_t> file_size;
+      database_column<const_data_buffer> file_blocks;
+    };
+  }
+}
+
+#endif //__VDS_DB_MODEL_FILE_CATALOG_DBO_H_
@@ -0,0 +1,40 @@
+#ifndef __VDS_DB_MODEL_REPLICA_SEGMENT_DBO_H_
+#define __VDS_DB_MODEL_REPLICA_SEGMENT_DBO_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "database_orm.h"
+
+namespace vds {
+  namespace orm {
+    class replica_segment_dbo : public database_table {
+    public:
+      enum class state_t : uint8_t {
+        active,
+        sealed,
+        compacted
+      };
+
+      replica_segment_dbo()
+      : database_table("replica_segment"),
+        local_path(this, "local_path"),
+        storage_path(this, "storage_path"),
+        data_size(this, "data_size"),
+        live_size(this, "live_size"),
+        state(this, "state") {
+      }
+
+      database_column<std::string> local_path;
+      database_column<std::string> storage_path;
+
+      database_column<int64_t> data_size;
+      database_column<int64_t> live_size;
+      database_column<state_t, int> state;
+    };
+  }
+}
+
+#endif //__VDS_DB_MODEL_REPLICA_SEGMENT_DBO_H_
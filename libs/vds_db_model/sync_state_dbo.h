@@ -22,13 +22,22 @@ namespace vds {
 				object_id(this, "object_id"),
         object_size(this, "object_size"),
         state(this, "state"),
-        next_sync(this, "next_sync") {
+        next_sync(this, "next_sync"),
+        next_check(this, "next_check"),
+        redundancy(this, "redundancy") {
 			}
 
 			database_column<const_data_buffer, std::string> object_id;
       database_column<int32_t, int> object_size;
       database_column<state_t, int> state;
       database_column<std::chrono::system_clock::time_point> next_sync;
+
+      //Time of the next replica maintenance of the object
+      database_column<std::chrono::system_clock::time_point> next_check;
+
+      //Count of distinct replicas above MIN_DISTRIBUTED_PIECES, the objects at risk are repaired first.
+      //NULL if the replicas have not been counted yet
+      database_column<int32_t, int> redundancy;
     };
 	}
 }
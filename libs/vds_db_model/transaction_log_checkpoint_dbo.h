@@ -0,0 +1,31 @@
+#ifndef __VDS_DB_MODEL_TRANSACTION_LOG_CHECKPOINT_DBO_H_
+#define __VDS_DB_MODEL_TRANSACTION_LOG_CHECKPOINT_DBO_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "database_orm.h"
+#include "const_data_buffer.h"
+
+namespace vds {
+  namespace orm {
+    //Serialized transaction_record_state after the block
+    class transaction_log_checkpoint_dbo : public database_table {
+    public:
+      transaction_log_checkpoint_dbo()
+          : database_table("transaction_log_checkpoint"),
+            id(this, "id"),
+            order_no(this, "order_no"),
+            state_data(this, "state_data") {
+      }
+
+      database_column<const_data_buffer, std::string> id;
+      database_column<int64_t> order_no;
+      database_column<const_data_buffer> state_data;
+    };
+  }
+}
+
+#endif //__VDS_DB_MODEL_TRANSACTION_LOG_CHECKPOINT_DBO_H_
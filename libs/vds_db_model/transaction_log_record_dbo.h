@@ -52,7 +52,8 @@ namespace vds {
             consensus(this, "consensus"),
             new_member(this, "new_member"),
             order_no(this, "order_no"),
-            time_point(this, "time_point"){
+            time_point(this, "time_point"),
+            rowid(this, "rowid"){
       }
 
       database_column<const_data_buffer, std::string> id;
@@ -62,6 +63,9 @@ namespace vds {
       database_column<bool, int> new_member;
       database_column<int64_t> order_no;
       database_column<std::chrono::system_clock::time_point> time_point;
+
+      //SQLite row id: records are never deleted so it grows with every saved block
+      database_column<int64_t> rowid;
     };
   }
 }
@@ -12,6 +12,7 @@ All rights reserved
 
 void vds::dht::network::service::register_services(service_registrator& registrator) {
   registrator.add_service<client>(&this->client_);
+  registrator.add_service<memory_budget>(&this->memory_budget_);
 }
 
 void vds::dht::network::service::start(
@@ -80,6 +81,7 @@ void vds::dht::network::service::start(
 
     this->client_.start(
         sp,
+        t,
         node_cert,
         node_key,
         udp_transport);
@@ -8,6 +8,8 @@ All rights reserved
 #include "dht_network_client.h"
 #include "chunk_dbo.h"
 #include "private/dht_network_client_p.h"
+#include "private/restore_block_stream.h"
+#include "file_service.h"
 #include "messages/sync_messages.h"
 #include "messages/dht_route_messages.h"
 #include "deflate.h"
@@ -26,10 +28,12 @@ vds::dht::network::_client::_client(
   const std::shared_ptr<asymmetric_private_key> & node_key)
   : sp_(sp),
     route_(sp, node_cert->fingerprint(hash::sha256())),
-    update_timer_("DHT Network"),
+    maintenance_scheduler_(sp),
     update_route_table_counter_(0),
     udp_transport_(udp_transport),
     sync_process_(sp),
+    storage_layout_(storage_layout_t::segments),
+    verify_mode_(verify_mode_t::cached),
   update_wellknown_connection_enabled_(true) {
   for (uint16_t replica = 0; replica < service::GENERATE_HORCRUX; ++replica) {
     this->generators_[replica].reset(new chunk_generator<uint16_t>(service::MIN_HORCRUX, replica));
@@ -43,6 +47,7 @@ vds::async_task<std::vector<vds::const_data_buffer>> vds::dht::network::_client:
   const const_data_buffer& value) {
 
   std::vector<const_data_buffer> result(service::GENERATE_HORCRUX);
+  std::list<async_task<void>> writes;
   for (uint16_t replica = 0; replica < service::GENERATE_HORCRUX; ++replica) {
     binary_serializer s;
     this->generators_.find(replica)->second->write(s, value.data(), value.size());
@@ -55,7 +60,7 @@ vds::async_task<std::vector<vds::const_data_buffer>> vds::dht::network::_client:
     auto st = t.get_reader(t1.select(t1.object_id).where(t1.object_id == object_id));
     if (!st.execute()) {
       auto client = this->sp_->get<dht::network::client>();
-      save_data(this->sp_, t, replica_hash, replica_data);
+      writes.push_back(this->save_data_async(t, replica_hash, replica_data));
       t.execute(
         t1.insert(
           t1.object_id = object_id,
@@ -70,12 +75,30 @@ vds::async_task<std::vector<vds::const_data_buffer>> vds::dht::network::_client:
             t2.last_access = std::chrono::system_clock::now()
           ));
       }
+      this->sync_process_.invalidate_replica_map(t, object_id);
 
       co_await this->sync_process_.add_sync_entry(t, object_id, replica_data.size());
     }
     result[replica] = replica_hash;
   }
 
+  //The horcruxes are written in parallel, all of them have to be on the disk before the commit
+  std::exception_ptr error;
+  for (auto & write : writes) {
+    try {
+      co_await std::move(write);
+    }
+    catch (...) {
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
   co_return result;
 }
 
@@ -137,6 +160,7 @@ vds::async_task<void> vds::dht::network::_client::apply_message(
   
   const messages::dht_pong& message,
   const imessage_map::message_info_t& message_info) {
+  this->replica_sources_.pong_received(message_info.source_node());
   this->route_.mark_pinged(
     message_info.source_node(),
     message_info.session()->address());
@@ -164,16 +188,120 @@ vds::async_task<void> vds::dht::network::_client::send(
   const const_data_buffer& target_node_id,
   const message_type_t message_id,
   const const_data_buffer& message) {
+  //Out of a transaction the sync message is only counted and sent at once
+  if (this->sync_outbox_.add(nullptr, target_node_id, message_id, message)) {
+    co_return;
+  }
+
+  if (sync_outbox::is_sync_message(message_id)) {
+    this->sync_outbox_.sent(message.size());
+  }
+
+  co_await this->send_message(target_node_id, message_id, message, traffic_shaper::message_class(message_id));
+}
+
+vds::async_task<void> vds::dht::network::_client::send(
+  database_transaction & t,
+  const const_data_buffer& target_node_id,
+  const message_type_t message_id,
+  const const_data_buffer& message) {
+
+  if (sync_outbox::is_sync_message(message_id) && this->sync_outbox_.begin(&t)) {
+    t.on_commit([pthis = this->shared_from_this(), scope = &t]() {
+      pthis->flush_sync_batch(pthis->sync_outbox_.end(scope)).detach();
+    });
+    t.on_rollback([pthis = this->shared_from_this(), scope = &t]() {
+      pthis->sync_outbox_.discard(scope);
+    });
+  }
+
+  if (this->sync_outbox_.add(&t, target_node_id, message_id, message)) {
+    co_return;
+  }
+
+  co_await this->send_message(target_node_id, message_id, message, traffic_shaper::message_class(message_id));
+}
+
+vds::async_task<void> vds::dht::network::_client::send(
+  const const_data_buffer& target_node_id,
+  const message_type_t message_id,
+  const const_data_buffer& message,
+  traffic_class_t traffic_class) {
+
+  if (sync_outbox::is_sync_message(message_id)) {
+    this->sync_outbox_.sent(message.size());
+  }
+
+  co_await this->send_message(target_node_id, message_id, message, traffic_class);
+}
+
+vds::async_task<void> vds::dht::network::_client::flush_sync_batch(
+  std::map<const_data_buffer, std::list<sync_outbox::message_t>> messages) {
+  for (const auto & node : messages) {
+    messages::sync_message_batch batch;
+    size_t batch_size = 0;
+    for (const auto & message : node.second) {
+      if (!batch.messages.empty() && batch_size + message.message_data.size() > sync_outbox::MAX_BATCH_SIZE) {
+        co_await this->send_sync_batch(node.first, batch);
+        batch.messages.clear();
+        batch_size = 0;
+      }
+
+      batch.messages.push_back(messages::sync_message_batch::item_t {
+        static_cast<uint8_t>(message.message_id),
+        message.message_data });
+      batch_size += message.message_data.size();
+    }
+
+    co_await this->send_sync_batch(node.first, batch);
+  }
+}
+
+void vds::dht::network::_client::finish_sync_tick() {
+  this->sync_outbox_.finish_tick();
+}
+
+vds::async_task<void> vds::dht::network::_client::send_sync_batch(
+  const const_data_buffer& target_node_id,
+  const messages::sync_message_batch& batch) {
+
+  if (1 == batch.messages.size()) {
+    const auto & message = batch.messages.front();
+    this->sync_outbox_.sent(message.message_data.size());
+    co_await this->send_message(
+      target_node_id,
+      static_cast<message_type_t>(message.message_type),
+      message.message_data,
+      traffic_shaper::message_class(static_cast<message_type_t>(message.message_type)));
+  }
+  else {
+    const auto message = message_serialize(batch);
+    this->sync_outbox_.sent(message.size());
+    co_await this->send_message(
+      target_node_id,
+      messages::sync_message_batch::message_id,
+      message,
+      traffic_shaper::message_class(messages::sync_message_batch::message_id));
+  }
+}
+
+vds::async_task<void> vds::dht::network::_client::send_message(
+  const const_data_buffer& target_node_id,
+  const message_type_t message_id,
+  const const_data_buffer& message,
+  traffic_class_t traffic_class) {
+  //The callback is finished before for_near returns, so the message is not copied
   co_await this->route_.for_near(
     target_node_id,
     1,
-    [target_node_id, message_id, message, pthis = this->shared_from_this()](
+    [target_node_id, message_id, &message, traffic_class, pthis = this->shared_from_this()](
     const std::shared_ptr<dht_route<std::shared_ptr<dht_session>>::node>& candidate) -> async_task<bool>{
       co_await candidate->proxy_session_->send_message(
         pthis->udp_transport_,
         (uint8_t)message_id,
         target_node_id,
-        message);
+        message,
+        traffic_class);
       co_return false;
     });
 }
@@ -187,7 +315,7 @@ vds::async_task<void> vds::dht::network::_client::send_near(
   co_await this->route_.for_near(
     target_node_id,
     radius,
-    [target_node_id, message_id, message, this](
+    [target_node_id, message_id, &message, this](
     const std::shared_ptr<dht_route<std::shared_ptr<dht_session>>::node>& candidate) -> vds::async_task<bool> {
 
       co_await candidate->proxy_session_->send_message(
@@ -211,7 +339,7 @@ vds::async_task<void> vds::dht::network::_client::send_near(
     target_node_id,
     radius,
     filter,
-    [target_node_id, message_id, message, this](
+    [target_node_id, message_id, &message, this](
     const std::shared_ptr<dht_route<std::shared_ptr<dht_session>>::node>& candidate) -> vds::async_task<bool> {
       co_await candidate->proxy_session_->send_message(
         this->udp_transport_,
@@ -235,7 +363,7 @@ vds::async_task<void> vds::dht::network::_client::proxy_message(
     [
       target_node_id,
       message_id,
-      message,
+      &message,
       pthis = this->shared_from_this(),
       distance = dht_object_id::distance(this->current_node_id(), target_node_id),
       source_node,
@@ -287,21 +415,96 @@ vds::const_data_buffer vds::dht::network::_client::replica_id(const std::string&
 }
 
 
-void vds::dht::network::_client::start() {
-  this->update_timer_.start(this->sp_, std::chrono::seconds(60), [pthis = this->shared_from_this()]() -> async_task<bool>{
+void vds::dht::network::_client::start(database_transaction & t) {
+  storage_allocator::reconcile(t, this->current_node_id());
+  this->storage_allocator_.load(t, this->current_node_id());
 
+  //Routing does not use the database, so it is never blocked by the database writer
+  this->maintenance_scheduler_.add_job(
+    "route",
+    std::chrono::seconds(60),
+    std::chrono::seconds(5),
+    std::chrono::seconds(10),
+    [pthis = this->shared_from_this()](const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
     co_await pthis->udp_transport_->on_timer();
-      co_await pthis->sp_->get<db_model>()->async_transaction([pthis](database_transaction& t) {
-        pthis->process_update(t).get();
-        return true;
-      });
+    co_await pthis->route_.on_timer(pthis->udp_transport_);
+    co_await pthis->update_route_table();
+    co_return 0;
+  });
+
+  this->maintenance_scheduler_.add_job(
+    "wellknown",
+    std::chrono::seconds(60),
+    std::chrono::seconds(10),
+    std::chrono::seconds(10),
+    [pthis = this->shared_from_this()](const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
+    co_await pthis->update_wellknown_connection();
+    co_return 0;
+  });
 
-      co_return !pthis->sp_->get_shutdown_event().is_shuting_down();
+  this->maintenance_scheduler_.add_transaction_job(
+    "storage",
+    std::chrono::seconds(60),
+    std::chrono::seconds(10),
+    std::chrono::seconds(5),
+    [pthis = this->shared_from_this()](database_transaction & t, const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
+    pthis->storage_allocator_.load(t, pthis->current_node_id());
+    pthis->segment_store_.compact(t, pthis->current_node_id());
+    co_return 0;
   });
+
+  this->maintenance_scheduler_.add_transaction_job(
+    "sync",
+    std::chrono::seconds(60),
+    std::chrono::seconds(10),
+    std::chrono::seconds(2),
+    [pthis = this->shared_from_this()](database_transaction & t, const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
+    //Leader broadcasts of all objects with the same member are sent as one batch after the commit
+    t.on_commit([pthis]() {
+      pthis->finish_sync_tick();
+    });
+    t.on_rollback([pthis]() {
+      pthis->finish_sync_tick();
+    });
+
+    const auto backlog = co_await pthis->sync_process_.do_sync(t, deadline);
+    co_return backlog;
+  });
+
+  this->maintenance_scheduler_.add_transaction_job(
+    "anti_entropy",
+    std::chrono::minutes(10),
+    std::chrono::minutes(1),
+    std::chrono::seconds(5),
+    [pthis = this->shared_from_this()](database_transaction & t, const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
+    co_await pthis->sync_process_.start_anti_entropy(t);
+    co_return 0;
+  });
+
+  this->maintenance_scheduler_.add_job(
+    "restore_hedge",
+    std::chrono::seconds(1),
+    std::chrono::seconds(0),
+    std::chrono::seconds(1),
+    [pthis = this->shared_from_this()](const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
+    for (const auto & request : pthis->replica_sources_.hedge()) {
+      co_await pthis->send(
+        request.second.node,
+        message_create<messages::sync_replica_piece_request>(
+          request.first,
+          std::set<uint16_t>({ request.second.replica })));
+    }
+    co_return pthis->replica_sources_.pending_restores();
+  });
+
+  this->maintenance_scheduler_.start();
+  this->replica_scrubber_.start(this->sp_);
 }
 
 void vds::dht::network::_client::stop() {
   //this->udp_transport_->stop(sp);
+  this->replica_scrubber_.stop();
+  this->maintenance_scheduler_.stop();
 }
 
 void vds::dht::network::_client::get_neighbors(
@@ -325,61 +528,90 @@ void vds::dht::network::_client::remove_session(
   this->route_.remove_session(session);
 }
 
-vds::filename vds::dht::network::_client::save_data(
+void vds::dht::network::_client::save_data(
   const service_provider * sp,
   database_transaction& t,
   const const_data_buffer& data_hash,
   const const_data_buffer& data) {
 
-  auto client = sp->get<network::client>();
+  const auto target = prepare_save(sp, t, data_hash, data.size());
+  target.f->write_at(target.position, data.data(), data.size());
+}
 
-  uint64_t allowed_size = 0;
-  std::string local_path;
+vds::async_task<void> vds::dht::network::_client::save_data_async(
+  database_transaction& t,
+  const const_data_buffer& data_hash,
+  const_data_buffer data) {
 
-  orm::device_config_dbo t3;
-  orm::device_record_dbo t4;
-  db_value<int64_t> data_size;
-  auto st = t.get_reader(
-    t3.select(t3.local_path, t3.reserved_size, db_sum(t4.data_size).as(data_size))
-      .left_join(t4, t4.node_id == t3.node_id && t4.storage_path == t3.local_path)
-      .where(t3.node_id == client->current_node_id())
-      .group_by(t3.local_path, t3.reserved_size));
-  while (st.execute()) {
-    const int64_t size = data_size.is_null(st) ? 0 : data_size.get(st);
-    if (t3.reserved_size.get(st) > size && allowed_size < (t3.reserved_size.get(st) - size)) {
-      allowed_size = (t3.reserved_size.get(st) - size);
-      local_path = t3.local_path.get(st);
-    }
+  const auto target = prepare_save(this->sp_, t, data_hash, data.size());
+
+  const auto file_service = this->sp_->get<ifile_service>(false);
+  if (nullptr == file_service) {
+    target.f->write_at(target.position, data.data(), data.size());
+    co_return;
   }
 
-  if (local_path.empty() || allowed_size < data.size()) {
+  co_await file_service->write_at(target.f, target.position, data.data(), data.size());
+}
+
+vds::dht::network::_client::write_target_t vds::dht::network::_client::prepare_save(
+  const service_provider * sp,
+  database_transaction& t,
+  const const_data_buffer& data_hash,
+  size_t data_size) {
+
+  auto client = sp->get<network::client>();
+
+  const auto local_path = (*client)->storage_allocator_.allocate(t, data_size);
+  if (local_path.empty()) {
     throw std::runtime_error("No disk space");
   }
 
-  auto append_path = base64::from_bytes(data_hash);
-  str_replace(append_path, '+', '#');
-  str_replace(append_path, '/', '_');
+  write_target_t result;
+  orm::device_record_dbo t4;
+  if (storage_layout_t::segments == (*client)->storage_layout_) {
+    const auto location = (*client)->segment_store_.reserve(t, local_path, safe_cast<int64_t>(data_size));
+
+    t.execute(t4.insert(
+      t4.node_id = client->current_node_id(),
+      t4.storage_path = local_path,
+      t4.local_path = location.local_path,
+      t4.data_hash = data_hash,
+      t4.data_offset = location.data_offset,
+      t4.data_size = data_size));
+
+    result.f = location.f;
+    result.position = safe_cast<size_t>(location.data_offset);
+  }
+  else {
+    auto append_path = base64::from_bytes(data_hash);
+    str_replace(append_path, '+', '#');
+    str_replace(append_path, '/', '_');
 
-  foldername fl(local_path);
-  fl.create();
+    foldername fl(local_path);
+    fl.create();
 
-  fl = foldername(fl, append_path.substr(0, 10));
-  fl.create();
+    fl = foldername(fl, append_path.substr(0, 10));
+    fl.create();
 
-  fl = foldername(fl, append_path.substr(10, 10));
-  fl.create();
+    fl = foldername(fl, append_path.substr(10, 10));
+    fl.create();
 
-  filename fn(fl, append_path.substr(20));
-  file::write_all(fn, data);
+    filename fn(fl, append_path.substr(20));
 
-  t.execute(t4.insert(
-    t4.node_id = client->current_node_id(),
-    t4.storage_path = local_path,
-    t4.local_path = fn.full_name(),
-    t4.data_hash = data_hash,
-    t4.data_size = data.size()));
+    t.execute(t4.insert(
+      t4.node_id = client->current_node_id(),
+      t4.storage_path = local_path,
+      t4.local_path = fn.full_name(),
+      t4.data_hash = data_hash,
+      t4.data_size = data_size));
 
-  return fn;
+    result.f = std::make_shared<file>(fn, file::file_mode::truncate);
+    result.position = 0;
+  }
+
+  storage_allocator::add_usage(t, client->current_node_id(), local_path, data_size);
+  return result;
 }
 
 vds::async_task<void> vds::dht::network::_client::update_route_table() {
@@ -397,16 +629,32 @@ vds::async_task<void> vds::dht::network::_client::update_route_table() {
   }
 }
 
-vds::async_task<void> vds::dht::network::_client::process_update( database_transaction& t) {
-  co_await this->sync_process_.do_sync(t);
+void vds::dht::network::_client::get_route_statistics(route_statistic& result) {
+  this->route_.get_statistics(result);
+}
 
-  co_await this->route_.on_timer(this->udp_transport_);
-  co_await this->update_route_table();
-  co_await this->update_wellknown_connection(t);
+void vds::dht::network::_client::get_scrub_statistics(scrub_statistic& result) {
+  this->replica_scrubber_.get_statistic(result);
 }
 
-void vds::dht::network::_client::get_route_statistics(route_statistic& result) {
-  this->route_.get_statistics(result);
+void vds::dht::network::_client::get_maintenance_statistics(maintenance_statistic& result) {
+  this->maintenance_scheduler_.get_statistic(result);
+}
+
+void vds::dht::network::_client::get_repair_statistics(repair_statistic& result) {
+  this->sync_process_.get_repair_statistic(result);
+}
+
+void vds::dht::network::_client::get_sync_message_statistics(sync_message_statistic& result) {
+  this->sync_outbox_.get_statistic(result);
+}
+
+void vds::dht::network::_client::get_anti_entropy_statistics(anti_entropy_statistic& result) {
+  this->sync_process_.get_anti_entropy_statistic(result);
+}
+
+void vds::dht::network::_client::get_replica_source_statistics(replica_source_statistic& result) {
+  this->replica_sources_.get_statistic(result);
 }
 
 void vds::dht::network::_client::get_session_statistics(session_statistic& session_statistic) {
@@ -513,16 +761,137 @@ vds::async_task<void> vds::dht::network::_client::apply_message( database_transa
   return this->sync_process_.apply_message(t, message, message_info);
 }
 
+vds::async_task<void> vds::dht::network::_client::apply_message( database_transaction& t,
+  const messages::sync_replica_map_digest& message, const imessage_map::message_info_t& message_info) {
+  return this->sync_process_.apply_message(t, message, message_info);
+}
+
+vds::async_task<void> vds::dht::network::_client::apply_message( database_transaction& t,
+  const messages::sync_replica_map_entries& message, const imessage_map::message_info_t& message_info) {
+  return this->sync_process_.apply_message(t, message, message_info);
+}
+
+vds::async_task<void> vds::dht::network::_client::apply_message( database_transaction& t,
+  const messages::sync_replica_piece_request& message, const imessage_map::message_info_t& message_info) {
+  return this->sync_process_.apply_message(t, message, message_info);
+}
+
+template <typename message_type>
+static vds::async_task<void> apply_sync_message(
+  vds::dht::network::_client * client,
+  vds::database_transaction& t,
+  const vds::dht::network::imessage_map::message_info_t& message_info) {
+  vds::binary_deserializer s(message_info.message_data());
+  const auto message = vds::message_deserialize<message_type>(s);
+  co_await client->apply_message(t, message, message_info);
+}
+
+vds::async_task<void> vds::dht::network::_client::apply_sync_item(
+  database_transaction& t,
+  const imessage_map::message_info_t& message_info) {
+
+  switch (message_info.message_type()) {
+  case message_type_t::sync_new_election_request:
+    co_await apply_sync_message<messages::sync_new_election_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_new_election_response:
+    co_await apply_sync_message<messages::sync_new_election_response>(this, t, message_info);
+    break;
+  case message_type_t::sync_add_message_request:
+    co_await apply_sync_message<messages::sync_add_message_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_leader_broadcast_request:
+    co_await apply_sync_message<messages::sync_leader_broadcast_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_leader_broadcast_response:
+    co_await apply_sync_message<messages::sync_leader_broadcast_response>(this, t, message_info);
+    break;
+  case message_type_t::sync_replica_operations_request:
+    co_await apply_sync_message<messages::sync_replica_operations_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_replica_operations_response:
+    co_await apply_sync_message<messages::sync_replica_operations_response>(this, t, message_info);
+    break;
+  case message_type_t::sync_looking_storage_request:
+    co_await apply_sync_message<messages::sync_looking_storage_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_looking_storage_response:
+    co_await apply_sync_message<messages::sync_looking_storage_response>(this, t, message_info);
+    break;
+  case message_type_t::sync_snapshot_request:
+    co_await apply_sync_message<messages::sync_snapshot_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_snapshot_response:
+    co_await apply_sync_message<messages::sync_snapshot_response>(this, t, message_info);
+    break;
+  case message_type_t::sync_offer_send_replica_operation_request:
+    co_await apply_sync_message<messages::sync_offer_send_replica_operation_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_offer_remove_replica_operation_request:
+    co_await apply_sync_message<messages::sync_offer_remove_replica_operation_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_replica_request:
+    co_await apply_sync_message<messages::sync_replica_request>(this, t, message_info);
+    break;
+  case message_type_t::sync_replica_query_operations_request:
+    co_await apply_sync_message<messages::sync_replica_query_operations_request>(this, t, message_info);
+    break;
+  default:
+    throw std::runtime_error("Invalid message in sync batch");
+  }
+}
+
+vds::async_task<void> vds::dht::network::_client::apply_message(
+  database_transaction& t,
+  const messages::sync_message_batch& message,
+  const imessage_map::message_info_t& message_info) {
+
+  //The responses are batched too, they are sent after the commit
+  for (const auto & item : message.messages) {
+    const imessage_map::message_info_t item_info(
+      message_info.session(),
+      static_cast<message_type_t>(item.message_type),
+      item.message_data,
+      message_info.source_node(),
+      message_info.hops());
+
+    //The failed message is rolled back alone with its responses, the other messages of the batch are applied
+    const auto mark = this->sync_outbox_.mark(&t);
+    try {
+      t.savepoint([this, &t, &item_info]() {
+        this->apply_sync_item(t, item_info).get();
+      });
+    }
+    catch (const std::exception & ex) {
+      this->sync_outbox_.rollback_to(&t, mark);
+      this->sp_->get<logger>()->warning(
+        ThisModule,
+        "%s at apply %s from sync batch",
+        ex.what(),
+        std::to_string(item_info.message_type()).c_str());
+    }
+  }
+
+  co_return;
+}
+
 vds::async_task<void> vds::dht::network::_client::restore(  
   const std::vector<const_data_buffer>& object_ids,
-  const std::shared_ptr<const_data_buffer>& result,
+  const std::shared_ptr<stream_output_async<uint8_t>>& target,
   const std::chrono::steady_clock::time_point& start) {
+  //The horcruxes of the block and the decoded tile are held until the block is written
+  const auto lease = co_await this->sp_->get<memory_budget>()->acquire(
+    service::BLOCK_SIZE + chunk_decoder<uint16_t>::TILE_SIZE);
+
+  //The horcruxes found are kept between the attempts
+  auto decoder = std::make_shared<chunk_decoder<uint16_t>>(service::MIN_HORCRUX);
   for (;;) {
     uint8_t progress = co_await this->restore_async(
       object_ids,
-      result);
+      decoder);
 
-    if (result->size() > 0) {
+    if (decoder->is_ready()) {
+      co_await decoder->restore(target);
       co_return;
     }
 
@@ -550,67 +919,97 @@ vds::async_task<vds::dht::network::client::block_info_t> vds::dht::network::_cli
 vds::async_task<uint8_t> vds::dht::network::_client::restore_async(
   
   const std::vector<const_data_buffer>& object_ids,
-  const std::shared_ptr<const_data_buffer>& result) {
+  const std::shared_ptr<chunk_decoder<uint16_t>>& decoder) {
 
-  auto result_progress = std::make_shared<uint8_t>();
+  struct replica_location_t {
+    uint16_t replica;
+    std::string local_path;
+    int64_t data_offset;
+    int64_t data_size;
+  };
+
+  //The replicas are read by ifile_service out of the transaction
+  std::list<replica_location_t> locations;
   co_await this->sp_->get<db_model>()->async_transaction(
-    [pthis = this->shared_from_this(), object_ids, result, result_progress](
+    [pthis = this->shared_from_this(), object_ids, decoder, &locations](
       database_transaction& t) -> bool {
 
-    std::vector<uint16_t> replicas;
-    std::vector<const_data_buffer> datas;
     std::list<const_data_buffer> unknonw_replicas;
 
     orm::chunk_dbo t1;
     orm::device_record_dbo t4;
-    for (uint16_t replica = 0; replica < service::GENERATE_HORCRUX; ++replica) {
+    for (uint16_t replica = 0;
+      replica < service::GENERATE_HORCRUX && decoder->size() + locations.size() < service::MIN_HORCRUX;
+      ++replica) {
+      if (decoder->contains(replica)) {
+        continue;
+      }
+
       auto st = t.get_reader(
         t1
-        .select(t4.local_path)
+        .select(t4.local_path, t4.data_offset, t4.data_size)
         .inner_join(t4, t4.node_id == pthis->current_node_id() && t4.data_hash == t1.object_id)
         .where(t1.object_id == object_ids[replica]));
 
       if (st.execute()) {
-        replicas.push_back(replica);
-        datas.push_back(file::read_all(filename(t4.local_path.get(st))));
-
-
-        if (replicas.size() >= service::MIN_HORCRUX) {
-          break;
-        }
+        locations.push_back(replica_location_t{
+          replica,
+          t4.local_path.get(st),
+          t4.data_offset.get(st),
+          t4.data_size.get(st) });
       }
       else {
         unknonw_replicas.push_back(object_ids[replica]);
       }
     }
 
-    if (replicas.size() >= service::MIN_HORCRUX) {
-      chunk_restore<uint16_t> restore(service::MIN_HORCRUX, replicas.data());
-      binary_serializer s;
-      restore.restore(s, datas);
-      *result = s.move_data();
-      *result_progress = 100;
+    if (decoder->size() + locations.size() >= service::MIN_HORCRUX) {
       return true;
     }
 
-    *result_progress = 99 * replicas.size() / service::MIN_HORCRUX;
     for (const auto& replica : unknonw_replicas) {
       pthis->sync_process_.restore_replica(t, replica).detach();
     }
     return true;
   });
 
-  co_return *result_progress;
+  std::list<std::pair<uint16_t, async_task<const_data_buffer>>> reads;
+  for (const auto & location : locations) {
+    reads.push_back(std::make_pair(
+      location.replica,
+      this->read_data_async(
+        object_ids[location.replica],
+        filename(location.local_path),
+        location.data_offset,
+        location.data_size)));
+  }
+
+  for (auto & read : reads) {
+    decoder->add(read.first, co_await std::move(read.second));
+  }
+
+  //The data is decoded by the caller out of the transaction
+  if (decoder->is_ready()) {
+    co_return 100;
+  }
+
+  co_return 99 * decoder->size() / service::MIN_HORCRUX;
 }
 
 vds::async_task<void>
-vds::dht::network::_client::update_wellknown_connection(
-  database_transaction& t) {
+vds::dht::network::_client::update_wellknown_connection() {
   if (this->update_wellknown_connection_enabled_) {
-    orm::well_known_node_dbo t1;
-    auto st = t.get_reader(t1.select(t1.address));
-    while (st.execute()) {
-      auto address = t1.address.get(st);
+    //Handshakes are made out of the transaction
+    std::list<std::string> addresses;
+    co_await this->sp_->get<db_model>()->async_read_transaction([&addresses](database_read_transaction& t) {
+      orm::well_known_node_dbo t1;
+      auto st = t.get_reader(t1.select(t1.address));
+      while (st.execute()) {
+        addresses.push_back(t1.address.get(st));
+      }
+    });
+
+    for (const auto & address : addresses) {
       try {
         co_await this->udp_transport_->try_handshake(address);
       }
@@ -631,16 +1030,120 @@ vds::dht::network::_client::update_wellknown_connection(
 vds::const_data_buffer
 vds::dht::network::_client::read_data(
   const const_data_buffer& data_hash,
-  const filename& data_path) {
-  auto data = file::read_all(data_path);
-  vds_assert(data_hash == hash::signature(hash::sha256(), data));
+  const filename& data_path,
+  int64_t data_offset,
+  int64_t data_size) {
+
+  if (0 > data_offset) {
+    //The file of a replica can be replaced, so the check is valid while the file is unchanged
+    const auto last_write_time = (verify_mode_t::cached == this->verify_mode_)
+      ? file::last_write_time(data_path)
+      : 0;
+
+    auto data = file::read_all(data_path);
+    this->verify_data(data_hash, data_path.full_name(), last_write_time, data_size, data);
+    return data;
+  }
+
+  //Segments are append-only, so the data at the offset never changes
+  auto data = segment_store::read(data_path, data_offset, data_size);
+  this->verify_data(data_hash, data_path.full_name() + ":" + std::to_string(data_offset), 0, data_size, data);
   return data;
 }
 
+vds::async_task<vds::const_data_buffer>
+vds::dht::network::_client::read_data_async(
+  const const_data_buffer& data_hash,
+  const filename& data_path,
+  int64_t data_offset,
+  int64_t data_size) {
+
+  const auto file_service = this->sp_->get<ifile_service>(false);
+  if (nullptr == file_service) {
+    co_return this->read_data(data_hash, data_path, data_offset, data_size);
+  }
+
+  if (0 > data_offset) {
+    const auto last_write_time = (verify_mode_t::cached == this->verify_mode_)
+      ? file::last_write_time(data_path)
+      : 0;
+
+    auto data = co_await file_service->read_all(data_path);
+    this->verify_data(data_hash, data_path.full_name(), last_write_time, data_size, data);
+    co_return data;
+  }
+
+  auto data = co_await file_service->read_range(data_path, safe_cast<size_t>(data_offset), safe_cast<size_t>(data_size));
+  this->verify_data(data_hash, data_path.full_name() + ":" + std::to_string(data_offset), 0, data_size, data);
+  co_return data;
+}
+
+void vds::dht::network::_client::verify_data(
+  const const_data_buffer& data_hash,
+  const std::string & key,
+  time_t last_write_time,
+  int64_t data_size,
+  const const_data_buffer& data) {
+
+  vds_assert(static_cast<int64_t>(data.size()) == data_size);
+
+  if (verify_mode_t::always == this->verify_mode_
+    || (verify_mode_t::cached == this->verify_mode_ && !this->is_verified(key, last_write_time))) {
+    vds_assert(data_hash == hash::signature(hash::sha256(), data));
+    if (verify_mode_t::cached == this->verify_mode_) {
+      this->set_verified(key, last_write_time);
+    }
+  }
+}
+
+bool vds::dht::network::_client::is_verified(
+  const std::string & key,
+  time_t last_write_time) {
+  std::lock_guard<std::mutex> lock(this->verified_replicas_mutex_);
+
+  const auto p = this->verified_replicas_.find(key);
+  return this->verified_replicas_.end() != p && last_write_time == p->second;
+}
+
+void vds::dht::network::_client::set_verified(
+  const std::string & key,
+  time_t last_write_time) {
+  std::lock_guard<std::mutex> lock(this->verified_replicas_mutex_);
+
+  if (MAX_VERIFIED_REPLICAS <= this->verified_replicas_.size()) {
+    this->verified_replicas_.clear();
+  }
+
+  this->verified_replicas_[key] = last_write_time;
+}
+
 void vds::dht::network::_client::delete_data(
-  const const_data_buffer& /*replica_hash*/,
-  const filename& data_path) {
-  file::delete_file(data_path);
+  const service_provider * sp,
+  database_transaction& t,
+  const const_data_buffer& replica_hash) {
+
+  auto client = sp->get<network::client>();
+
+  orm::device_record_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.storage_path, t1.local_path, t1.data_offset, t1.data_size)
+    .where(t1.node_id == client->current_node_id() && t1.data_hash == replica_hash));
+  if (!st.execute()) {
+    return;
+  }
+
+  const auto storage_path = t1.storage_path.get(st);
+  const auto data_size = t1.data_size.get(st);
+  if (0 > t1.data_offset.get(st)) {
+    file::delete_file(filename(t1.local_path.get(st)));
+  }
+  else {
+    segment_store::release(t, t1.local_path.get(st), data_size);
+  }
+
+  t.execute(t1.delete_if(t1.node_id == client->current_node_id() && t1.data_hash == replica_hash));
+  storage_allocator::add_usage(t, client->current_node_id(), storage_path, -data_size);
+  (*client)->storage_allocator_.release(t, storage_path, data_size);
 }
 
 void vds::dht::network::_client::add_route(
@@ -662,11 +1165,12 @@ vds::async_task<void> vds::dht::network::_client::find_nodes(
 
 void vds::dht::network::client::start(
   const service_provider * sp,
+  database_transaction & t,
   const std::shared_ptr<certificate> & node_cert,
   const std::shared_ptr<asymmetric_private_key> & node_key,
   const std::shared_ptr<iudp_transport> & udp_transport) {
   this->impl_.reset(new _client(sp, udp_transport, node_cert, node_key));
-  this->impl_->start();
+  this->impl_->start(t);
 
 }
 
@@ -723,21 +1227,27 @@ vds::async_task<vds::dht::network::client::chunk_info> vds::dht::network::client
 vds::async_task<vds::const_data_buffer> vds::dht::network::client::restore(
   
   const chunk_info& block_id) {
-  auto result = std::make_shared<const_data_buffer>();
-  co_await this->impl_->restore(block_id.object_ids, result, std::chrono::steady_clock::now());
+  auto result = std::make_shared<collect_data<uint8_t>>();
+  co_await this->restore(block_id, result);
+  co_return result->move_data();
+}
+
+vds::async_task<void> vds::dht::network::client::restore(
+  const chunk_info& block_id,
+  const std::shared_ptr<stream_output_async<uint8_t>>& target) {
 
   auto key2 = symmetric_key::create(
     symmetric_crypto::aes_256_cbc(),
     block_id.key.data(),
     pack_block_iv);
 
-  auto zipped = symmetric_decrypt::decrypt(key2, *result);
-  auto original_data = inflate::decompress(zipped.data(), zipped.size());
-
-  vds_assert(block_id.id == hash::signature(hash::sha256(), original_data));
-
-  co_return original_data;
+  //horcruxes -> decrypt -> inflate -> hash check -> target without the whole block buffers between the steps
+  auto block_stream = std::make_shared<restore_block_stream>(block_id.id, target);
+  auto inflate_stream = std::make_shared<inflate>(block_stream);
+  auto decrypt_stream = std::make_shared<symmetric_decrypt>(key2, inflate_stream);
 
+  co_await this->impl_->restore(block_id.object_ids, decrypt_stream, std::chrono::steady_clock::now());
+  co_await decrypt_stream->write_async(nullptr, 0);
 }
 
 vds::async_task<vds::dht::network::client::block_info_t> vds::dht::network::client::prepare_restore(
@@ -759,6 +1269,30 @@ void vds::dht::network::client::get_session_statistics(session_statistic& sessio
   this->impl_->get_session_statistics(session_statistic);
 }
 
+void vds::dht::network::client::get_scrub_statistics(scrub_statistic& result) {
+  this->impl_->get_scrub_statistics(result);
+}
+
+void vds::dht::network::client::get_maintenance_statistics(maintenance_statistic& result) {
+  this->impl_->get_maintenance_statistics(result);
+}
+
+void vds::dht::network::client::get_repair_statistics(repair_statistic& result) {
+  this->impl_->get_repair_statistics(result);
+}
+
+void vds::dht::network::client::get_sync_message_statistics(sync_message_statistic& result) {
+  this->impl_->get_sync_message_statistics(result);
+}
+
+void vds::dht::network::client::get_anti_entropy_statistics(anti_entropy_statistic& result) {
+  this->impl_->get_anti_entropy_statistics(result);
+}
+
+void vds::dht::network::client::get_replica_source_statistics(replica_source_statistic& result) {
+  this->impl_->get_replica_source_statistics(result);
+}
+
 void vds::dht::network::client::update_wellknown_connection_enabled(bool value) {
   this->impl_->update_wellknown_connection_enabled(value);
 }
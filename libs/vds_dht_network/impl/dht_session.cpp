@@ -31,6 +31,7 @@ vds::async_task<void> vds::dht::network::dht_session::ping_node(
 
   //vds_assert(node_id != transport->this_node_id());
 
+  (*this->sp_->get<client>())->replica_sources().ping_sent(node_id);
   co_await this->send_message(
     transport,
     (uint8_t)messages::dht_ping::message_id,
@@ -0,0 +1,132 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/maintenance_scheduler.h"
+#include "db_model.h"
+#include "logger.h"
+
+vds::dht::network::maintenance_scheduler::maintenance_scheduler(const service_provider * sp)
+: sp_(sp) {
+}
+
+void vds::dht::network::maintenance_scheduler::add_job(
+  const std::string & name,
+  const std::chrono::steady_clock::duration & period,
+  const std::chrono::steady_clock::duration & jitter,
+  const std::chrono::steady_clock::duration & budget,
+  const handler_t & handler) {
+
+  auto job = std::make_unique<job_t>(name);
+  job->period_ = period;
+  job->jitter_ = jitter;
+  job->budget_ = budget;
+  job->handler_ = handler;
+  job->statistic_.period_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(period).count();
+  job->statistic_.budget_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(budget).count();
+
+  std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+  this->jobs_[name] = std::move(job);
+}
+
+void vds::dht::network::maintenance_scheduler::add_transaction_job(
+  const std::string & name,
+  const std::chrono::steady_clock::duration & period,
+  const std::chrono::steady_clock::duration & jitter,
+  const std::chrono::steady_clock::duration & budget,
+  const transaction_handler_t & handler) {
+
+  this->add_job(name, period, jitter, budget,
+    [sp = this->sp_, handler](const std::chrono::steady_clock::time_point & deadline) -> async_task<size_t> {
+    size_t backlog = 0;
+    co_await sp->get<db_model>()->async_transaction([&backlog, &handler, &deadline](database_transaction & t) {
+      backlog = handler(t, deadline).get();
+    });
+    co_return backlog;
+  });
+}
+
+void vds::dht::network::maintenance_scheduler::start() {
+  std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+  for (auto & p : this->jobs_) {
+    auto job = p.second.get();
+    job->timer_.start(this->sp_, job->period_, [this, job]() -> async_task<bool> {
+      co_await this->execute(job);
+      co_return !this->sp_->get_shutdown_event().is_shuting_down();
+    },
+    job->jitter_);
+  }
+}
+
+void vds::dht::network::maintenance_scheduler::stop() {
+  std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+  for (auto & p : this->jobs_) {
+    p.second->timer_.stop();
+  }
+}
+
+vds::async_task<bool> vds::dht::network::maintenance_scheduler::run(const std::string & name) {
+  job_t * job;
+  {
+    std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+    auto p = this->jobs_.find(name);
+    if (this->jobs_.end() == p) {
+      throw std::runtime_error("Maintenance job " + name + " not found");
+    }
+    job = p->second.get();
+  }
+
+  return this->execute(job);
+}
+
+vds::async_task<bool> vds::dht::network::maintenance_scheduler::execute(job_t * job) {
+  {
+    std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+    if (job->statistic_.is_running_) {
+      ++job->statistic_.skipped_;
+      co_return false;
+    }
+    job->statistic_.is_running_ = true;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  size_t backlog = 0;
+  bool is_failed = false;
+  try {
+    backlog = co_await job->handler_(start + job->budget_);
+  }
+  catch (const std::exception & ex) {
+    is_failed = true;
+    this->sp_->get<logger>()->warning(ThisModule, "Maintenance job %s failed: %s", job->name_.c_str(), ex.what());
+  }
+
+  const auto duration = std::chrono::steady_clock::now() - start;
+
+  std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+  job->statistic_.is_running_ = false;
+  ++job->statistic_.runs_;
+  if (is_failed) {
+    ++job->statistic_.errors_;
+  }
+  else {
+    job->statistic_.backlog_ = backlog;
+  }
+  if (duration > job->budget_) {
+    ++job->statistic_.overruns_;
+  }
+
+  job->statistic_.last_duration_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+  if (job->statistic_.max_duration_ms_ < job->statistic_.last_duration_ms_) {
+    job->statistic_.max_duration_ms_ = job->statistic_.last_duration_ms_;
+  }
+
+  co_return true;
+}
+
+void vds::dht::network::maintenance_scheduler::get_statistic(maintenance_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->jobs_mutex_);
+  for (const auto & p : this->jobs_) {
+    result.jobs_[p.first] = p.second->statistic_;
+  }
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "memory_budget.h"
+
+vds::dht::network::memory_budget::lease::lease(memory_budget * owner, size_t size)
+: owner_(owner),
+  size_(size) {
+}
+
+vds::dht::network::memory_budget::lease::~lease() {
+  this->owner_->release(this->size_);
+}
+
+vds::dht::network::memory_budget::memory_budget(size_t limit)
+: limit_(limit),
+  used_(0),
+  peak_(0),
+  granted_(0),
+  queued_(0),
+  rejected_(0),
+  total_wait_ms_(0),
+  max_wait_ms_(0) {
+}
+
+vds::async_task<std::shared_ptr<vds::dht::network::memory_budget::lease>>
+vds::dht::network::memory_budget::acquire(size_t size) {
+  size = std::min(size, this->limit_);
+
+  auto result = std::make_shared<async_result<std::shared_ptr<lease>>>();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (!this->waiters_.empty() || !this->try_acquire_locked(size)) {
+      this->waiters_.push_back(waiter_t { size, std::chrono::steady_clock::now(), result });
+      return result->get_future();
+    }
+  }
+
+  result->set_value(std::make_shared<lease>(this, size));
+  return result->get_future();
+}
+
+std::shared_ptr<vds::dht::network::memory_budget::lease>
+vds::dht::network::memory_budget::try_acquire(size_t size) {
+  size = std::min(size, this->limit_);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  if (!this->waiters_.empty() || !this->try_acquire_locked(size)) {
+    ++this->rejected_;
+    return std::shared_ptr<lease>();
+  }
+
+  return std::make_shared<lease>(this, size);
+}
+
+bool vds::dht::network::memory_budget::try_acquire_locked(size_t size) {
+  if (this->limit_ < this->used_ + size) {
+    return false;
+  }
+
+  this->used_ += size;
+  this->peak_ = std::max(this->peak_, this->used_);
+  ++this->granted_;
+  return true;
+}
+
+void vds::dht::network::memory_budget::release(size_t size) {
+  std::list<waiter_t> granted;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->used_ -= size;
+
+    //Strictly in the order of arrival, so the large request is not passed by the small ones
+    const auto now = std::chrono::steady_clock::now();
+    while (!this->waiters_.empty() && this->try_acquire_locked(this->waiters_.front().size)) {
+      const auto wait_ms = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - this->waiters_.front().enqueued).count());
+      ++this->queued_;
+      this->total_wait_ms_ += wait_ms;
+      this->max_wait_ms_ = std::max(this->max_wait_ms_, wait_ms);
+
+      granted.splice(granted.end(), this->waiters_, this->waiters_.begin());
+    }
+  }
+
+  //The waiting coroutines are resumed out of the lock
+  for (const auto & waiter : granted) {
+    waiter.result->set_value(std::make_shared<lease>(this, waiter.size));
+  }
+}
+
+void vds::dht::network::memory_budget::get_statistic(memory_budget_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  result.limit_ = this->limit_;
+  result.used_ = this->used_;
+  result.peak_ = this->peak_;
+  result.waiting_ = this->waiters_.size();
+  result.granted_ = this->granted_;
+  result.queued_ = this->queued_;
+  result.rejected_ = this->rejected_;
+  result.total_wait_ms_ = this->total_wait_ms_;
+  result.max_wait_ms_ = this->max_wait_ms_;
+}
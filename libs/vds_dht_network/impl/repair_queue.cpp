@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/repair_queue.h"
+#include "dht_network.h"
+
+vds::dht::network::repair_queue::repair_queue()
+: bytes_per_second_(DEFAULT_BYTES_PER_SECOND),
+  max_parallel_(DEFAULT_MAX_PARALLEL),
+  available_bytes_(DEFAULT_BYTES_PER_SECOND * MAX_BURST().count()),
+  started_(0),
+  last_tick_(std::chrono::steady_clock::now()),
+  statistic_{},
+  is_degraded_(false) {
+}
+
+int vds::dht::network::repair_queue::redundancy_margin(size_t replica_count) {
+  return static_cast<int>(replica_count) - service::MIN_DISTRIBUTED_PIECES;
+}
+
+int vds::dht::network::repair_queue::full_redundancy_margin() {
+  return redundancy_margin(service::GENERATE_DISTRIBUTED_PIECES);
+}
+
+void vds::dht::network::repair_queue::limits(uint64_t bytes_per_second, size_t max_parallel) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->bytes_per_second_ = bytes_per_second;
+  this->max_parallel_ = std::max<size_t>(1, max_parallel);
+  this->available_bytes_ = static_cast<int64_t>(bytes_per_second * MAX_BURST().count());
+}
+
+void vds::dht::network::repair_queue::start_tick(const std::chrono::steady_clock::time_point & now) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - this->last_tick_).count();
+  this->last_tick_ = now;
+
+  const auto max_bytes = static_cast<int64_t>(this->bytes_per_second_ * MAX_BURST().count());
+  this->available_bytes_ += static_cast<int64_t>(this->bytes_per_second_ * elapsed / 1000);
+  if (this->available_bytes_ > max_bytes) {
+    this->available_bytes_ = max_bytes;
+  }
+
+  this->started_ = 0;
+  this->statistic_.at_risk_objects_ = 0;
+  this->queue_.clear();
+}
+
+void vds::dht::network::repair_queue::push(
+  const const_data_buffer & object_id,
+  int margin,
+  uint64_t repair_bytes) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->queue_.emplace(margin, entry_t { object_id, margin, repair_bytes });
+}
+
+bool vds::dht::network::repair_queue::pop(entry_t & result) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  if (this->queue_.empty() || this->started_ >= this->max_parallel_ || 0 >= this->available_bytes_) {
+    return false;
+  }
+
+  auto p = this->queue_.begin();
+  result = std::move(p->second);
+  this->queue_.erase(p);
+
+  //The debt is paid by the next ticks
+  this->available_bytes_ -= static_cast<int64_t>(result.repair_bytes);
+  ++this->started_;
+
+  ++this->statistic_.repaired_objects_;
+  this->statistic_.repaired_bytes_ += result.repair_bytes;
+  if (0 >= result.margin) {
+    ++this->statistic_.at_risk_objects_;
+  }
+
+  return true;
+}
+
+void vds::dht::network::repair_queue::finish_tick(
+  size_t degraded_objects,
+  const std::chrono::system_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  for (const auto & p : this->queue_) {
+    if (0 >= p.first) {
+      ++this->statistic_.at_risk_objects_;
+    }
+  }
+  this->statistic_.queued_objects_ = this->queue_.size();
+  this->statistic_.degraded_objects_ = degraded_objects;
+
+  if (0 < degraded_objects) {
+    if (!this->is_degraded_) {
+      this->is_degraded_ = true;
+      this->degraded_since_ = now;
+    }
+  }
+  else if (this->is_degraded_) {
+    this->is_degraded_ = false;
+    this->statistic_.last_time_to_full_redundancy_ms_ =
+      std::chrono::duration_cast<std::chrono::milliseconds>(now - this->degraded_since_).count();
+  }
+
+  this->queue_.clear();
+}
+
+void vds::dht::network::repair_queue::get_statistic(repair_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  result = this->statistic_;
+  result.degraded_time_ms_ = this->is_degraded_
+    ? std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - this->degraded_since_).count()
+    : 0;
+}
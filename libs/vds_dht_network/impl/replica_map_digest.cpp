@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/replica_map_digest.h"
+#include "binary_serialize.h"
+#include "hash.h"
+
+vds::dht::network::replica_map_digest::replica_map_digest()
+: levels_(MAX_BITS / FANOUT_BITS + 1) {
+}
+
+void vds::dht::network::replica_map_digest::add(
+  const const_data_buffer & object_id,
+  uint16_t replica,
+  const const_data_buffer & node) {
+
+  binary_serializer s;
+  s << object_id << replica << node;
+
+  const auto object_key = key(object_id);
+  auto p = this->items_.emplace(
+    object_key,
+    item_t {
+      entry_t { object_id, replica, node },
+      hash::signature(hash::sha256(), s.move_data())
+    });
+
+  this->update_levels(object_key, p->second.hash, true);
+}
+
+void vds::dht::network::replica_map_digest::remove(const const_data_buffer & object_id) {
+  const auto object_key = key(object_id);
+  auto range = this->items_.equal_range(object_key);
+  for (auto p = range.first; range.second != p;) {
+    if (p->second.entry.object_id == object_id) {
+      this->update_levels(object_key, p->second.hash, false);
+      p = this->items_.erase(p);
+    }
+    else {
+      ++p;
+    }
+  }
+}
+
+vds::dht::network::replica_map_digest::range_t vds::dht::network::replica_map_digest::get_range(
+  uint32_t prefix,
+  uint8_t bits) const {
+
+  if (MAX_BITS >= bits && 0 == bits % FANOUT_BITS) {
+    const auto & level = this->levels_[bits / FANOUT_BITS];
+    const auto p = level.find(prefix);
+    return range_t {
+      prefix,
+      bits,
+      (level.end() == p) ? const_data_buffer() : const_data_buffer(p->second.hash.data(), p->second.hash.size())
+    };
+  }
+
+  std::vector<uint8_t> result;
+  const auto end = this->range_end(prefix, bits);
+  for (auto p = this->range_begin(prefix, bits); end != p; ++p) {
+    const auto & item_hash = p->second.hash;
+    if (result.empty()) {
+      result.resize(item_hash.size());
+    }
+
+    for (size_t i = 0; i < item_hash.size(); ++i) {
+      result[i] ^= item_hash[i];
+    }
+  }
+
+  return range_t {
+    prefix,
+    bits,
+    result.empty() ? const_data_buffer() : const_data_buffer(result.data(), result.size())
+  };
+}
+
+size_t vds::dht::network::replica_map_digest::count(
+  uint32_t prefix,
+  uint8_t bits) const {
+
+  if (MAX_BITS >= bits && 0 == bits % FANOUT_BITS) {
+    const auto & level = this->levels_[bits / FANOUT_BITS];
+    const auto p = level.find(prefix);
+    return (level.end() == p) ? 0 : p->second.count;
+  }
+
+  return std::distance(this->range_begin(prefix, bits), this->range_end(prefix, bits));
+}
+
+void vds::dht::network::replica_map_digest::compare(
+  const std::list<range_t> & partner_ranges,
+  std::list<range_t> & children,
+  std::list<range_t> & leaves) const {
+
+  for (const auto & partner_range : partner_ranges) {
+    if (MAX_BITS < partner_range.bits || 0 != (static_cast<uint64_t>(partner_range.prefix) >> partner_range.bits)) {
+      continue;
+    }
+
+    auto range = this->get_range(partner_range.prefix, partner_range.bits);
+    if (range.hash == partner_range.hash) {
+      continue;
+    }
+
+    if (MAX_BITS <= partner_range.bits || this->count(partner_range.prefix, partner_range.bits) <= MAX_LEAF_ENTRIES) {
+      leaves.push_back(std::move(range));
+      continue;
+    }
+
+    const uint8_t step = std::min<uint8_t>(FANOUT_BITS, MAX_BITS - partner_range.bits);
+    for (uint32_t i = 0; i < (1U << step); ++i) {
+      children.push_back(this->get_range((partner_range.prefix << step) | i, partner_range.bits + step));
+    }
+  }
+}
+
+std::list<vds::dht::network::replica_map_digest::entry_t> vds::dht::network::replica_map_digest::get_entries(
+  uint32_t prefix,
+  uint8_t bits) const {
+
+  std::list<entry_t> result;
+  const auto end = this->range_end(prefix, bits);
+  for (auto p = this->range_begin(prefix, bits); end != p; ++p) {
+    result.push_back(p->second.entry);
+  }
+
+  return result;
+}
+
+std::set<vds::const_data_buffer> vds::dht::network::replica_map_digest::difference(
+  uint32_t prefix,
+  uint8_t bits,
+  const std::list<entry_t> & partner_entries) const {
+
+  std::map<const_data_buffer, std::set<std::pair<uint16_t, const_data_buffer>>> local_map;
+  const auto end = this->range_end(prefix, bits);
+  for (auto p = this->range_begin(prefix, bits); end != p; ++p) {
+    local_map[p->second.entry.object_id].emplace(p->second.entry.replica, p->second.entry.node);
+  }
+
+  std::map<const_data_buffer, std::set<std::pair<uint16_t, const_data_buffer>>> partner_map;
+  for (const auto & entry : partner_entries) {
+    partner_map[entry.object_id].emplace(entry.replica, entry.node);
+  }
+
+  std::set<const_data_buffer> result;
+  for (const auto & p : local_map) {
+    const auto partner = partner_map.find(p.first);
+    if (partner_map.end() == partner || partner->second != p.second) {
+      result.emplace(p.first);
+    }
+  }
+
+  for (const auto & p : partner_map) {
+    if (local_map.end() == local_map.find(p.first)) {
+      result.emplace(p.first);
+    }
+  }
+
+  return result;
+}
+
+uint32_t vds::dht::network::replica_map_digest::key(const const_data_buffer & object_id) {
+  uint32_t result = 0;
+  for (size_t i = 0; i < sizeof(result); ++i) {
+    result <<= 8;
+    if (i < object_id.size()) {
+      result |= object_id[i];
+    }
+  }
+
+  return result;
+}
+
+void vds::dht::network::replica_map_digest::update_levels(
+  uint32_t key,
+  const const_data_buffer & hash,
+  bool is_added) {
+
+  for (uint8_t bits = 0; bits <= MAX_BITS; bits += FANOUT_BITS) {
+    auto & level = this->levels_[bits / FANOUT_BITS];
+    const uint32_t prefix = (0 == bits) ? 0 : (key >> (32 - bits));
+
+    auto & range = level[prefix];
+    if (range.hash.empty()) {
+      range.hash.resize(hash.size());
+      range.count = 0;
+    }
+
+    for (size_t i = 0; i < hash.size(); ++i) {
+      range.hash[i] ^= hash[i];
+    }
+
+    if (is_added) {
+      ++range.count;
+    }
+    else if (0 == --range.count) {
+      level.erase(prefix);
+    }
+  }
+}
+
+std::multimap<uint32_t, vds::dht::network::replica_map_digest::item_t>::const_iterator
+vds::dht::network::replica_map_digest::range_begin(uint32_t prefix, uint8_t bits) const {
+  if (0 == bits) {
+    return this->items_.begin();
+  }
+
+  return this->items_.lower_bound(static_cast<uint32_t>(static_cast<uint64_t>(prefix) << (32 - bits)));
+}
+
+std::multimap<uint32_t, vds::dht::network::replica_map_digest::item_t>::const_iterator
+vds::dht::network::replica_map_digest::range_end(uint32_t prefix, uint8_t bits) const {
+  const uint64_t end = (0 == bits) ? 0x100000000ULL : ((static_cast<uint64_t>(prefix) + 1) << (32 - bits));
+  if (0xFFFFFFFFULL < end) {
+    return this->items_.end();
+  }
+
+  return this->items_.lower_bound(static_cast<uint32_t>(end));
+}
@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include <atomic>
+#include "private/replica_scrubber.h"
+#include "private/dht_network_client_p.h"
+#include "private/segment_store.h"
+#include "database_orm.h"
+#include "device_record_dbo.h"
+#include "db_model.h"
+#include "mt_service.h"
+
+vds::dht::network::replica_scrubber::replica_scrubber()
+: sp_(nullptr),
+  scrub_timer_("Replica Scrubber"),
+  bytes_per_second_(DEFAULT_BYTES_PER_SECOND),
+  max_parallel_(DEFAULT_MAX_PARALLEL),
+  statistic_{},
+  pass_start_(std::chrono::system_clock::now()) {
+}
+
+void vds::dht::network::replica_scrubber::start(const service_provider * sp) {
+  this->sp_ = sp;
+  this->scrub_timer_.start(sp, SCRUB_PERIOD(), [this]() -> async_task<bool> {
+    uint64_t byte_budget;
+    {
+      std::lock_guard<std::mutex> lock(this->limits_mutex_);
+      byte_budget = this->bytes_per_second_ * SCRUB_PERIOD().count();
+    }
+
+    co_await this->scrub(byte_budget);
+    co_return !this->sp_->get_shutdown_event().is_shuting_down();
+  });
+}
+
+void vds::dht::network::replica_scrubber::stop() {
+  this->scrub_timer_.stop();
+}
+
+void vds::dht::network::replica_scrubber::limits(uint64_t bytes_per_second, size_t max_parallel) {
+  std::lock_guard<std::mutex> lock(this->limits_mutex_);
+  this->bytes_per_second_ = bytes_per_second;
+  this->max_parallel_ = std::max<size_t>(1, max_parallel);
+}
+
+vds::async_task<size_t> vds::dht::network::replica_scrubber::scrub(uint64_t byte_budget) {
+  auto client = this->sp_->get<network::client>();
+  const auto node_id = client->current_node_id();
+
+  size_t max_parallel;
+  {
+    std::lock_guard<std::mutex> lock(this->limits_mutex_);
+    max_parallel = this->max_parallel_;
+  }
+
+  std::chrono::system_clock::time_point pass_start;
+  {
+    std::lock_guard<std::mutex> lock(this->statistic_mutex_);
+    pass_start = this->pass_start_;
+  }
+
+  std::vector<replica_t> replicas;
+  int64_t total_count = 0;
+  int64_t pending_count = 0;
+  co_await this->sp_->get<db_model>()->async_read_transaction(
+    [&replicas, &total_count, &pending_count, node_id, pass_start, byte_budget](database_read_transaction & t) {
+
+    db_value<int64_t> count;
+    orm::device_record_dbo t1;
+    auto st = t.get_reader(t1.select(db_count(t1.data_hash).as(count)).where(t1.node_id == node_id));
+    if (st.execute()) {
+      total_count = count.get(st);
+    }
+
+    //last_verified is stored with one second precision
+    st = t.get_reader(
+      t1.select(db_count(t1.data_hash).as(count))
+      .where(t1.node_id == node_id && t1.last_verified <= pass_start - std::chrono::seconds(1)));
+    if (st.execute()) {
+      pending_count = count.get(st);
+    }
+
+    uint64_t batch_size = 0;
+    st = t.get_reader(
+      t1.select(t1.data_hash, t1.local_path, t1.data_offset, t1.data_size)
+      .where(t1.node_id == node_id)
+      .order_by(t1.last_verified));
+    while (replicas.size() < BATCH_SIZE && st.execute()) {
+      const auto data_size = t1.data_size.get(st);
+      if (!replicas.empty() && batch_size + data_size > byte_budget) {
+        break;
+      }
+
+      batch_size += data_size;
+      replicas.push_back(replica_t {
+        t1.data_hash.get(st),
+        t1.local_path.get(st),
+        t1.data_offset.get(st),
+        data_size,
+        true });
+    }
+  });
+
+  if (0 == pending_count && 0 < total_count) {
+    std::lock_guard<std::mutex> lock(this->statistic_mutex_);
+    this->pass_start_ = std::chrono::system_clock::now();
+    ++this->statistic_.passes_;
+    pending_count = total_count;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->statistic_mutex_);
+    this->statistic_.pass_total_ = total_count;
+    this->statistic_.pass_verified_ = total_count - pending_count;
+  }
+
+  if (replicas.empty()) {
+    co_return 0;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  co_await this->verify(replicas, max_parallel);
+  const auto time = std::chrono::steady_clock::now() - start;
+
+  uint64_t verified_bytes = 0;
+  size_t corrupted_count = 0;
+  co_await this->sp_->get<db_model>()->async_transaction(
+    [this, &replicas, &verified_bytes, &corrupted_count, client, node_id](database_transaction & t) {
+
+    const auto now = std::chrono::system_clock::now();
+    orm::device_record_dbo t1;
+    for (const auto & replica : replicas) {
+      if (replica.is_valid) {
+        verified_bytes += replica.data_size;
+        t.execute(
+          t1.update(t1.last_verified = now)
+          .where(t1.node_id == node_id && t1.data_hash == replica.data_hash));
+        continue;
+      }
+
+      //The replica can be moved by the segment compaction or removed while the hash is calculated
+      auto st = t.get_reader(
+        t1.select(t1.local_path, t1.data_offset)
+        .where(t1.node_id == node_id && t1.data_hash == replica.data_hash));
+      if (!st.execute()
+        || t1.local_path.get(st) != replica.local_path
+        || t1.data_offset.get(st) != replica.data_offset) {
+        continue;
+      }
+
+      this->sp_->get<logger>()->warning(
+        ThisModule,
+        "Replica %s at %s is corrupted",
+        base64::from_bytes(replica.data_hash).c_str(),
+        replica.local_path.c_str());
+
+      ++corrupted_count;
+      (*client)->repair_replica(t, replica.data_hash).get();
+    }
+  });
+
+  const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+
+  std::lock_guard<std::mutex> lock(this->statistic_mutex_);
+  this->statistic_.verified_count_ += replicas.size() - corrupted_count;
+  this->statistic_.verified_bytes_ += verified_bytes;
+  this->statistic_.corrupted_count_ += corrupted_count;
+  this->statistic_.bytes_per_second_ = (0 == ms) ? verified_bytes * 1000 : verified_bytes * 1000 / ms;
+  this->statistic_.pass_verified_ = std::min<uint64_t>(
+    this->statistic_.pass_total_,
+    this->statistic_.pass_verified_ + replicas.size());
+
+  co_return replicas.size();
+}
+
+void vds::dht::network::replica_scrubber::get_statistic(scrub_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->statistic_mutex_);
+  result = this->statistic_;
+}
+
+vds::async_task<void> vds::dht::network::replica_scrubber::verify(
+  std::vector<replica_t> & replicas,
+  size_t max_parallel) {
+
+  const size_t worker_count = std::min<size_t>(replicas.size(), max_parallel);
+  auto next = std::make_shared<std::atomic<size_t>>(0);
+  auto remaining = std::make_shared<std::atomic<size_t>>(worker_count);
+  auto done = std::make_shared<async_result<void>>();
+
+  for (size_t worker = 0; worker < worker_count; ++worker) {
+    mt_service::async(this->sp_, [&replicas, next, remaining, done]() {
+      for (auto index = (*next)++; index < replicas.size(); index = (*next)++) {
+        replicas[index].is_valid = is_valid(replicas[index]);
+      }
+
+      if (0 == --(*remaining)) {
+        done->set_value();
+      }
+    });
+  }
+
+  co_await done->get_future();
+}
+
+bool vds::dht::network::replica_scrubber::is_valid(const replica_t & replica) {
+  try {
+    const auto data = (0 > replica.data_offset)
+      ? file::read_all(filename(replica.local_path))
+      : segment_store::read(filename(replica.local_path), replica.data_offset, replica.data_size);
+
+    return static_cast<int64_t>(data.size()) == replica.data_size
+      && replica.data_hash == hash::signature(hash::sha256(), data);
+  }
+  catch (...) {
+    return false;
+  }
+}
@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/replica_source_selector.h"
+
+vds::dht::network::replica_source_selector::peer_t::peer_t()
+: rtt_ms_(DEFAULT_RTT_MS),
+  bytes_per_second_(DEFAULT_BYTES_PER_SECOND),
+  ping_pending_(false),
+  requests_(0),
+  responses_(0),
+  timeouts_(0) {
+}
+
+vds::dht::network::replica_source_selector::replica_source_selector()
+: completed_restores_(0),
+  hedged_requests_(0),
+  last_restore_ms_(0) {
+}
+
+void vds::dht::network::replica_source_selector::ping_sent(
+  const const_data_buffer & node,
+  const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto & peer = this->peers_[node];
+  //The first unanswered ping is measured
+  if (!peer.ping_pending_) {
+    peer.ping_pending_ = true;
+    peer.ping_time_ = now;
+  }
+}
+
+void vds::dht::network::replica_source_selector::pong_received(
+  const const_data_buffer & node,
+  const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto p = this->peers_.find(node);
+  if (this->peers_.end() == p || !p->second.ping_pending_) {
+    return;
+  }
+
+  auto & peer = p->second;
+  peer.ping_pending_ = false;
+
+  //Smoothed as TCP does
+  const auto sample = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::milliseconds>(now - peer.ping_time_).count());
+  peer.rtt_ms_ = (7 * peer.rtt_ms_ + sample) / 8;
+}
+
+std::chrono::milliseconds vds::dht::network::replica_source_selector::estimate(
+  const const_data_buffer & node,
+  uint64_t bytes) const {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->estimate_locked(node, bytes);
+}
+
+std::chrono::milliseconds vds::dht::network::replica_source_selector::estimate_locked(
+  const const_data_buffer & node,
+  uint64_t bytes) const {
+
+  const auto p = this->peers_.find(node);
+  if (this->peers_.end() == p) {
+    return std::chrono::milliseconds(DEFAULT_RTT_MS + bytes * 1000 / DEFAULT_BYTES_PER_SECOND);
+  }
+
+  return std::chrono::milliseconds(
+    p->second.rtt_ms_ + bytes * 1000 / std::max<uint64_t>(1, p->second.bytes_per_second_));
+}
+
+std::list<vds::dht::network::replica_source_selector::request_t> vds::dht::network::replica_source_selector::plan(
+  const std::map<const_data_buffer, std::set<uint16_t>> & holders,
+  uint64_t replica_size) const {
+
+  std::multimap<std::chrono::milliseconds, const_data_buffer> nodes;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (const auto & p : holders) {
+      nodes.emplace(this->estimate_locked(p.first, replica_size), p.first);
+    }
+  }
+
+  std::list<request_t> result;
+  std::set<uint16_t> planned_replicas;
+  std::set<std::pair<const_data_buffer, uint16_t>> planned;
+
+  //Different replicas from the different nodes
+  for (const auto & node : nodes) {
+    for (const auto replica : holders.find(node.second)->second) {
+      if (planned_replicas.end() == planned_replicas.find(replica)) {
+        planned_replicas.emplace(replica);
+        planned.emplace(node.second, replica);
+        result.push_back(request_t { node.second, replica });
+        break;
+      }
+    }
+  }
+
+  //Other replicas of the same nodes
+  for (const auto & node : nodes) {
+    for (const auto replica : holders.find(node.second)->second) {
+      if (planned_replicas.end() == planned_replicas.find(replica)) {
+        planned_replicas.emplace(replica);
+        planned.emplace(node.second, replica);
+        result.push_back(request_t { node.second, replica });
+      }
+    }
+  }
+
+  //Other holders of the same replicas
+  for (const auto & node : nodes) {
+    for (const auto replica : holders.find(node.second)->second) {
+      if (planned.end() == planned.find(std::make_pair(node.second, replica))) {
+        planned.emplace(node.second, replica);
+        result.push_back(request_t { node.second, replica });
+      }
+    }
+  }
+
+  return result;
+}
+
+bool vds::dht::network::replica_source_selector::start(
+  const const_data_buffer & object_id,
+  size_t needed,
+  const std::list<request_t> & plan,
+  uint64_t replica_size,
+  std::list<request_t> & requests,
+  const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  auto p = this->restores_.find(object_id);
+  if (this->restores_.end() != p) {
+    if (now < p->second.started + MAX_RESTORE_TIME()) {
+      return false;
+    }
+
+    this->restores_.erase(p);
+  }
+
+  auto & restore = this->restores_[object_id];
+  restore.needed = needed;
+  restore.replica_size = replica_size;
+  restore.started = now;
+
+  std::set<uint16_t> requested;
+  for (const auto & request : plan) {
+    if (requested.size() < needed && requested.end() == requested.find(request.replica)) {
+      requested.emplace(request.replica);
+      this->send_locked(restore, request, now);
+      requests.push_back(request);
+    }
+    else {
+      restore.spare.push_back(request);
+    }
+  }
+
+  return true;
+}
+
+void vds::dht::network::replica_source_selector::send_locked(
+  restore_t & restore,
+  const request_t & request,
+  const std::chrono::steady_clock::time_point & now) {
+
+  auto & peer = this->peers_[request.node];
+  ++peer.requests_;
+
+  const auto delay = std::max<std::chrono::milliseconds>(
+    MIN_HEDGE_DELAY(),
+    2 * this->estimate_locked(request.node, restore.replica_size));
+
+  restore.sent.push_back(pending_request_t { request, now, now + delay, false });
+}
+
+void vds::dht::network::replica_source_selector::received(
+  const const_data_buffer & node,
+  const const_data_buffer & object_id,
+  uint16_t replica,
+  size_t bytes,
+  const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  auto p = this->restores_.find(object_id);
+  if (this->restores_.end() == p) {
+    return;
+  }
+
+  auto & restore = p->second;
+  for (auto request = restore.sent.begin(); restore.sent.end() != request;) {
+    if (request->request.node == node && request->request.replica == replica) {
+      auto & peer = this->peers_[node];
+      ++peer.responses_;
+
+      //The transfer time without the round trip
+      const auto elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - request->sent).count());
+      const auto transfer_ms = std::max<uint64_t>(1, (elapsed > peer.rtt_ms_) ? elapsed - peer.rtt_ms_ : 0);
+      const auto sample = static_cast<uint64_t>(bytes) * 1000 / transfer_ms;
+      peer.bytes_per_second_ = (3 * peer.bytes_per_second_ + sample) / 4;
+    }
+
+    if (request->request.replica == replica) {
+      request = restore.sent.erase(request);
+    }
+    else {
+      ++request;
+    }
+  }
+
+  restore.received.emplace(replica);
+  if (restore.received.size() >= restore.needed) {
+    ++this->completed_restores_;
+    this->last_restore_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(now - restore.started).count();
+    this->restores_.erase(p);
+  }
+}
+
+std::list<std::pair<vds::const_data_buffer, vds::dht::network::replica_source_selector::request_t>>
+vds::dht::network::replica_source_selector::hedge(const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  std::list<std::pair<const_data_buffer, request_t>> result;
+  for (auto p = this->restores_.begin(); this->restores_.end() != p;) {
+    auto & restore = p->second;
+    if (restore.started + MAX_RESTORE_TIME() <= now) {
+      p = this->restores_.erase(p);
+      continue;
+    }
+
+    size_t expired = 0;
+    std::set<uint16_t> active;
+    for (auto & request : restore.sent) {
+      if (!request.timed_out && request.deadline <= now) {
+        request.timed_out = true;
+        ++expired;
+
+        //The slow peer is asked later next time
+        auto & peer = this->peers_[request.request.node];
+        ++peer.timeouts_;
+        peer.bytes_per_second_ = std::max<uint64_t>(1, peer.bytes_per_second_ / 2);
+      }
+
+      if (!request.timed_out) {
+        active.emplace(request.request.replica);
+      }
+    }
+
+    while (0 < expired && !restore.spare.empty()) {
+      const auto request = restore.spare.front();
+      restore.spare.pop_front();
+
+      if (restore.received.end() != restore.received.find(request.replica)
+        || active.end() != active.find(request.replica)) {
+        continue;
+      }
+
+      active.emplace(request.replica);
+      this->send_locked(restore, request, now);
+      result.push_back(std::make_pair(p->first, request));
+      ++this->hedged_requests_;
+      --expired;
+    }
+
+    ++p;
+  }
+
+  return result;
+}
+
+size_t vds::dht::network::replica_source_selector::pending_restores() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->restores_.size();
+}
+
+void vds::dht::network::replica_source_selector::get_statistic(replica_source_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  result.pending_restores_ = this->restores_.size();
+  result.completed_restores_ = this->completed_restores_;
+  result.hedged_requests_ = this->hedged_requests_;
+  result.last_restore_ms_ = this->last_restore_ms_;
+
+  result.peers_.clear();
+  for (const auto & p : this->peers_) {
+    result.peers_.push_back(replica_source_statistic::peer_info {
+      p.first,
+      p.second.rtt_ms_,
+      p.second.bytes_per_second_,
+      p.second.requests_,
+      p.second.responses_,
+      p.second.timeouts_
+    });
+  }
+}
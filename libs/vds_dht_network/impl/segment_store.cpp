@@ -0,0 +1,281 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/segment_store.h"
+#include "database_orm.h"
+#include "device_record_dbo.h"
+#include "replica_segment_dbo.h"
+
+vds::dht::network::segment_store::segment_store()
+: segment_size_(SEGMENT_SIZE) {
+}
+
+vds::dht::network::segment_store::location_t vds::dht::network::segment_store::write(
+  database_transaction & t,
+  const std::string & storage_path,
+  const const_data_buffer & data) {
+
+  auto location = this->reserve(t, storage_path, static_cast<int64_t>(data.size()));
+  location.f->write_at(safe_cast<size_t>(location.data_offset), data.data(), data.size());
+  return location;
+}
+
+vds::dht::network::segment_store::location_t vds::dht::network::segment_store::reserve(
+  database_transaction & t,
+  const std::string & storage_path,
+  int64_t data_size) {
+
+  std::unique_lock<std::mutex> lock(this->active_segments_mutex_);
+
+  auto & segment = this->active_segments_[storage_path];
+  if (!segment) {
+    segment = this->open_active_segment(t, storage_path);
+  }
+
+  auto data_offset = segment->length_;
+  if (0 < data_offset && this->segment_size_ < data_offset + data_size) {
+    orm::replica_segment_dbo t1;
+    t.execute(
+      t1.update(t1.state = orm::replica_segment_dbo::state_t::sealed)
+      .where(t1.local_path == segment->fn_.full_name()));
+
+    segment = this->open_active_segment(t, storage_path);
+    data_offset = segment->length_;
+  }
+
+  const auto local_path = segment->fn_.full_name();
+  if (this->pending_segments_.empty()) {
+    //The data has to be on the disk before device_record points to it
+    t.before_commit([this]() {
+      this->sync_pending();
+    });
+    t.on_commit([this]() {
+      this->commit_pending();
+    });
+    t.on_rollback([this]() {
+      this->rollback_pending();
+    });
+  }
+  this->pending_segments_.emplace(local_path, pending_segment_t{ segment->f_, data_offset });
+
+  segment->length_ += data_size;
+  auto f = segment->f_;
+  lock.unlock();
+
+  orm::replica_segment_dbo t1;
+  auto st = t.get_reader(t1.select(t1.live_size).where(t1.local_path == local_path));
+  if (st.execute()) {
+    const auto live_size = t1.live_size.get(st);
+    t.execute(
+      t1.update(
+        t1.data_size = data_offset + data_size,
+        t1.live_size = live_size + data_size)
+      .where(t1.local_path == local_path));
+  }
+  else {
+    t.execute(
+      t1.insert(
+        t1.local_path = local_path,
+        t1.storage_path = storage_path,
+        t1.data_size = data_offset + data_size,
+        t1.live_size = data_size,
+        t1.state = orm::replica_segment_dbo::state_t::active));
+  }
+
+  return location_t{ local_path, data_offset, f };
+}
+
+vds::const_data_buffer vds::dht::network::segment_store::read(
+  const filename & fn,
+  int64_t data_offset,
+  int64_t data_size) {
+  return file::read_range(fn, safe_cast<size_t>(data_offset), safe_cast<size_t>(data_size));
+}
+
+void vds::dht::network::segment_store::release(
+  database_transaction & t,
+  const std::string & local_path,
+  int64_t data_size) {
+
+  orm::replica_segment_dbo t1;
+  auto st = t.get_reader(t1.select(t1.live_size).where(t1.local_path == local_path));
+  if (st.execute()) {
+    auto live_size = t1.live_size.get(st) - data_size;
+    if (live_size < 0) {
+      live_size = 0;
+    }
+
+    t.execute(t1.update(t1.live_size = live_size).where(t1.local_path == local_path));
+  }
+}
+
+void vds::dht::network::segment_store::compact(
+  database_transaction & t,
+  const const_data_buffer & node_id) {
+
+  orm::replica_segment_dbo t1;
+
+  //Segments compacted by the committed transaction can be removed
+  std::list<std::string> compacted;
+  auto st = t.get_reader(
+    t1.select(t1.local_path)
+    .where(t1.state == orm::replica_segment_dbo::state_t::compacted));
+  while (st.execute()) {
+    compacted.push_back(t1.local_path.get(st));
+  }
+
+  for (const auto & local_path : compacted) {
+    file::delete_file(filename(local_path), true);
+    t.execute(t1.delete_if(t1.local_path == local_path));
+  }
+
+  std::list<std::string> candidates;
+  st = t.get_reader(
+    t1.select(t1.local_path, t1.data_size, t1.live_size)
+    .where(t1.state == orm::replica_segment_dbo::state_t::sealed));
+  while (st.execute()) {
+    if (t1.live_size.get(st) < t1.data_size.get(st) / 2) {
+      candidates.push_back(t1.local_path.get(st));
+    }
+  }
+
+  size_t count = 0;
+  for (const auto & local_path : candidates) {
+    if (COMPACT_SEGMENTS_PER_TICK <= count) {
+      break;
+    }
+
+    if (this->is_active(local_path)) {
+      continue;
+    }
+
+    struct replica_info_t {
+      std::string storage_path;
+      const_data_buffer data_hash;
+      int64_t data_offset;
+      int64_t data_size;
+    };
+    std::list<replica_info_t> replicas;
+
+    orm::device_record_dbo t2;
+    st = t.get_reader(
+      t2.select(t2.storage_path, t2.data_hash, t2.data_offset, t2.data_size)
+      .where(t2.node_id == node_id && t2.local_path == local_path));
+    while (st.execute()) {
+      replicas.push_back(replica_info_t{
+        t2.storage_path.get(st),
+        t2.data_hash.get(st),
+        t2.data_offset.get(st),
+        t2.data_size.get(st) });
+    }
+
+    for (const auto & replica : replicas) {
+      const auto data = read(filename(local_path), replica.data_offset, replica.data_size);
+      const auto location = this->write(t, replica.storage_path, data);
+
+      t.execute(
+        t2.update(
+          t2.local_path = location.local_path,
+          t2.data_offset = location.data_offset)
+        .where(
+          t2.node_id == node_id
+          && t2.storage_path == replica.storage_path
+          && t2.data_hash == replica.data_hash));
+    }
+
+    t.execute(
+      t1.update(
+        t1.live_size = 0,
+        t1.state = orm::replica_segment_dbo::state_t::compacted)
+      .where(t1.local_path == local_path));
+
+    ++count;
+  }
+}
+
+std::unique_ptr<vds::dht::network::segment_store::active_segment_t>
+vds::dht::network::segment_store::open_active_segment(
+  database_transaction & t,
+  const std::string & storage_path) {
+
+  auto result = std::make_unique<active_segment_t>();
+
+  orm::replica_segment_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.local_path)
+    .where(t1.storage_path == storage_path && t1.state == orm::replica_segment_dbo::state_t::active));
+  if (st.execute()) {
+    result->fn_ = filename(t1.local_path.get(st));
+  }
+  else {
+    foldername folder(foldername(storage_path), "segments");
+    folder.create();
+
+    auto index = std::chrono::system_clock::now().time_since_epoch().count();
+    do {
+      result->fn_ = filename(folder, std::to_string(index++) + ".seg");
+    } while (file::exists(result->fn_));
+  }
+
+  //The writes are positioned, so the segment is not opened for append
+  result->f_ = std::make_shared<file>(result->fn_, file::file_mode::open_or_create);
+
+  //The tail of the segment may contain data of the transaction interrupted by a crash
+  result->length_ = static_cast<int64_t>(result->f_->length());
+  return result;
+}
+
+bool vds::dht::network::segment_store::is_active(const std::string & local_path) {
+  std::lock_guard<std::mutex> lock(this->active_segments_mutex_);
+
+  for (const auto & p : this->active_segments_) {
+    if (p.second && p.second->fn_.full_name() == local_path) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void vds::dht::network::segment_store::sync_pending() {
+  std::lock_guard<std::mutex> lock(this->active_segments_mutex_);
+
+  for (const auto & p : this->pending_segments_) {
+    p.second.f_->flush();
+  }
+}
+
+void vds::dht::network::segment_store::commit_pending() {
+  std::lock_guard<std::mutex> lock(this->active_segments_mutex_);
+  this->pending_segments_.clear();
+}
+
+void vds::dht::network::segment_store::rollback_pending() {
+  std::lock_guard<std::mutex> lock(this->active_segments_mutex_);
+
+  //The state of the segments has been rolled back too, so they are reopened from replica_segment
+  for (auto p = this->active_segments_.begin(); p != this->active_segments_.end();) {
+    if (p->second && this->pending_segments_.end() != this->pending_segments_.find(p->second->fn_.full_name())) {
+      p = this->active_segments_.erase(p);
+    }
+    else {
+      ++p;
+    }
+  }
+
+  std::map<std::string, pending_segment_t> pending_segments;
+  pending_segments.swap(this->pending_segments_);
+
+  for (const auto & p : pending_segments) {
+    if (0 == p.second.length_) {
+      p.second.f_->close();
+      file::delete_file(filename(p.first), true);
+    }
+    else {
+      p.second.f_->truncate(safe_cast<size_t>(p.second.length_));
+      p.second.f_->flush();
+    }
+  }
+}
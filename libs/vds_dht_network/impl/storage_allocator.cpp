@@ -0,0 +1,187 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/storage_allocator.h"
+#include "database_orm.h"
+#include "device_config_dbo.h"
+#include "device_record_dbo.h"
+
+vds::dht::network::storage_allocator::storage_allocator()
+: placement_policy_(placement_policy_t::most_free),
+  next_device_(0) {
+}
+
+vds::dht::network::storage_allocator::placement_policy_t
+vds::dht::network::storage_allocator::placement_policy() const {
+  std::lock_guard<std::mutex> lock(this->devices_mutex_);
+  return this->placement_policy_;
+}
+
+void vds::dht::network::storage_allocator::placement_policy(placement_policy_t value) {
+  std::lock_guard<std::mutex> lock(this->devices_mutex_);
+  this->placement_policy_ = value;
+}
+
+void vds::dht::network::storage_allocator::load(
+  const database_read_transaction & t,
+  const const_data_buffer & node_id) {
+
+  std::vector<device_info_t> devices;
+
+  orm::device_config_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.local_path, t1.reserved_size, t1.used_size)
+    .where(t1.node_id == node_id));
+  while (st.execute()) {
+    devices.push_back(device_info_t{
+      t1.local_path.get(st),
+      t1.reserved_size.get(st),
+      t1.used_size.get(st)});
+  }
+
+  std::lock_guard<std::mutex> lock(this->devices_mutex_);
+  this->devices_.swap(devices);
+  if (this->next_device_ >= this->devices_.size()) {
+    this->next_device_ = 0;
+  }
+}
+
+std::string vds::dht::network::storage_allocator::allocate(
+  database_transaction & t,
+  uint64_t size) {
+
+  std::string result;
+  {
+    std::lock_guard<std::mutex> lock(this->devices_mutex_);
+
+    auto device = this->select_device(size);
+    if (nullptr == device) {
+      return std::string();
+    }
+
+    device->used_size_ += size;
+    result = device->local_path_;
+  }
+
+  t.on_rollback([this, result, size]() {
+    this->release(result, size);
+  });
+
+  return result;
+}
+
+void vds::dht::network::storage_allocator::release(
+  database_transaction & t,
+  const std::string & storage_path,
+  uint64_t size) {
+  t.on_commit([this, storage_path, size]() {
+    this->release(storage_path, size);
+  });
+}
+
+void vds::dht::network::storage_allocator::release(
+  const std::string & storage_path,
+  uint64_t size) {
+  std::lock_guard<std::mutex> lock(this->devices_mutex_);
+
+  for (auto & device : this->devices_) {
+    if (device.local_path_ == storage_path) {
+      device.used_size_ = (device.used_size_ > static_cast<int64_t>(size)) ? (device.used_size_ - size) : 0;
+      break;
+    }
+  }
+}
+
+//The number of storage devices per node is small so each policy is a constant time scan
+vds::dht::network::storage_allocator::device_info_t *
+vds::dht::network::storage_allocator::select_device(uint64_t size) {
+  const auto count = this->devices_.size();
+
+  switch (this->placement_policy_) {
+  case placement_policy_t::most_free: {
+    device_info_t * result = nullptr;
+    for (auto & device : this->devices_) {
+      if (static_cast<int64_t>(size) <= device.free_size()
+        && (nullptr == result || result->free_size() < device.free_size())) {
+        result = &device;
+      }
+    }
+    return result;
+  }
+
+  case placement_policy_t::round_robin: {
+    for (size_t i = 0; i < count; ++i) {
+      auto & device = this->devices_[(this->next_device_ + i) % count];
+      if (static_cast<int64_t>(size) <= device.free_size()) {
+        this->next_device_ = (this->next_device_ + i + 1) % count;
+        return &device;
+      }
+    }
+    return nullptr;
+  }
+
+  case placement_policy_t::fill_first: {
+    for (auto & device : this->devices_) {
+      if (static_cast<int64_t>(size) <= device.free_size()) {
+        return &device;
+      }
+    }
+    return nullptr;
+  }
+
+  default:
+    throw std::runtime_error("Invalid placement policy");
+  }
+}
+
+void vds::dht::network::storage_allocator::reconcile(
+  database_transaction & t,
+  const const_data_buffer & node_id) {
+
+  orm::device_config_dbo t1;
+  t.execute(t1.update(t1.used_size = 0).where(t1.node_id == node_id));
+
+  std::map<std::string, int64_t> usage;
+
+  orm::device_record_dbo t2;
+  db_value<int64_t> data_size;
+  auto st = t.get_reader(
+    t2.select(t2.storage_path, db_sum(t2.data_size).as(data_size))
+    .where(t2.node_id == node_id)
+    .group_by(t2.storage_path));
+  while (st.execute()) {
+    usage[t2.storage_path.get(st)] = data_size.is_null(st) ? 0 : data_size.get(st);
+  }
+
+  for (const auto & p : usage) {
+    t.execute(
+      t1.update(t1.used_size = p.second)
+      .where(t1.node_id == node_id && t1.local_path == p.first));
+  }
+}
+
+void vds::dht::network::storage_allocator::add_usage(
+  database_transaction & t,
+  const const_data_buffer & node_id,
+  const std::string & storage_path,
+  int64_t delta) {
+
+  orm::device_config_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.used_size)
+    .where(t1.node_id == node_id && t1.local_path == storage_path));
+  if (!st.execute()) {
+    throw std::runtime_error("Storage " + storage_path + " not found");
+  }
+
+  auto used_size = t1.used_size.get(st) + delta;
+  if (used_size < 0) {
+    used_size = 0;
+  }
+
+  t.execute(
+    t1.update(t1.used_size = used_size)
+    .where(t1.node_id == node_id && t1.local_path == storage_path));
+}
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/sync_outbox.h"
+#include "binary_serialize.h"
+
+vds::dht::network::sync_outbox::sync_outbox()
+: tick_messages_(0),
+  tick_datagrams_(0),
+  tick_bytes_(0),
+  statistic_{} {
+}
+
+bool vds::dht::network::sync_outbox::is_sync_message(message_type_t message_id) {
+  switch (message_id) {
+  case message_type_t::sync_new_election_request:
+  case message_type_t::sync_new_election_response:
+  case message_type_t::sync_add_message_request:
+  case message_type_t::sync_leader_broadcast_request:
+  case message_type_t::sync_leader_broadcast_response:
+  case message_type_t::sync_replica_operations_request:
+  case message_type_t::sync_replica_operations_response:
+  case message_type_t::sync_looking_storage_request:
+  case message_type_t::sync_looking_storage_response:
+  case message_type_t::sync_snapshot_request:
+  case message_type_t::sync_snapshot_response:
+  case message_type_t::sync_offer_send_replica_operation_request:
+  case message_type_t::sync_offer_remove_replica_operation_request:
+  case message_type_t::sync_replica_request:
+  case message_type_t::sync_replica_query_operations_request:
+    return true;
+
+  //Replica data is large, it is not delayed
+  default:
+    return false;
+  }
+}
+
+bool vds::dht::network::sync_outbox::begin(const scope_id_t & scope) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->scopes_.emplace(scope, scope_t()).second;
+}
+
+bool vds::dht::network::sync_outbox::add(
+  const scope_id_t & scope,
+  const const_data_buffer & node_id,
+  message_type_t message_id,
+  const const_data_buffer & message_data) {
+
+  if (!is_sync_message(message_id)) {
+    return false;
+  }
+
+  //Every sync message starts with object_id
+  const_data_buffer object_id;
+  binary_deserializer s(message_data);
+  s >> object_id;
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  ++this->tick_messages_;
+  ++this->statistic_.total_messages_;
+  this->tick_objects_.emplace(object_id);
+
+  auto p = this->scopes_.find(scope);
+  if (this->scopes_.end() == p) {
+    return false;
+  }
+
+  p->second.push_back(scope_message_t{ node_id, message_t { message_id, message_data } });
+  return true;
+}
+
+size_t vds::dht::network::sync_outbox::mark(const scope_id_t & scope) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto p = this->scopes_.find(scope);
+  if (this->scopes_.end() == p) {
+    return 0;
+  }
+
+  return p->second.size();
+}
+
+void vds::dht::network::sync_outbox::rollback_to(const scope_id_t & scope, size_t mark) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto p = this->scopes_.find(scope);
+  if (this->scopes_.end() != p && mark < p->second.size()) {
+    p->second.resize(mark);
+  }
+}
+
+std::map<vds::const_data_buffer, std::list<vds::dht::network::sync_outbox::message_t>> vds::dht::network::sync_outbox::end(
+  const scope_id_t & scope) {
+
+  std::map<const_data_buffer, std::list<message_t>> result;
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto p = this->scopes_.find(scope);
+  vds_assert(this->scopes_.end() != p);
+  for (auto & message : p->second) {
+    result[message.node_id_].push_back(std::move(message.message_));
+  }
+
+  this->scopes_.erase(p);
+  return result;
+}
+
+void vds::dht::network::sync_outbox::discard(const scope_id_t & scope) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->scopes_.erase(scope);
+}
+
+void vds::dht::network::sync_outbox::sent(size_t bytes) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  ++this->tick_datagrams_;
+  this->tick_bytes_ += bytes;
+  ++this->statistic_.total_datagrams_;
+  this->statistic_.total_bytes_ += bytes;
+}
+
+void vds::dht::network::sync_outbox::finish_tick() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->statistic_.tick_messages_ = this->tick_messages_;
+  this->statistic_.tick_objects_ = this->tick_objects_.size();
+  this->statistic_.tick_datagrams_ = this->tick_datagrams_;
+  this->statistic_.tick_bytes_ = this->tick_bytes_;
+
+  this->tick_messages_ = 0;
+  this->tick_objects_.clear();
+  this->tick_datagrams_ = 0;
+  this->tick_bytes_ = 0;
+}
+
+void vds::dht::network::sync_outbox::get_statistic(sync_message_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  result = this->statistic_;
+}
@@ -23,19 +23,19 @@ All rights reserved
 #include "dht_network.h"
 
 vds::dht::network::sync_process::sync_process(const service_provider * sp)
-  : sp_(sp), sync_replicas_timeout_(0) {
+  : sp_(sp), replica_map_digests_rollback_count_(0) {
   for (uint16_t replica = 0; replica < service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
     this->distributed_generators_[replica].reset(new chunk_generator<uint16_t>(service::MIN_DISTRIBUTED_PIECES, replica));
   }
 }
 
-vds::async_task<void> vds::dht::network::sync_process::do_sync(
-  
-  database_transaction& t) {
+vds::async_task<size_t> vds::dht::network::sync_process::do_sync(
+  database_transaction& t,
+  const std::chrono::steady_clock::time_point& deadline) {
 
   co_await this->sync_entries(t);
   co_await this->sync_local_queues(t);
-  co_await this->sync_replicas(t);
+  co_return co_await this->sync_replicas(t, deadline);
 }
 
 vds::async_task<void> vds::dht::network::sync_process::add_to_log(
@@ -102,6 +102,7 @@ vds::async_task<void> vds::dht::network::sync_process::add_to_log(
         base64::from_bytes(object_id).c_str());
 
       co_await (*client)->send(
+        t,
         member,
         message_create<messages::sync_replica_operations_request>(
           object_id,
@@ -176,6 +177,7 @@ vds::async_task<void> vds::dht::network::sync_process::add_local_log(
   }
   else {
     co_await (*client)->send(
+      t,
       leader_node,
       message_create<messages::sync_add_message_request>(
         object_id,
@@ -244,6 +246,7 @@ vds::async_task<void> vds::dht::network::sync_process::make_new_election(
     for (const auto& member : members) {
       if (member != client->current_node_id()) {
         co_await client->send(
+          t,
           member,
           message_create<messages::sync_new_election_request>(
             object_id,
@@ -337,6 +340,7 @@ vds::async_task<vds::dht::network::sync_process::base_message_type> vds::dht::ne
 
         if(db_last_applied < last_applied) {
           co_await client->send(
+            t,
             leader_node,
             message_create<messages::sync_replica_query_operations_request>(
             message.object_id,
@@ -356,6 +360,7 @@ vds::async_task<vds::dht::network::sync_process::base_message_type> vds::dht::ne
             t.execute(t2.delete_if(
               t2.object_id == message.object_id
               && t2.member_node == message_info.source_node()));
+            this->update_replica_map_digests(t, message.object_id);
           }
         }
         else {
@@ -593,15 +598,17 @@ vds::async_task<vds::const_data_buffer> vds::dht::network::sync_process::restore
   orm::device_record_dbo t4;
   auto st = t.get_reader(
     t2.select(
-        t2.replica, t2.replica_hash, t4.local_path)
+        t2.replica, t2.replica_hash, t4.local_path, t4.data_offset, t4.data_size)
       .inner_join(t4, t4.node_id == client->current_node_id() && t4.data_hash == t2.replica_hash)
       .where(t2.object_id == object_id));
   while (st.execute()) {
     replicas.push_back(t2.replica.get(st));
     datas.push_back(
-      _client::read_data(
+      (*client)->read_data(
         t2.replica_hash.get(st),
-        filename(t4.local_path.get(st))));
+        filename(t4.local_path.get(st)),
+        t4.data_offset.get(st),
+        t4.data_size.get(st)));
 
     if (replicas.size() >= service::MIN_DISTRIBUTED_PIECES) {
       break;
@@ -625,6 +632,7 @@ vds::async_task<vds::const_data_buffer> vds::dht::network::sync_process::restore
       t1.insert(
         t1.object_id = object_id,
         t1.last_sync = std::chrono::system_clock::now()));
+    this->replica_sync_.invalidate(t, object_id);
 
     co_return data;
   }
@@ -638,55 +646,7 @@ vds::async_task<vds::const_data_buffer> vds::dht::network::sync_process::restore
   }
   this->sp_->get<logger>()->trace(SyncModule, "%s", log_message.c_str());
 
-  std::set<const_data_buffer> candidates;
-  orm::sync_replica_map_dbo t5;
-  st = t.get_reader(t5.select(t5.node).where(t5.object_id == object_id));
-  while (st.execute()) {
-    if (candidates.end() == candidates.find(t5.node.get(st)) && client->current_node_id() != t5.node.get(st)) {
-      candidates.emplace(t5.node.get(st));
-    }
-  }
-
-  orm::sync_member_dbo t6;
-  st = t.get_reader(t6.select(t6.voted_for, t6.member_node).where(t6.object_id == object_id));
-  while (st.execute()) {
-    if (candidates.end() == candidates.find(t6.member_node.get(st))
-      && client->current_node_id() != t6.member_node.get(st)) {
-      candidates.emplace(t6.member_node.get(st));
-    }
-    if (candidates.end() == candidates.find(t6.voted_for.get(st))
-      && client->current_node_id() != t6.voted_for.get(st)) {
-      candidates.emplace(t6.voted_for.get(st));
-    }
-  }
-
-  if (!candidates.empty()) {
-    for (const auto& candidate : candidates) {
-      this->sp_->get<logger>()->trace(
-        SyncModule,
-        "%s from %s",
-        log_message.c_str(),
-        base64::from_bytes(candidate).c_str());
-
-      co_await (*client)->send(
-        candidate,
-        message_create<messages::sync_replica_request>(
-          object_id,
-          exist_replicas));
-    }
-  }
-  else {
-    co_await (*client)->send_neighbors(
-      message_create<messages::dht_find_node>(object_id));
-
-    co_await (*client)->send_near(
-      object_id,
-      service::GENERATE_DISTRIBUTED_PIECES,
-      message_create<messages::sync_replica_request>(
-        object_id,
-        exist_replicas));
-  }
-
+  co_await this->request_replicas(t, object_id, exist_replicas, log_message);
   co_return const_data_buffer();
 }
 
@@ -722,12 +682,30 @@ vds::async_task<std::list<uint16_t>> vds::dht::network::sync_process::prepare_re
   }
   this->sp_->get<logger>()->trace(SyncModule, "%s", log_message.c_str());
 
+  co_await this->request_replicas(t, object_id, exist_replicas, log_message);
+  co_return replicas;
+}
+
+vds::async_task<void> vds::dht::network::sync_process::request_replicas(
+  database_read_transaction & t,
+  const const_data_buffer & object_id,
+  const std::set<uint16_t> & exist_replicas,
+  const std::string & log_message) {
+
+  auto client = this->sp_->get<network::client>();
+
+  //Known holders of the missing replicas are asked directly, the fastest first
+  std::map<const_data_buffer, std::set<uint16_t>> holders;
   std::set<const_data_buffer> candidates;
   orm::sync_replica_map_dbo t5;
-  st = t.get_reader(t5.select(t5.node).where(t5.object_id == object_id));
+  auto st = t.get_reader(t5.select(t5.node, t5.replica).where(t5.object_id == object_id));
   while (st.execute()) {
-    if (candidates.end() == candidates.find(t5.node.get(st)) && client->current_node_id() != t5.node.get(st)) {
-      candidates.emplace(t5.node.get(st));
+    const auto node = t5.node.get(st);
+    if (client->current_node_id() != node) {
+      candidates.emplace(node);
+      if (exist_replicas.end() == exist_replicas.find(t5.replica.get(st))) {
+        holders[node].emplace(t5.replica.get(st));
+      }
     }
   }
 
@@ -744,6 +722,36 @@ vds::async_task<std::list<uint16_t>> vds::dht::network::sync_process::prepare_re
     }
   }
 
+  const size_t needed = service::MIN_DISTRIBUTED_PIECES - exist_replicas.size();
+  const uint64_t replica_size = service::BLOCK_SIZE / service::MIN_DISTRIBUTED_PIECES;
+  auto & sources = (*client)->replica_sources();
+
+  std::list<replica_source_selector::request_t> requests;
+  if (!sources.start(object_id, needed, sources.plan(holders, replica_size), replica_size, requests)) {
+    //The requests in progress are hedged by the maintenance job
+    co_return;
+  }
+
+  for (const auto & request : requests) {
+    this->sp_->get<logger>()->trace(
+      SyncModule,
+      "%s: replica %d from %s",
+      log_message.c_str(),
+      request.replica,
+      base64::from_bytes(request.node).c_str());
+
+    co_await (*client)->send(
+      request.node,
+      message_create<messages::sync_replica_piece_request>(
+        object_id,
+        std::set<uint16_t>({ request.replica })));
+  }
+
+  if (requests.size() >= needed) {
+    co_return;
+  }
+
+  //The leader generates or finds the rest replicas
   if (!candidates.empty()) {
     for (const auto& candidate : candidates) {
       this->sp_->get<logger>()->trace(
@@ -770,8 +778,6 @@ vds::async_task<std::list<uint16_t>> vds::dht::network::sync_process::prepare_re
         object_id,
         exist_replicas));
   }
-
-  co_return replicas;
 }
 
 vds::async_task<void> vds::dht::network::sync_process::apply_message(
@@ -813,6 +819,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
         base64::from_bytes(message.object_id).c_str());
 
       co_await client->send(
+        t,
         message_info.source_node(),
         message_create<messages::sync_looking_storage_response>(
           message.object_id,
@@ -911,6 +918,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
   const auto leader = this->get_leader(t, message.object_id);
   if (leader && client->current_node_id() != leader) {
     return client->send(
+      t,
       leader,
       message);
   }
@@ -1031,7 +1039,10 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
     }
   }
 
+  this->invalidate_replica_map(t, message.object_id);
+
   co_await client->send(
+    t,
     message_info.source_node(),
     message_create<messages::sync_leader_broadcast_response>(
       message.object_id,
@@ -1052,6 +1063,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
   auto leader = this->get_leader(t, message.object_id);
   if (leader && leader != message.leader_node) {
     return (*client)->send(
+      t,
       leader,
       message_create<messages::sync_add_message_request>(
         message.object_id,
@@ -1065,6 +1077,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
 
   if (message.leader_node != client->current_node_id()) {
     return (*client)->send(
+      t,
       message.leader_node,
       message);
   }
@@ -1221,6 +1234,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
           base64::from_bytes(message_info.source_node()).c_str(),
           base64::from_bytes(message.object_id).c_str());
         co_await (*client)->send(
+          t,
           message_info.source_node(),
           message_create<messages::sync_replica_operations_response>(
             message.object_id,
@@ -1299,12 +1313,9 @@ vds::async_task<void> vds::dht::network::sync_process::remove_replica(
   }
 
   const auto replica_hash = t1.replica_hash.get(st);
-  _client::delete_data(
-    replica_hash,
-    filename(t2.local_path.get(st)));
+  _client::delete_data(this->sp_, t, replica_hash);
 
   t.execute(t1.delete_if(t1.object_id == object_id && t1.replica == replica));
-  t.execute(t2.delete_if(t2.node_id == client->client::current_node_id() && t2.data_hash == replica_hash));
 
   co_return co_await add_local_log(
     t,
@@ -1315,6 +1326,33 @@ vds::async_task<void> vds::dht::network::sync_process::remove_replica(
     leader_node);
 }
 
+vds::async_task<void> vds::dht::network::sync_process::repair_replica(
+  vds::database_transaction& t,
+  const const_data_buffer & replica_hash) {
+
+  orm::chunk_replica_data_dbo t1;
+  auto st = t.get_reader(t1.select(
+                             t1.object_id,
+                             t1.replica)
+                           .where(t1.replica_hash == replica_hash));
+  if (!st.execute()) {
+    _client::delete_data(this->sp_, t, replica_hash);
+    co_return;
+  }
+
+  const auto object_id = t1.object_id.get(st);
+  const auto replica = t1.replica.get(st);
+
+  const auto leader = this->get_leader(t, object_id);
+  if (!leader) {
+    _client::delete_data(this->sp_, t, replica_hash);
+    t.execute(t1.delete_if(t1.object_id == object_id && t1.replica == replica));
+    co_return;
+  }
+
+  co_await this->remove_replica(t, object_id, replica, leader);
+}
+
 std::map<size_t, std::set<uint16_t>> vds::dht::network::sync_process::get_replica_frequency(
   
   database_transaction& t,
@@ -1438,7 +1476,7 @@ vds::async_task<void> vds::dht::network::sync_process::send_random_replicas(
       orm::device_record_dbo t6;
       st = t.get_reader(
         t5
-        .select(t5.replica, t5.replica_hash, t6.local_path)
+        .select(t5.replica, t5.replica_hash, t6.local_path, t6.data_offset, t6.data_size)
         .inner_join(t6, t6.node_id == client->client::current_node_id() && t6.data_hash == t5.replica_hash)
         .where(t5.object_id == object_id));
 
@@ -1459,11 +1497,15 @@ vds::async_task<void> vds::dht::network::sync_process::send_random_replicas(
                 replica,
                 replica_hash = t5.replica_hash.get(st),
                 local_path = t6.local_path.get(st),
+                data_offset = t6.data_offset.get(st),
+                data_size = t6.data_size.get(st),
                 target_node,
                 object_id]() -> async_task<void>{
-                auto data = _client::read_data(
+                auto data = (*client)->read_data(
                   replica_hash,
-                  filename(local_path));
+                  filename(local_path),
+                  data_offset,
+                  data_size);
                 sp->get<logger>()->trace(
                   SyncModule,
                   "Send replica %s:%d to %s",
@@ -1479,7 +1521,7 @@ vds::async_task<void> vds::dht::network::sync_process::send_random_replicas(
                     commit_index,
                     last_applied,
                     replica,
-                    data,
+                    std::move(data),
                     client->client::current_node_id()));
               });
           }
@@ -1533,12 +1575,16 @@ vds::async_task<void> vds::dht::network::sync_process::send_random_replicas(
       orm::device_record_dbo t4;
       st = t.get_reader(
         t3
-        .select(t4.local_path)
+        .select(t4.local_path, t4.data_offset, t4.data_size)
         .inner_join(t4, t4.node_id == client->client::current_node_id() && t4.data_hash == object_id)
         .where(t3.object_id == object_id));
 
       if (st.execute()) {
-        auto data = file::read_all(filename(t4.local_path.get(st)));
+        auto data = (*client)->read_data(
+          object_id,
+          filename(t4.local_path.get(st)),
+          t4.data_offset.get(st),
+          t4.data_size.get(st));
         for (uint16_t replica = 0; replica < service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
           if (allowed_replicas.end() == allowed_replicas.find(replica)
             && send_replicas.end() == send_replicas.find(replica)) {
@@ -1565,7 +1611,7 @@ vds::async_task<void> vds::dht::network::sync_process::send_random_replicas(
                 base64::from_bytes(target_node).c_str());
 
               const auto data_hash = hash::signature(hash::sha256(), replica_data);
-              auto fn = _client::save_data(this->sp_, t, data_hash, replica_data);
+              _client::save_data(this->sp_, t, data_hash, replica_data);
 
               orm::chunk_replica_data_dbo t5;
               t.execute(
@@ -1670,6 +1716,83 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
     message.exist_replicas);
 }
 
+vds::async_task<void> vds::dht::network::sync_process::apply_message(
+  database_transaction& t,
+  const messages::sync_replica_piece_request& message,
+  const imessage_map::message_info_t& message_info) {
+
+  auto client = this->sp_->get<network::client>();
+
+  orm::sync_state_dbo t1;
+  orm::sync_member_dbo t2;
+  auto st = t.get_reader(
+    t1.select(
+      t1.state,
+      t2.voted_for,
+      t2.generation,
+      t2.current_term,
+      t2.commit_index,
+      t2.last_applied)
+    .inner_join(t2, t2.object_id == t1.object_id && t2.member_node == client->current_node_id())
+    .where(t1.object_id == message.object_id));
+  if (!st.execute()) {
+    this->sp_->get<logger>()->trace(
+      SyncModule,
+      "Replica %s request from %s: object not found",
+      base64::from_bytes(message.object_id).c_str(),
+      base64::from_bytes(message_info.source_node()).c_str());
+    co_return;
+  }
+
+  const auto leader_node = (orm::sync_state_dbo::state_t::leader == t1.state.get(st))
+    ? client->current_node_id()
+    : t2.voted_for.get(st);
+  const auto generation = t2.generation.get(st);
+  const auto current_term = t2.current_term.get(st);
+  const auto commit_index = t2.commit_index.get(st);
+  const auto last_applied = t2.last_applied.get(st);
+
+  orm::chunk_replica_data_dbo t3;
+  orm::device_record_dbo t4;
+  st = t.get_reader(
+    t3.select(t3.replica, t3.replica_hash, t4.local_path, t4.data_offset, t4.data_size)
+    .inner_join(t4, t4.node_id == client->current_node_id() && t4.data_hash == t3.replica_hash)
+    .where(t3.object_id == message.object_id));
+  while (st.execute()) {
+    const auto replica = t3.replica.get(st);
+    if (message.replicas.end() == message.replicas.find(replica)) {
+      continue;
+    }
+
+    auto data = (*client)->read_data(
+      t3.replica_hash.get(st),
+      filename(t4.local_path.get(st)),
+      t4.data_offset.get(st),
+      t4.data_size.get(st));
+
+    this->sp_->get<logger>()->trace(
+      SyncModule,
+      "Send replica %s:%d to %s",
+      base64::from_bytes(message.object_id).c_str(),
+      replica,
+      base64::from_bytes(message_info.source_node()).c_str());
+
+    //The piece is requested by a restore waiting for it
+    co_await (*client)->send(
+      message_info.source_node(),
+      message_create<messages::sync_replica_data>(
+        message.object_id,
+        generation,
+        current_term,
+        commit_index,
+        last_applied,
+        replica,
+        std::move(data),
+        leader_node),
+      traffic_class_t::user);
+  }
+}
+
 vds::async_task<void> vds::dht::network::sync_process::apply_message(
   
   database_transaction& t,
@@ -1678,6 +1801,12 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
 
   auto client = this->sp_->get<network::client>();
 
+  (*client)->replica_sources().received(
+    message_info.source_node(),
+    message.object_id,
+    message.replica,
+    message.data.size());
+
   orm::chunk_replica_data_dbo t2;
   auto st = t.get_reader(
     t2.select(t2.replica_hash)
@@ -1694,7 +1823,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
   }
   else {
     const auto data_hash = hash::signature(hash::sha256(), message.data);
-    auto fn = _client::save_data(this->sp_, t, data_hash, message.data);
+    _client::save_data(this->sp_, t, data_hash, message.data);
     this->sp_->get<logger>()->trace(
       SyncModule,
       "Got replica %s:%d from %s",
@@ -1730,6 +1859,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
           t3.delete_index = 0,
           t3.last_activity = std::chrono::system_clock::now()));
         validate_last_applied(t, message.object_id);
+        this->update_replica_map_digests(t, message.object_id);
       }
 
       co_await this->send_snapshot_request(message.object_id, message.leader_node);
@@ -1776,6 +1906,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
 
   auto client = this->sp_->get<network::client>();
   co_return co_await (*client)->send(
+    t,
     message_info.source_node(),
     message_create<messages::sync_replica_operations_request>(
       message.object_id,
@@ -1880,6 +2011,7 @@ vds::async_task<void> vds::dht::network::sync_process::send_leader_broadcast(
           last_applied);
 
       co_await client->send(
+        t,
         member_node,
         message_create<messages::sync_leader_broadcast_request>(
           object_id,
@@ -2069,6 +2201,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_message(
         t2.commit_index = 0,
         t2.last_applied = 0,
         t2.last_activity = std::chrono::system_clock::now()));
+      this->update_replica_map_digests(t, message.object_id);
     }
     else {
       t.execute(t2.update(
@@ -2317,6 +2450,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_record(
           t1.last_applied = last_applied,
           t1.delete_index = 0,
           t1.last_activity = std::chrono::system_clock::now()));
+      this->update_replica_map_digests(t, object_id);
     }
 
     if (leader_node_id == client->current_node_id()) {
@@ -2333,6 +2467,7 @@ vds::async_task<void> vds::dht::network::sync_process::apply_record(
         t1.delete_if(
           t1.object_id == object_id
           && t1.member_node == member_node));
+      this->update_replica_map_digests(t, object_id);
     }
     else {
       t.execute(
@@ -2368,8 +2503,11 @@ vds::async_task<void> vds::dht::network::sync_process::apply_record(
           t1.node = member_node,
           t1.replica = replica,
           t1.last_access = std::chrono::system_clock::now()));
+      this->update_replica_map_digests(t, object_id);
     }
 
+    this->replica_sync_.add_replica(t, object_id, replica, member_node);
+    replica_sync::schedule_check(t, object_id);
     break;
   }
 
@@ -2380,7 +2518,10 @@ vds::async_task<void> vds::dht::network::sync_process::apply_record(
         t1.object_id == object_id
         && t1.node == member_node
         && t1.replica == replica));
+    this->update_replica_map_digests(t, object_id);
 
+    this->replica_sync_.remove_replica(t, object_id, replica, member_node);
+    replica_sync::schedule_check(t, object_id);
     break;
   }
 
@@ -2471,6 +2612,210 @@ vds::async_task<void> vds::dht::network::sync_process::send_snapshot(
   }
 }
 
+vds::async_task<void> vds::dht::network::sync_process::start_anti_entropy(database_transaction& t) {
+  const auto client = this->sp_->get<network::client>();
+
+  orm::sync_member_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.member_node)
+    .where(t1.member_node != client->current_node_id())
+    .group_by(t1.member_node));
+  std::set<const_data_buffer> partners;
+  while (st.execute()) {
+    partners.emplace(t1.member_node.get(st));
+  }
+
+  if (partners.empty()) {
+    co_return;
+  }
+
+  //Round robin over the member nodes
+  auto partner = partners.upper_bound(this->anti_entropy_partner_);
+  if (partners.end() == partner) {
+    partner = partners.begin();
+  }
+  this->anti_entropy_partner_ = *partner;
+
+  replica_map_digest::range_t root;
+  {
+    std::lock_guard<std::mutex> lock(this->anti_entropy_mutex_);
+    const auto & digest = this->load_replica_map_digest(t, *partner);
+
+    this->sp_->get<logger>()->trace(
+      SyncModule,
+      "Anti-entropy with %s, %d replica map entries",
+      base64::from_bytes(*partner).c_str(),
+      static_cast<int>(digest.size()));
+
+    root = digest.root();
+    ++this->anti_entropy_statistic_.rounds_;
+  }
+
+  co_await this->send_replica_map_ranges(*partner, { root });
+}
+
+const vds::dht::network::replica_map_digest & vds::dht::network::sync_process::load_replica_map_digest(
+  const database_read_transaction& t,
+  const const_data_buffer& partner_node) {
+
+  const auto rollback_count = t.rollback_count();
+  if (this->replica_map_digests_rollback_count_ != rollback_count) {
+    this->replica_map_digests_rollback_count_ = rollback_count;
+    this->replica_map_digests_.clear();
+  }
+
+  auto p = this->replica_map_digests_.find(partner_node);
+  if (this->replica_map_digests_.end() != p) {
+    return p->second;
+  }
+
+  orm::sync_replica_map_dbo t1;
+  orm::sync_member_dbo t2;
+  auto st = t.get_reader(
+    t1.select(t1.object_id, t1.replica, t1.node)
+    .inner_join(t2, t2.object_id == t1.object_id && t2.member_node == partner_node));
+
+  auto & result = this->replica_map_digests_[partner_node];
+  while (st.execute()) {
+    result.add(t1.object_id.get(st), t1.replica.get(st), t1.node.get(st));
+  }
+
+  return result;
+}
+
+void vds::dht::network::sync_process::update_replica_map_digests(
+  const database_read_transaction& t,
+  const const_data_buffer& object_id) {
+
+  std::lock_guard<std::mutex> lock(this->anti_entropy_mutex_);
+  if (this->replica_map_digests_rollback_count_ != t.rollback_count() || this->replica_map_digests_.empty()) {
+    return;
+  }
+
+  orm::sync_member_dbo t1;
+  auto st = t.get_reader(t1.select(t1.member_node).where(t1.object_id == object_id));
+  std::set<const_data_buffer> members;
+  while (st.execute()) {
+    members.emplace(t1.member_node.get(st));
+  }
+
+  orm::sync_replica_map_dbo t2;
+  st = t.get_reader(t2.select(t2.replica, t2.node).where(t2.object_id == object_id));
+  std::list<std::tuple<uint16_t, const_data_buffer>> replicas;
+  while (st.execute()) {
+    replicas.push_back(std::make_tuple(t2.replica.get(st), t2.node.get(st)));
+  }
+
+  for (auto & p : this->replica_map_digests_) {
+    p.second.remove(object_id);
+    if (members.end() != members.find(p.first)) {
+      for (const auto & replica : replicas) {
+        p.second.add(object_id, std::get<0>(replica), std::get<1>(replica));
+      }
+    }
+  }
+}
+
+vds::async_task<void> vds::dht::network::sync_process::send_replica_map_ranges(
+  const const_data_buffer& partner_node,
+  const std::list<replica_map_digest::range_t>& ranges) {
+
+  auto& client = *this->sp_->get<network::client>();
+
+  messages::sync_replica_map_digest message;
+  message.source_node = client->current_node_id();
+  message.ranges = ranges;
+  const auto message_data = message_serialize(message);
+
+  {
+    std::lock_guard<std::mutex> lock(this->anti_entropy_mutex_);
+    this->anti_entropy_statistic_.sent_ranges_ += ranges.size();
+    this->anti_entropy_statistic_.sent_bytes_ += message_data.size();
+  }
+
+  co_await client->send(partner_node, messages::sync_replica_map_digest::message_id, message_data);
+}
+
+vds::async_task<void> vds::dht::network::sync_process::apply_message(
+  database_transaction& t,
+  const messages::sync_replica_map_digest& message,
+  const imessage_map::message_info_t& message_info) {
+
+  auto& client = *this->sp_->get<network::client>();
+
+  std::list<replica_map_digest::range_t> children;
+  std::list<const_data_buffer> entries_messages;
+  {
+    std::lock_guard<std::mutex> lock(this->anti_entropy_mutex_);
+    this->anti_entropy_statistic_.received_bytes_ += message_info.message_data().size();
+
+    const auto & digest = this->load_replica_map_digest(t, message.source_node);
+
+    std::list<replica_map_digest::range_t> leaves;
+    digest.compare(message.ranges, children, leaves);
+
+    for (const auto & leaf : leaves) {
+      messages::sync_replica_map_entries entries;
+      entries.source_node = client->current_node_id();
+      entries.prefix = leaf.prefix;
+      entries.bits = leaf.bits;
+      entries.entries = digest.get_entries(leaf.prefix, leaf.bits);
+      entries_messages.push_back(message_serialize(entries));
+
+      this->anti_entropy_statistic_.sent_entries_ += entries.entries.size();
+      this->anti_entropy_statistic_.sent_bytes_ += entries_messages.back().size();
+    }
+  }
+
+  if (!children.empty()) {
+    co_await this->send_replica_map_ranges(message.source_node, children);
+  }
+
+  for (const auto & message_data : entries_messages) {
+    co_await client->send(message.source_node, messages::sync_replica_map_entries::message_id, message_data);
+  }
+}
+
+vds::async_task<void> vds::dht::network::sync_process::apply_message(
+  database_transaction& t,
+  const messages::sync_replica_map_entries& message,
+  const imessage_map::message_info_t& message_info) {
+
+  const auto client = this->sp_->get<network::client>();
+
+  std::set<const_data_buffer> objects;
+  {
+    std::lock_guard<std::mutex> lock(this->anti_entropy_mutex_);
+    objects = this->load_replica_map_digest(t, message.source_node).difference(message.prefix, message.bits, message.entries);
+
+    this->anti_entropy_statistic_.received_bytes_ += message_info.message_data().size();
+    this->anti_entropy_statistic_.different_objects_ += objects.size();
+  }
+
+  //The leader snapshot is the source of truth for both nodes
+  for (const auto & object_id : objects) {
+    this->sp_->get<logger>()->trace(
+      SyncModule,
+      "Replica map of %s is different with %s",
+      base64::from_bytes(object_id).c_str(),
+      base64::from_bytes(message.source_node).c_str());
+
+    const auto leader = this->get_leader(t, object_id);
+    if (client->current_node_id() == leader) {
+      co_await this->send_snapshot(t, object_id, { message.source_node });
+    }
+    else if (leader) {
+      co_await this->send_snapshot_request(object_id, leader);
+      if (leader != message.source_node) {
+        co_await this->send_snapshot_request(object_id, leader, message.source_node);
+      }
+    }
+    else {
+      co_await this->send_snapshot_request(object_id, message.source_node);
+    }
+  }
+}
+
 vds::async_task<void> vds::dht::network::sync_process::sync_local_queues(
   
   database_transaction& t) {
@@ -2493,6 +2838,7 @@ vds::async_task<void> vds::dht::network::sync_process::sync_local_queues(
   std::set<uint64_t> processed;
   while (st.execute()) {
     co_await (*client)->send(
+      t,
       t3.voted_for.get(st),
       message_create<messages::sync_add_message_request>(
         t1.object_id.get(st),
@@ -2510,70 +2856,286 @@ vds::async_task<void> vds::dht::network::sync_process::sync_local_queues(
   }
 }
 
-vds::async_task<void> vds::dht::network::sync_process::sync_replicas( database_transaction& t) {
-  if (this->sync_replicas_timeout_++ == 120) {
-    replica_sync sync;
-    sync.load(this->sp_, t);
-    co_await sync.normalize_density(this, this->sp_, t);
-  }
+vds::async_task<size_t> vds::dht::network::sync_process::sync_replicas(
+  database_transaction& t,
+  const std::chrono::steady_clock::time_point& deadline) {
+  co_return co_await this->replica_sync_.process(this, this->sp_, t, deadline);
 }
 
-void vds::dht::network::sync_process::replica_sync::load(
+void vds::dht::network::sync_process::invalidate_replica_map(
+  const database_read_transaction& t,
+  const const_data_buffer& object_id) {
+  this->replica_sync_.invalidate(t, object_id);
+  this->update_replica_map_digests(t, object_id);
+}
+
+vds::dht::network::sync_process::replica_sync::replica_sync()
+: rollback_count_(0) {
+}
+
+vds::async_task<size_t> vds::dht::network::sync_process::replica_sync::process(
+  sync_process * owner,
   const service_provider * sp,
-  const database_read_transaction& t) {
+  database_transaction& t,
+  const std::chrono::steady_clock::time_point& deadline) {
+
+  this->check_rollback(t);
+
+  auto backlog = co_await this->process_leader_objects(owner, sp, t, deadline);
+  backlog += co_await this->process_local_chunks(sp, t, deadline);
+  co_return backlog;
+}
+
+vds::async_task<size_t> vds::dht::network::sync_process::replica_sync::process_leader_objects(
+  sync_process * owner,
+  const service_provider * sp,
+  database_transaction& t,
+  const std::chrono::steady_clock::time_point& deadline) {
+
   const auto client = sp->get<network::client>();
+  const auto now = std::chrono::system_clock::now();
+
+  orm::sync_state_dbo t1;
+  db_value<int64_t> due_count;
+  auto st = t.get_reader(
+    t1
+    .select(db_count(t1.object_id).as(due_count))
+    .where(t1.state == orm::sync_state_dbo::state_t::leader && t1.next_check <= now));
+  size_t backlog = st.execute() ? due_count.get(st) : 0;
+
+  //The objects at risk go first, the objects with unknown redundancy after the known ones
+  std::list<std::tuple<const_data_buffer, int32_t /*object_size*/>> objects;
+  st = t.get_reader(
+    t1
+    .select(t1.object_id, t1.object_size)
+    .where(t1.state == orm::sync_state_dbo::state_t::leader && t1.next_check <= now)
+    .order_by(db_is_null(t1.redundancy), t1.redundancy, t1.next_check));
+  while (objects.size() < BATCH_SIZE && st.execute()) {
+    objects.emplace_back(t1.object_id.get(st), t1.object_size.get(st));
+  }
+
+  this->repair_queue_.start_tick(std::chrono::steady_clock::now());
+
+  std::map<const_data_buffer, std::tuple<object_info_t, std::map<uint16_t, std::set<const_data_buffer>>>> repairs;
+  for (const auto & p : objects) {
+    if (deadline < std::chrono::steady_clock::now()) {
+      break;
+    }
+
+    const auto & object_id = std::get<0>(p);
+    auto object = this->load_object(sp, t, object_id);
+    if (object.sync_leader_ == client->current_node_id()) {
+      std::map<uint16_t, std::set<const_data_buffer>> replica_nodes;
+      for (const auto& node : object.nodes_) {
+        for (const auto replica : node.second.replicas_) {
+          replica_nodes[replica].emplace(node.first);
+        }
+      }
+
+      const auto margin = repair_queue::redundancy_margin(replica_nodes.size());
+      t.execute(
+        t1.update(t1.redundancy = margin)
+        .where(t1.object_id == object_id));
+
+      //Some replicas has been lost
+      if (replica_nodes.size() < service::GENERATE_DISTRIBUTED_PIECES) {
+        sp->get<logger>()->trace(
+          SyncModule,
+          "object %s have %d replicas",
+          base64::from_bytes(object_id).c_str(),
+          replica_nodes.size());
+
+        const uint64_t replica_size = (std::get<1>(p) + service::MIN_DISTRIBUTED_PIECES - 1) / service::MIN_DISTRIBUTED_PIECES;
+        this->repair_queue_.push(
+          object_id,
+          margin,
+          (service::GENERATE_DISTRIBUTED_PIECES - replica_nodes.size()) * replica_size);
+        repairs.emplace(object_id, std::make_tuple(std::move(object), std::move(replica_nodes)));
+        continue;
+      }
+
+      //All replicas exists
+      co_await object.normalize_density(sp, t, replica_nodes, object_id);
+      co_await object.remove_duplicates(owner, sp, t, replica_nodes, object_id);
+    }
+
+    t.execute(
+      t1.update(t1.next_check = now + CHECK_INTERVAL())
+      .where(t1.object_id == object_id));
+    --backlog;
+  }
+
+  //Objects which are not repaired in this tick stay due
+  repair_queue::entry_t entry;
+  while (std::chrono::steady_clock::now() <= deadline && this->repair_queue_.pop(entry)) {
+    const auto & repair = repairs.at(entry.object_id);
+    std::get<0>(repair).restore_replicas(sp, t, std::get<1>(repair), entry.object_id);
+
+    t.execute(
+      t1.update(t1.next_check = now + CHECK_INTERVAL())
+      .where(t1.object_id == entry.object_id));
+    --backlog;
+  }
+
+  //The objects with unknown redundancy are not counted, NULL is never less than the margin
+  db_value<int64_t> degraded_count;
+  st = t.get_reader(
+    t1
+    .select(db_count(t1.object_id).as(degraded_count))
+    .where(t1.state == orm::sync_state_dbo::state_t::leader && t1.redundancy < repair_queue::full_redundancy_margin()));
+  this->repair_queue_.finish_tick(st.execute() ? degraded_count.get(st) : 0, now);
+
+  co_return backlog;
+}
+
+vds::async_task<size_t> vds::dht::network::sync_process::replica_sync::process_local_chunks(
+  const service_provider * sp,
+  database_transaction& t,
+  const std::chrono::steady_clock::time_point& deadline) {
+
+  const auto now = std::chrono::system_clock::now();
 
   orm::chunk_dbo t1;
+  db_value<int64_t> due_count;
   auto st = t.get_reader(
+    t1
+    .select(db_count(t1.object_id).as(due_count))
+    .where(t1.last_sync <= now - CHECK_INTERVAL()));
+  size_t backlog = st.execute() ? due_count.get(st) : 0;
+
+  std::list<const_data_buffer> objects;
+  st = t.get_reader(
     t1
     .select(t1.object_id)
-    .where(t1.last_sync <= std::chrono::system_clock::now() - std::chrono::minutes(10))
+    .where(t1.last_sync <= now - CHECK_INTERVAL())
     .order_by(t1.last_sync));
-  while (st.execute()) {
-    this->register_local_chunk(t1.object_id.get(st), client->current_node_id());
+  while (objects.size() < BATCH_SIZE && st.execute()) {
+    objects.push_back(t1.object_id.get(st));
   }
 
-  orm::sync_replica_map_dbo t2;
-  st = t.get_reader(t2.select(t2.object_id, t2.replica, t2.node));
-  while (st.execute()) {
-    this->register_replica(t2.object_id.get(st), t2.replica.get(st), t2.node.get(st));
+  orm::sync_state_dbo t2;
+  for (const auto & object_id : objects) {
+    if (deadline < std::chrono::steady_clock::now()) {
+      break;
+    }
+
+    //Send chunks if this node is not in memebers
+    st = t.get_reader(t2.select(t2.state).where(t2.object_id == object_id));
+    if (!st.execute()) {
+      sp->get<logger>()->trace(
+        SyncModule,
+        "This node has replicas %s without leader",
+        base64::from_bytes(object_id).c_str());
+
+      this->load_object(sp, t, object_id).try_to_attach(sp, object_id);
+    }
+
+    t.execute(
+      t1.update(t1.last_sync = now)
+      .where(t1.object_id == object_id));
+    --backlog;
+  }
+
+  co_return backlog;
+}
+
+vds::dht::network::sync_process::replica_sync::object_info_t
+vds::dht::network::sync_process::replica_sync::load_object(
+  const service_provider * sp,
+  const database_read_transaction& t,
+  const const_data_buffer& object_id) {
+
+  const auto client = sp->get<network::client>();
+
+  object_info_t result;
+  result.sync_generation_ = 0;
+  result.sync_current_term_ = 0;
+  result.sync_commit_index_ = 0;
+  result.sync_last_applied_ = 0;
+
+  const auto & cached = this->load_replicas(sp, t, object_id);
+  if (cached.is_local_chunk) {
+    auto& p = result.nodes_[client->current_node_id()];
+    for (uint16_t replica = 0; replica < service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
+      p.replicas_.emplace(replica);
+    }
+  }
+
+  for (const auto & node : cached.replicas) {
+    result.nodes_[node.first].replicas_.insert(node.second.begin(), node.second.end());
   }
 
   orm::sync_state_dbo t3;
   orm::sync_member_dbo t4;
-  st = t.get_reader(t3.select(
-                        t3.object_id,
+  auto st = t.get_reader(t3.select(
                         t3.state,
                         t4.voted_for,
                         t4.generation,
                         t4.current_term,
                         t4.commit_index,
                         t4.last_applied)
-                      .inner_join(t4, t4.object_id == t3.object_id && t4.member_node == client->current_node_id()));
+                      .inner_join(t4, t4.object_id == t3.object_id && t4.member_node == client->current_node_id())
+                      .where(t3.object_id == object_id));
+  if (st.execute()) {
+    result.sync_leader_ = (t3.state.get(st) == orm::sync_state_dbo::state_t::leader)
+      ? client->current_node_id()
+      : t4.voted_for.get(st);
+    result.sync_generation_ = t4.generation.get(st);
+    result.sync_current_term_ = t4.current_term.get(st);
+    result.sync_commit_index_ = t4.commit_index.get(st);
+    result.sync_last_applied_ = t4.last_applied.get(st);
+  }
+
+  st = t.get_reader(t4.select(t4.member_node).where(t4.object_id == object_id));
   while (st.execute()) {
-    if (t3.state.get(st) == orm::sync_state_dbo::state_t::leader) {
-      this->register_sync_leader(
-        t3.object_id.get(st),
-        client->current_node_id(),
-        t4.generation.get(st),
-        t4.current_term.get(st),
-        t4.commit_index.get(st),
-        t4.last_applied.get(st));
-    }
-    else {
-      this->register_sync_leader(
-        t3.object_id.get(st),
-        t4.voted_for.get(st),
-        t4.generation.get(st),
-        t4.current_term.get(st),
-        t4.commit_index.get(st),
-        t4.last_applied.get(st));
-    }
+    result.nodes_[t4.member_node.get(st)]; //just create record
   }
 
-  st = t.get_reader(t4.select(t4.object_id, t4.member_node));
+  return result;
+}
+
+vds::dht::network::sync_process::replica_sync::cached_object_t &
+vds::dht::network::sync_process::replica_sync::load_replicas(
+  const service_provider * sp,
+  const database_read_transaction& t,
+  const const_data_buffer& object_id) {
+
+  this->check_rollback(t);
+
+  auto p = this->cache_.find(object_id);
+  if (this->cache_.end() != p) {
+    this->cache_order_.splice(this->cache_order_.end(), this->cache_order_, p->second.order);
+    return p->second;
+  }
+
+  cached_object_t object;
+
+  orm::chunk_dbo t1;
+  auto st = t.get_reader(t1.select(t1.object_id).where(t1.object_id == object_id));
+  object.is_local_chunk = st.execute();
+
+  orm::sync_replica_map_dbo t2;
+  st = t.get_reader(t2.select(t2.replica, t2.node).where(t2.object_id == object_id));
   while (st.execute()) {
-    this->register_sync_member(t4.object_id.get(st), t4.member_node.get(st));
+    object.replicas[t2.node.get(st)].emplace(t2.replica.get(st));
+  }
+
+  while (!this->cache_order_.empty() && this->cache_.size() >= MAX_CACHED_OBJECTS) {
+    this->cache_.erase(this->cache_order_.front());
+    this->cache_order_.pop_front();
+  }
+
+  this->cache_order_.push_back(object_id);
+  object.order = std::prev(this->cache_order_.end());
+  return this->cache_.emplace(object_id, std::move(object)).first->second;
+}
+
+void vds::dht::network::sync_process::replica_sync::check_rollback(const database_read_transaction& t) {
+  const auto rollback_count = t.rollback_count();
+  if (this->rollback_count_ != rollback_count) {
+    this->rollback_count_ = rollback_count;
+    this->cache_.clear();
+    this->cache_order_.clear();
   }
 }
 
@@ -2890,6 +3452,7 @@ vds::async_task<void> vds::dht::network::sync_process::replica_sync::object_info
             }
             else {
               co_await (*client)->send(
+                t,
                 node,
                 message_create<messages::sync_offer_remove_replica_operation_request>(
                   object_id,
@@ -2924,87 +3487,81 @@ void vds::dht::network::sync_process::replica_sync::object_info_t::try_to_attach
   }
 }
 
-void vds::dht::network::sync_process::replica_sync::register_local_chunk(
-  const const_data_buffer& object_id, const const_data_buffer& current_node_id) {
-  auto& p = this->objects_[object_id].nodes_[current_node_id];
-  for (uint16_t replica = 0; replica < service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
-    p.replicas_.emplace(replica);
-  }
-}
+void vds::dht::network::sync_process::replica_sync::add_replica(
+  const database_read_transaction& t,
+  const const_data_buffer& object_id,
+  uint16_t replica,
+  const const_data_buffer& node_id) {
 
-void vds::dht::network::sync_process::replica_sync::register_replica(const const_data_buffer& object_id,
-                                                                     uint16_t replica,
-                                                                     const const_data_buffer& node_id) {
-  auto& p = this->objects_[object_id].nodes_[node_id];
-  if (p.replicas_.end() == p.replicas_.find(replica)) {
-    p.replicas_.emplace(replica);
+  this->check_rollback(t);
+
+  auto p = this->cache_.find(object_id);
+  if (this->cache_.end() != p) {
+    p->second.replicas[node_id].emplace(replica);
   }
 }
 
-void vds::dht::network::sync_process::replica_sync::register_sync_leader(
+void vds::dht::network::sync_process::replica_sync::remove_replica(
+  const database_read_transaction& t,
   const const_data_buffer& object_id,
-  const const_data_buffer& leader_node_id,
-  uint64_t generation,
-  uint64_t current_term,
-  uint64_t commit_index,
-  uint64_t last_applied) {
-  auto& p = this->objects_[object_id];
-  vds_assert(!p.sync_leader_);
-  p.sync_leader_ = leader_node_id;
-  p.sync_generation_ = generation;
-  p.sync_current_term_ = current_term;
-  p.sync_commit_index_ = commit_index;
-  p.sync_last_applied_ = last_applied;
-}
+  uint16_t replica,
+  const const_data_buffer& node_id) {
 
-void vds::dht::network::sync_process::replica_sync::register_sync_member(
-  const const_data_buffer& object_id,
-  const const_data_buffer& member_node) {
-  auto& p = this->objects_[object_id];
-  if (p.nodes_.end() == p.nodes_.find(member_node)) {
-    p.nodes_[member_node]; //just create record
+  this->check_rollback(t);
+
+  auto p = this->cache_.find(object_id);
+  if (this->cache_.end() == p) {
+    return;
+  }
+
+  auto node = p->second.replicas.find(node_id);
+  if (p->second.replicas.end() != node) {
+    node->second.erase(replica);
+    if (node->second.empty()) {
+      p->second.replicas.erase(node);
+    }
   }
 }
 
-vds::async_task<void> vds::dht::network::sync_process::replica_sync::normalize_density(
-  vds::dht::network::sync_process * owner,
-  const service_provider * sp,
-  database_transaction& t) {
-  const auto client = sp->get<network::client>();
-  for (const auto& object : this->objects_) {
-    //Send chunks if this node is not in memebers
-    if (!object.second.sync_leader_) {
-      sp->get<logger>()->trace(
-        SyncModule,
-        "This node has replicas %s without leader",
-        base64::from_bytes(object.first).c_str());
+void vds::dht::network::sync_process::replica_sync::invalidate(
+  const database_read_transaction& t,
+  const const_data_buffer& object_id) {
 
-      object.second.try_to_attach(sp, object.first);
-    }
-    else if (object.second.sync_leader_ == client->current_node_id()) {
-      std::map<uint16_t, std::set<const_data_buffer>> replica_nodes;
-      for (const auto& node : object.second.nodes_) {
-        for (const auto replica : node.second.replicas_) {
-          replica_nodes[replica].emplace(node.first);
-        }
-      }
+  this->check_rollback(t);
 
-      //Some replicas has been lost
-      if (replica_nodes.size() < service::GENERATE_DISTRIBUTED_PIECES) {
-        sp->get<logger>()->trace(
-          SyncModule,
-          "object %s have %d replicas",
-          base64::from_bytes(object.first).c_str(),
-          replica_nodes.size());
-        object.second.restore_replicas(sp, t, replica_nodes, object.first);
-      }
-      else {
-        //All replicas exists
-        co_await object.second.normalize_density(sp, t, replica_nodes, object.first);
-        co_await object.second.remove_duplicates(owner, sp, t, replica_nodes, object.first);
-      }
-    }
+  auto p = this->cache_.find(object_id);
+  if (this->cache_.end() != p) {
+    this->cache_order_.erase(p->second.order);
+    this->cache_.erase(p);
+  }
+}
+
+void vds::dht::network::sync_process::replica_sync::schedule_check(
+  database_transaction& t,
+  const const_data_buffer& object_id) {
+
+  //The check corrects the value if the leader has the chunk
+  size_t replica_count = 0;
+  orm::sync_replica_map_dbo t2;
+  auto st = t.get_reader(t2.select(t2.replica).where(t2.object_id == object_id).group_by(t2.replica));
+  while (st.execute()) {
+    ++replica_count;
   }
+
+  orm::sync_state_dbo t1;
+  t.execute(
+    t1.update(
+      t1.next_check = std::chrono::system_clock::now(),
+      t1.redundancy = repair_queue::redundancy_margin(replica_count))
+    .where(t1.object_id == object_id));
+}
+
+void vds::dht::network::sync_process::replica_sync::repair_limits(uint64_t bytes_per_second, size_t max_parallel) {
+  this->repair_queue_.limits(bytes_per_second, max_parallel);
+}
+
+void vds::dht::network::sync_process::replica_sync::get_repair_statistic(repair_statistic & result) const {
+  this->repair_queue_.get_statistic(result);
 }
 
 vds::async_task<void> vds::dht::network::sync_process::make_leader(
@@ -3064,16 +3621,28 @@ vds::async_task<void> vds::dht::network::sync_process::send_replica(
   orm::device_record_dbo t2;
   auto st = t.get_reader(t1.select(
                              t1.replica_hash,
-                             t2.local_path)
+                             t2.local_path,
+                             t2.data_offset,
+                             t2.data_size)
                            .inner_join(t2, t2.node_id == client->current_node_id() && t2.data_hash == t1.replica_hash)
                            .where(t1.object_id == object_id && t1.replica == replica));
   if (!st.execute()) {
     co_return;
   }
 
-  const auto data = _client::read_data(
+  //The transfer is refused when the memory is exhausted, the replica will be requested again
+  const auto lease = sp->get<memory_budget>()->try_acquire(safe_cast<size_t>(t2.data_size.get(st)));
+  if (!lease) {
+    sp->get<logger>()->trace(SyncModule, "Send replica %s:%d refused by the memory budget",
+      base64::from_bytes(object_id).c_str(), replica);
+    co_return;
+  }
+
+  auto data = co_await (*client)->read_data_async(
     t1.replica_hash.get(st),
-    filename(t2.local_path.get(st)));
+    filename(t2.local_path.get(st)),
+    t2.data_offset.get(st),
+    t2.data_size.get(st));
 
   co_return co_await (*client)->send(
     target_node,
@@ -3084,6 +3653,6 @@ vds::async_task<void> vds::dht::network::sync_process::send_replica(
       commit_index,
       last_applied,
       replica,
-      data,
+      std::move(data),
       leader_node_id));
 }
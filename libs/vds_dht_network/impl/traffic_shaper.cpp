@@ -0,0 +1,288 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "private/traffic_shaper.h"
+
+vds::dht::network::traffic_shaper::bucket_t::bucket_t()
+: bytes_per_second(0),
+  burst_bytes(0),
+  tokens(0),
+  updated(std::chrono::steady_clock::now()) {
+}
+
+void vds::dht::network::traffic_shaper::bucket_t::limits(uint64_t bytes_per_second, uint64_t burst_bytes) {
+  this->bytes_per_second = bytes_per_second;
+  //One second of the traffic by default
+  this->burst_bytes = (0 == burst_bytes) ? bytes_per_second : burst_bytes;
+  this->tokens = std::min<int64_t>(this->tokens, this->burst_bytes);
+  if (0 == this->tokens) {
+    this->tokens = this->burst_bytes;
+  }
+}
+
+void vds::dht::network::traffic_shaper::bucket_t::refill(const std::chrono::steady_clock::time_point & now) {
+  if (0 == this->bytes_per_second || now <= this->updated) {
+    return;
+  }
+
+  const auto elapsed_us = static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::microseconds>(now - this->updated).count());
+  if (elapsed_us >= 1000000 * this->burst_bytes / this->bytes_per_second + 1000000) {
+    this->tokens = this->burst_bytes;
+    this->updated = now;
+    return;
+  }
+
+  const auto added = elapsed_us * this->bytes_per_second / 1000000;
+  //The fraction of the token is kept for the next refill
+  if (0 < added) {
+    this->tokens = std::min<int64_t>(this->burst_bytes, this->tokens + static_cast<int64_t>(added));
+    this->updated = now;
+  }
+}
+
+bool vds::dht::network::traffic_shaper::bucket_t::is_available() const {
+  return 0 == this->bytes_per_second || 0 < this->tokens;
+}
+
+void vds::dht::network::traffic_shaper::bucket_t::consume(size_t size) {
+  if (0 != this->bytes_per_second) {
+    this->tokens -= static_cast<int64_t>(size);
+  }
+}
+
+vds::dht::network::traffic_shaper::class_t::class_t()
+: queued_bytes(0),
+  sent(0),
+  sent_bytes(0),
+  throttled(0),
+  total_wait_ms(0),
+  dropped(0) {
+}
+
+vds::dht::network::traffic_shaper::peer_t::peer_t()
+: queued(0),
+  sent_bytes(0),
+  throttled(0) {
+}
+
+vds::dht::network::traffic_shaper::traffic_shaper()
+: peer_bytes_per_second_(0),
+  peer_burst_bytes_(0),
+  last_cleanup_(std::chrono::steady_clock::now()) {
+}
+
+vds::dht::network::traffic_class_t vds::dht::network::traffic_shaper::message_class(message_type_t message_id) {
+  switch (message_id) {
+  case message_type_t::transaction_log_record:
+  case message_type_t::sync_snapshot_response:
+  case message_type_t::sync_replica_data:
+  case message_type_t::sync_message_batch:
+  case message_type_t::sync_replica_map_digest:
+  case message_type_t::sync_replica_map_entries:
+    return traffic_class_t::background;
+
+  default:
+    return traffic_class_t::control;
+  }
+}
+
+const char * vds::dht::network::traffic_shaper::class_name(traffic_class_t traffic_class) {
+  switch (traffic_class) {
+  case traffic_class_t::control:
+    return "control";
+  case traffic_class_t::user:
+    return "user";
+  case traffic_class_t::background:
+    return "background";
+  case traffic_class_t::probe:
+    return "probe";
+  default:
+    return "unknown";
+  }
+}
+
+void vds::dht::network::traffic_shaper::class_limits(
+  traffic_class_t traffic_class,
+  uint64_t bytes_per_second,
+  uint64_t burst_bytes) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->classes_[static_cast<size_t>(traffic_class)].bucket.limits(bytes_per_second, burst_bytes);
+}
+
+void vds::dht::network::traffic_shaper::peer_limits(uint64_t bytes_per_second, uint64_t burst_bytes) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->peer_bytes_per_second_ = bytes_per_second;
+  this->peer_burst_bytes_ = burst_bytes;
+  for (auto & p : this->peers_) {
+    p.second.bucket.limits(bytes_per_second, burst_bytes);
+  }
+}
+
+vds::dht::network::traffic_shaper::peer_t & vds::dht::network::traffic_shaper::peer_locked(
+  const network_address & address,
+  const std::chrono::steady_clock::time_point & now) {
+
+  auto p = this->peers_.find(address);
+  if (this->peers_.end() == p) {
+    p = this->peers_.emplace(address, peer_t()).first;
+    p->second.bucket.limits(this->peer_bytes_per_second_, this->peer_burst_bytes_);
+  }
+
+  p->second.last_used = now;
+  p->second.bucket.refill(now);
+  return p->second;
+}
+
+bool vds::dht::network::traffic_shaper::submit(
+  const network_address & address,
+  traffic_class_t traffic_class,
+  size_t size,
+  const send_handler_t & handler,
+  std::list<send_handler_t> & ready,
+  const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  auto & current_class = this->classes_[static_cast<size_t>(traffic_class)];
+  auto & peer = this->peer_locked(address, now);
+
+  //Strict priority: the control datagram goes at once, the others pay for its bandwidth
+  if (traffic_class_t::control == traffic_class) {
+    current_class.bucket.refill(now);
+    this->send_locked(current_class, peer, size, handler, ready);
+    return true;
+  }
+
+  if (MAX_QUEUE_BYTES < current_class.queued_bytes + size) {
+    ++current_class.dropped;
+    return false;
+  }
+
+  current_class.queue.push_back(item_t { address, size, handler, now });
+  current_class.queued_bytes += size;
+  ++peer.queued;
+
+  this->pump_locked(ready, now);
+  return true;
+}
+
+void vds::dht::network::traffic_shaper::pump(
+  std::list<send_handler_t> & ready,
+  const std::chrono::steady_clock::time_point & now) {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->pump_locked(ready, now);
+}
+
+void vds::dht::network::traffic_shaper::pump_locked(
+  std::list<send_handler_t> & ready,
+  const std::chrono::steady_clock::time_point & now) {
+
+  //The peer without the bandwidth is not used by the lower classes too
+  std::set<network_address> blocked_peers;
+  for (size_t index = static_cast<size_t>(traffic_class_t::user); index < CLASS_COUNT; ++index) {
+    auto & current_class = this->classes_[index];
+    current_class.bucket.refill(now);
+
+    for (auto p = current_class.queue.begin(); current_class.queue.end() != p;) {
+      if (!current_class.bucket.is_available()) {
+        break;
+      }
+
+      if (blocked_peers.end() != blocked_peers.find(p->address)) {
+        ++p;
+        continue;
+      }
+
+      auto & peer = this->peer_locked(p->address, now);
+      if (!peer.bucket.is_available()) {
+        blocked_peers.emplace(p->address);
+        ++p;
+        continue;
+      }
+
+      if (p->enqueued < now) {
+        ++current_class.throttled;
+        ++peer.throttled;
+        current_class.total_wait_ms += std::chrono::duration_cast<std::chrono::milliseconds>(now - p->enqueued).count();
+      }
+
+      --peer.queued;
+      current_class.queued_bytes -= p->size;
+      this->send_locked(current_class, peer, p->size, p->handler, ready);
+      p = current_class.queue.erase(p);
+    }
+  }
+
+  if (this->last_cleanup_ + PEER_IDLE_TIME() < now) {
+    this->last_cleanup_ = now;
+    for (auto p = this->peers_.begin(); this->peers_.end() != p;) {
+      if (0 == p->second.queued && p->second.last_used + PEER_IDLE_TIME() < now) {
+        p = this->peers_.erase(p);
+      }
+      else {
+        ++p;
+      }
+    }
+  }
+}
+
+void vds::dht::network::traffic_shaper::send_locked(
+  class_t & traffic_class,
+  peer_t & peer,
+  size_t size,
+  const send_handler_t & handler,
+  std::list<send_handler_t> & ready) {
+
+  traffic_class.bucket.consume(size);
+  peer.bucket.consume(size);
+
+  ++traffic_class.sent;
+  traffic_class.sent_bytes += size;
+  peer.sent_bytes += size;
+
+  ready.push_back(handler);
+}
+
+size_t vds::dht::network::traffic_shaper::queue_size() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  size_t result = 0;
+  for (const auto & traffic_class : this->classes_) {
+    result += traffic_class.queue.size();
+  }
+
+  return result;
+}
+
+void vds::dht::network::traffic_shaper::get_statistic(session_statistic & result) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  for (size_t index = 0; index < CLASS_COUNT; ++index) {
+    const auto & traffic_class = this->classes_[index];
+    result.traffic_classes_.push_back(session_statistic::traffic_class_info {
+      class_name(static_cast<traffic_class_t>(index)),
+      traffic_class.bucket.bytes_per_second,
+      traffic_class.queue.size(),
+      traffic_class.sent,
+      traffic_class.sent_bytes,
+      traffic_class.throttled,
+      traffic_class.total_wait_ms,
+      traffic_class.dropped
+    });
+  }
+}
+
+void vds::dht::network::traffic_shaper::get_peer_statistic(
+  const network_address & address,
+  session_statistic::session_info & result) const {
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  const auto p = this->peers_.find(address);
+  if (this->peers_.end() != p) {
+    result.queued_ = p->second.queued;
+    result.sent_bytes_ = p->second.sent_bytes;
+    result.throttled_ = p->second.throttled;
+  }
+}
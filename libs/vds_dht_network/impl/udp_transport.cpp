@@ -12,7 +12,8 @@ All rights reserved
 #include "dht_network_client.h"
 #include "dht_network_client_p.h"
 
-vds::dht::network::udp_transport::udp_transport(){
+vds::dht::network::udp_transport::udp_transport()
+: shaper_timer_("Traffic Shaper") {
 }
 
 vds::dht::network::udp_transport::~udp_transport() {
@@ -41,25 +42,61 @@ void vds::dht::network::udp_transport::start(
   }
 
       this->continue_read().detach();
+
+  this->shaper_timer_.start(sp, SHAPER_PERIOD(), [this]() -> async_task<bool> {
+    std::list<traffic_shaper::send_handler_t> ready;
+    this->shaper_.pump(ready);
+    for (const auto & handler : ready) {
+      handler();
+    }
+
+    co_return !this->sp_->get_shutdown_event().is_shuting_down();
+  });
 }
 
 void vds::dht::network::udp_transport::stop() {
+  this->shaper_timer_.stop();
   this->server_.stop();
 }
 
 vds::async_task<void>
-vds::dht::network::udp_transport::write_async( const udp_datagram& datagram) {
+vds::dht::network::udp_transport::write_async(
+  const udp_datagram& datagram,
+  traffic_class_t traffic_class) {
   auto result = std::make_shared<vds::async_result<void>>();
-  this->send_thread_->schedule([result, this, datagram]() {
-    try{
-      this->writer_->write_async(datagram).get();
-    }
-    catch (...){
-      result->set_exception(std::current_exception());
-      return;
-    }
+
+  //The datagram goes to the send apartment when the shaper has the bandwidth for it,
+  //the task is completed when the datagram is sent
+  std::list<traffic_shaper::send_handler_t> ready;
+  const auto is_queued = this->shaper_.submit(
+    datagram.address(),
+    traffic_class,
+    datagram.data_size(),
+    [result, this, datagram]() {
+      this->send_thread_->schedule([result, this, datagram]() {
+        try{
+          this->writer_->write_async(datagram).get();
+        }
+        catch (...){
+          result->set_exception(std::current_exception());
+          return;
+        }
+        result->set_value();
+      });
+    },
+    ready);
+
+  if (!is_queued) {
+    this->sp_->get<logger>()->debug(
+      ThisModule,
+      "The send queue is full, drop the datagram to %s",
+      datagram.address().to_string().c_str());
     result->set_value();
-  });
+  }
+
+  for (const auto & handler : ready) {
+    handler();
+  }
 
   return result->get_future();
 
@@ -122,7 +159,8 @@ vds::async_task<void> vds::dht::network::udp_transport::try_handshake(
   co_await this->write_async(udp_datagram(
     address,
     out_message.move_data(),
-    false));
+    false),
+    traffic_class_t::control);
 }
 
 vds::async_task<void> vds::dht::network::udp_transport::on_timer() {
@@ -141,14 +179,30 @@ vds::async_task<void> vds::dht::network::udp_transport::on_timer() {
   }
 }
 
+void vds::dht::network::udp_transport::traffic_limits(
+  traffic_class_t traffic_class,
+  uint64_t bytes_per_second,
+  uint64_t burst_bytes) {
+  this->shaper_.class_limits(traffic_class, bytes_per_second, burst_bytes);
+}
+
+void vds::dht::network::udp_transport::peer_traffic_limits(
+  uint64_t bytes_per_second,
+  uint64_t burst_bytes) {
+  this->shaper_.peer_limits(bytes_per_second, burst_bytes);
+}
+
 void vds::dht::network::udp_transport::get_session_statistics(session_statistic& session_statistic) {
-  session_statistic.output_size_ = this->send_thread_->size();
+  session_statistic.output_size_ = this->send_thread_->size() + this->shaper_.queue_size();
+  this->shaper_.get_statistic(session_statistic);
 
   std::shared_lock<std::shared_mutex> lock(this->sessions_mutex_);
   for (const auto& p : this->sessions_) {
     const auto & session = p.second;
     if (session.session_) {
-      session_statistic.items_.push_back(session.session_->get_statistic());
+      auto item = session.session_->get_statistic();
+      this->shaper_.get_peer_statistic(p.first, item);
+      session_statistic.items_.push_back(item);
     }
   }
 }
@@ -191,7 +245,8 @@ vds::async_task<void> vds::dht::network::udp_transport::continue_read(
           uint8_t out_message[] = { (uint8_t)protocol_message_type_t::Failed };
           try {
             co_await this->write_async(udp_datagram(datagram.address(),
-              const_data_buffer(out_message, sizeof(out_message))));
+              const_data_buffer(out_message, sizeof(out_message))),
+              traffic_class_t::control);
           }
           catch (...) {
           }
@@ -256,7 +311,7 @@ vds::async_task<void> vds::dht::network::udp_transport::continue_read(
         session_info.session_mutex_.unlock();
 
         out_message += bs.move_data();
-        co_await this->write_async(udp_datagram(datagram.address(), out_message.move_data(), false));
+        co_await this->write_async(udp_datagram(datagram.address(), out_message.move_data(), false), traffic_class_t::control);
         co_await this->sp_->get<imessage_map>()->on_new_session(partner_node_id);
       }
       else {
@@ -347,7 +402,8 @@ vds::async_task<void> vds::dht::network::udp_transport::continue_read(
 
             uint8_t out_message[] = { (uint8_t)protocol_message_type_t::Failed };
             co_await this->write_async(udp_datagram(datagram.address(),
-              const_data_buffer(out_message, sizeof(out_message))));
+              const_data_buffer(out_message, sizeof(out_message))),
+              traffic_class_t::control);
           }
         }
         catch (...) {
@@ -371,7 +427,8 @@ vds::async_task<void> vds::dht::network::udp_transport::continue_read(
         uint8_t out_message[] = { (uint8_t)protocol_message_type_t::Failed };
         try {
           co_await this->write_async(udp_datagram(datagram.address(),
-            const_data_buffer(out_message, sizeof(out_message))));
+            const_data_buffer(out_message, sizeof(out_message))),
+            traffic_class_t::control);
         }
         catch (...) {
         }
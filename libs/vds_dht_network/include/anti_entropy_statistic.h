@@ -0,0 +1,36 @@
+#ifndef __VDS_DHT_NETWORK_ANTI_ENTROPY_STATISTIC_H_
+#define __VDS_DHT_NETWORK_ANTI_ENTROPY_STATISTIC_H_
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+namespace vds {
+  struct anti_entropy_statistic {
+    //Reconciliations of the replica map started by this node
+    uint64_t rounds_;
+
+    uint64_t sent_ranges_;
+    uint64_t sent_entries_;
+    uint64_t sent_bytes_;
+    uint64_t received_bytes_;
+
+    //Objects which replica map was different, the snapshot has been requested for them
+    uint64_t different_objects_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      result->add_property("rounds", this->rounds_);
+      result->add_property("sent_ranges", this->sent_ranges_);
+      result->add_property("sent_entries", this->sent_entries_);
+      result->add_property("sent_bytes", this->sent_bytes_);
+      result->add_property("received_bytes", this->received_bytes_);
+      result->add_property("different_objects", this->different_objects_);
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_ANTI_ENTROPY_STATISTIC_H_
@@ -8,6 +8,7 @@ All rights reserved
 #include "service_provider.h"
 #include "const_data_buffer.h"
 #include "dht_network_client.h"
+#include "memory_budget.h"
 #include "asymmetriccrypto.h"
 
 namespace vds {
@@ -37,6 +38,7 @@ namespace vds {
 
       private:
         client client_;
+        memory_budget memory_budget_;
       };
     }
   }
@@ -8,8 +8,15 @@ All rights reserved
 
 #include "service_provider.h"
 #include "const_data_buffer.h"
+#include "stream.h"
 #include "route_statistic.h"
 #include "session_statistic.h"
+#include "scrub_statistic.h"
+#include "maintenance_statistic.h"
+#include "repair_statistic.h"
+#include "sync_message_statistic.h"
+#include "anti_entropy_statistic.h"
+#include "replica_source_statistic.h"
 
 namespace vds {
   class database_transaction;
@@ -28,6 +35,7 @@ namespace vds {
       public:
         void start(
           const service_provider * sp,
+          database_transaction & t,
           const std::shared_ptr<certificate> & node_cert,
           const std::shared_ptr<asymmetric_private_key> & node_key,
           const std::shared_ptr<iudp_transport> & udp_transport);
@@ -52,6 +60,11 @@ namespace vds {
         async_task<const_data_buffer> restore(          
           const chunk_info& block_id);
 
+        //The block is decoded to the target as the horcruxes are restored, the end of stream is not written
+        async_task<void> restore(
+          const chunk_info& block_id,
+          const std::shared_ptr<stream_output_async<uint8_t>>& target);
+
         async_task<block_info_t> prepare_restore(
           database_read_transaction & t,
           const chunk_info& block_id);
@@ -60,6 +73,12 @@ namespace vds {
 
         void get_route_statistics(route_statistic& result);
         void get_session_statistics(session_statistic& session_statistic);
+        void get_scrub_statistics(scrub_statistic& result);
+        void get_maintenance_statistics(maintenance_statistic& result);
+        void get_repair_statistics(repair_statistic& result);
+        void get_sync_message_statistics(sync_message_statistic& result);
+        void get_anti_entropy_statistics(anti_entropy_statistic& result);
+        void get_replica_source_statistics(replica_source_statistic& result);
 
         _client* operator ->() const {
           return this->impl_.get();
@@ -14,6 +14,14 @@ namespace vds {
 
   namespace dht {
     namespace network {
+      //In the order of priority
+      enum class traffic_class_t : uint8_t {
+        control,
+        user,
+        background,
+        probe
+      };
+
       class iudp_transport : public std::enable_shared_from_this<iudp_transport> {
       public:
         virtual void start(
@@ -24,10 +32,16 @@ namespace vds {
 
         virtual void stop() = 0;
 
-        virtual async_task<void> write_async( const udp_datagram& datagram) = 0;
+        virtual async_task<void> write_async(
+          const udp_datagram& datagram,
+          traffic_class_t traffic_class) = 0;
         virtual async_task<void> try_handshake( const std::string& address) = 0;
         virtual async_task<void> on_timer() = 0;
 
+        //Zero bytes_per_second removes the limit
+        virtual void traffic_limits(traffic_class_t traffic_class, uint64_t bytes_per_second, uint64_t burst_bytes) = 0;
+        virtual void peer_traffic_limits(uint64_t bytes_per_second, uint64_t burst_bytes) = 0;
+
       };
     }
   }
@@ -0,0 +1,59 @@
+#ifndef __VDS_DHT_NETWORK_MAINTENANCE_STATISTIC_H_
+#define __VDS_DHT_NETWORK_MAINTENANCE_STATISTIC_H_
+#include <map>
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+namespace vds {
+  struct maintenance_statistic {
+    struct job_info_t {
+      uint64_t period_ms_;
+      uint64_t budget_ms_;
+
+      uint64_t runs_;
+      //Runs which have been skipped because the previous run of the job was not finished
+      uint64_t skipped_;
+      //Runs which took longer than the budget
+      uint64_t overruns_;
+      uint64_t errors_;
+
+      uint64_t last_duration_ms_;
+      uint64_t max_duration_ms_;
+
+      //Work left by the last run
+      uint64_t backlog_;
+      bool is_running_;
+
+      std::shared_ptr<json_value> serialize() const {
+        auto result = std::make_shared<json_object>();
+        result->add_property("period_ms", this->period_ms_);
+        result->add_property("budget_ms", this->budget_ms_);
+        result->add_property("runs", this->runs_);
+        result->add_property("skipped", this->skipped_);
+        result->add_property("overruns", this->overruns_);
+        result->add_property("errors", this->errors_);
+        result->add_property("last_duration_ms", this->last_duration_ms_);
+        result->add_property("max_duration_ms", this->max_duration_ms_);
+        result->add_property("backlog", this->backlog_);
+        result->add_property("is_running", std::string(this->is_running_ ? "true" : "false"));
+        return result;
+      }
+    };
+
+    std::map<std::string, job_info_t> jobs_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      for (const auto & job : this->jobs_) {
+        result->add_property(job.first, job.second.serialize());
+      }
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_MAINTENANCE_STATISTIC_H_
@@ -0,0 +1,84 @@
+#ifndef __VDS_DHT_NETWORK_MEMORY_BUDGET_H_
+#define __VDS_DHT_NETWORK_MEMORY_BUDGET_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include "async_task.h"
+#include "memory_budget_statistic.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Node-wide limit of the memory held by the replicas and blocks in transfer.
+       * acquire waits in the order of arrival when the budget is exhausted.
+       * Database transactions are serialized, so the code inside them uses try_acquire and never waits:
+       * the memory may be held by a restore which waits for the next transaction.
+       */
+      class memory_budget {
+      public:
+        static constexpr size_t DEFAULT_LIMIT = 256 * 1024 * 1024;
+
+        //The memory is returned to the budget when the lease is destroyed
+        class lease {
+        public:
+          lease(memory_budget * owner, size_t size);
+          ~lease();
+
+          lease(const lease &) = delete;
+          lease & operator = (const lease &) = delete;
+
+          size_t size() const {
+            return this->size_;
+          }
+
+        private:
+          memory_budget * owner_;
+          size_t size_;
+        };
+
+        memory_budget(size_t limit = DEFAULT_LIMIT);
+
+        //The request larger than the limit waits for the whole budget
+        async_task<std::shared_ptr<lease>> acquire(size_t size);
+
+        //nullptr if the memory is not available now or other requests are waiting
+        std::shared_ptr<lease> try_acquire(size_t size);
+
+        void get_statistic(memory_budget_statistic & result) const;
+
+      private:
+        struct waiter_t {
+          size_t size;
+          std::chrono::steady_clock::time_point enqueued;
+          std::shared_ptr<async_result<std::shared_ptr<lease>>> result;
+        };
+
+        mutable std::mutex mutex_;
+        size_t limit_;
+        size_t used_;
+        size_t peak_;
+        std::list<waiter_t> waiters_;
+
+        uint64_t granted_;
+        uint64_t queued_;
+        uint64_t rejected_;
+        uint64_t total_wait_ms_;
+        uint64_t max_wait_ms_;
+
+        bool try_acquire_locked(size_t size);
+        void release(size_t size);
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_MEMORY_BUDGET_H_
@@ -0,0 +1,44 @@
+#ifndef __VDS_DHT_NETWORK_MEMORY_BUDGET_STATISTIC_H_
+#define __VDS_DHT_NETWORK_MEMORY_BUDGET_STATISTIC_H_
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+namespace vds {
+  struct memory_budget_statistic {
+    uint64_t limit_;
+    uint64_t used_;
+    uint64_t peak_;
+
+    //Requests waiting for the memory now
+    uint64_t waiting_;
+
+    uint64_t granted_;
+    //Granted after the wait
+    uint64_t queued_;
+    //try_acquire refused because the budget was exhausted
+    uint64_t rejected_;
+
+    uint64_t total_wait_ms_;
+    uint64_t max_wait_ms_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      result->add_property("limit", this->limit_);
+      result->add_property("used", this->used_);
+      result->add_property("peak", this->peak_);
+      result->add_property("waiting", this->waiting_);
+      result->add_property("granted", this->granted_);
+      result->add_property("queued", this->queued_);
+      result->add_property("rejected", this->rejected_);
+      result->add_property("average_wait_ms", (0 == this->queued_) ? 0 : this->total_wait_ms_ / this->queued_);
+      result->add_property("max_wait_ms", this->max_wait_ms_);
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_MEMORY_BUDGET_STATISTIC_H_
@@ -68,7 +68,14 @@ namespace vds {
         sync_replica_request,
         sync_replica_data,
 
-        sync_replica_query_operations_request
+        sync_replica_query_operations_request,
+
+        sync_message_batch,
+
+        sync_replica_map_digest,
+        sync_replica_map_entries,
+
+        sync_replica_piece_request
 
       };
     }
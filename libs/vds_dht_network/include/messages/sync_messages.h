@@ -29,6 +29,25 @@ namespace vds {
         }
       };
 
+      /**
+       * \brief Request of the replicas which the target node holds, it is served by any member
+       */
+      class sync_replica_piece_request {
+      public:
+        static const network::message_type_t message_id = network::message_type_t::sync_replica_piece_request;
+
+        const_data_buffer object_id;
+        std::set<uint16_t> replicas;
+
+        template <typename visitor_type>
+        auto visit(visitor_type & v) {
+          return v(
+            this->object_id,
+            this->replicas
+          );
+        }
+      };
+
       /**
        * \brief Base class to message from leader
        */
@@ -340,6 +359,83 @@ namespace vds {
         }
       };
       ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /**
+       * \brief Sync messages of many objects to the same node
+       */
+      class sync_message_batch {
+      public:
+        static const network::message_type_t message_id = network::message_type_t::sync_message_batch;
+
+        struct item_t {
+          uint8_t message_type;
+          const_data_buffer message_data;
+        };
+
+        std::list<item_t> messages;
+
+        template <typename visitor_type>
+        auto visit(visitor_type & v) {
+          return v(
+            this->messages
+            );
+        }
+      };
+      ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+      /**
+       * \brief Hashes of the key ranges of the replica map of the objects shared by two nodes
+       */
+      class sync_replica_map_digest {
+      public:
+        static const network::message_type_t message_id = network::message_type_t::sync_replica_map_digest;
+
+        //The objects which first bits of object_id are equal to prefix
+        struct range_t {
+          uint32_t prefix;
+          uint8_t bits;
+          const_data_buffer hash;
+        };
+
+        const_data_buffer source_node;
+        std::list<range_t> ranges;
+
+        template <typename visitor_type>
+        auto visit(visitor_type & v) {
+          return v(
+            this->source_node,
+            this->ranges
+            );
+        }
+      };
+
+      /**
+       * \brief Replica map entries of the key range which hash is different
+       */
+      class sync_replica_map_entries {
+      public:
+        static const network::message_type_t message_id = network::message_type_t::sync_replica_map_entries;
+
+        struct entry_t {
+          const_data_buffer object_id;
+          uint16_t replica;
+          const_data_buffer node;
+        };
+
+        const_data_buffer source_node;
+        uint32_t prefix;
+        uint8_t bits;
+        std::list<entry_t> entries;
+
+        template <typename visitor_type>
+        auto visit(visitor_type & v) {
+          return v(
+            this->source_node,
+            this->prefix,
+            this->bits,
+            this->entries
+            );
+        }
+      };
+      ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     }
   }
 
@@ -370,6 +466,42 @@ namespace vds {
     return s >> f.voted_for >> f.cert >> f.sign;
   }
 
+  inline binary_serializer& operator <<(
+    binary_serializer& s,
+    const dht::messages::sync_message_batch::item_t & f) {
+    return s << f.message_type << f.message_data;
+  }
+
+  inline binary_deserializer& operator >>(
+    binary_deserializer& s,
+    dht::messages::sync_message_batch::item_t & f) {
+    return s >> f.message_type >> f.message_data;
+  }
+
+  inline binary_serializer& operator <<(
+    binary_serializer& s,
+    const dht::messages::sync_replica_map_digest::range_t & f) {
+    return s << f.prefix << f.bits << f.hash;
+  }
+
+  inline binary_deserializer& operator >>(
+    binary_deserializer& s,
+    dht::messages::sync_replica_map_digest::range_t & f) {
+    return s >> f.prefix >> f.bits >> f.hash;
+  }
+
+  inline binary_serializer& operator <<(
+    binary_serializer& s,
+    const dht::messages::sync_replica_map_entries::entry_t & f) {
+    return s << f.object_id << f.replica << f.node;
+  }
+
+  inline binary_deserializer& operator >>(
+    binary_deserializer& s,
+    dht::messages::sync_replica_map_entries::entry_t & f) {
+    return s >> f.object_id >> f.replica >> f.node;
+  }
+
 }
 
 #endif//__VDS_DHT_NETWORK_SYNC_MESSAGES_H__
@@ -31,14 +31,21 @@ namespace vds {
       public:
         static const network::message_type_t message_id = network::message_type_t::transaction_log_request;
 
+        //Old peers do not send the formats and receive the canonical record
+        struct record_formats_t {
+          bool compact = false;
+        };
+
         const_data_buffer transaction_id;
         const_data_buffer source_node;
+        record_formats_t record_formats;
 
         template <typename visitor_type>
         auto visit(visitor_type & v) {
           return v(
             this->transaction_id,
-            this->source_node
+            this->source_node,
+            this->record_formats
           );
         }
       };
@@ -58,9 +65,25 @@ namespace vds {
           );
         }
       };
+
+      inline binary_serializer & operator << (
+        binary_serializer & s,
+        const transaction_log_request::record_formats_t & data) {
+        s << data.compact;
+        return s;
+      }
+
+      inline binary_deserializer & operator >> (
+        binary_deserializer & s,
+        transaction_log_request::record_formats_t & data) {
+        data.compact = false;
+        if (0 < s.size()) {
+          s >> data.compact;
+        }
+        return s;
+      }
     }
   }
 }
 
-
 #endif//__VDS_DHT_NETWORK_TRANSACTION_LOG_MESSAGES_H__
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef __VDS_DHT_NETWORK_REPAIR_STATISTIC_H_
+#define __VDS_DHT_NETWORK_REPAIR_STATISTIC_H_
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+namespace vds {
+  struct repair_statistic {
+    //Objects of this node as the leader which have lost some replicas
+    uint64_t degraded_objects_;
+    //Objects of the last tick which can not lose a replica without becoming unrecoverable
+    uint64_t at_risk_objects_;
+    //Objects left for the next tick because the budget was exceeded
+    uint64_t queued_objects_;
+
+    uint64_t repaired_objects_;
+    uint64_t repaired_bytes_;
+
+    //Time since the first object became degraded, zero if all objects have full redundancy
+    uint64_t degraded_time_ms_;
+    uint64_t last_time_to_full_redundancy_ms_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      result->add_property("degraded_objects", this->degraded_objects_);
+      result->add_property("at_risk_objects", this->at_risk_objects_);
+      result->add_property("queued_objects", this->queued_objects_);
+      result->add_property("repaired_objects", this->repaired_objects_);
+      result->add_property("repaired_bytes", this->repaired_bytes_);
+      result->add_property("degraded_time_ms", this->degraded_time_ms_);
+      result->add_property("last_time_to_full_redundancy_ms", this->last_time_to_full_redundancy_ms_);
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_REPAIR_STATISTIC_H_
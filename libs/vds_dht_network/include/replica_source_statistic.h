@@ -0,0 +1,61 @@
+#ifndef __VDS_DHT_NETWORK_REPLICA_SOURCE_STATISTIC_H_
+#define __VDS_DHT_NETWORK_REPLICA_SOURCE_STATISTIC_H_
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include "encoding.h"
+
+namespace vds {
+  struct replica_source_statistic {
+
+    struct peer_info {
+      const_data_buffer node_id_;
+      uint64_t rtt_ms_;
+      uint64_t bytes_per_second_;
+      uint64_t requests_;
+      uint64_t responses_;
+      uint64_t timeouts_;
+
+      void serialize(std::shared_ptr<json_array>& items) const {
+        auto result = std::make_shared<json_object>();
+        result->add_property("node", base64::from_bytes(this->node_id_));
+        result->add_property("rtt_ms", this->rtt_ms_);
+        result->add_property("bytes_per_second", this->bytes_per_second_);
+        result->add_property("requests", this->requests_);
+        result->add_property("responses", this->responses_);
+        result->add_property("timeouts", this->timeouts_);
+        items->add(result);
+      }
+    };
+
+    uint64_t pending_restores_;
+    uint64_t completed_restores_;
+    uint64_t hedged_requests_;
+    //Time from the first request to the k-th replica of the last restored object
+    uint64_t last_restore_ms_;
+    std::list<peer_info> peers_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      result->add_property("pending_restores", this->pending_restores_);
+      result->add_property("completed_restores", this->completed_restores_);
+      result->add_property("hedged_requests", this->hedged_requests_);
+      result->add_property("last_restore_ms", this->last_restore_ms_);
+
+      auto items = std::make_shared<json_array>();
+      for (const auto& p : this->peers_) {
+        p.serialize(items);
+      }
+      result->add_property("peers", items);
+
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_REPLICA_SOURCE_STATISTIC_H_
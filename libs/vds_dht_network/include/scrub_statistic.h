@@ -0,0 +1,38 @@
+#ifndef __VDS_DHT_NETWORK_SCRUB_STATISTIC_H_
+#define __VDS_DHT_NETWORK_SCRUB_STATISTIC_H_
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+namespace vds {
+  struct scrub_statistic {
+    //Replicas checked in the current pass and the total count of local replicas
+    uint64_t pass_verified_;
+    uint64_t pass_total_;
+    uint64_t passes_;
+
+    uint64_t verified_count_;
+    uint64_t verified_bytes_;
+    uint64_t corrupted_count_;
+
+    //Throughput of the last batch
+    uint64_t bytes_per_second_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      result->add_property("pass_verified", this->pass_verified_);
+      result->add_property("pass_total", this->pass_total_);
+      result->add_property("passes", this->passes_);
+      result->add_property("verified_count", this->verified_count_);
+      result->add_property("verified_bytes", this->verified_bytes_);
+      result->add_property("corrupted_count", this->corrupted_count_);
+      result->add_property("bytes_per_second", this->bytes_per_second_);
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_SCRUB_STATISTIC_H_
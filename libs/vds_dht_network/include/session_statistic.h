@@ -18,6 +18,11 @@ namespace vds {
       bool blocked_;
       bool not_started_;
 
+      //Datagrams waiting for the bandwidth of the peer
+      uint64_t queued_;
+      uint64_t sent_bytes_;
+      uint64_t throttled_;
+
       void serialize(std::shared_ptr<json_array>& items) const {
         auto result = std::make_shared<json_object>();
         result->add_property("address", this->address_);
@@ -27,12 +32,43 @@ namespace vds {
         if(this->not_started_) {
           result->add_property("not_started", "true");
         }
+        result->add_property("queued", this->queued_);
+        result->add_property("sent_bytes", this->sent_bytes_);
+        result->add_property("throttled", this->throttled_);
+        items->add(result);
+      }
+    };
+
+    struct traffic_class_info {
+      std::string name_;
+      //Zero if not limited
+      uint64_t bytes_per_second_;
+      uint64_t queued_;
+      uint64_t sent_;
+      uint64_t sent_bytes_;
+      //Datagrams which waited for the bandwidth
+      uint64_t throttled_;
+      uint64_t total_wait_ms_;
+      //Datagrams over the queue limit
+      uint64_t dropped_;
+
+      void serialize(std::shared_ptr<json_array>& items) const {
+        auto result = std::make_shared<json_object>();
+        result->add_property("name", this->name_);
+        result->add_property("bytes_per_second", this->bytes_per_second_);
+        result->add_property("queued", this->queued_);
+        result->add_property("sent", this->sent_);
+        result->add_property("sent_bytes", this->sent_bytes_);
+        result->add_property("throttled", this->throttled_);
+        result->add_property("average_wait_ms", (0 == this->throttled_) ? 0 : this->total_wait_ms_ / this->throttled_);
+        result->add_property("dropped", this->dropped_);
         items->add(result);
       }
     };
 
     size_t output_size_;
     std::list<session_info> items_;
+    std::list<traffic_class_info> traffic_classes_;
 
     std::shared_ptr<json_value> serialize() const {
       auto result = std::make_shared<json_object>();
@@ -46,6 +82,13 @@ namespace vds {
 
       result->add_property("items", items);
 
+      auto traffic_classes = std::make_shared<json_array>();
+      for (const auto& p : this->traffic_classes_) {
+        p.serialize(traffic_classes);
+      }
+
+      result->add_property("traffic_classes", traffic_classes);
+
       return result;
     }
   };
@@ -0,0 +1,39 @@
+#ifndef __VDS_DHT_NETWORK_SYNC_MESSAGE_STATISTIC_H_
+#define __VDS_DHT_NETWORK_SYNC_MESSAGE_STATISTIC_H_
+#include "json_object.h"
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+namespace vds {
+  struct sync_message_statistic {
+    //Sync messages of the last maintenance tick, the objects they belong to
+    //and the datagrams which have been sent after batching
+    uint64_t tick_messages_;
+    uint64_t tick_objects_;
+    uint64_t tick_datagrams_;
+    uint64_t tick_bytes_;
+
+    uint64_t total_messages_;
+    uint64_t total_datagrams_;
+    uint64_t total_bytes_;
+
+    std::shared_ptr<json_value> serialize() const {
+      auto result = std::make_shared<json_object>();
+      result->add_property("tick_messages", this->tick_messages_);
+      result->add_property("tick_objects", this->tick_objects_);
+      result->add_property("tick_datagrams", this->tick_datagrams_);
+      result->add_property("tick_bytes", this->tick_bytes_);
+      result->add_property("messages_per_object", std::to_string(
+        (0 == this->tick_objects_) ? 0.0 : static_cast<double>(this->tick_messages_) / this->tick_objects_));
+      result->add_property("total_messages", this->total_messages_);
+      result->add_property("total_datagrams", this->total_datagrams_);
+      result->add_property("total_bytes", this->total_bytes_);
+      return result;
+    }
+  };
+}
+
+#endif //__VDS_DHT_NETWORK_SYNC_MESSAGE_STATISTIC_H_
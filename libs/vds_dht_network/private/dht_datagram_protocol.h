@@ -18,6 +18,7 @@ All rights reserved
 #include "debug_mutex.h"
 #include "vds_exceptions.h"
 #include "hash.h"
+#include "traffic_shaper.h"
 
 
 namespace vds {
@@ -54,6 +55,20 @@ namespace vds {
           uint8_t message_type,
           const const_data_buffer& target_node,
           const const_data_buffer& message) {
+          return this->send_message(
+            s,
+            message_type,
+            target_node,
+            message,
+            traffic_shaper::message_class(static_cast<message_type_t>(message_type)));
+        }
+
+        vds::async_task<void> send_message(
+          const std::shared_ptr<transport_type>& s,
+          uint8_t message_type,
+          const const_data_buffer& target_node,
+          const const_data_buffer& message,
+          traffic_class_t traffic_class) {
           vds_assert(message.size() <= 0xFFFF);
           vds_assert(target_node != this->this_node_id_);
 
@@ -70,7 +85,8 @@ namespace vds {
             target_node,
             this->this_node_id_,
             0,
-            message);
+            message,
+            traffic_class);
         }
 
         vds::async_task<void> proxy_message(
@@ -98,7 +114,8 @@ namespace vds {
             target_node,
             source_node,
             hops,
-            message);
+            message,
+            traffic_shaper::message_class(static_cast<message_type_t>(message_type)));
         }
 
         vds::async_task<void> process_datagram(
@@ -109,7 +126,8 @@ namespace vds {
           if(protocol_message_type_t::MTUTest == static_cast<protocol_message_type_t>(*datagram.data())) {
             const_data_buffer data = datagram;
             data[0] = (uint8_t)protocol_message_type_t::MTUTestPassed;
-            co_await s->write_async(udp_datagram(this->address_, data, false));
+            //The receive loop waits for the reply, so it is not queued behind the throttled traffic
+            co_await s->write_async(udp_datagram(this->address_, data, false), traffic_class_t::control);
             co_return;
           }
           if (protocol_message_type_t::MTUTestPassed == static_cast<protocol_message_type_t>(*datagram.data())) {
@@ -261,7 +279,7 @@ namespace vds {
               out_message.add((uint8_t)protocol_message_type_t::MTUTest);
 
               try {
-                co_await s->write_async(udp_datagram(this->address_, out_message.move_data(), false));
+                co_await s->write_async(udp_datagram(this->address_, out_message.move_data(), false), traffic_class_t::probe);
               }
               catch (...) {
               }
@@ -307,7 +325,8 @@ namespace vds {
           const const_data_buffer& target_node,
           const const_data_buffer& source_node,
           const uint8_t hops,
-          const const_data_buffer& message) {
+          const const_data_buffer& message,
+          traffic_class_t traffic_class) {
 
           for (;;) {
             resizable_data_buffer buffer;
@@ -337,7 +356,7 @@ namespace vds {
 
               const_data_buffer datagram = buffer.move_data();
               try {
-                co_await s->write_async( udp_datagram(this->address_, datagram, false));
+                co_await s->write_async(udp_datagram(this->address_, datagram, false), traffic_class);
               }
               catch (const udp_datagram_size_exception & ex) {
                 this->mtu_ /= 2;
@@ -345,14 +364,20 @@ namespace vds {
               }
             }
             else {
+              //Hash the serialized header and the message body without copying the body
               binary_serializer bs;
               bs
                 << message_type
                 << target_node
                 << source_node
-                << hops
-                << message;
-              const auto message_id = hash::signature(hash::sha256(), bs.move_data());
+                << hops;
+              bs.write_number(message.size());
+
+              hash h(hash::sha256());
+              h.update(bs.get_buffer(), bs.size());
+              h.update(message.data(), message.size());
+              h.final();
+              const auto message_id = h.signature();
               vds_assert(message_id.size() == 32);
 
               uint16_t offset;
@@ -398,7 +423,7 @@ namespace vds {
                 buffer.size());
               const_data_buffer datagram = buffer.move_data();
               try {
-                co_await s->write_async(udp_datagram(this->address_, datagram, false));
+                co_await s->write_async(udp_datagram(this->address_, datagram, false), traffic_class);
               }
               catch (const udp_datagram_size_exception &) {
                 this->mtu_ /= 2;
@@ -426,7 +451,7 @@ namespace vds {
 
                 const_data_buffer datagram = buffer.move_data();
                 try {
-                  co_await s->write_async(udp_datagram(this->address_, datagram, false));
+                  co_await s->write_async(udp_datagram(this->address_, datagram, false), traffic_class);
                 }
                 catch (const udp_datagram_size_exception &) {
                   this->mtu_ /= 2;
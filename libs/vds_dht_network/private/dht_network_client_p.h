@@ -13,6 +13,12 @@ All rights reserved
 #include "sync_process.h"
 #include "udp_transport.h"
 #include "imessage_map.h"
+#include "storage_allocator.h"
+#include "segment_store.h"
+#include "replica_scrubber.h"
+#include "maintenance_scheduler.h"
+#include "sync_outbox.h"
+#include "replica_source_selector.h"
 
 class mock_server;
 
@@ -32,6 +38,10 @@ namespace vds {
       class transaction_log_request;
       class dht_find_node_response;
       class dht_find_node;
+      class sync_message_batch;
+      class sync_replica_map_digest;
+      class sync_replica_map_entries;
+      class sync_replica_piece_request;
     }
   }
 
@@ -41,13 +51,26 @@ namespace vds {
     namespace network {
       class _client : public std::enable_shared_from_this<_client> {
       public:
+        enum class storage_layout_t {
+          file_per_replica,
+          segments
+        };
+
+        enum class verify_mode_t {
+          always,
+          cached,
+          never
+        };
+
+        static constexpr size_t MAX_VERIFIED_REPLICAS = 100000;
+
         _client(
           const service_provider * sp,
           const std::shared_ptr<iudp_transport> & udp_transport,
           const std::shared_ptr<certificate> & node_cert,
           const std::shared_ptr<asymmetric_private_key> & node_key);
 
-        void start();
+        void start(database_transaction & t);
         void stop();
         void get_neighbors(
           
@@ -58,12 +81,35 @@ namespace vds {
           database_read_transaction& t,
           const const_data_buffer& partner_id);
 
-        static filename save_data(
+        static void save_data(
           const service_provider * sp,
           database_transaction& t,
           const const_data_buffer& data_hash,
           const const_data_buffer& data);
 
+        //Writes through ifile_service if it is registered, has to be completed before the transaction is committed
+        async_task<void> save_data_async(
+          database_transaction& t,
+          const const_data_buffer& data_hash,
+          const_data_buffer data);
+
+        /**
+         * \brief Read replica data. The hash is checked according to verify_mode
+         * and the result of the check is cached while the replica file is unchanged.
+         */
+        const_data_buffer read_data(
+          const const_data_buffer& data_hash,
+          const filename& data_path,
+          int64_t data_offset,
+          int64_t data_size);
+
+        //Uses ifile_service if it is registered so the calling thread is not blocked by the disk
+        async_task<const_data_buffer> read_data_async(
+          const const_data_buffer& data_hash,
+          const filename& data_path,
+          int64_t data_offset,
+          int64_t data_size);
+
         async_task<std::vector<vds::const_data_buffer>> save(
           
           database_transaction& t,
@@ -196,6 +242,26 @@ namespace vds {
           const messages::sync_replica_query_operations_request & message,
           const imessage_map::message_info_t& message_info);
 
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_replica_map_digest & message,
+          const imessage_map::message_info_t& message_info);
+
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_replica_map_entries & message,
+          const imessage_map::message_info_t& message_info);
+
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_replica_piece_request & message,
+          const imessage_map::message_info_t& message_info);
+
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_message_batch& message,
+          const imessage_map::message_info_t& message_info);
+
         //
         template <typename message_type>
         async_task<void> send(
@@ -210,6 +276,36 @@ namespace vds {
           message_type_t message_id,
           const const_data_buffer& message);
 
+        //Sync messages of the transaction are grouped by the target node and sent after the commit
+        template <typename message_type>
+        async_task<void> send(
+          database_transaction & t,
+          const const_data_buffer& node_id,
+          const message_type& message) {
+          co_await this->send(t, node_id, message_type::message_id, message_serialize(message));
+        }
+
+        async_task<void> send(
+          database_transaction & t,
+          const const_data_buffer& node_id,
+          message_type_t message_id,
+          const const_data_buffer& message);
+
+        //The message is sent at once in the traffic class given instead of the one of its type
+        template <typename message_type>
+        async_task<void> send(
+          const const_data_buffer& node_id,
+          const message_type& message,
+          traffic_class_t traffic_class) {
+          co_await this->send(node_id, message_type::message_id, message_serialize(message), traffic_class);
+        }
+
+        async_task<void> send(
+          const const_data_buffer& node_id,
+          message_type_t message_id,
+          const const_data_buffer& message,
+          traffic_class_t traffic_class);
+
         async_task<void> find_nodes(
             
             const const_data_buffer& node_id,
@@ -245,22 +341,34 @@ namespace vds {
 
         void add_session( const std::shared_ptr<dht_session>& session, uint8_t hops);
 
+        //Writes the decoded block to the target without the end of stream
         vds::async_task<void> restore(          
           const std::vector<const_data_buffer>& object_ids,
-          const std::shared_ptr<const_data_buffer>& result,
+          const std::shared_ptr<stream_output_async<uint8_t>>& target,
           const std::chrono::steady_clock::time_point& start);
 
         vds::async_task<client::block_info_t> prepare_restore(
           database_read_transaction & t,
           const std::vector<const_data_buffer>& object_ids);
 
+        //Adds the local horcruxes to the decoder, requests the missing ones
         vds::async_task<uint8_t> restore_async(
           
           const std::vector<const_data_buffer>& object_ids,
-          const std::shared_ptr<const_data_buffer>& result);
+          const std::shared_ptr<chunk_decoder<uint16_t>>& decoder);
 
         void get_route_statistics(route_statistic& result);
         void get_session_statistics(session_statistic& session_statistic);
+        void get_scrub_statistics(scrub_statistic& result);
+        void get_maintenance_statistics(maintenance_statistic& result);
+        void get_repair_statistics(repair_statistic& result);
+        void get_sync_message_statistics(sync_message_statistic& result);
+        void get_anti_entropy_statistics(anti_entropy_statistic& result);
+        void get_replica_source_statistics(replica_source_statistic& result);
+
+        replica_source_selector & replica_sources() {
+          return this->replica_sources_;
+        }
 
         void add_route(
           
@@ -283,6 +391,49 @@ namespace vds {
           this->update_wellknown_connection_enabled_ = value;
         }
 
+        void placement_policy(storage_allocator::placement_policy_t value) {
+          this->storage_allocator_.placement_policy(value);
+        }
+
+        void storage_layout(storage_layout_t value) {
+          this->storage_layout_ = value;
+        }
+
+        void verify_mode(verify_mode_t value) {
+          this->verify_mode_ = value;
+        }
+
+        void scrub_limits(uint64_t bytes_per_second, size_t max_parallel) {
+          this->replica_scrubber_.limits(bytes_per_second, max_parallel);
+        }
+
+        void repair_limits(uint64_t bytes_per_second, size_t max_parallel) {
+          this->sync_process_.repair_limits(bytes_per_second, max_parallel);
+        }
+
+        void traffic_limits(traffic_class_t traffic_class, uint64_t bytes_per_second, uint64_t burst_bytes) {
+          this->udp_transport_->traffic_limits(traffic_class, bytes_per_second, burst_bytes);
+        }
+
+        void peer_traffic_limits(uint64_t bytes_per_second, uint64_t burst_bytes) {
+          this->udp_transport_->peer_traffic_limits(bytes_per_second, burst_bytes);
+        }
+
+        replica_scrubber & scrubber() {
+          return this->replica_scrubber_;
+        }
+
+        maintenance_scheduler & maintenance() {
+          return this->maintenance_scheduler_;
+        }
+
+        //Remove the corrupted local replica so sync_process restores it from other nodes
+        async_task<void> repair_replica(
+          database_transaction& t,
+          const const_data_buffer& replica_hash) {
+          return this->sync_process_.repair_replica(t, replica_hash);
+        }
+
       private:
         friend class sync_process;
         friend class dht_session;
@@ -293,16 +444,51 @@ namespace vds {
         dht_route<std::shared_ptr<dht_session>> route_;
         std::map<uint16_t, std::unique_ptr<chunk_generator<uint16_t>>> generators_;
         sync_process sync_process_;
+        storage_allocator storage_allocator_;
+        segment_store segment_store_;
+        storage_layout_t storage_layout_;
+        replica_scrubber replica_scrubber_;
+        sync_outbox sync_outbox_;
+        replica_source_selector replica_sources_;
+
+        verify_mode_t verify_mode_;
+        std::mutex verified_replicas_mutex_;
+        std::map<std::string /*local_path[:offset]*/, time_t /*last write time*/> verified_replicas_;
+
+        void verify_data(
+          const const_data_buffer& data_hash,
+          const std::string & key,
+          time_t last_write_time,
+          int64_t data_size,
+          const const_data_buffer& data);
+        bool is_verified(const std::string & key, time_t last_write_time);
+        void set_verified(const std::string & key, time_t last_write_time);
 
-        timer update_timer_;
+        maintenance_scheduler maintenance_scheduler_;
         uint32_t update_route_table_counter_;
         bool update_wellknown_connection_enabled_;
         vds::async_task<void> update_route_table();
-        vds::async_task<void> process_update(
-          
-          database_transaction& t);
 
 
+        vds::async_task<void> send_message(
+          const const_data_buffer& node_id,
+          message_type_t message_id,
+          const const_data_buffer& message,
+          traffic_class_t traffic_class);
+
+        vds::async_task<void> flush_sync_batch(
+          std::map<const_data_buffer, std::list<sync_outbox::message_t>> messages);
+
+        vds::async_task<void> send_sync_batch(
+          const const_data_buffer& node_id,
+          const messages::sync_message_batch& batch);
+
+        vds::async_task<void> apply_sync_item(
+          database_transaction& t,
+          const imessage_map::message_info_t& message_info);
+
+        void finish_sync_tick();
+
         vds::async_task<void> send_near(
           
           const const_data_buffer& node_id,
@@ -335,17 +521,24 @@ namespace vds {
           const std::string& key,
           uint16_t replica);
 
-        vds::async_task<void> update_wellknown_connection(
-          
-          database_transaction& t);
-
-        static const_data_buffer read_data(
-          const const_data_buffer& data_hash,
-          const filename& data_path);
+        vds::async_task<void> update_wellknown_connection();
 
         static void delete_data(
-          const const_data_buffer& replica_hash,
-          const filename& filename);
+          const service_provider * sp,
+          database_transaction& t,
+          const const_data_buffer& replica_hash);
+
+        struct write_target_t {
+          std::shared_ptr<file> f;
+          size_t position;
+        };
+
+        //Allocate the storage and register the replica, the data is written by the caller
+        static write_target_t prepare_save(
+          const service_provider * sp,
+          database_transaction& t,
+          const const_data_buffer& data_hash,
+          size_t data_size);
       };
     }
   }
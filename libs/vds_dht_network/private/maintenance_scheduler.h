@@ -0,0 +1,93 @@
+#ifndef __VDS_DHT_NETWORK_MAINTENANCE_SCHEDULER_H_
+#define __VDS_DHT_NETWORK_MAINTENANCE_SCHEDULER_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include "async_task.h"
+#include "task_manager.h"
+#include "maintenance_statistic.h"
+
+namespace vds {
+  class database_transaction;
+
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Periodic maintenance jobs of the node.
+       * Every job has its own timer, period and time budget, so a slow job does not delay the others.
+       * A job is never executed in parallel with itself.
+       * A job returns the count of work items left for the next run, this value is reported as backlog.
+       */
+      class maintenance_scheduler {
+      public:
+        typedef std::function<async_task<size_t>(
+          const std::chrono::steady_clock::time_point & deadline)> handler_t;
+
+        typedef std::function<async_task<size_t>(
+          database_transaction & t,
+          const std::chrono::steady_clock::time_point & deadline)> transaction_handler_t;
+
+        maintenance_scheduler(const service_provider * sp);
+
+        //The job is executed without database transaction
+        void add_job(
+          const std::string & name,
+          const std::chrono::steady_clock::duration & period,
+          const std::chrono::steady_clock::duration & jitter,
+          const std::chrono::steady_clock::duration & budget,
+          const handler_t & handler);
+
+        //The job is executed in its own database transaction
+        void add_transaction_job(
+          const std::string & name,
+          const std::chrono::steady_clock::duration & period,
+          const std::chrono::steady_clock::duration & jitter,
+          const std::chrono::steady_clock::duration & budget,
+          const transaction_handler_t & handler);
+
+        void start();
+        void stop();
+
+        /**
+         * \brief Execute the job out of schedule
+         * \return false if the job is running already
+         */
+        async_task<bool> run(const std::string & name);
+
+        void get_statistic(maintenance_statistic & result) const;
+
+      private:
+        struct job_t {
+          std::string name_;
+          std::chrono::steady_clock::duration period_;
+          std::chrono::steady_clock::duration jitter_;
+          std::chrono::steady_clock::duration budget_;
+          handler_t handler_;
+          timer timer_;
+
+          maintenance_statistic::job_info_t statistic_;
+
+          job_t(const std::string & name)
+          : name_(name), timer_(name_.c_str()), statistic_{} {
+          }
+        };
+
+        const service_provider * sp_;
+
+        mutable std::mutex jobs_mutex_;
+        std::map<std::string, std::unique_ptr<job_t>> jobs_;
+
+        async_task<bool> execute(job_t * job);
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_MAINTENANCE_SCHEDULER_H_
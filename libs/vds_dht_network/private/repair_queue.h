@@ -0,0 +1,84 @@
+#ifndef __VDS_DHT_NETWORK_REPAIR_QUEUE_H_
+#define __VDS_DHT_NETWORK_REPAIR_QUEUE_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <map>
+#include <mutex>
+#include "const_data_buffer.h"
+#include "repair_statistic.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Objects with lost replicas ordered by the redundancy margin.
+       * The objects closest to be unrecoverable are taken first.
+       * Repair is limited by the bandwidth (token bucket) and by the count of objects repaired per tick.
+       */
+      class repair_queue {
+      public:
+        static constexpr uint64_t DEFAULT_BYTES_PER_SECOND = 8 * 1024 * 1024;
+        static constexpr size_t DEFAULT_MAX_PARALLEL = 64;
+
+        //Unused bandwidth is accumulated for this period at most
+        static std::chrono::seconds MAX_BURST() {
+          return std::chrono::seconds(60);
+        }
+
+        struct entry_t {
+          const_data_buffer object_id;
+          int margin;
+          uint64_t repair_bytes;
+        };
+
+        repair_queue();
+
+        //Count of distinct replicas above the count which is required to restore the object
+        static int redundancy_margin(size_t replica_count);
+        static int full_redundancy_margin();
+
+        //The budget starts with the full burst of the new bandwidth
+        void limits(uint64_t bytes_per_second, size_t max_parallel);
+
+        //Refill the budget by the time since the previous tick
+        void start_tick(const std::chrono::steady_clock::time_point & now);
+
+        void push(const const_data_buffer & object_id, int margin, uint64_t repair_bytes);
+
+        /**
+         * \brief Take the object with the lowest margin.
+         * The object is taken while there is any bandwidth left, so the large objects are not stalled.
+         * \return false if the queue is empty or the budget of the tick is exhausted
+         */
+        bool pop(entry_t & result);
+
+        //Objects left in the queue stay due and are queued again at the next tick
+        void finish_tick(size_t degraded_objects, const std::chrono::system_clock::time_point & now);
+
+        void get_statistic(repair_statistic & result) const;
+
+      private:
+        std::multimap<int /*margin*/, entry_t> queue_;
+
+        mutable std::mutex mutex_;
+        uint64_t bytes_per_second_;
+        size_t max_parallel_;
+
+        int64_t available_bytes_;
+        size_t started_;
+        std::chrono::steady_clock::time_point last_tick_;
+
+        repair_statistic statistic_;
+        bool is_degraded_;
+        std::chrono::system_clock::time_point degraded_since_;
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_REPAIR_QUEUE_H_
@@ -0,0 +1,106 @@
+#ifndef __VDS_DHT_NETWORK_REPLICA_MAP_DIGEST_H_
+#define __VDS_DHT_NETWORK_REPLICA_MAP_DIGEST_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include "const_data_buffer.h"
+#include "messages/sync_messages.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Hash tree over the (object_id, replica, node) entries of the replica map shared with a partner.
+       * The range of the tree is the objects which first bits of object_id are equal to the prefix,
+       * the hash of the range is XOR of the entry hashes, so the hashes of the ranges on the tree levels
+       * are kept up to date when the entries are added or removed.
+       * Nodes exchange the hashes from the root and go down to the different ranges only,
+       * the entries are exchanged for the small different ranges.
+       */
+      class replica_map_digest {
+      public:
+        typedef messages::sync_replica_map_digest::range_t range_t;
+        typedef messages::sync_replica_map_entries::entry_t entry_t;
+
+        static constexpr uint8_t FANOUT_BITS = 4;
+        static constexpr uint8_t MAX_BITS = 24;
+        static constexpr size_t MAX_LEAF_ENTRIES = 32;
+
+        replica_map_digest();
+
+        void add(
+          const const_data_buffer & object_id,
+          uint16_t replica,
+          const const_data_buffer & node);
+
+        //Remove all entries of the object
+        void remove(const const_data_buffer & object_id);
+
+        size_t size() const {
+          return this->items_.size();
+        }
+
+        range_t root() const {
+          return this->get_range(0, 0);
+        }
+
+        //Empty hash for the empty range
+        range_t get_range(uint32_t prefix, uint8_t bits) const;
+
+        size_t count(uint32_t prefix, uint8_t bits) const;
+
+        /**
+         * \brief Compare the ranges of the partner with the local ones.
+         * \param children the children of the large different ranges to be compared by the partner
+         * \param leaves the small different ranges which entries have to be sent to the partner
+         */
+        void compare(
+          const std::list<range_t> & partner_ranges,
+          std::list<range_t> & children,
+          std::list<range_t> & leaves) const;
+
+        std::list<entry_t> get_entries(uint32_t prefix, uint8_t bits) const;
+
+        //Objects of the range which replica map differs from the partner entries
+        std::set<const_data_buffer> difference(
+          uint32_t prefix,
+          uint8_t bits,
+          const std::list<entry_t> & partner_entries) const;
+
+      private:
+        struct item_t {
+          entry_t entry;
+          const_data_buffer hash;
+        };
+
+        struct range_state_t {
+          std::vector<uint8_t> hash;
+          size_t count;
+        };
+
+        //By the first 32 bits of object_id
+        std::multimap<uint32_t, item_t> items_;
+
+        //Ranges of the tree levels by the prefix, the level is bits / FANOUT_BITS
+        std::vector<std::map<uint32_t, range_state_t>> levels_;
+
+        static uint32_t key(const const_data_buffer & object_id);
+
+        void update_levels(uint32_t key, const const_data_buffer & hash, bool is_added);
+
+        std::multimap<uint32_t, item_t>::const_iterator range_begin(uint32_t prefix, uint8_t bits) const;
+        std::multimap<uint32_t, item_t>::const_iterator range_end(uint32_t prefix, uint8_t bits) const;
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_REPLICA_MAP_DIGEST_H_
@@ -0,0 +1,80 @@
+#ifndef __VDS_DHT_NETWORK_REPLICA_SCRUBBER_H_
+#define __VDS_DHT_NETWORK_REPLICA_SCRUBBER_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <mutex>
+#include <vector>
+#include "const_data_buffer.h"
+#include "async_task.h"
+#include "task_manager.h"
+#include "scrub_statistic.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Background pass which re-hashes local replicas in order of device_record.last_verified.
+       * Corrupted replicas are handed over to sync_process to be restored from other nodes.
+       */
+      class replica_scrubber {
+      public:
+        static constexpr size_t BATCH_SIZE = 256;
+        static constexpr uint64_t DEFAULT_BYTES_PER_SECOND = 4 * 1024 * 1024;
+        static constexpr size_t DEFAULT_MAX_PARALLEL = 2;
+
+        static std::chrono::seconds SCRUB_PERIOD() {
+          return std::chrono::seconds(10);
+        }
+
+        replica_scrubber();
+
+        void start(const service_provider * sp);
+        void stop();
+
+        /**
+         * \brief I/O budget in bytes per second and the count of threads which compute hashes
+         */
+        void limits(uint64_t bytes_per_second, size_t max_parallel);
+
+        /**
+         * \brief Check the next batch of replicas which fits into the byte budget.
+         * At least one replica is checked so large replicas do not stall the pass.
+         * \return count of checked replicas
+         */
+        async_task<size_t> scrub(uint64_t byte_budget);
+
+        void get_statistic(scrub_statistic & result) const;
+
+      private:
+        struct replica_t {
+          const_data_buffer data_hash;
+          std::string local_path;
+          int64_t data_offset;
+          int64_t data_size;
+          bool is_valid;
+        };
+
+        const service_provider * sp_;
+        timer scrub_timer_;
+
+        std::mutex limits_mutex_;
+        uint64_t bytes_per_second_;
+        size_t max_parallel_;
+
+        mutable std::mutex statistic_mutex_;
+        scrub_statistic statistic_;
+        std::chrono::system_clock::time_point pass_start_;
+
+        async_task<void> verify(std::vector<replica_t> & replicas, size_t max_parallel);
+        static bool is_valid(const replica_t & replica);
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_REPLICA_SCRUBBER_H_
@@ -0,0 +1,145 @@
+#ifndef __VDS_DHT_NETWORK_REPLICA_SOURCE_SELECTOR_H_
+#define __VDS_DHT_NETWORK_REPLICA_SOURCE_SELECTOR_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include "const_data_buffer.h"
+#include "replica_source_statistic.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Choice of the nodes to restore an object from.
+       * RTT of the peers is measured by dht_ping, throughput by the replicas received from them.
+       * The k fastest holders of different replicas are asked in parallel,
+       * the request which is not answered by the deadline is hedged by the next source.
+       */
+      class replica_source_selector {
+      public:
+        //Optimistic estimates, so unknown peers are tried
+        static constexpr uint64_t DEFAULT_RTT_MS = 200;
+        static constexpr uint64_t DEFAULT_BYTES_PER_SECOND = 1024 * 1024;
+
+        static std::chrono::milliseconds MIN_HEDGE_DELAY() {
+          return std::chrono::seconds(2);
+        }
+
+        //The restore is forgotten and started again by the next call
+        static std::chrono::seconds MAX_RESTORE_TIME() {
+          return std::chrono::minutes(2);
+        }
+
+        struct request_t {
+          const_data_buffer node;
+          uint16_t replica;
+        };
+
+        replica_source_selector();
+
+        void ping_sent(
+          const const_data_buffer & node,
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        void pong_received(
+          const const_data_buffer & node,
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        //Expected time to receive the bytes from the node
+        std::chrono::milliseconds estimate(const const_data_buffer & node, uint64_t bytes) const;
+
+        /**
+         * \brief Order the replica sources by the expected time.
+         * Different replicas from different nodes are first, then other replicas of the same nodes,
+         * then other holders of the replicas as the hedge sources.
+         */
+        std::list<request_t> plan(
+          const std::map<const_data_buffer, std::set<uint16_t>> & holders,
+          uint64_t replica_size) const;
+
+        /**
+         * \brief Register the restore of the object.
+         * \param requests the requests to be sent now
+         * \return false if the restore of the object is in progress already
+         */
+        bool start(
+          const const_data_buffer & object_id,
+          size_t needed,
+          const std::list<request_t> & plan,
+          uint64_t replica_size,
+          std::list<request_t> & requests,
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        void received(
+          const const_data_buffer & node,
+          const const_data_buffer & object_id,
+          uint16_t replica,
+          size_t bytes,
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        //The requests to the next sources instead of the ones which did not answer by the deadline
+        std::list<std::pair<const_data_buffer /*object_id*/, request_t>> hedge(
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        size_t pending_restores() const;
+
+        void get_statistic(replica_source_statistic & result) const;
+
+      private:
+        struct peer_t {
+          uint64_t rtt_ms_;
+          uint64_t bytes_per_second_;
+          bool ping_pending_;
+          std::chrono::steady_clock::time_point ping_time_;
+          uint64_t requests_;
+          uint64_t responses_;
+          uint64_t timeouts_;
+
+          peer_t();
+        };
+
+        struct pending_request_t {
+          request_t request;
+          std::chrono::steady_clock::time_point sent;
+          std::chrono::steady_clock::time_point deadline;
+          bool timed_out;
+        };
+
+        struct restore_t {
+          size_t needed;
+          uint64_t replica_size;
+          std::chrono::steady_clock::time_point started;
+          std::set<uint16_t> received;
+          std::list<pending_request_t> sent;
+          std::list<request_t> spare;
+        };
+
+        mutable std::mutex mutex_;
+        std::map<const_data_buffer, peer_t> peers_;
+        std::map<const_data_buffer, restore_t> restores_;
+
+        uint64_t completed_restores_;
+        uint64_t hedged_requests_;
+        uint64_t last_restore_ms_;
+
+        std::chrono::milliseconds estimate_locked(const const_data_buffer & node, uint64_t bytes) const;
+
+        void send_locked(
+          restore_t & restore,
+          const request_t & request,
+          const std::chrono::steady_clock::time_point & now);
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_REPLICA_SOURCE_SELECTOR_H_
@@ -0,0 +1,53 @@
+#ifndef __VDS_DHT_NETWORK_RESTORE_BLOCK_STREAM_H_
+#define __VDS_DHT_NETWORK_RESTORE_BLOCK_STREAM_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "stream.h"
+#include "hash.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      //Validates the hash of the restored block and passes the data to the target without the end of stream
+      class restore_block_stream : public stream_output_async<uint8_t> {
+      public:
+        restore_block_stream(
+          const const_data_buffer & block_id,
+          const std::shared_ptr<stream_output_async<uint8_t>> & target)
+        : block_id_(block_id),
+          target_(target),
+          hash_(hash::sha256()) {
+        }
+
+        vds::async_task<void> write_async(
+          const uint8_t * data,
+          size_t len) override {
+
+          if (0 == len) {
+            this->hash_.final();
+            if (this->block_id_ != this->hash_.signature()) {
+              throw std::runtime_error("Invalid block hash");
+            }
+
+            co_return;
+          }
+
+          this->hash_.update(data, len);
+          co_await this->target_->write_async(data, len);
+        }
+
+      private:
+        const_data_buffer block_id_;
+        std::shared_ptr<stream_output_async<uint8_t>> target_;
+        hash hash_;
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_RESTORE_BLOCK_STREAM_H_
@@ -0,0 +1,109 @@
+#ifndef __VDS_DHT_NETWORK_SEGMENT_STORE_H_
+#define __VDS_DHT_NETWORK_SEGMENT_STORE_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <map>
+#include <mutex>
+#include "const_data_buffer.h"
+#include "filename.h"
+#include "file.h"
+
+namespace vds {
+  class database_transaction;
+
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Append-only store which packs replicas into large segment files.
+       * The position of every replica is kept in device_record (local_path, data_offset, data_size).
+       */
+      class segment_store {
+      public:
+        static constexpr int64_t SEGMENT_SIZE = 256 * 1024 * 1024;
+        static constexpr size_t COMPACT_SEGMENTS_PER_TICK = 1;
+
+        struct location_t {
+          std::string local_path;
+          int64_t data_offset;
+          std::shared_ptr<file> f;
+        };
+
+        segment_store();
+
+        //The size at which the active segment is sealed
+        void segment_size(int64_t value) {
+          this->segment_size_ = value;
+        }
+
+        location_t write(
+          database_transaction & t,
+          const std::string & storage_path,
+          const const_data_buffer & data);
+
+        /**
+         * \brief Reserve the space in the active segment, the data has to be written
+         * at the offset before the transaction is committed
+         */
+        location_t reserve(
+          database_transaction & t,
+          const std::string & storage_path,
+          int64_t data_size);
+
+        static const_data_buffer read(
+          const filename & fn,
+          int64_t data_offset,
+          int64_t data_size);
+
+        static void release(
+          database_transaction & t,
+          const std::string & local_path,
+          int64_t data_size);
+
+        /**
+         * \brief Move live replicas out of segments with a lot of removed data
+         * and delete segments which have been compacted by the previous call
+         */
+        void compact(
+          database_transaction & t,
+          const const_data_buffer & node_id);
+
+      private:
+        struct active_segment_t {
+          filename fn_;
+          std::shared_ptr<file> f_;
+          int64_t length_;
+        };
+
+        struct pending_segment_t {
+          std::shared_ptr<file> f_;
+          int64_t length_;
+        };
+
+        int64_t segment_size_;
+
+        std::mutex active_segments_mutex_;
+        std::map<std::string /*storage_path*/, std::unique_ptr<active_segment_t>> active_segments_;
+
+        //Length of the segments before the current transaction, the transactions are executed one by one
+        std::map<std::string /*local_path*/, pending_segment_t> pending_segments_;
+
+        std::unique_ptr<active_segment_t> open_active_segment(
+          database_transaction & t,
+          const std::string & storage_path);
+
+        bool is_active(const std::string & local_path);
+
+        void sync_pending();
+        void commit_pending();
+        void rollback_pending();
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_SEGMENT_STORE_H_
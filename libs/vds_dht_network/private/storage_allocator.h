@@ -0,0 +1,98 @@
+#ifndef __VDS_DHT_NETWORK_STORAGE_ALLOCATOR_H_
+#define __VDS_DHT_NETWORK_STORAGE_ALLOCATOR_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <mutex>
+#include <vector>
+#include "const_data_buffer.h"
+
+namespace vds {
+  class database_read_transaction;
+  class database_transaction;
+
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief In-memory view of the local storage devices used to place replicas
+       * without scanning device_record on every write.
+       */
+      class storage_allocator {
+      public:
+        enum class placement_policy_t {
+          most_free,
+          round_robin,
+          fill_first
+        };
+
+        storage_allocator();
+
+        placement_policy_t placement_policy() const;
+        void placement_policy(placement_policy_t value);
+
+        /**
+         * \brief Reload devices and usage counters from device_config
+         */
+        void load(
+          const database_read_transaction & t,
+          const const_data_buffer & node_id);
+
+        /**
+         * \brief Select storage for new data and reserve the space until the transaction is rolled back
+         * \return local path of the storage or empty string if there is no space
+         */
+        std::string allocate(
+          database_transaction & t,
+          uint64_t size);
+
+        /**
+         * \brief Return the space to the storage once the transaction is committed
+         */
+        void release(
+          database_transaction & t,
+          const std::string & storage_path,
+          uint64_t size);
+
+        /**
+         * \brief Recalculate device_config.used_size from device_record
+         */
+        static void reconcile(
+          database_transaction & t,
+          const const_data_buffer & node_id);
+
+        static void add_usage(
+          database_transaction & t,
+          const const_data_buffer & node_id,
+          const std::string & storage_path,
+          int64_t delta);
+
+      private:
+        struct device_info_t {
+          std::string local_path_;
+          int64_t reserved_size_;
+          int64_t used_size_;
+
+          int64_t free_size() const {
+            return (this->used_size_ < this->reserved_size_) ? (this->reserved_size_ - this->used_size_) : 0;
+          }
+        };
+
+        mutable std::mutex devices_mutex_;
+        placement_policy_t placement_policy_;
+        std::vector<device_info_t> devices_;
+        size_t next_device_;
+
+        device_info_t * select_device(uint64_t size);
+        void release(
+          const std::string & storage_path,
+          uint64_t size);
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_STORAGE_ALLOCATOR_H_
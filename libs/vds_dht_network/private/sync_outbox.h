@@ -0,0 +1,97 @@
+#ifndef __VDS_DHT_NETWORK_SYNC_OUTBOX_H_
+#define __VDS_DHT_NETWORK_SYNC_OUTBOX_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "const_data_buffer.h"
+#include "messages/dht_route_messages.h"
+#include "sync_message_statistic.h"
+#include "database.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Sync messages collected while a database transaction is processed.
+       * The messages to the same node are sent as one sync_message_batch after the transaction is committed,
+       * so the leader broadcasts and the responses of many objects with the same members share datagrams.
+       * The messages of the rolled back transaction are never sent.
+       */
+      class sync_outbox {
+      public:
+        static constexpr size_t MAX_BATCH_SIZE = 64 * 1024;
+
+        struct message_t {
+          message_type_t message_id;
+          const_data_buffer message_data;
+        };
+
+        typedef const database_transaction * scope_id_t;
+
+        sync_outbox();
+
+        static bool is_sync_message(message_type_t message_id);
+
+        //Open the scope of the transaction, returns false if it is already open
+        bool begin(const scope_id_t & scope);
+
+        /**
+         * \brief Count the sync message and hold it until the transaction is finished
+         * \return false if the scope is not open and the message has to be sent at once
+         */
+        bool add(
+          const scope_id_t & scope,
+          const const_data_buffer & node_id,
+          message_type_t message_id,
+          const const_data_buffer & message_data);
+
+        //The number of the held messages, a part of the transaction rolled back alone returns to it
+        size_t mark(const scope_id_t & scope) const;
+        void rollback_to(const scope_id_t & scope, size_t mark);
+
+        //The transaction is committed, the messages are grouped by the target node
+        std::map<const_data_buffer, std::list<message_t>> end(const scope_id_t & scope);
+
+        //The transaction is rolled back, the messages of the scope are never sent
+        void discard(const scope_id_t & scope);
+
+        void sent(size_t bytes);
+
+        //Move the counters of the tick to the statistic
+        void finish_tick();
+
+        void get_statistic(sync_message_statistic & result) const;
+
+      private:
+        struct scope_message_t {
+          const_data_buffer node_id_;
+          message_t message_;
+        };
+
+        //The messages in the order they are sent
+        typedef std::vector<scope_message_t> scope_t;
+
+        mutable std::mutex mutex_;
+        std::map<scope_id_t, scope_t> scopes_;
+
+        uint64_t tick_messages_;
+        std::set<const_data_buffer> tick_objects_;
+        uint64_t tick_datagrams_;
+        uint64_t tick_bytes_;
+
+        sync_message_statistic statistic_;
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_SYNC_OUTBOX_H_
@@ -7,6 +7,9 @@
 #include "dht_network_client.h"
 #include "chunk.h"
 #include "imessage_map.h"
+#include "repair_queue.h"
+#include "replica_map_digest.h"
+#include "anti_entropy_statistic.h"
 
 /*
 Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
@@ -20,6 +23,7 @@ namespace vds {
       class sync_offer_remove_replica_operation_request;
       class sync_replica_data;
       class sync_replica_request;
+      class sync_replica_piece_request;
       class sync_replica_operations_response;
       class sync_replica_operations_request;
       class sync_leader_broadcast_response;
@@ -50,9 +54,13 @@ namespace vds {
       public:
         sync_process(const service_provider * sp);
 
-        async_task<void> do_sync(
-          
-          database_transaction& t);
+        /**
+         * \brief Maintenance tick. Replica maintenance stops at the deadline.
+         * \return count of objects which are due for the replica check yet
+         */
+        async_task<size_t> do_sync(
+          database_transaction& t,
+          const std::chrono::steady_clock::time_point& deadline);
 
         async_task<void> add_sync_entry( database_transaction& t,
                             const const_data_buffer& object_id, uint32_t object_size);
@@ -61,6 +69,39 @@ namespace vds {
           database_transaction& t,
           const const_data_buffer object_id);
 
+        /**
+         * \brief Remove the corrupted local replica and tell the sync leader about it,
+         * so the replica is generated again by sync_replicas.
+         */
+        async_task<void> repair_replica(
+          database_transaction& t,
+          const const_data_buffer& replica_hash);
+
+        //The local chunk or the replica map of the object has been changed outside of sync messages
+        void invalidate_replica_map(
+          const database_read_transaction& t,
+          const const_data_buffer& object_id);
+
+        void repair_limits(uint64_t bytes_per_second, size_t max_parallel) {
+          this->replica_sync_.repair_limits(bytes_per_second, max_parallel);
+        }
+
+        void get_repair_statistic(repair_statistic & result) const {
+          this->replica_sync_.get_repair_statistic(result);
+        }
+
+        /**
+         * \brief Reconcile the replica map of the shared objects with the next member node.
+         * The nodes exchange the hashes of the key ranges and the entries of the different small ranges only,
+         * the snapshot is requested for the objects with different replica map.
+         */
+        async_task<void> start_anti_entropy(database_transaction& t);
+
+        void get_anti_entropy_statistic(anti_entropy_statistic & result) const {
+          std::lock_guard<std::mutex> lock(this->anti_entropy_mutex_);
+          result = this->anti_entropy_statistic_;
+        }
+
         async_task<std::list<uint16_t>> prepare_restore_replica(
           database_read_transaction & t,
           const const_data_buffer object_id);
@@ -158,6 +199,11 @@ namespace vds {
           const messages::sync_replica_request& message,
           const imessage_map::message_info_t& message_info);
 
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_replica_piece_request& message,
+          const imessage_map::message_info_t& message_info);
+
         async_task<void> apply_message(
           
           database_transaction& t,
@@ -169,6 +215,16 @@ namespace vds {
           database_transaction& t,
           const messages::sync_replica_query_operations_request & message,
           const imessage_map::message_info_t& message_info);
+
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_replica_map_digest & message,
+          const imessage_map::message_info_t& message_info);
+
+        async_task<void> apply_message(
+          database_transaction& t,
+          const messages::sync_replica_map_entries & message,
+          const imessage_map::message_info_t& message_info);
         
         async_task<void> on_new_session(
           
@@ -203,7 +259,28 @@ namespace vds {
         }
 
         std::map<uint16_t, std::unique_ptr<chunk_generator<uint16_t>>> distributed_generators_;
-        int sync_replicas_timeout_;
+
+        const_data_buffer anti_entropy_partner_;
+        mutable std::mutex anti_entropy_mutex_;
+        anti_entropy_statistic anti_entropy_statistic_;
+
+        //Replica map digests of the partners, updated with the replica map and the members of the objects
+        std::map<const_data_buffer, replica_map_digest> replica_map_digests_;
+        uint64_t replica_map_digests_rollback_count_;
+
+        //Replica map of the objects which have the partner as a member, anti_entropy_mutex_ has to be locked
+        const replica_map_digest & load_replica_map_digest(
+          const database_read_transaction& t,
+          const const_data_buffer& partner_node);
+
+        //The replica map or the members of the object have been changed
+        void update_replica_map_digests(
+          const database_read_transaction& t,
+          const const_data_buffer& object_id);
+
+        async_task<void> send_replica_map_ranges(
+          const const_data_buffer& partner_node,
+          const std::list<replica_map_digest::range_t>& ranges);
 
         async_task<void> add_to_log( database_transaction& t,
                         const const_data_buffer& object_id,
@@ -254,6 +331,13 @@ namespace vds {
           
           database_transaction& t);
 
+        //Ask the sources of the missing replicas of the object
+        async_task<void> request_replicas(
+          database_read_transaction & t,
+          const const_data_buffer & object_id,
+          const std::set<uint16_t> & exist_replicas,
+          const std::string & log_message);
+
         async_task<void> send_snapshot_request(
           
           const const_data_buffer& object_id,
@@ -335,20 +419,64 @@ namespace vds {
           const const_data_buffer& object_id);
 
         //Sync replicas
-        async_task<void> sync_replicas(
-          
-          database_transaction& t);
-
+        async_task<size_t> sync_replicas(
+          database_transaction& t,
+          const std::chrono::steady_clock::time_point& deadline);
+
+        /**
+         * \brief Replica maintenance of the objects which are due by sync_state.next_check.
+         * Objects are processed in bounded batches until the deadline of a tick,
+         * objects with lost replicas are repaired in order of redundancy margin by repair_queue,
+         * the replica map of the processed objects is cached and updated by the sync messages.
+         * Used from database transactions only, which are serialized.
+         */
         class replica_sync {
         public:
-         
-          void load(const service_provider * sp,
-            const database_read_transaction& t);
+          static constexpr size_t BATCH_SIZE = 1000;
+          static constexpr size_t MAX_CACHED_OBJECTS = 10000;
+
+          static std::chrono::system_clock::duration CHECK_INTERVAL() {
+            return std::chrono::minutes(10);
+          }
 
-          async_task<void> normalize_density(
+          replica_sync();
+
+          //Returns count of the due objects left for the next tick
+          async_task<size_t> process(
             sync_process * owner,
             const service_provider * sp,
-            database_transaction& t);
+            database_transaction& t,
+            const std::chrono::steady_clock::time_point& deadline);
+
+          //Updates of the cached replica map
+          void add_replica(
+            const database_read_transaction& t,
+            const const_data_buffer& object_id,
+            uint16_t replica,
+            const const_data_buffer& node_id);
+
+          void remove_replica(
+            const database_read_transaction& t,
+            const const_data_buffer& object_id,
+            uint16_t replica,
+            const const_data_buffer& node_id);
+
+          void invalidate(
+            const database_read_transaction& t,
+            const const_data_buffer& object_id);
+
+          size_t cached_objects() const {
+            return this->cache_.size();
+          }
+
+          //Reschedule the object to be checked at the next tick
+          static void schedule_check(
+            database_transaction& t,
+            const const_data_buffer& object_id);
+
+          void repair_limits(uint64_t bytes_per_second, size_t max_parallel);
+          void get_repair_statistic(repair_statistic & result) const;
+
         private:
           struct node_info_t {
             std::set<uint16_t> replicas_;
@@ -410,31 +538,45 @@ namespace vds {
 
           };
 
-          std::map<const_data_buffer, object_info_t> objects_;
+          struct cached_object_t {
+            bool is_local_chunk;
+            std::map<const_data_buffer, std::set<uint16_t>> replicas;
+            std::list<const_data_buffer>::iterator order;
+          };
 
-          void register_local_chunk(
-            const const_data_buffer& object_id,
-            const const_data_buffer& current_node_id);
+          repair_queue repair_queue_;
 
-          void register_replica(
-            const const_data_buffer& object_id,
-            uint16_t replica,
-            const const_data_buffer& node_id);
+          std::map<const_data_buffer, cached_object_t> cache_;
+          std::list<const_data_buffer> cache_order_;
+          uint64_t rollback_count_;
 
-          void register_sync_leader(
-            const const_data_buffer& object_id,
-            const const_data_buffer& leader_node_id,
-            uint64_t generation,
-            uint64_t current_term,
-            uint64_t commit_index,
-            uint64_t last_applied);
+          void check_rollback(const database_read_transaction& t);
 
-          void register_sync_member(
-            const const_data_buffer& object_id,
-            const const_data_buffer& member_node);
+          //Replica map from the cache and the current sync state from the database
+          object_info_t load_object(
+            const service_provider * sp,
+            const database_read_transaction& t,
+            const const_data_buffer& object_id);
 
+          cached_object_t & load_replicas(
+            const service_provider * sp,
+            const database_read_transaction& t,
+            const const_data_buffer& object_id);
+
+          async_task<size_t> process_leader_objects(
+            sync_process * owner,
+            const service_provider * sp,
+            database_transaction& t,
+            const std::chrono::steady_clock::time_point& deadline);
+
+          async_task<size_t> process_local_chunks(
+            const service_provider * sp,
+            database_transaction& t,
+            const std::chrono::steady_clock::time_point& deadline);
         };
 
+        replica_sync replica_sync_;
+
         async_task<void> send_random_replicas(
           std::map<uint16_t, std::list<std::function<async_task<void>()>>> allowed_replicas,
           std::set<uint16_t> send_replicas,
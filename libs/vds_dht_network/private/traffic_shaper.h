@@ -0,0 +1,143 @@
+#ifndef __VDS_DHT_NETWORK_TRAFFIC_SHAPER_H_
+#define __VDS_DHT_NETWORK_TRAFFIC_SHAPER_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <chrono>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include "network_address.h"
+#include "iudp_transport.h"
+#include "messages/dht_route_messages.h"
+#include "session_statistic.h"
+
+namespace vds {
+  namespace dht {
+    namespace network {
+
+      /**
+       * \brief Token bucket rate limits of the outgoing datagrams per traffic class and per peer.
+       * Control datagrams are never queued. The other classes wait in the order of priority,
+       * so the background repair does not take the bandwidth of the user restore.
+       * A bucket may go into debt, so the datagram larger than the burst is sent when the tokens are positive.
+       * The queue of a class is limited by MAX_QUEUE_BYTES, the datagram over the limit is dropped
+       * like the one lost by the network.
+       */
+      class traffic_shaper {
+      public:
+        static constexpr size_t CLASS_COUNT = 4;
+        static constexpr size_t MAX_QUEUE_BYTES = 16 * 1024 * 1024;
+
+        //Idle peers are forgotten
+        static std::chrono::seconds PEER_IDLE_TIME() {
+          return std::chrono::minutes(1);
+        }
+
+        typedef std::function<void(void)> send_handler_t;
+
+        traffic_shaper();
+
+        static traffic_class_t message_class(message_type_t message_id);
+        static const char * class_name(traffic_class_t traffic_class);
+
+        //Zero bytes_per_second removes the limit
+        void class_limits(traffic_class_t traffic_class, uint64_t bytes_per_second, uint64_t burst_bytes);
+        void peer_limits(uint64_t bytes_per_second, uint64_t burst_bytes);
+
+        //The handlers of the datagrams which may be sent now are added to ready, the caller invokes them.
+        //false if the queue of the class is full and the datagram is dropped
+        bool submit(
+          const network_address & address,
+          traffic_class_t traffic_class,
+          size_t size,
+          const send_handler_t & handler,
+          std::list<send_handler_t> & ready,
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        void pump(
+          std::list<send_handler_t> & ready,
+          const std::chrono::steady_clock::time_point & now = std::chrono::steady_clock::now());
+
+        size_t queue_size() const;
+
+        void get_statistic(session_statistic & result) const;
+        void get_peer_statistic(const network_address & address, session_statistic::session_info & result) const;
+
+      private:
+        struct bucket_t {
+          uint64_t bytes_per_second;
+          uint64_t burst_bytes;
+          int64_t tokens;
+          std::chrono::steady_clock::time_point updated;
+
+          bucket_t();
+
+          void limits(uint64_t bytes_per_second, uint64_t burst_bytes);
+          void refill(const std::chrono::steady_clock::time_point & now);
+          bool is_available() const;
+          void consume(size_t size);
+        };
+
+        struct item_t {
+          network_address address;
+          size_t size;
+          send_handler_t handler;
+          std::chrono::steady_clock::time_point enqueued;
+        };
+
+        struct class_t {
+          bucket_t bucket;
+          std::list<item_t> queue;
+          size_t queued_bytes;
+
+          uint64_t sent;
+          uint64_t sent_bytes;
+          uint64_t throttled;
+          uint64_t total_wait_ms;
+          uint64_t dropped;
+
+          class_t();
+        };
+
+        struct peer_t {
+          bucket_t bucket;
+          uint64_t queued;
+          uint64_t sent_bytes;
+          uint64_t throttled;
+          std::chrono::steady_clock::time_point last_used;
+
+          peer_t();
+        };
+
+        mutable std::mutex mutex_;
+        class_t classes_[CLASS_COUNT];
+
+        uint64_t peer_bytes_per_second_;
+        uint64_t peer_burst_bytes_;
+        std::map<network_address, peer_t> peers_;
+        std::chrono::steady_clock::time_point last_cleanup_;
+
+        peer_t & peer_locked(const network_address & address, const std::chrono::steady_clock::time_point & now);
+
+        void send_locked(
+          class_t & traffic_class,
+          peer_t & peer,
+          size_t size,
+          const send_handler_t & handler,
+          std::list<send_handler_t> & ready);
+
+        void pump_locked(
+          std::list<send_handler_t> & ready,
+          const std::chrono::steady_clock::time_point & now);
+      };
+    }
+  }
+}
+
+#endif //__VDS_DHT_NETWORK_TRAFFIC_SHAPER_H_
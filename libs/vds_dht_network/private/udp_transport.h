@@ -12,6 +12,8 @@ All rights reserved
 #include "debug_mutex.h"
 #include "iudp_transport.h"
 #include "thread_apartment.h"
+#include "task_manager.h"
+#include "traffic_shaper.h"
 
 namespace vds {
   struct session_statistic;
@@ -25,6 +27,11 @@ namespace vds {
         static constexpr uint32_t MAGIC_LABEL = 0xAFAFAFAF;
         static constexpr uint8_t PROTOCOL_VERSION = 0;
 
+        //The queued datagrams are sent when the tokens are refilled
+        static std::chrono::milliseconds SHAPER_PERIOD() {
+          return std::chrono::milliseconds(10);
+        }
+
         udp_transport();
         udp_transport(const udp_transport&) = delete;
         udp_transport(udp_transport&&) = delete;
@@ -38,11 +45,16 @@ namespace vds {
 
         void stop() override;
 
-        vds::async_task<void> write_async( const udp_datagram& datagram) override;
+        vds::async_task<void> write_async(
+          const udp_datagram& datagram,
+          traffic_class_t traffic_class) override;
         vds::async_task<void> try_handshake( const std::string& address) override;
 
         async_task<void> on_timer() override;
 
+        void traffic_limits(traffic_class_t traffic_class, uint64_t bytes_per_second, uint64_t burst_bytes) override;
+        void peer_traffic_limits(uint64_t bytes_per_second, uint64_t burst_bytes) override;
+
         const const_data_buffer& this_node_id() const {
           return this->this_node_id_;
         }
@@ -61,6 +73,9 @@ namespace vds {
 
         std::shared_ptr<thread_apartment> send_thread_;
 
+        traffic_shaper shaper_;
+        timer shaper_timer_;
+
 #ifdef _DEBUG
 #ifndef _WIN32
         pid_t owner_id_;
@@ -20,6 +20,8 @@ All rights reserved
 #include "private/upload_stream_task_p.h"
 #include "member_user.h"
 #include "file_manager_service.h"
+#include "file_catalog_dbo.h"
+#include "channel_message_dbo.h"
 
 vds::file_manager::file_operations::file_operations()
   : impl_(new file_manager_private::_file_operations()) {
@@ -99,39 +101,26 @@ vds::async_task<vds::file_manager::file_operations::download_result_t> vds::file
   const const_data_buffer & target_file,
   const std::shared_ptr<stream_output_async<uint8_t>> & output_stream) {
 
-  auto result = std::make_shared<file_manager::file_operations::download_result_t>();
-  co_await this->sp_->get<db_model>()->async_transaction(
-      [pthis = this->shared_from_this(), user_mng, channel_id, target_file, output_stream, result](database_transaction &t) -> bool {
-        auto channel = user_mng->get_channel(channel_id);
-
-        user_mng->walk_messages(
-            channel_id,
-            t,
-            [pthis, result, target_file, output_stream](const transactions::user_message_transaction &message) -> bool {
-          for (const auto & file : message.files) {
-            if (target_file == file.file_id) {
-              result->name = file.name;
-              result->mime_type = file.mime_type;
-              result->size = file.size;
-              mt_service::async(pthis->sp_, [pthis, output_stream, fb = file.file_blocks]() {
-                try {
-                  pthis->download_stream(output_stream, fb).get();
-                }
-                catch(...){}
-              });
-              return false;
-            }
-          }
-              return true;
-            });
-
-        return true;
+  auto file = std::make_shared<transactions::user_message_transaction::file_info_t>();
+  co_await this->sp_->get<db_model>()->async_read_transaction(
+      [user_mng, channel_id, target_file, file](database_read_transaction &t) {
+    if (!find_file(t, user_mng, channel_id, target_file, *file)) {
+      throw vds_exceptions::not_found();
+    }
   });
 
-  if (result->mime_type.empty()) {
-    throw vds_exceptions::not_found();
-  }
-  co_return *result;
+  mt_service::async(this->sp_, [pthis = this->shared_from_this(), output_stream, file]() {
+    try {
+      pthis->download_stream(output_stream, file->file_blocks).get();
+    }
+    catch(...){}
+  });
+
+  co_return file_manager::file_operations::download_result_t {
+    file->name,
+    file->mime_type,
+    file->size
+  };
 }
 
 vds::async_task<vds::file_manager::file_operations::prepare_download_result_t> vds::file_manager_private::_file_operations::prepare_download_file(
@@ -141,52 +130,71 @@ vds::async_task<vds::file_manager::file_operations::prepare_download_result_t> v
 
   auto result = std::make_shared<file_manager::file_operations::prepare_download_result_t>();
   co_await this->sp_->get<db_model>()->async_read_transaction(
-    [pthis = this->shared_from_this(), user_mng, channel_id, target_file, result](database_read_transaction &t) -> bool {
-    auto channel = user_mng->get_channel(channel_id);
+    [pthis = this->shared_from_this(), user_mng, channel_id, target_file, result](database_read_transaction &t) {
+    transactions::user_message_transaction::file_info_t file;
+    if (!find_file(t, user_mng, channel_id, target_file, file)) {
+      throw vds_exceptions::not_found();
+    }
 
-    user_mng->walk_messages(
-      channel_id,
-      t,
-      [pthis, &t, result, target_file](const transactions::user_message_transaction &message) -> bool {
-      for (const auto & file : message.files) {
-        if (target_file == file.file_id) {
-          result->name = file.name;
-          result->mime_type = file.mime_type;
-          result->size = file.size;
-          result->blocks = pthis->prepare_download_stream(t, file.file_blocks).get();
-
-          uint16_t ready_blocks = 0;
-          for (auto & p : result->blocks) {
-            for (auto & pr : p.second.replicas) {
-              if (pr.second.size() >= dht::network::service::MIN_DISTRIBUTED_PIECES) {
-                ++ready_blocks;
-              }
-            }
-          }
-
-          if(ready_blocks >= dht::network::service::MIN_HORCRUX) {
-            result->progress = 100;
-          }
-          else {
-            result->progress = 100 * ready_blocks / dht::network::service::MIN_HORCRUX;
-            if (result->progress > 99) {
-              result->progress = 99;
-            }
-          }
-          return false;
+    result->name = file.name;
+    result->mime_type = file.mime_type;
+    result->size = file.size;
+    result->blocks = pthis->prepare_download_stream(t, file.file_blocks).get();
+
+    uint16_t ready_blocks = 0;
+    for (auto & p : result->blocks) {
+      for (auto & pr : p.second.replicas) {
+        if (pr.second.size() >= dht::network::service::MIN_DISTRIBUTED_PIECES) {
+          ++ready_blocks;
         }
       }
-      return true;
-    });
+    }
+
+    if(ready_blocks >= dht::network::service::MIN_HORCRUX) {
+      result->progress = 100;
+    }
+    else {
+      result->progress = 100 * ready_blocks / dht::network::service::MIN_HORCRUX;
+      if (result->progress > 99) {
+        result->progress = 99;
+      }
+    }
+  });
 
-      return true;
+  co_return *result;
+}
+
+bool vds::file_manager_private::_file_operations::find_file(
+  database_read_transaction& t,
+  const std::shared_ptr<user_manager>& user_mng,
+  const const_data_buffer& channel_id,
+  const const_data_buffer& target_file,
+  transactions::user_message_transaction::file_info_t& result) {
 
-    });
+  if (!user_mng->get_channel(channel_id)) {
+    return false;
+  }
 
-  if (result->mime_type.empty()) {
-    throw vds_exceptions::not_found();
+  //The block has to be applied to the channel index
+  orm::file_catalog_dbo t1;
+  orm::channel_message_dbo t2;
+  auto st = t.get_reader(
+    t1.select(t1.name, t1.mime_type, t1.file_size, t1.file_blocks)
+    .inner_join(t2, t2.block_id == t1.block_id)
+    .where(t1.channel_id == channel_id && t1.file_id == target_file));
+  if (st.execute()) {
+    result.name = t1.name.get(st);
+    result.mime_type = t1.mime_type.get(st);
+    result.size = safe_cast<size_t>(t1.file_size.get(st));
+    result.file_id = target_file;
+
+    const auto file_blocks = t1.file_blocks.get(st);
+    binary_deserializer s(file_blocks);
+    s >> result.file_blocks;
+    return true;
   }
-  co_return *result;
+
+  return false;
 }
 
 vds::async_task<void> vds::file_manager_private::_file_operations::create_message(
@@ -263,14 +271,13 @@ vds::async_task<void> vds::file_manager_private::_file_operations::download_stre
   while (!file_blocks.empty()) {
     auto network_client = this->sp_->get<dht::network::client>();
 
-    const_data_buffer data = co_await network_client->restore(dht::network::client::chunk_info{
+    //The block is validated by the hash while it is written
+    co_await network_client->restore(
+      dht::network::client::chunk_info{
         file_blocks.begin()->block_id,
         file_blocks.begin()->block_key,
-        file_blocks.begin()->replica_hashes });
-
-    vds_assert(data.size() == file_blocks.begin()->block_size);
-    auto buffer = std::make_shared<const_data_buffer>(data);
-    co_await target_stream->write_async(buffer->data(), buffer->size());
+        file_blocks.begin()->replica_hashes },
+      target_stream);
 
     file_blocks.pop_front();
   }
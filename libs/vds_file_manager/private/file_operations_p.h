@@ -78,6 +78,14 @@ namespace vds {
           const std::shared_ptr<stream_output_async<uint8_t>> & target_stream,
           const std::list<transactions::user_message_transaction::file_block_t> &file_blocks);
 
+      //Indexed lookup in the file catalog
+      static bool find_file(
+        database_read_transaction &t,
+        const std::shared_ptr<user_manager> & user_mng,
+        const const_data_buffer & channel_id,
+        const const_data_buffer & target_file,
+        transactions::user_message_transaction::file_info_t & result);
+
       async_task<std::map<vds::const_data_buffer, dht::network::client::block_info_t>> prepare_download_stream(
         database_read_transaction &t,
         const std::list<vds::transactions::user_message_transaction::file_block_t> &file_blocks_param);
@@ -3,6 +3,7 @@
 #include "private/upload_stream_task_p.h"
 #include "db_model.h"
 #include "dht_network_client.h"
+#include "dht_network.h"
 
 vds::_upload_stream_task::_upload_stream_task()
 : total_hash_(hash::sha256()), total_size_(0), readed_(0) {
@@ -52,6 +53,10 @@ vds::async_task<void> vds::_upload_stream_task::process_data(
     this->total_size_ += this->readed_;
   }
 
+  //The compressed block and all horcruxes are built in memory by save
+  const auto lease = co_await sp->get<dht::network::memory_budget>()->acquire(
+    this->readed_ * (1 + dht::network::service::GENERATE_HORCRUX / dht::network::service::MIN_HORCRUX));
+
   co_await sp->get<db_model>()->async_transaction([pthis = this->shared_from_this(), network_client](
     database_transaction &t)->bool{
 
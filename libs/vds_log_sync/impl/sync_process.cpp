@@ -71,7 +71,8 @@ vds::async_task<void> vds::transaction_log::sync_process::query_unknown_records(
           neighbor->node_id_,
           message_create<dht::messages::transaction_log_request>(
             p,
-            client->current_node_id()));
+            client->current_node_id(),
+            dht::messages::transaction_log_request::record_formats_t{ true }));
       }
     }
   }
@@ -102,7 +103,8 @@ vds::async_task<void> vds::transaction_log::sync_process::apply_message(
         message.source_node,
         message_create<dht::messages::transaction_log_request>(
           p,
-          client->current_node_id()));
+          client->current_node_id(),
+          dht::messages::transaction_log_request::record_formats_t{ true }));
     }
   }
   else {
@@ -156,12 +158,14 @@ vds::async_task<void> vds::transaction_log::sync_process::apply_message(
       "Provide log record %s",
       base64::from_bytes(message.transaction_id).c_str());
 
+    //The record is stored in the compact format, old peers expect the canonical bytes
+    const auto data = t1.data.get(st);
     auto client = this->sp_->get<vds::dht::network::client>();
     co_await(*client)->send(
       message.source_node,
       message_create<dht::messages::transaction_log_record>(
         message.transaction_id,
-        t1.data.get(st)));
+        message.record_formats.compact ? data : transactions::transaction_block::unpack(data)));
 
   }
 }
@@ -183,20 +187,8 @@ vds::async_task<void> vds::transaction_log::sync_process::apply_message(
   }
 
   orm::transaction_log_record_dbo t1;
-  const auto root_cert = cert_control::get_root_certificate();
-  std::shared_ptr<certificate> write_cert;
-  if (block.ancestors().empty() || block.write_cert_id() == root_cert->subject()) {
-    write_cert = root_cert;
-  }
-  else {
-    orm::certificate_chain_dbo t2;
-    auto st = t.get_reader(t2.select(t2.cert).where(t2.id == block.write_cert_id()));
-    if (st.execute()) {
-      write_cert = std::make_shared<certificate>(certificate::parse_der(t2.cert.get(st)));
-    }
-  }
-
-  if (!write_cert || !block.validate(*write_cert)) {
+  const auto write_cert = get_write_cert(t, block);
+  if (!write_cert || !this->verifier_.verify(block, *write_cert)) {
     auto client = this->sp_->get<vds::dht::network::client>();
 
     orm::transaction_log_hierarchy_dbo t4;
@@ -208,7 +200,8 @@ vds::async_task<void> vds::transaction_log::sync_process::apply_message(
           message_info.source_node(),
           message_create<dht::messages::transaction_log_request>(
             ancestor,
-            client->current_node_id()));
+            client->current_node_id(),
+            dht::messages::transaction_log_request::record_formats_t{ true }));
       }
     }
 
@@ -275,3 +268,133 @@ vds::async_task<void> vds::transaction_log::sync_process::sync_local_channels(
         client->current_node_id()));
   }
 }
+
+void vds::transaction_log::sync_process::process_record(
+  const dht::messages::transaction_log_record& message,
+  const dht::network::imessage_map::message_info_t& message_info) {
+
+  //The compact record is unpacked once, the verification and the apply parse the canonical bytes
+  auto record = std::make_shared<dht::messages::transaction_log_record>(message);
+  try {
+    record->data = transactions::transaction_block::unpack(message.data);
+  }
+  catch (const std::exception & ex) {
+    this->sp_->get<logger>()->warning(
+      ThisModule,
+      "%s at unpack log record %s",
+      ex.what(),
+      base64::from_bytes(message.record_id).c_str());
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(this->pending_mutex_);
+  this->pending_records_.push_back(pending_record_t{
+    record,
+    message_info });
+
+  const auto start_processing = !this->is_processing_;
+  this->is_processing_ = true;
+  lock.unlock();
+
+  //The receive loop is not blocked, the records received meanwhile are verified by the next batch
+  if (start_processing) {
+    this->process_records().detach();
+  }
+}
+
+vds::transaction_log::sync_process::verify_statistic_t vds::transaction_log::sync_process::get_verify_statistic() const {
+  std::lock_guard<std::mutex> lock(this->pending_mutex_);
+  return this->verify_statistic_;
+}
+
+vds::async_task<void> vds::transaction_log::sync_process::process_records() {
+  for (;;) {
+    std::list<pending_record_t> records;
+
+    std::unique_lock<std::mutex> lock(this->pending_mutex_);
+    while (!this->pending_records_.empty() && records.size() < MAX_VERIFY_BATCH_SIZE) {
+      records.splice(records.end(), this->pending_records_, this->pending_records_.begin());
+    }
+
+    if (records.empty()) {
+      this->is_processing_ = false;
+      co_return;
+    }
+    lock.unlock();
+
+    try {
+      co_await this->verify_records(records);
+    }
+    catch (const std::exception & ex) {
+      this->sp_->get<logger>()->warning(ThisModule, "%s at verify log records", ex.what());
+    }
+
+    lock.lock();
+    ++this->verify_statistic_.batches;
+    this->verify_statistic_.verified += records.size();
+    this->verify_statistic_.max_batch_size = std::max(this->verify_statistic_.max_batch_size, records.size());
+    lock.unlock();
+
+    //Signatures are in the verifier cache now, so records are applied one by one in the received order
+    for (const auto & record : records) {
+      try {
+        co_await this->sp_->get<db_model>()->async_transaction(
+          [this, &record](database_transaction & t) {
+          this->apply_message(t, *record.message, record.message_info).get();
+        });
+      }
+      catch (const std::exception & ex) {
+        this->sp_->get<logger>()->warning(
+          ThisModule,
+          "%s at apply log record %s",
+          ex.what(),
+          base64::from_bytes(record.message->record_id).c_str());
+      }
+
+      lock.lock();
+      ++this->verify_statistic_.applied;
+      lock.unlock();
+    }
+  }
+}
+
+vds::async_task<void> vds::transaction_log::sync_process::verify_records(
+  const std::list<pending_record_t>& records) {
+
+  std::vector<transactions::transaction_block_verifier::request_t> requests;
+  co_await this->sp_->get<db_model>()->async_read_transaction(
+    [&records, &requests](database_read_transaction & t) {
+    for (const auto & record : records) {
+      try {
+        auto block = std::make_shared<transactions::transaction_block>(record.message->data);
+        auto write_cert = get_write_cert(t, *block);
+        if (write_cert) {
+          requests.push_back(transactions::transaction_block_verifier::request_t{ block, write_cert });
+        }
+      }
+      catch (...) {
+        //The invalid record will be rejected by apply_message
+      }
+    }
+  });
+
+  co_await this->verifier_.verify_batch(this->sp_, std::move(requests));
+}
+
+std::shared_ptr<vds::certificate> vds::transaction_log::sync_process::get_write_cert(
+  const database_read_transaction& t,
+  const transactions::transaction_block& block) {
+
+  const auto root_cert = cert_control::get_root_certificate();
+  if (block.ancestors().empty() || block.write_cert_id() == root_cert->subject()) {
+    return root_cert;
+  }
+
+  orm::certificate_chain_dbo t2;
+  auto st = t.get_reader(t2.select(t2.cert).where(t2.id == block.write_cert_id()));
+  if (st.execute()) {
+    return std::make_shared<certificate>(certificate::parse_der(t2.cert.get(st)));
+  }
+
+  return std::shared_ptr<certificate>();
+}
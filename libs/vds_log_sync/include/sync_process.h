@@ -1,8 +1,11 @@
 #ifndef __VDS_LOG_SYNC_SYNC_PROCESS_H_
 #define __VDS_LOG_SYNC_SYNC_PROCESS_H_
 
+#include <list>
+#include <mutex>
 #include "database.h"
 #include "imessage_map.h"
+#include "transaction_block_verifier.h"
 
 /*
 Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
@@ -23,9 +26,12 @@ namespace vds {
   namespace  transaction_log {
     class sync_process {
     public:
+      //Records received after the node has been offline are verified by batches
+      static constexpr size_t MAX_VERIFY_BATCH_SIZE = 256;
+
       sync_process(
         const service_provider * sp)
-        : sp_(sp) {        
+        : sp_(sp), is_processing_(false), verify_statistic_{} {        
       }
 
       async_task<void> do_sync(        
@@ -49,6 +55,20 @@ namespace vds {
         const dht::messages::transaction_log_record & message,
         const dht::network::imessage_map::message_info_t & message_info);
 
+      //Queues the record, its signature is verified in parallel with other received records and it is applied later
+      void process_record(
+        const dht::messages::transaction_log_record & message,
+        const dht::network::imessage_map::message_info_t & message_info);
+
+      struct verify_statistic_t {
+        uint64_t batches;
+        uint64_t verified;
+        size_t max_batch_size;
+        uint64_t applied;
+      };
+
+      verify_statistic_t get_verify_statistic() const;
+
       async_task<void> on_new_session(
         
         database_read_transaction & t,
@@ -57,6 +77,24 @@ namespace vds {
     private:
       const service_provider * sp_;
 
+      struct pending_record_t {
+        std::shared_ptr<dht::messages::transaction_log_record> message;
+        dht::network::imessage_map::message_info_t message_info;
+      };
+
+      mutable std::mutex pending_mutex_;
+      std::list<pending_record_t> pending_records_;
+      bool is_processing_;
+      verify_statistic_t verify_statistic_;
+      transactions::transaction_block_verifier verifier_;
+
+      async_task<void> process_records();
+      async_task<void> verify_records(const std::list<pending_record_t> & records);
+
+      static std::shared_ptr<certificate> get_write_cert(
+        const database_read_transaction & t,
+        const transactions::transaction_block & block);
+
       async_task<void> query_unknown_records( database_transaction& t);
 
 
@@ -8,6 +8,7 @@
 #include "messages/dht_route_messages.h"
 #include "messages/sync_messages.h"
 #include "messages/transaction_log_messages.h"
+#include "../vds_log_sync/include/sync_process.h"
 
 #define route_client(message_type)\
   case dht::network::message_type_t::message_type: {\
@@ -56,15 +57,9 @@ vds::async_task<void> vds::_server::process_message(
     break;
   }
   case dht::network::message_type_t::transaction_log_record: {
-    co_await this->sp_->get<db_model>()->async_transaction([message_info, pthis = this->shared_from_this()](database_transaction & t) {
-      binary_deserializer s(message_info.message_data());
-      auto message = message_deserialize<dht::messages::transaction_log_record>(s);
-      (*pthis->sp_->get<server>())->apply_message(
-          t,
-          message,
-          message_info).get();
-      return true;
-    });
+    binary_deserializer s(message_info.message_data());
+    auto message = message_deserialize<dht::messages::transaction_log_record>(s);
+    this->transaction_log_sync_process_->process_record(message, message_info);
     break;
   }
 
@@ -175,6 +170,10 @@ vds::async_task<void> vds::_server::process_message(
     route_client(sync_replica_data)
     
     route_client(sync_replica_query_operations_request)
+    route_client(sync_message_batch)
+    route_client(sync_replica_map_digest)
+    route_client(sync_replica_map_entries)
+    route_client(sync_replica_piece_request)
 
     default:{
       throw std::runtime_error("Invalid command");
@@ -15,6 +15,11 @@ namespace vds {
     class sync_process;
   }
 
+  namespace transactions {
+    class transaction_log_notifier;
+    class transaction_log_dag;
+  }
+
   namespace dht {
     namespace network {
       class service;
@@ -89,6 +94,8 @@ namespace vds {
     std::unique_ptr<file_manager::file_manager_service> file_manager_;
     std::shared_ptr<dht::network::iudp_transport> udp_transport_;
     std::unique_ptr<dht::network::service> dht_network_service_;
+    std::unique_ptr<transactions::transaction_log_notifier> transaction_log_notifier_;
+    std::unique_ptr<transactions::transaction_log_dag> transaction_log_dag_;
 
     std::shared_ptr<transaction_log::sync_process> transaction_log_sync_process_;
   };
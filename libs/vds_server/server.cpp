@@ -20,6 +20,9 @@ All rights reserved
 #include "sync_state_dbo.h"
 #include "sync_member_dbo.h"
 #include "sync_replica_map_dbo.h"
+#include "transaction_log.h"
+#include "transaction_log_notifier.h"
+#include "transaction_log_dag.h"
 
 vds::server::server()
 : impl_(new _server(this))
@@ -35,6 +38,8 @@ void vds::server::register_services(service_registrator& registrator)
   registrator.add_service<server>(this);
   registrator.add_service<dht::network::imessage_map>(this->impl_.get());
   registrator.add_service<db_model>(this->impl_->db_model_.get());
+  registrator.add_service<transactions::transaction_log_notifier>(this->impl_->transaction_log_notifier_.get());
+  registrator.add_service<transactions::transaction_log_dag>(this->impl_->transaction_log_dag_.get());
 
   this->impl_->dht_network_service_->register_services(registrator);
   this->impl_->file_manager_->register_services(registrator);
@@ -70,6 +75,8 @@ vds::_server::_server(server * owner)
   file_manager_(new file_manager::file_manager_service()),
   udp_transport_(new dht::network::udp_transport()),
   dht_network_service_(new dht::network::service()),
+  transaction_log_notifier_(new transactions::transaction_log_notifier()),
+  transaction_log_dag_(new transactions::transaction_log_dag()),
   update_timer_("Log Sync") {
 }
 
@@ -80,7 +87,12 @@ vds::_server::~_server()
 void vds::_server::start(const service_provider* sp)
 {
   this->sp_ = sp;
+  this->transaction_log_notifier_->start(sp);
   this->db_model_->start(sp);
+  this->db_model_->async_transaction([sp](database_transaction & t) {
+    transactions::transaction_log::build_channel_index(sp, t);
+  }).get();
+
   this->transaction_log_sync_process_.reset(new transaction_log::sync_process(sp));
 
   this->update_timer_.start(sp, std::chrono::seconds(60), [sp, pthis = this->shared_from_this()]() -> async_task<bool>{
@@ -103,6 +115,7 @@ void vds::_server::stop()
 
   this->dht_network_service_->stop();
   this->udp_transport_->stop();
+  this->transaction_log_notifier_->stop();
   this->db_model_->stop();
   this->file_manager_.reset();
   this->db_model_.reset();
@@ -120,6 +133,13 @@ vds::async_task<vds::server_statistic> vds::_server::get_statistic() {
 
   this->sp_->get<dht::network::client>()->get_route_statistics(result->route_statistic_);
   this->sp_->get<dht::network::client>()->get_session_statistics(result->session_statistic_);
+  this->sp_->get<dht::network::client>()->get_scrub_statistics(result->scrub_statistic_);
+  this->sp_->get<dht::network::client>()->get_maintenance_statistics(result->maintenance_statistic_);
+  this->sp_->get<dht::network::client>()->get_repair_statistics(result->repair_statistic_);
+  this->sp_->get<dht::network::client>()->get_sync_message_statistics(result->sync_message_statistic_);
+  this->sp_->get<dht::network::client>()->get_anti_entropy_statistics(result->anti_entropy_statistic_);
+  this->sp_->get<dht::network::client>()->get_replica_source_statistics(result->replica_source_statistic_);
+  this->sp_->get<dht::network::memory_budget>()->get_statistic(result->memory_budget_statistic_);
 
   co_await this->sp_->get<db_model>()->async_read_transaction([this, result](database_read_transaction & t){
 
@@ -9,6 +9,13 @@ All rights reserved
 #include "route_statistic.h"
 #include "sync_statistic.h"
 #include "session_statistic.h"
+#include "scrub_statistic.h"
+#include "maintenance_statistic.h"
+#include "repair_statistic.h"
+#include "sync_message_statistic.h"
+#include "anti_entropy_statistic.h"
+#include "replica_source_statistic.h"
+#include "memory_budget_statistic.h"
 
 namespace vds {
 
@@ -17,12 +24,26 @@ namespace vds {
     sync_statistic sync_statistic_;
     route_statistic route_statistic_;
     session_statistic session_statistic_;
+    scrub_statistic scrub_statistic_;
+    maintenance_statistic maintenance_statistic_;
+    repair_statistic repair_statistic_;
+    sync_message_statistic sync_message_statistic_;
+    anti_entropy_statistic anti_entropy_statistic_;
+    replica_source_statistic replica_source_statistic_;
+    memory_budget_statistic memory_budget_statistic_;
     std::shared_ptr<vds::json_value> serialize() const {
       auto result = std::make_shared<vds::json_object>();
       result->add_property("db_queue_length", std::to_string(this->db_queue_length_));
       result->add_property("sync", this->sync_statistic_.serialize());
       result->add_property("route", this->route_statistic_.serialize());
       result->add_property("session", this->session_statistic_.serialize());
+      result->add_property("scrub", this->scrub_statistic_.serialize());
+      result->add_property("maintenance", this->maintenance_statistic_.serialize());
+      result->add_property("repair", this->repair_statistic_.serialize());
+      result->add_property("sync_messages", this->sync_message_statistic_.serialize());
+      result->add_property("anti_entropy", this->anti_entropy_statistic_.serialize());
+      result->add_property("replica_sources", this->replica_source_statistic_.serialize());
+      result->add_property("memory_budget", this->memory_budget_statistic_.serialize());
       return result;
     }
   };
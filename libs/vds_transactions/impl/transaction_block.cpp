@@ -7,6 +7,119 @@ All rights reserved
 #include "include/transaction_block.h"
 #include "transaction_log_record_dbo.h"
 #include "encoding.h"
+#include "deflate.h"
+#include "inflate.h"
+
+namespace {
+  //Compact format flags
+  enum compact_flags_t : uint8_t {
+    body_deflated = 1
+  };
+}
+
+vds::transactions::transaction_block::transaction_block(const const_data_buffer &data) {
+  const auto block_data = is_compact(data) ? unpack(data) : data;
+  this->id_ = hash::signature(hash::sha256(), block_data);
+
+  binary_deserializer s(block_data);
+  s
+    >> this->version_;
+
+  if(this->version_ != CURRENT_VERSION) {
+    throw std::runtime_error("Invalid block version");
+  }
+
+  uint64_t time_point;
+  s
+    >> time_point
+    >> this->order_no_
+    >> this->write_cert_id_
+    >> this->ancestors_
+    >> this->block_messages_
+    >> this->signature_;
+
+  this->time_point_ = std::chrono::system_clock::from_time_t(time_point);
+}
+
+vds::const_data_buffer vds::transactions::transaction_block::pack(const const_data_buffer &data) {
+  if (is_compact(data)) {
+    return data;
+  }
+
+  binary_deserializer s(data);
+
+  uint32_t version;
+  uint64_t time_point;
+  uint64_t order_no;
+  s >> version >> time_point >> order_no;
+  if (version != CURRENT_VERSION) {
+    throw std::runtime_error("Invalid block version");
+  }
+
+  //Body is write_cert_id, ancestors and messages as they are in the canonical form
+  const auto body_offset = data.size() - s.size();
+
+  std::string write_cert_id;
+  std::set<const_data_buffer> ancestors;
+  const_data_buffer block_messages;
+  s >> write_cert_id >> ancestors >> block_messages;
+
+  const auto body_size = data.size() - s.size() - body_offset;
+
+  const_data_buffer signature;
+  s >> signature;
+
+  //Repeated certificate and block ids are replaced by the deflate back references
+  uint8_t flags = 0;
+  auto body = deflate::compress(data.data() + body_offset, body_size);
+  if (body.size() < body_size) {
+    flags |= body_deflated;
+  }
+  else {
+    body = const_data_buffer(data.data() + body_offset, body_size);
+  }
+
+  binary_serializer result;
+  result << COMPACT_VERSION << flags;
+  result.write_number(time_point);
+  result.write_number(order_no);
+  result << body << signature;
+
+  return result.move_data();
+}
+
+vds::const_data_buffer vds::transactions::transaction_block::unpack(const const_data_buffer &data) {
+  if (!is_compact(data)) {
+    return data;
+  }
+
+  binary_deserializer s(data);
+
+  uint8_t version;
+  uint8_t flags;
+  s >> version >> flags;
+
+  const uint64_t time_point = s.read_number();
+  const uint64_t order_no = s.read_number();
+
+  const_data_buffer body;
+  const_data_buffer signature;
+  s >> body >> signature;
+
+  if (0 != (flags & body_deflated)) {
+    body = inflate::decompress(body.data(), body.size());
+  }
+
+  binary_serializer result;
+  result
+    << CURRENT_VERSION
+    << time_point
+    << order_no;
+  result.push_data(body.data(), body.size(), false);
+  result << signature;
+
+  return result.move_data();
+}
 
 bool vds::transactions::transaction_block::validate(const certificate& write_cert) {
   binary_serializer block_data;
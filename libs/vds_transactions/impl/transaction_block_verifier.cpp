@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "private/stdafx.h"
+#include <atomic>
+#include <thread>
+#include "include/transaction_block_verifier.h"
+#include "mt_service.h"
+
+vds::transactions::transaction_block_verifier::transaction_block_verifier(size_t max_cache_size)
+: max_cache_size_(max_cache_size) {
+}
+
+bool vds::transactions::transaction_block_verifier::verify(
+  transaction_block & block,
+  const certificate & write_cert) {
+
+  const auto key = cache_key(block, write_cert);
+  if (this->is_verified(key)) {
+    return true;
+  }
+
+  if (!block.validate(write_cert)) {
+    return false;
+  }
+
+  this->add_verified(key);
+  return true;
+}
+
+vds::async_task<std::vector<bool>> vds::transactions::transaction_block_verifier::verify_batch(
+  const service_provider * sp,
+  std::vector<request_t> batch) {
+
+  //std::vector<bool> is not safe to be written from several threads
+  auto results = std::make_shared<std::vector<uint8_t>>(batch.size(), 0);
+
+  if (!batch.empty()) {
+    const size_t worker_count = std::min<size_t>(
+      batch.size(),
+      std::max<size_t>(1, std::thread::hardware_concurrency()));
+
+    auto requests = std::make_shared<std::vector<request_t>>(std::move(batch));
+    auto remaining = std::make_shared<std::atomic<size_t>>(worker_count);
+    auto done = std::make_shared<async_result<void>>();
+
+    for (size_t worker = 0; worker < worker_count; ++worker) {
+      mt_service::async(sp, [this, worker, worker_count, requests, results, remaining, done]() {
+        for (size_t i = worker; i < requests->size(); i += worker_count) {
+          auto & request = (*requests)[i];
+          try {
+            (*results)[i] = (request.write_cert && this->verify(*request.block, *request.write_cert)) ? 1 : 0;
+          }
+          catch (...) {
+            (*results)[i] = 0;
+          }
+        }
+
+        if (0 == --(*remaining)) {
+          done->set_value();
+        }
+      });
+    }
+
+    co_await done->get_future();
+  }
+
+  co_return std::vector<bool>(results->begin(), results->end());
+}
+
+size_t vds::transactions::transaction_block_verifier::cache_size() const {
+  std::unique_lock<std::mutex> lock(this->cache_mutex_);
+  return this->cache_.size();
+}
+
+vds::const_data_buffer vds::transactions::transaction_block_verifier::cache_key(
+  const transaction_block & block,
+  const certificate & write_cert) {
+
+  //The block id is the hash of the block data including its signature
+  binary_serializer s;
+  s << block.id() << write_cert.fingerprint();
+  return s.move_data();
+}
+
+bool vds::transactions::transaction_block_verifier::is_verified(const const_data_buffer & key) {
+  std::unique_lock<std::mutex> lock(this->cache_mutex_);
+
+  auto p = this->cache_.find(key);
+  if (this->cache_.end() == p) {
+    return false;
+  }
+
+  this->cache_order_.splice(this->cache_order_.end(), this->cache_order_, p->second);
+  return true;
+}
+
+void vds::transactions::transaction_block_verifier::add_verified(const const_data_buffer & key) {
+  std::unique_lock<std::mutex> lock(this->cache_mutex_);
+
+  if (this->cache_.end() != this->cache_.find(key)) {
+    return;
+  }
+
+  this->cache_order_.push_back(key);
+  this->cache_.emplace(key, std::prev(this->cache_order_.end()));
+
+  while (this->cache_.size() > this->max_cache_size_) {
+    this->cache_.erase(this->cache_order_.front());
+    this->cache_order_.pop_front();
+  }
+}
@@ -18,9 +18,14 @@ All rights reserved
 #include "logger.h"
 #include "certificate_chain_dbo.h"
 #include "include/transaction_state_calculator.h"
+#include "include/transaction_log_notifier.h"
+#include "include/transaction_log_dag.h"
 #include "transaction_log_vote_request_dbo.h"
 #include "member_user_dbo.h"
 #include "transaction_log_balance_dbo.h"
+#include "channel_message_dbo.h"
+#include "file_catalog_dbo.h"
+#include "transaction_log_checkpoint_dbo.h"
 
 vds::const_data_buffer vds::transactions::transaction_log::save(
 	const service_provider * sp,
@@ -35,7 +40,7 @@ vds::const_data_buffer vds::transactions::transaction_log::save(
   t.execute(
     t1.insert(
       t1.id = block.id(),
-      t1.data = block_data,
+      t1.data = transaction_block::pack(block_data),
       t1.state = orm::transaction_log_record_dbo::state_t::validated,
       t1.new_member = false,
       t1.consensus = block.ancestors().empty(),
@@ -69,7 +74,19 @@ vds::const_data_buffer vds::transactions::transaction_log::save(
     ));
   }
 
-  process_block(sp, t, block_data);
+  transaction_log_dag local_dag;
+  auto dag = sp->get<transaction_log_dag>(false);
+  if (nullptr == dag) {
+    dag = &local_dag;
+  }
+
+  dag->add(t, block, orm::transaction_log_record_dbo::state_t::validated, block.ancestors().empty());
+  process_block(sp, t, *dag, block.id());
+
+  auto notifier = sp->get<transaction_log_notifier>(false);
+  if (nullptr != notifier) {
+    notifier->notify(sp);
+  }
 
   return block.id();
 }
@@ -77,20 +94,21 @@ vds::const_data_buffer vds::transactions::transaction_log::save(
 void vds::transactions::transaction_log::process_block(
   const service_provider* sp,
   database_transaction& t,
-  const const_data_buffer& block_data) {
-  transaction_block block(block_data);
+  transaction_log_dag & dag,
+  const const_data_buffer& block_id) {
+  const auto node = dag.get(t, block_id);
+  const auto & block = node->block;
   //Check user status
   orm::transaction_log_record_dbo t1;
   orm::member_user_dbo t5;
   auto st = t.get_reader(
-    t5.select(t1.consensus)
-    .inner_join(t1, t1.id == t5.log_id)
+    t5.select(t5.log_id)
     .where(t5.id == block.write_cert_id()));
   if(!st.execute()) {
     throw std::runtime_error("Invalid data");
   }
 
-  if(!t1.consensus.get(st)) {
+  if(!dag.get(t, t5.log_id.get(st))->consensus) {
     sp->get<logger>()->trace(
       ThisModule,
       "User %s is not in consensus. So ignore all actions from this user.",
@@ -100,22 +118,22 @@ void vds::transactions::transaction_log::process_block(
   }
 
   //Check ancestors
-  std::set<const_data_buffer> remove_leaf;
+  std::list<std::shared_ptr<transaction_log_dag::node_t>> remove_leaf;
   auto state = orm::transaction_log_record_dbo::state_t::leaf;
   for (const auto & ancestor : block.ancestors()) {
-    auto st = t.get_reader(t1.select(t1.state,t1.order_no,t1.time_point).where(t1.id == ancestor));
-    if (!st.execute()) {
+    const auto ancestor_node = dag.find(t, ancestor);
+    if (!ancestor_node) {
       return;
     }
     else {
-      if(t1.order_no.get(st) >= block.order_no() || t1.time_point.get(st) > block.time_point()) {
+      if(ancestor_node->block.order_no() >= block.order_no() || ancestor_node->block.time_point() > block.time_point()) {
         state = orm::transaction_log_record_dbo::state_t::invalid;
         vds_assert(false);
       }
       else {
-        switch (static_cast<orm::transaction_log_record_dbo::state_t>(t1.state.get(st))) {
+        switch (ancestor_node->state) {
         case orm::transaction_log_record_dbo::state_t::leaf: {
-          remove_leaf.emplace(ancestor);
+          remove_leaf.push_back(ancestor_node);
           break;
         }
 
@@ -143,46 +161,42 @@ void vds::transactions::transaction_log::process_block(
     state = orm::transaction_log_record_dbo::state_t::invalid;
   }
 
-  if(check_consensus(t, block.id())) {
+  //transaction_record_state::save has created the vote requests
+  dag.load_votes(t, *node);
+  if(node->is_votes_approved()) {
     t.execute(t1.update(t1.consensus = true).where(t1.id == block.id()));
+    node->consensus = true;
   }
 
 
-  update_consensus(sp, t, block_data);
+  update_consensus(sp, t, dag, node);
   t.execute(t1.update(t1.state = state).where(t1.id == block.id()));
+  node->state = state;
+
+  if (node->consensus && orm::transaction_log_record_dbo::state_t::leaf == state) {
+    save_checkpoint(t, *node);
+  }
 
   if (orm::transaction_log_record_dbo::state_t::leaf == state) {
+    index_channel_messages(t, block);
+
     for (const auto & p : remove_leaf) {
       t.execute(
         t1.update(
           t1.state = orm::transaction_log_record_dbo::state_t::processed)
-        .where(t1.id == p));
+        .where(t1.id == p->block.id()));
+      p->state = orm::transaction_log_record_dbo::state_t::processed;
     }
   }
 
   //process followers
-  std::set<const_data_buffer> followers;
-  orm::transaction_log_hierarchy_dbo t4;
-  st = t.get_reader(t4.select(t4.follower_id).where(t4.id == block.id()));
-  while (st.execute()) {
-    const auto follower_id = t4.follower_id.get(st);
-    if (follower_id) {
-      followers.emplace(follower_id);
-    }
-  }
-
+  const auto followers = node->followers;
   for (const auto &p : followers) {
-
-    st = t.get_reader(t1.select(t1.data).where(t1.id == p));
-    if (!st.execute()) {
-      throw std::runtime_error("Invalid data");
-    }
-
     if(state == orm::transaction_log_record_dbo::state_t::leaf) {
-      process_block(sp, t, t1.data.get(st));
+      process_block(sp, t, dag, p);
     }
     else {
-      invalid_block(sp, t, p);
+      invalid_block(sp, t, dag, p);
     }
   }
 }
@@ -190,82 +204,156 @@ void vds::transactions::transaction_log::process_block(
 void vds::transactions::transaction_log::update_consensus(
   const service_provider* sp,
   database_transaction& t,
-  const const_data_buffer& block_data) {
+  transaction_log_dag & dag,
+  const std::shared_ptr<transaction_log_dag::node_t> & leaf) {
   
-  auto leaf_owner = transaction_block(block_data).write_cert_id();
+  const auto & leaf_owner = leaf->block.write_cert_id();
 
-  std::map<const_data_buffer, const_data_buffer> not_processed;
-  std::map<const_data_buffer, const_data_buffer> processed;
+  std::map<const_data_buffer, std::shared_ptr<transaction_log_dag::node_t>> not_processed;
+  std::set<const_data_buffer> processed;
   std::set<const_data_buffer> consensus_candidate;
 
-  not_processed[transaction_block(block_data).id()] = block_data;
+  not_processed[leaf->block.id()] = leaf;
 
   while (!not_processed.empty()) {
     auto pbegin = not_processed.begin();
-    auto data = pbegin->second;
+    processed.emplace(pbegin->first);
+    const auto node = pbegin->second;
     not_processed.erase(pbegin);
 
-    transaction_block block(data);
+    const auto & block = node->block;
 
-    orm::transaction_log_record_dbo t1;
     for (const auto & ancestor : block.ancestors()) {
       if(processed.end() != processed.find(ancestor) || not_processed.end() != not_processed.find(ancestor)) {
         continue;
       }
 
-      auto st = t.get_reader(t1.select(t1.state, t1.data).where(t1.id == ancestor));
-      if (!st.execute()) {
-        throw std::runtime_error("Invalid data");
-      }
+      const auto ancestor_node = dag.get(t, ancestor);
 
-      auto ancestor_data = t1.data.get(st);
-
-      orm::transaction_log_vote_request_dbo t2;
-      t.execute(
-        t2.update(t2.approved = true)
-        .where(t2.id == ancestor && t2.owner == leaf_owner));
+      auto vote = ancestor_node->votes.find(leaf_owner);
+      if (ancestor_node->votes.end() != vote && !vote->second) {
+        orm::transaction_log_vote_request_dbo t2;
+        t.execute(
+          t2.update(t2.approved = true)
+          .where(t2.id == ancestor && t2.owner == leaf_owner));
+        vote->second = true;
+      }
 
-      if(check_consensus(t, ancestor)) {
+      if(ancestor_node->is_votes_approved()) {
         consensus_candidate.emplace(ancestor);
       }
 
       if(block.write_cert_id() != leaf_owner){
-        not_processed[ancestor] = ancestor_data;
+        not_processed[ancestor] = ancestor_node;
       }
     }
   }
   for(auto & candidate : consensus_candidate) {
-    make_consensus(sp, t, candidate);
+    make_consensus(sp, t, dag, candidate);
+  }
+}
+
+void vds::transactions::transaction_log::invalid_block(
+  const service_provider * sp,
+  class database_transaction &t,
+  const const_data_buffer & block_id) {
+
+  transaction_log_dag local_dag;
+  auto dag = sp->get<transaction_log_dag>(false);
+  if (nullptr == dag) {
+    dag = &local_dag;
   }
+
+  invalid_block(sp, t, *dag, block_id);
 }
 
 void vds::transactions::transaction_log::invalid_block(
   const service_provider * sp,
   class database_transaction &t,
+  transaction_log_dag & dag,
   const const_data_buffer & block_id) {
 
   orm::transaction_log_record_dbo t1;
   t.execute(t1.update(t1.state = orm::transaction_log_record_dbo::state_t::invalid).where(t1.id == block_id));
 
+  orm::channel_message_dbo t2;
+  t.execute(t2.delete_if(t2.block_id == block_id));
+
+  orm::file_catalog_dbo t3;
+  t.execute(t3.delete_if(t3.block_id == block_id));
+
+  orm::transaction_log_checkpoint_dbo t4;
+  t.execute(t4.delete_if(t4.id == block_id));
+
   std::set<const_data_buffer> followers;
-  orm::transaction_log_hierarchy_dbo t4;
-  auto st = t.get_reader(t4.select(t4.follower_id).where(t4.id == block_id));
-  while (st.execute()) {
-    const auto follower_id = t4.follower_id.get(st);
-    if (follower_id) {
-      followers.emplace(follower_id);
-    }
+  const auto node = dag.find(t, block_id);
+  if (node) {
+    node->state = orm::transaction_log_record_dbo::state_t::invalid;
+    followers = node->followers;
+  }
+  else {
+    followers = dag.followers(t, block_id);
   }
 
   for (const auto &p : followers) {
+    invalid_block(sp, t, dag, p);
+  }
+}
 
-    st = t.get_reader(t1.select(t1.data).where(t1.id == p));
-    if (!st.execute()) {
-      throw std::runtime_error("Invalid data");
-    }
+void vds::transactions::transaction_log::index_channel_messages(
+  database_transaction& t,
+  const transaction_block& block) {
 
-    invalid_block(sp, t, p);
+  orm::channel_message_dbo t1;
+  int message_index = 0;
+  block.walk_messages(
+    [&t, &t1, &block, &message_index](const channel_message & message)->bool {
+    t.execute(
+      t1.insert_or_ignore(
+        t1.block_id = block.id(),
+        t1.message_index = message_index++,
+        t1.channel_id = message.channel_id(),
+        t1.order_no = block.order_no(),
+        t1.read_cert_subject = message.channel_read_cert_subject(),
+        t1.crypted_key = message.crypted_key(),
+        t1.crypted_data = message.crypted_data()));
+    return true;
+  });
+}
+
+void vds::transactions::transaction_log::build_channel_index(
+  const service_provider* sp,
+  database_transaction& t) {
+
+  auto st = t.parse("SELECT version FROM module WHERE id='channel_message'");
+  if (!st.execute()) {
+    throw std::runtime_error("Database has been corrupted");
+  }
+
+  int64_t version;
+  st.get_value(0, version);
+  if (0 != version) {
+    return;
   }
+
+  sp->get<logger>()->info(ThisModule, "Build channel message index");
+
+  std::list<const_data_buffer> blocks;
+  orm::transaction_log_record_dbo t1;
+  auto reader = t.get_reader(
+    t1.select(t1.data)
+    .where(
+      t1.state == orm::transaction_log_record_dbo::state_t::processed
+      || t1.state == orm::transaction_log_record_dbo::state_t::leaf));
+  while (reader.execute()) {
+    blocks.push_back(t1.data.get(reader));
+  }
+
+  for (const auto & data : blocks) {
+    index_channel_messages(t, transaction_block(data));
+  }
+
+  t.execute("UPDATE module SET version=1 WHERE id='channel_message'");
 }
 
 void vds::transactions::transaction_log::invalid_become_consensus(const service_provider* sp,
@@ -282,7 +370,10 @@ void vds::transactions::transaction_log::invalid_become_consensus(const service_
   //}
 }
 
-void vds::transactions::transaction_log::make_consensus(const service_provider* sp, database_transaction& t,
+void vds::transactions::transaction_log::make_consensus(
+  const service_provider* sp,
+  database_transaction& t,
+  transaction_log_dag & dag,
   const const_data_buffer& start_log_id) {
 
   std::set<const_data_buffer> not_processed;
@@ -294,29 +385,15 @@ void vds::transactions::transaction_log::make_consensus(const service_provider*
     not_processed.erase(not_processed.begin());
     processed.emplace(log_id);
 
-
-    orm::transaction_log_record_dbo t1;
-    auto st = t.get_reader(t1.select(t1.state, t1.data, t1.consensus).where(t1.id == log_id));
-    if (!st.execute()) {
-      throw std::runtime_error("Invalid data");
-    }
-
-    if (t1.consensus.get(st)) {
+    const auto node = dag.get(t, log_id);
+    if (node->consensus) {
       continue;
     }
 
-    auto state = t1.state.get(st);
-
     //check all ancestors in consensus
     auto all_ancestors_in_consensus = true;
-    transaction_block block(t1.data.get(st));
-
-    for (const auto & ancestor : block.ancestors()) {
-      st = t.get_reader(t1.select(t1.consensus).where(t1.id == ancestor));
-      if (!st.execute()) {
-        throw std::runtime_error("Invalid data");
-      }
-      if (!t1.consensus.get(st)) {
+    for (const auto & ancestor : node->block.ancestors()) {
+      if (!dag.get(t, ancestor)->consensus) {
         all_ancestors_in_consensus = false;
         break;
       }
@@ -326,30 +403,25 @@ void vds::transactions::transaction_log::make_consensus(const service_provider*
       continue;
     }
 
+    orm::transaction_log_record_dbo t1;
     t.execute(
       t1.update(
         t1.consensus = true)
       .where(t1.id == log_id));
+    node->consensus = true;
 
-    switch (state) {
+    switch (node->state) {
     case orm::transaction_log_record_dbo::state_t::invalid:
       invalid_become_consensus(sp, t, log_id);
       break;
 
     case orm::transaction_log_record_dbo::state_t::processed: {
-      std::set<const_data_buffer> followers;
-      orm::transaction_log_hierarchy_dbo t3;
-      st = t.get_reader(t3.select(t3.follower_id).where(t3.id == log_id));
-      while(st.execute()) {
-        auto follower_id = t3.follower_id.get(st);
-        if(not_processed.end() == not_processed.find(follower_id)
-          && processed.end() == processed.find(follower_id)) {
-          followers.emplace(follower_id);
-        }
-      }
+      save_checkpoint(t, *node);
 
-      for(const auto & follower_id : followers) {
-        if (check_consensus(t, follower_id)) {
+      for(const auto & follower_id : node->followers) {
+        if(not_processed.end() == not_processed.find(follower_id)
+          && processed.end() == processed.find(follower_id)
+          && dag.get(t, follower_id)->is_votes_approved()) {
           not_processed.emplace(follower_id);
         }
       }
@@ -358,6 +430,7 @@ void vds::transactions::transaction_log::make_consensus(const service_provider*
     }
 
     case orm::transaction_log_record_dbo::state_t::leaf: {
+      save_checkpoint(t, *node);
       break;
     }
 
@@ -367,6 +440,18 @@ void vds::transactions::transaction_log::make_consensus(const service_provider*
   }
 }
 
+void vds::transactions::transaction_log::save_checkpoint(
+  database_transaction& t,
+  const transaction_log_dag::node_t & node) {
+
+  const auto & block = node.block;
+  if (!transaction_record_state::is_checkpoint_required(t, block.order_no())) {
+    return;
+  }
+
+  transaction_record_state::load(t, block.id()).save_checkpoint(t, block.id(), block.order_no());
+}
+
 bool vds::transactions::transaction_log::check_consensus(
   database_read_transaction& t,
   const const_data_buffer & log_id) {
@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "private/stdafx.h"
+#include "include/transaction_log_dag.h"
+#include "transaction_log_hierarchy_dbo.h"
+#include "transaction_log_vote_request_dbo.h"
+
+bool vds::transactions::transaction_log_dag::node_t::is_votes_approved() const {
+  size_t approved_count = 0;
+  for (const auto & vote : this->votes) {
+    if (vote.second) {
+      ++approved_count;
+    }
+  }
+
+  return (approved_count > this->votes.size() / 2);
+}
+
+vds::transactions::transaction_log_dag::transaction_log_dag(size_t max_size)
+: max_size_(max_size),
+  rollback_count_(0) {
+}
+
+std::shared_ptr<vds::transactions::transaction_log_dag::node_t>
+vds::transactions::transaction_log_dag::find(
+  const database_read_transaction & t,
+  const const_data_buffer & id) {
+
+  this->check_rollback(t);
+
+  auto p = this->nodes_.find(id);
+  if (this->nodes_.end() != p) {
+    this->order_.splice(this->order_.end(), this->order_, p->second.order);
+    return p->second.node;
+  }
+
+  orm::transaction_log_record_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.data, t1.state, t1.consensus)
+    .where(t1.id == id));
+  if (!st.execute()) {
+    return std::shared_ptr<node_t>();
+  }
+
+  auto node = std::make_shared<node_t>(transaction_block(t1.data.get(st)));
+  node->state = t1.state.get(st);
+  node->consensus = t1.consensus.get(st);
+
+  load_followers(t, node->block.id(), node->followers);
+  this->load_votes(t, *node);
+  this->put(node);
+
+  return node;
+}
+
+std::shared_ptr<vds::transactions::transaction_log_dag::node_t>
+vds::transactions::transaction_log_dag::get(
+  const database_read_transaction & t,
+  const const_data_buffer & id) {
+
+  auto result = this->find(t, id);
+  if (!result) {
+    throw std::runtime_error("Invalid data");
+  }
+
+  return result;
+}
+
+std::shared_ptr<vds::transactions::transaction_log_dag::node_t>
+vds::transactions::transaction_log_dag::add(
+  const database_read_transaction & t,
+  const transaction_block & block,
+  orm::transaction_log_record_dbo::state_t state,
+  bool consensus) {
+
+  this->check_rollback(t);
+
+  auto node = std::make_shared<node_t>(block);
+  node->state = state;
+  node->consensus = consensus;
+
+  //Followers could be received before this block
+  load_followers(t, node->block.id(), node->followers);
+  this->put(node);
+
+  for (const auto & ancestor : block.ancestors()) {
+    this->add_follower(ancestor, block.id());
+  }
+
+  return node;
+}
+
+void vds::transactions::transaction_log_dag::add_follower(
+  const const_data_buffer & id,
+  const const_data_buffer & follower_id) {
+
+  auto p = this->nodes_.find(id);
+  if (this->nodes_.end() != p) {
+    p->second.node->followers.emplace(follower_id);
+  }
+}
+
+std::set<vds::const_data_buffer> vds::transactions::transaction_log_dag::followers(
+  const database_read_transaction & t,
+  const const_data_buffer & id) {
+
+  auto node = this->find(t, id);
+  if (node) {
+    return node->followers;
+  }
+
+  std::set<const_data_buffer> result;
+  load_followers(t, id, result);
+  return result;
+}
+
+void vds::transactions::transaction_log_dag::load_votes(
+  const database_read_transaction & t,
+  node_t & node) {
+
+  node.votes.clear();
+
+  orm::transaction_log_vote_request_dbo t1;
+  auto st = t.get_reader(t1.select(t1.owner, t1.approved).where(t1.id == node.block.id()));
+  while (st.execute()) {
+    node.votes[t1.owner.get(st)] = t1.approved.get(st);
+  }
+}
+
+void vds::transactions::transaction_log_dag::clear() {
+  this->nodes_.clear();
+  this->order_.clear();
+}
+
+size_t vds::transactions::transaction_log_dag::size() const {
+  return this->nodes_.size();
+}
+
+void vds::transactions::transaction_log_dag::check_rollback(const database_read_transaction & t) {
+  const auto rollback_count = t.rollback_count();
+  if (this->rollback_count_ != rollback_count) {
+    this->rollback_count_ = rollback_count;
+    this->clear();
+  }
+}
+
+void vds::transactions::transaction_log_dag::put(const std::shared_ptr<node_t> & node) {
+  auto p = this->nodes_.find(node->block.id());
+  if (this->nodes_.end() != p) {
+    this->order_.splice(this->order_.end(), this->order_, p->second.order);
+    p->second.node = node;
+    return;
+  }
+
+  this->order_.push_back(node->block.id());
+  this->nodes_.emplace(node->block.id(), entry_t{ node, std::prev(this->order_.end()) });
+
+  while (this->nodes_.size() > this->max_size_) {
+    this->nodes_.erase(this->order_.front());
+    this->order_.pop_front();
+  }
+}
+
+void vds::transactions::transaction_log_dag::load_followers(
+  const database_read_transaction & t,
+  const const_data_buffer & id,
+  std::set<const_data_buffer> & followers) {
+
+  orm::transaction_log_hierarchy_dbo t1;
+  auto st = t.get_reader(t1.select(t1.follower_id).where(t1.id == id));
+  while (st.execute()) {
+    const auto follower_id = t1.follower_id.get(st);
+    if (follower_id) {
+      followers.emplace(follower_id);
+    }
+  }
+}
@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "private/stdafx.h"
+#include "include/transaction_log_notifier.h"
+#include "mt_service.h"
+#include "shutdown_event.h"
+
+vds::transactions::transaction_log_notifier::transaction_log_notifier()
+: sp_(nullptr),
+  generation_(0),
+  timeout_timer_("Transaction Log Wait") {
+}
+
+void vds::transactions::transaction_log_notifier::start(const service_provider * sp) {
+  this->sp_ = sp;
+  this->timeout_timer_.start(sp, std::chrono::seconds(1), [sp, this]() -> async_task<bool> {
+    const auto is_shuting_down = sp->get_shutdown_event().is_shuting_down();
+    this->check_timeouts(is_shuting_down);
+    co_return !is_shuting_down;
+  });
+}
+
+void vds::transactions::transaction_log_notifier::stop() {
+  this->check_timeouts(true);
+}
+
+uint64_t vds::transactions::transaction_log_notifier::generation() const {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  return this->generation_;
+}
+
+void vds::transactions::transaction_log_notifier::notify(const service_provider * sp) {
+  std::list<waiter_t> waiters;
+
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  ++this->generation_;
+  waiters.swap(this->waiters_);
+  lock.unlock();
+
+  //Waiters start new transactions so do not run them on the database thread
+  if (!waiters.empty()) {
+    mt_service::async(sp, [waiters]() {
+      for (const auto & waiter : waiters) {
+        waiter.result->set_value(true);
+      }
+    });
+  }
+}
+
+vds::async_task<bool> vds::transactions::transaction_log_notifier::wait(
+  uint64_t generation,
+  const std::chrono::steady_clock::duration & timeout) {
+
+  auto result = std::make_shared<async_result<bool>>();
+
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  if (this->generation_ != generation) {
+    result->set_value(true);
+  }
+  else {
+    this->waiters_.push_back(waiter_t{ result, std::chrono::steady_clock::now() + timeout });
+  }
+
+  return result->get_future();
+}
+
+void vds::transactions::transaction_log_notifier::check_timeouts(bool is_shuting_down) {
+  std::list<waiter_t> expired;
+
+  const auto now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  for (auto p = this->waiters_.begin(); p != this->waiters_.end();) {
+    if (is_shuting_down || p->deadline <= now) {
+      expired.push_back(*p);
+      p = this->waiters_.erase(p);
+    }
+    else {
+      ++p;
+    }
+  }
+  lock.unlock();
+
+  for (const auto & waiter : expired) {
+    waiter.result->set_value(false);
+  }
+}
@@ -12,6 +12,7 @@ All rights reserved
 #include "transaction_log_record_dbo.h"
 #include "transaction_log_hierarchy_dbo.h"
 #include "transaction_log_balance_dbo.h"
+#include "transaction_log_checkpoint_dbo.h"
 
 vds::transactions::transaction_record_state vds::transactions::transaction_record_state::load(
   database_read_transaction& t, const const_data_buffer& log_id) {
@@ -53,15 +54,6 @@ void vds::transactions::transaction_record_state::save(
   const const_data_buffer& log_id) const {
   bool is_new_user = true;
   for (const auto & account : this->account_state_) {
-    for (const auto & account_state : account.second.balance_) {
-      orm::transaction_log_balance_dbo t1;
-      t.execute(t1.insert(
-        t1.id = log_id,
-        t1.owner = account.first,
-        t1.source = account_state.first,
-        t1.balance = account_state.second));
-    }
-
     if (account.second.approve_required) {
       orm::transaction_log_vote_request_dbo t2;
       t.execute(t2.insert(
@@ -79,6 +71,81 @@ void vds::transactions::transaction_record_state::save(
   }
 }
 
+bool vds::transactions::transaction_record_state::is_checkpoint_required(
+  database_read_transaction& t,
+  uint64_t order_no) {
+
+  orm::transaction_log_checkpoint_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.order_no)
+    .order_by(db_desc_order(t1.order_no)));
+  if (!st.execute()) {
+    //The first final block is the base of all states
+    return true;
+  }
+
+  return (static_cast<uint64_t>(t1.order_no.get(st)) + CHECKPOINT_INTERVAL <= order_no);
+}
+
+void vds::transactions::transaction_record_state::save_checkpoint(
+  database_transaction& t,
+  const const_data_buffer& log_id,
+  uint64_t order_no) const {
+
+  orm::transaction_log_checkpoint_dbo t1;
+  t.execute(t1.insert(
+    t1.id = log_id,
+    t1.order_no = static_cast<int64_t>(order_no),
+    t1.state_data = this->serialize()));
+}
+
+vds::const_data_buffer vds::transactions::transaction_record_state::serialize() const {
+  std::list<std::map<std::string, account_state_t>::const_iterator> accounts;
+  for (auto p = this->account_state_.begin(); p != this->account_state_.end(); ++p) {
+    if (p->second.approve_required || !p->second.balance_.empty()) {
+      accounts.push_back(p);
+    }
+  }
+
+  binary_serializer s;
+  s.write_number(accounts.size());
+  for (const auto & p : accounts) {
+    s << p->first << p->second.approve_required;
+    s.write_number(p->second.balance_.size());
+    for (const auto & balance : p->second.balance_) {
+      s << balance.first << static_cast<uint64_t>(balance.second);
+    }
+  }
+
+  return s.move_data();
+}
+
+vds::transactions::transaction_record_state vds::transactions::transaction_record_state::deserialize(
+  const const_data_buffer& data) {
+
+  transaction_record_state result;
+
+  binary_deserializer s(data);
+  auto account_count = s.read_number();
+  while (0 < account_count--) {
+    std::string account;
+    s >> account;
+
+    auto & account_state = result.account_state_[account];
+    s >> account_state.approve_required;
+
+    auto balance_count = s.read_number();
+    while (0 < balance_count--) {
+      const_data_buffer source;
+      uint64_t balance;
+      s >> source >> balance;
+      account_state.balance_[source] = static_cast<int64_t>(balance);
+    }
+  }
+
+  return result;
+}
+
 void vds::transactions::transaction_record_state::apply(
   const transaction_block & block) {
 
@@ -147,61 +214,57 @@ vds::transactions::transaction_record_state vds::transactions::transaction_recor
   vds_assert(!this->items_.empty());
   vds_assert(!this->items_.rbegin()->second.empty());
 
-  //looking for leaf
-  std::set<const_data_buffer/*log_id*/> not_processed;
+  //looking for the nearest ancestor with the saved state
+  std::map<uint64_t/*order_no*/, std::set<const_data_buffer/*log_id*/>> not_processed;
   std::set<const_data_buffer/*log_id*/> processed;
 
-  not_processed.emplace(this->items_.rbegin()->second.begin()->first);
+  not_processed[this->items_.rbegin()->first].emplace(this->items_.rbegin()->second.begin()->first);
 
   transaction_record_state result;
   bool state_loaded = false;
 
   while (!not_processed.empty()) {
-    auto p = *not_processed.begin();
-    not_processed.erase(p);
+    auto porder = std::prev(not_processed.end());
+    const auto order_no = porder->first;
+    const auto p = *porder->second.begin();
+    porder->second.erase(porder->second.begin());
+    if (porder->second.empty()) {
+      not_processed.erase(porder);
+    }
     processed.emplace(p);
 
     orm::transaction_log_record_dbo t2;
     auto st = t.get_reader(
-      t2.select(t2.state, t2.order_no,t2.new_member,t2.data)
+      t2.select(t2.state, t2.new_member, t2.data)
       .where(t2.id == p));
 
     if (!st.execute()) {
       throw std::runtime_error("Invalid data");
     }
 
+    const transaction_block block(t2.data.get(st));
     if (orm::transaction_log_record_dbo::have_state(t2.state.get(st))) {
-      if(t2.new_member.get(st)) {
-        result.account_state_[transaction_block(t2.data.get(st)).write_cert_id()].approve_required = true;
-      }
-      this->set_state(t2.order_no.get(st), p, log_state_t::exclude);
-      orm::transaction_log_vote_request_dbo t3;
-      st = t.get_reader(t3.select(t3.owner, t3.approved).where(t3.id == p));
-      while(st.execute()) {
-        result.account_state_[t3.owner.get(st)].approve_required = true;
-      }
-
-      orm::transaction_log_balance_dbo t4;
-      st = t.get_reader(t4.select(t4.owner, t4.source, t4.balance).where(t4.id == p));
-      while (st.execute()) {
-        result.account_state_[t4.owner.get(st)].balance_[t4.source.get(st)] = t4.balance.get(st);
+      if (load_checkpoint(t, p, result) || load_balance(t, p, block, t2.new_member.get(st), result)) {
+        //The state is after the block, so the block and its ancestors are applied already
+        this->set_state(order_no, p, log_state_t::included);
+        state_loaded = true;
+        break;
       }
-
-      state_loaded = true;
-      break;
     }
 
-    orm::transaction_log_hierarchy_dbo t1;
-    st = t.get_reader(
-      t1.select(t1.follower_id)
-      .where(t1.id == p));
+    for (const auto & ancestor : block.ancestors()) {
+      if (processed.end() != processed.find(ancestor)) {
+        continue;
+      }
 
-    while (st.execute()) {
-      auto follower = t1.follower_id.get(st);
-      if (not_processed.end() == not_processed.find(follower)
-        && processed.end() == processed.find(follower)) {
-        not_processed.emplace(follower);
+      st = t.get_reader(
+        t2.select(t2.order_no)
+        .where(t2.id == ancestor));
+      if (!st.execute()) {
+        throw std::runtime_error("Invalid data");
       }
+
+      not_processed[t2.order_no.get(st)].emplace(ancestor);
     }
   }
 
@@ -210,6 +273,51 @@ vds::transactions::transaction_record_state vds::transactions::transaction_recor
   return result;
 }
 
+bool vds::transactions::transaction_record_state::transaction_state_calculator::load_checkpoint(
+  vds::database_read_transaction& t,
+  const const_data_buffer& log_id,
+  transaction_record_state& result) {
+
+  orm::transaction_log_checkpoint_dbo t1;
+  auto st = t.get_reader(t1.select(t1.state_data).where(t1.id == log_id));
+  if (!st.execute()) {
+    return false;
+  }
+
+  result = deserialize(t1.state_data.get(st));
+  return true;
+}
+
+bool vds::transactions::transaction_record_state::transaction_state_calculator::load_balance(
+  vds::database_read_transaction& t,
+  const const_data_buffer& log_id,
+  const transaction_block & block,
+  bool is_new_member,
+  transaction_record_state& result) {
+
+  orm::transaction_log_balance_dbo t4;
+  auto st = t.get_reader(t4.select(t4.owner, t4.source, t4.balance).where(t4.id == log_id));
+  if (!st.execute()) {
+    return false;
+  }
+
+  do {
+    result.account_state_[t4.owner.get(st)].balance_[t4.source.get(st)] = t4.balance.get(st);
+  } while (st.execute());
+
+  if (is_new_member) {
+    result.account_state_[block.write_cert_id()].approve_required = true;
+  }
+
+  orm::transaction_log_vote_request_dbo t3;
+  st = t.get_reader(t3.select(t3.owner, t3.approved).where(t3.id == log_id));
+  while (st.execute()) {
+    result.account_state_[t3.owner.get(st)].approve_required = true;
+  }
+
+  return true;
+}
+
 vds::transactions::transaction_record_state vds::transactions::transaction_record_state::transaction_state_calculator::load(
   vds::database_read_transaction& t) {
 
@@ -22,26 +22,22 @@ namespace vds {
        */
       static constexpr uint32_t CURRENT_VERSION = 0x31564453U;//1VDS
 
-      transaction_block(const const_data_buffer &data)
-      : id_(hash::signature(hash::sha256(), data)){
-        binary_deserializer s(data);
-        s
-          >> this->version_;
-
-        if(this->version_ != CURRENT_VERSION) {
-          throw std::runtime_error("Invalid block version");
-        }
-
-        uint64_t time_point;
-        s
-          >> time_point
-          >> this->order_no_
-          >> this->write_cert_id_
-          >> this->ancestors_
-          >> this->block_messages_
-          >> this->signature_;
-
-        this->time_point_ = std::chrono::system_clock::from_time_t(time_point);
+      /**
+       * \brief Compact storage and transfer format marker
+       */
+      static constexpr uint8_t COMPACT_VERSION = 0xC1U;
+
+      //Accepts both canonical and compact encoded block
+      transaction_block(const const_data_buffer &data);
+
+      //Compact encoding: varint header fields and deflated body, the signature is kept as is
+      static const_data_buffer pack(const const_data_buffer &data);
+
+      //Restores canonical bytes which the block id and the signature are calculated from
+      static const_data_buffer unpack(const const_data_buffer &data);
+
+      static bool is_compact(const const_data_buffer &data) {
+        return 0 < data.size() && COMPACT_VERSION == data[0];
       }
 
       const uint32_t & version() const {
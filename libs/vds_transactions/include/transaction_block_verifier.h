@@ -0,0 +1,62 @@
+#ifndef __VDS_TRANSACTIONS_TRANSACTION_BLOCK_VERIFIER_H_
+#define __VDS_TRANSACTIONS_TRANSACTION_BLOCK_VERIFIER_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "async_task.h"
+#include "service_provider.h"
+#include "transaction_block.h"
+
+namespace vds {
+  namespace transactions {
+    /**
+     * \brief Verifies signatures of the transaction blocks and remembers
+     * the successfully verified (block, certificate) pairs.
+     */
+    class transaction_block_verifier {
+    public:
+      static constexpr size_t MAX_CACHE_SIZE = 10000;
+
+      struct request_t {
+        std::shared_ptr<transaction_block> block;
+        std::shared_ptr<certificate> write_cert;
+      };
+
+      transaction_block_verifier(size_t max_cache_size = MAX_CACHE_SIZE);
+
+      bool verify(
+        transaction_block & block,
+        const certificate & write_cert);
+
+      //Verifies the batch on the mt_service pool, result[i] is the result of batch[i]
+      async_task<std::vector<bool>> verify_batch(
+        const service_provider * sp,
+        std::vector<request_t> batch);
+
+      size_t cache_size() const;
+
+    private:
+      size_t max_cache_size_;
+
+      mutable std::mutex cache_mutex_;
+      std::map<const_data_buffer, std::list<const_data_buffer>::iterator> cache_;
+      std::list<const_data_buffer> cache_order_;
+
+      static const_data_buffer cache_key(
+        const transaction_block & block,
+        const certificate & write_cert);
+
+      bool is_verified(const const_data_buffer & key);
+      void add_verified(const const_data_buffer & key);
+    };
+  }
+}
+
+#endif //__VDS_TRANSACTIONS_TRANSACTION_BLOCK_VERIFIER_H_
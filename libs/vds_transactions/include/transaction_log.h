@@ -8,6 +8,7 @@ All rights reserved
 
 #include "const_data_buffer.h"
 #include "user_manager_transactions.h"
+#include "transaction_log_dag.h"
 
 namespace vds {
   namespace transactions {
@@ -30,11 +31,27 @@ namespace vds {
         class database_transaction &t,
         const const_data_buffer & block_id);
 
+      //Index channel messages of the blocks saved before the channel_message table was introduced
+      static void build_channel_index(
+        const service_provider * sp,
+        class database_transaction &t);
+
     private:
+      static void index_channel_messages(
+        class database_transaction &t,
+        const transaction_block & block);
+
       static void process_block(
         const service_provider * sp,
         class database_transaction &t,
-        const const_data_buffer & block_data);
+        transaction_log_dag & dag,
+        const const_data_buffer & block_id);
+
+      static void invalid_block(
+        const service_provider * sp,
+        class database_transaction &t,
+        transaction_log_dag & dag,
+        const const_data_buffer & block_id);
 
       static void invalid_become_consensus(
         const service_provider* sp,
@@ -44,11 +61,18 @@ namespace vds {
       static void make_consensus(
         const service_provider * sp,
         class database_transaction &t,
+        transaction_log_dag & dag,
         const const_data_buffer & log_id);
       static void update_consensus(
         const service_provider * sp,
         class database_transaction &t,
-        const const_data_buffer & block_data);
+        transaction_log_dag & dag,
+        const std::shared_ptr<transaction_log_dag::node_t> & leaf);
+
+      //The block has become final, so its state will not be rolled back
+      static void save_checkpoint(
+        class database_transaction &t,
+        const transaction_log_dag::node_t & node);
     };
   }
 }
@@ -0,0 +1,104 @@
+#ifndef __VDS_TRANSACTIONS_TRANSACTION_LOG_DAG_H_
+#define __VDS_TRANSACTIONS_TRANSACTION_LOG_DAG_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include <map>
+#include <set>
+#include <memory>
+#include "const_data_buffer.h"
+#include "transaction_block.h"
+#include "transaction_log_record_dbo.h"
+
+namespace vds {
+  class database_read_transaction;
+
+  namespace transactions {
+    /**
+     * \brief Size-bounded cache of the parsed transaction log blocks with their followers,
+     * state, consensus flag and votes. Changes are written to the tables by transaction_log
+     * and mirrored here, so the consensus is calculated by the graph walk without queries.
+     * Used on the database thread only.
+     */
+    class transaction_log_dag {
+    public:
+      static constexpr size_t MAX_CACHE_SIZE = 10000;
+
+      struct node_t {
+        node_t(const transaction_block & block)
+        : block(block) {
+        }
+
+        transaction_block block;
+        orm::transaction_log_record_dbo::state_t state;
+        bool consensus;
+        std::set<const_data_buffer> followers;
+
+        //owner -> approved
+        std::map<std::string, bool> votes;
+
+        bool is_votes_approved() const;
+      };
+
+      transaction_log_dag(size_t max_size = MAX_CACHE_SIZE);
+
+      //Returns nullptr if the block is not in the transaction log
+      std::shared_ptr<node_t> find(
+        const database_read_transaction & t,
+        const const_data_buffer & id);
+
+      std::shared_ptr<node_t> get(
+        const database_read_transaction & t,
+        const const_data_buffer & id);
+
+      //The new block has been saved to transaction_log_record
+      std::shared_ptr<node_t> add(
+        const database_read_transaction & t,
+        const transaction_block & block,
+        orm::transaction_log_record_dbo::state_t state,
+        bool consensus);
+
+      void add_follower(
+        const const_data_buffer & id,
+        const const_data_buffer & follower_id);
+
+      //Followers are known even for the blocks which have not been received yet
+      std::set<const_data_buffer> followers(
+        const database_read_transaction & t,
+        const const_data_buffer & id);
+
+      //Votes have been changed in transaction_log_vote_request
+      void load_votes(
+        const database_read_transaction & t,
+        node_t & node);
+
+      void clear();
+      size_t size() const;
+
+    private:
+      size_t max_size_;
+      uint64_t rollback_count_;
+
+      struct entry_t {
+        std::shared_ptr<node_t> node;
+        std::list<const_data_buffer>::iterator order;
+      };
+
+      std::map<const_data_buffer, entry_t> nodes_;
+      std::list<const_data_buffer> order_;
+
+      void check_rollback(const database_read_transaction & t);
+      void put(const std::shared_ptr<node_t> & node);
+      static void load_followers(
+        const database_read_transaction & t,
+        const const_data_buffer & id,
+        std::set<const_data_buffer> & followers);
+    };
+  }
+}
+
+#endif //__VDS_TRANSACTIONS_TRANSACTION_LOG_DAG_H_
@@ -0,0 +1,56 @@
+#ifndef __VDS_TRANSACTIONS_TRANSACTION_LOG_NOTIFIER_H_
+#define __VDS_TRANSACTIONS_TRANSACTION_LOG_NOTIFIER_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <list>
+#include <mutex>
+#include "async_task.h"
+#include "service_provider.h"
+#include "task_manager.h"
+
+namespace vds {
+  namespace transactions {
+    /**
+     * \brief Tells the readers of the transaction log that new blocks have been saved.
+     * The generation grows with every saved block.
+     */
+    class transaction_log_notifier {
+    public:
+      transaction_log_notifier();
+
+      //Starts the timeout checks
+      void start(const service_provider * sp);
+      void stop();
+
+      uint64_t generation() const;
+
+      //Called by transaction_log inside the database transaction which saves the block
+      void notify(const service_provider * sp);
+
+      //Returns true when the generation is different from the given one or false after the timeout
+      async_task<bool> wait(
+        uint64_t generation,
+        const std::chrono::steady_clock::duration & timeout);
+
+    private:
+      struct waiter_t {
+        std::shared_ptr<async_result<bool>> result;
+        std::chrono::steady_clock::time_point deadline;
+      };
+
+      const service_provider * sp_;
+      mutable std::mutex mutex_;
+      uint64_t generation_;
+      std::list<waiter_t> waiters_;
+      timer timeout_timer_;
+
+      void check_timeouts(bool is_shuting_down);
+    };
+  }
+}
+
+#endif //__VDS_TRANSACTIONS_TRANSACTION_LOG_NOTIFIER_H_
@@ -19,6 +19,9 @@ namespace vds {
 
     class transaction_record_state {
     public:
+      //The state is stored for final blocks at least the interval apart,
+      //so loading replays blocks after the nearest checkpoint only
+      static constexpr uint64_t CHECKPOINT_INTERVAL = 32;
 
       transaction_record_state() {        
       }
@@ -48,12 +51,25 @@ namespace vds {
       static transaction_record_state load(
         database_read_transaction & t,
         const transaction_block & block);
-      
+
       void save(
         database_transaction & t,
         const std::string & owner,
         const const_data_buffer & log_id) const;
 
+      //The block has become final under consensus
+      static bool is_checkpoint_required(
+        database_read_transaction & t,
+        uint64_t order_no);
+
+      void save_checkpoint(
+        database_transaction & t,
+        const const_data_buffer & log_id,
+        uint64_t order_no) const;
+
+      const_data_buffer serialize() const;
+      static transaction_record_state deserialize(const const_data_buffer & data);
+
       struct account_state_t {
         bool approve_required;
         std::map<const_data_buffer/*source*/, int64_t /*balance*/> balance_;
@@ -133,6 +149,19 @@ namespace vds {
         transaction_record_state load_init_state(
           vds::database_read_transaction& t);
 
+        static bool load_checkpoint(
+          vds::database_read_transaction& t,
+          const const_data_buffer & log_id,
+          transaction_record_state & result);
+
+        //States saved as transaction_log_balance rows before checkpoints
+        static bool load_balance(
+          vds::database_read_transaction& t,
+          const const_data_buffer & log_id,
+          const transaction_block & block,
+          bool is_new_member,
+          transaction_record_state & result);
+
       };
     };
   }
@@ -6,6 +6,7 @@ Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
 All rights reserved
 */
 
+#include <mutex>
 #include "cert_control.h"
 #include "vds_exceptions.h"
 #include "user_manager.h"
@@ -35,9 +36,20 @@ namespace vds {
       return this->login_state_;
     }
 
+    //Applies the transaction log records saved after the last update
     void update(        
         class database_transaction &t);
 
+    //Generation of the transaction log at the last update
+    uint64_t log_generation() const {
+      return this->log_generation_;
+    }
+
+    //Number of the transaction log reads
+    uint64_t update_count() const {
+      return this->update_count_;
+    }
+
 
     std::shared_ptr<user_channel> get_channel(const const_data_buffer &channel_id) const {
       auto p = this->channels_.find(channel_id);
@@ -87,6 +99,11 @@ namespace vds {
       return this->wallets_;
     }
 
+    //RSA decrypt of the message key is cached
+    const_data_buffer decrypt_key(
+      const asymmetric_private_key & read_key,
+      const const_data_buffer & crypted_key);
+
   private:
     const service_provider * sp_;
     std::string user_credentials_key_;
@@ -96,13 +113,31 @@ namespace vds {
     std::shared_ptr<certificate> root_user_cert_;
     std::string root_user_name_;
 
-    std::set<const_data_buffer> processed_;
+    int64_t last_rowid_;
+    uint64_t log_generation_;
+    uint64_t update_count_;
     std::shared_ptr<certificate> user_cert_;
     std::string user_name_;
     std::string user_password_;
     std::map<const_data_buffer, std::shared_ptr<user_channel>> channels_;
     std::map<std::string, std::shared_ptr<certificate>> certificate_chain_;
     std::list<std::shared_ptr<user_wallet>> wallets_;
+
+    static constexpr size_t MAX_KEY_CACHE_SIZE = 10000;
+    std::mutex key_cache_mutex_;
+    std::map<const_data_buffer, const_data_buffer> key_cache_;
+    std::list<const_data_buffer> key_cache_order_;
+
+    static void add_to_file_catalog(
+      database_transaction & t,
+      const const_data_buffer & channel_id,
+      const const_data_buffer & block_id,
+      const transactions::user_message_transaction & message);
+
+    //Add the files of the channel messages which have been applied before the channel key was received
+    void backfill_file_catalog(
+      database_transaction & t,
+      const const_data_buffer & channel_id);
   };
 }
 
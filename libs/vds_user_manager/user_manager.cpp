@@ -24,6 +24,9 @@ All rights reserved
 #include "create_user_transaction.h"
 #include "private/user_channel_p.h"
 #include "control_message_transaction.h"
+#include "channel_message_dbo.h"
+#include "file_catalog_dbo.h"
+#include "transaction_log_notifier.h"
 
 vds::user_manager::user_manager(const service_provider * sp)
 : sp_(sp) {
@@ -37,12 +40,43 @@ vds::user_manager::login_state_t vds::user_manager::get_login_state() const {
 }
 
 vds::async_task<void> vds::user_manager::update() {
-  return this->sp_->get<db_model>()->async_transaction([pthis = this->shared_from_this()](database_transaction & t) {
+  auto notifier = this->sp_->get<transactions::transaction_log_notifier>(false);
+  if (nullptr != notifier && notifier->generation() == this->impl_->log_generation()) {
+    co_return;
+  }
+
+  co_await this->sp_->get<db_model>()->async_transaction([pthis = this->shared_from_this()](database_transaction & t) {
     pthis->impl_->update(t);
     return true;
   });
 }
 
+uint64_t vds::user_manager::update_count() const {
+  return this->impl_->update_count();
+}
+
+vds::async_task<vds::user_manager::login_state_t> vds::user_manager::wait_login_state(
+  const std::chrono::steady_clock::duration & timeout) {
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  auto notifier = this->sp_->get<transactions::transaction_log_notifier>();
+  for (;;) {
+    const auto generation = notifier->generation();
+    co_await this->update();
+
+    const auto state = this->get_login_state();
+    if (login_state_t::waiting != state) {
+      co_return state;
+    }
+
+    //Sleep until new transaction log records instead of polling the database
+    const auto now = std::chrono::steady_clock::now();
+    if (deadline <= now || !co_await notifier->wait(generation, deadline - now)) {
+      co_return this->get_login_state();
+    }
+  }
+}
+
 void vds::user_manager::load(
   database_transaction & t,
   const std::string & user_login,
@@ -230,13 +264,53 @@ const std::list<std::shared_ptr<vds::user_wallet>>& vds::user_manager::wallets()
   return this->impl_->wallets();
 }
 
+void vds::user_manager::walk_channel_messages(
+  const const_data_buffer & channel_id,
+  database_read_transaction & t,
+  int64_t after_order_no,
+  const std::function<bool(int64_t order_no, const const_data_buffer & data)> & callback) const {
+
+  orm::channel_message_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.order_no, t1.read_cert_subject, t1.crypted_key, t1.crypted_data)
+    .where(t1.channel_id == channel_id && t1.order_no > after_order_no)
+    .order_by(t1.order_no, t1.block_id, t1.message_index));
+
+  while (st.execute()) {
+    const auto data = this->decrypt_message(
+      channel_id,
+      t1.read_cert_subject.get(st),
+      t1.crypted_key.get(st),
+      t1.crypted_data.get(st));
+
+    if (!callback(t1.order_no.get(st), data)) {
+      break;
+    }
+  }
+}
+
+vds::const_data_buffer vds::user_manager::decrypt_message(
+  const const_data_buffer & channel_id,
+  const std::string & read_cert_subject,
+  const const_data_buffer & crypted_key,
+  const const_data_buffer & crypted_data) const {
+
+  const auto read_cert_key = this->get_channel(channel_id)->read_cert_private_key(read_cert_subject);
+  const auto key_data = this->impl_->decrypt_key(*read_cert_key, crypted_key);
+  const auto key = symmetric_key::deserialize(symmetric_crypto::aes_256_cbc(), key_data);
+  return symmetric_decrypt::decrypt(key, crypted_data);
+}
+
 /////////////////////////////////////////////////////////////////////
 vds::_user_manager::_user_manager(
   const service_provider * sp,
 		const std::string & user_login,
     const std::string & user_password)
 : sp_(sp),
-  login_state_(user_manager::login_state_t::waiting), 
+  login_state_(user_manager::login_state_t::waiting),
+  last_rowid_(0),
+  log_generation_(UINT64_MAX),
+  update_count_(0),
   user_credentials_key_(dht::dht_object_id::user_credentials_to_key(user_login, user_password)),
   user_password_(user_password)
 {
@@ -246,22 +320,30 @@ void vds::_user_manager::update(
 		
 		database_transaction &t) {
 	const auto log = this->sp_->get<logger>();
+  ++this->update_count_;
+
+  auto notifier = this->sp_->get<transactions::transaction_log_notifier>(false);
+  if (nullptr != notifier) {
+    this->log_generation_ = notifier->generation();
+  }
 
   std::list<const_data_buffer> new_records;
   orm::transaction_log_record_dbo t1;
 	auto st = t.get_reader(
-			t1.select(t1.id)
+			t1.select(t1.id, t1.rowid)
+      .where(t1.rowid > this->last_rowid_)
 					.order_by(t1.order_no));
   while (st.execute()) {
-    auto id = t1.id.get(st);
-    if (this->processed_.end() != this->processed_.find(id)) {
-      continue;
-    }
+    new_records.push_back(t1.id.get(st));
 
-    new_records.push_back(id);
+    const auto rowid = t1.rowid.get(st);
+    if (this->last_rowid_ < rowid) {
+      this->last_rowid_ = rowid;
+    }
   }
 
 	std::set<const_data_buffer> new_channels;
+  std::set<const_data_buffer> received_keys;
 	for(auto & id : new_records) {
     st = t.get_reader(
       t1.select(t1.data)
@@ -313,13 +395,17 @@ void vds::_user_manager::update(
         }
         return true;
       },
-        [this, &new_channels, log](const transactions::channel_message  & message)->bool {
+        [this, &t, &id, &new_channels, &received_keys, log](const transactions::channel_message  & message)->bool {
         auto channel = this->get_channel(message.channel_id());
         if (channel) {
           auto channel_read_key = channel->read_cert_private_key(message.channel_read_cert_subject());
           if (channel_read_key) {
             message.walk_messages(*channel_read_key,
-              [this, channel_id = message.channel_id(), log](const transactions::channel_add_reader_transaction & message)->bool {
+              [&t, &id, channel_id = message.channel_id()](const transactions::user_message_transaction & message)->bool {
+              add_to_file_catalog(t, channel_id, id, message);
+              return true;
+            },
+              [this, channel_id = message.channel_id(), log, &received_keys](const transactions::channel_add_reader_transaction & message)->bool {
               auto cp = std::make_shared<user_channel>(
                 message.id,
                 string2channel_type(message.channel_type),
@@ -330,12 +416,13 @@ void vds::_user_manager::update(
                 std::shared_ptr<asymmetric_private_key>());
 
               this->channels_[cp->id()] = cp;
+              received_keys.emplace(cp->id());
               log->debug(ThisModule, "Got channel %s reader certificate",
                 base64::from_bytes(cp->id()).c_str());
 
               return true;
             },
-              [this, channel_id = message.channel_id(), log](const transactions::channel_add_writer_transaction & message)->bool {
+              [this, channel_id = message.channel_id(), log, &received_keys](const transactions::channel_add_writer_transaction & message)->bool {
               auto cp = std::make_shared<user_channel>(
                 message.id,
                 string2channel_type(message.channel_type),
@@ -346,6 +433,7 @@ void vds::_user_manager::update(
                 message.write_private_key);
 
               this->channels_[cp->id()] = cp;
+              received_keys.emplace(cp->id());
 
               log->debug(ThisModule, "Got channel %s write certificate",
                 base64::from_bytes(cp->id()).c_str());
@@ -403,6 +491,96 @@ void vds::_user_manager::update(
         return true;
       });
 	}
+
+  for (const auto & channel_id : received_keys) {
+    this->backfill_file_catalog(t, channel_id);
+  }
+}
+
+void vds::_user_manager::add_to_file_catalog(
+  database_transaction & t,
+  const const_data_buffer & channel_id,
+  const const_data_buffer & block_id,
+  const transactions::user_message_transaction & message) {
+
+  orm::file_catalog_dbo t1;
+  for (const auto & file : message.files) {
+    binary_serializer file_blocks;
+    file_blocks << file.file_blocks;
+
+    t.execute(
+      t1.insert_or_ignore(
+        t1.channel_id = channel_id,
+        t1.file_id = file.file_id,
+        t1.block_id = block_id,
+        t1.name = file.name,
+        t1.mime_type = file.mime_type,
+        t1.file_size = file.size,
+        t1.file_blocks = file_blocks.move_data()));
+  }
+}
+
+void vds::_user_manager::backfill_file_catalog(
+  database_transaction & t,
+  const const_data_buffer & channel_id) {
+
+  const auto channel = this->get_channel(channel_id);
+  if (!channel) {
+    return;
+  }
+
+  std::list<std::pair<const_data_buffer /*block_id*/, const_data_buffer /*data*/>> messages;
+
+  orm::channel_message_dbo t1;
+  auto st = t.get_reader(
+    t1.select(t1.block_id, t1.read_cert_subject, t1.crypted_key, t1.crypted_data)
+    .where(t1.channel_id == channel_id));
+  while (st.execute()) {
+    const auto read_key = channel->read_cert_private_key(t1.read_cert_subject.get(st));
+    if (!read_key) {
+      continue;
+    }
+
+    const auto key_data = this->decrypt_key(*read_key, t1.crypted_key.get(st));
+    const auto key = symmetric_key::deserialize(symmetric_crypto::aes_256_cbc(), key_data);
+    messages.push_back(std::make_pair(
+      t1.block_id.get(st),
+      symmetric_decrypt::decrypt(key, t1.crypted_data.get(st))));
+  }
+
+  for (const auto & message : messages) {
+    auto handler = [&t, &channel_id, &message](const transactions::user_message_transaction & user_message)->bool {
+      add_to_file_catalog(t, channel_id, message.first, user_message);
+      return true;
+    };
+    transactions::channel_messages_walker_lambdas<decltype(handler)> handlers(std::move(handler));
+    handlers.process(message.second);
+  }
+}
+
+vds::const_data_buffer vds::_user_manager::decrypt_key(
+  const asymmetric_private_key & read_key,
+  const const_data_buffer & crypted_key) {
+
+  std::unique_lock<std::mutex> lock(this->key_cache_mutex_);
+  auto p = this->key_cache_.find(crypted_key);
+  if (this->key_cache_.end() != p) {
+    return p->second;
+  }
+  lock.unlock();
+
+  auto result = read_key.decrypt(crypted_key);
+
+  lock.lock();
+  if (this->key_cache_.emplace(crypted_key, result).second) {
+    this->key_cache_order_.push_back(crypted_key);
+    if (MAX_KEY_CACHE_SIZE < this->key_cache_order_.size()) {
+      this->key_cache_.erase(this->key_cache_order_.front());
+      this->key_cache_order_.pop_front();
+    }
+  }
+
+  return result;
 }
 
 void vds::_user_manager::add_certificate(const std::shared_ptr<vds::certificate> &cert) {
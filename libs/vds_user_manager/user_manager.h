@@ -34,6 +34,13 @@ namespace vds {
 
     vds::async_task<void> update();
 
+    //Number of the transaction log reads, a pending login reads the log only after new blocks
+    uint64_t update_count() const;
+
+    //Waits until the login state is not waiting or the timeout is expired
+    vds::async_task<login_state_t> wait_login_state(
+      const std::chrono::steady_clock::duration & timeout);
+
     void load(
       
       class database_transaction &t,
@@ -67,36 +74,24 @@ namespace vds {
       database_read_transaction & t,
       handler_types && ... handlers) const {
 
-      orm::transaction_log_record_dbo t1;
-      auto st = t.get_reader(
-        t1.select(t1.data)
-        .where(
-          t1.state == orm::transaction_log_record_dbo::state_t::processed
-          || t1.state == orm::transaction_log_record_dbo::state_t::leaf)
-        .order_by(t1.order_no));
-
       transactions::channel_messages_walker_lambdas<handler_types...> channel_handlers(
         std::forward<handler_types>(handlers)...);
-      while (st.execute()) {
-        transactions::transaction_block block(t1.data.get(st));
-        if (!block.walk_messages(
-          [this, channel_id, &channel_handlers](const transactions::channel_message & message)->bool {
-          if (channel_id == message.channel_id()) {
-
-            auto read_cert_key = this->get_channel(channel_id)->read_cert_private_key(message.channel_read_cert_subject());
-            const auto key_data = read_cert_key->decrypt(message.crypted_key());
-            const auto key = symmetric_key::deserialize(symmetric_crypto::aes_256_cbc(), key_data);
-            const auto data = symmetric_decrypt::decrypt(key, message.crypted_data());
-
-            return channel_handlers.process(data);
-          }
-          return true;
-        })) {
-          break;
-        }
-      }
+      this->walk_channel_messages(
+        channel_id,
+        t,
+        -1,
+        [&channel_handlers](int64_t /*order_no*/, const const_data_buffer & data)->bool {
+        return channel_handlers.process(data);
+      });
     }
 
+    //Visit decrypted messages of the channel with order_no greater than after_order_no
+    void walk_channel_messages(
+      const const_data_buffer & channel_id,
+      database_read_transaction & t,
+      int64_t after_order_no,
+      const std::function<bool(int64_t order_no, const const_data_buffer & data)> & callback) const;
+
     bool validate_and_save(
         
         const std::list<std::shared_ptr<certificate>> &cert_chain);
@@ -130,6 +125,12 @@ namespace vds {
     std::shared_ptr<_user_manager> impl_;
 
     vds::async_task<void> save_certificate( const std::shared_ptr<certificate> &cert);
+
+    const_data_buffer decrypt_message(
+      const const_data_buffer & channel_id,
+      const std::string & read_cert_subject,
+      const const_data_buffer & crypted_key,
+      const const_data_buffer & crypted_data) const;
   };
 }
 
@@ -0,0 +1,84 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "stdafx.h"
+#include "file_service.h"
+#include "mt_service.h"
+#include "foldername.h"
+#include "test_config.h"
+
+static void check_file_service(
+  vds::ifile_service * file_service,
+  const vds::filename & fn) {
+
+  std::vector<uint8_t> data(1024 * 1024 + 123);
+  for (auto & p : data) {
+    p = static_cast<uint8_t>(std::rand());
+  }
+
+  auto f = std::make_shared<vds::file>(fn, vds::file::file_mode::truncate);
+  file_service->write_at(f, 0, data.data(), data.size() / 2).get();
+  file_service->write_at(f, data.size() / 2, data.data() + data.size() / 2, data.size() - data.size() / 2).get();
+  file_service->fsync(f).get();
+  f->close();
+
+  const auto all = file_service->read_all(fn).get();
+  GTEST_ASSERT_EQ(all.size(), data.size());
+  GTEST_ASSERT_EQ(0, memcmp(all.data(), data.data(), data.size()));
+
+  f = std::make_shared<vds::file>(fn, vds::file::file_mode::open_read);
+
+  std::vector<uint8_t> buffer(4096);
+  const auto readed = file_service->read_at(f, data.size() - 100, buffer.data(), buffer.size()).get();
+  GTEST_ASSERT_EQ(readed, 100);
+  GTEST_ASSERT_EQ(0, memcmp(buffer.data(), data.data() + data.size() - 100, 100));
+
+  std::vector<std::vector<uint8_t>> buffers(16, std::vector<uint8_t>(1000));
+  std::vector<vds::ifile_service::read_request_t> requests;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    requests.push_back(vds::ifile_service::read_request_t{ f, i * 50000, buffers[i].data(), buffers[i].size() });
+  }
+
+  const auto result = file_service->read_batch(requests).get();
+  GTEST_ASSERT_EQ(result.size(), buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    GTEST_ASSERT_EQ(result[i], buffers[i].size());
+    GTEST_ASSERT_EQ(0, memcmp(buffers[i].data(), data.data() + i * 50000, buffers[i].size()));
+  }
+}
+
+static void test_file_service(bool use_uring) {
+  vds::foldername folder(vds::filename::current_process().contains_folder(), "test_file_service");
+  folder.delete_folder(true);
+  folder.create();
+
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::file_service file_service(use_uring);
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(file_service);
+
+  auto sp = registrator.build();
+  registrator.start();
+
+  check_file_service(sp->get<vds::ifile_service>(), vds::filename(folder, "data.bin"));
+
+  registrator.shutdown();
+  folder.delete_folder(true);
+}
+
+TEST(core_tests, test_file_service_uring) {
+  test_file_service(true);
+}
+
+TEST(core_tests, test_file_service_thread_pool) {
+  test_file_service(false);
+}
@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include "stdafx.h"
+#include "stream.h"
+#include "mt_service.h"
+#include "foldername.h"
+#include "test_config.h"
+
+#define BENCHMARK_FILE_SIZE (256 * 1024 * 1024)
+
+static vds::async_task<void> write_file(
+  const vds::service_provider * sp,
+  const vds::filename & fn,
+  const std::vector<uint8_t> & data,
+  size_t buffer_size,
+  bool direct_io) {
+
+  auto stream = std::make_shared<vds::file_stream_output_async>(
+    fn,
+    vds::file::file_mode::truncate,
+    buffer_size,
+    direct_io,
+    sp);
+
+  size_t offset = 0;
+  while (offset < data.size()) {
+    auto size = 1 + std::rand() % (64 * 1024);
+    if (size > data.size() - offset) {
+      size = data.size() - offset;
+    }
+
+    co_await stream->write_async(data.data() + offset, size);
+    offset += size;
+  }
+
+  co_await stream->write_async(nullptr, 0);
+}
+
+static vds::async_task<std::vector<uint8_t>> read_file(
+  const vds::service_provider * sp,
+  const vds::filename & fn,
+  size_t buffer_size,
+  bool direct_io) {
+
+  auto stream = std::make_shared<vds::file_stream_input_async>(
+    fn,
+    buffer_size,
+    direct_io,
+    sp);
+
+  std::vector<uint8_t> result;
+  uint8_t buffer[64 * 1024];
+  for (;;) {
+    const auto readed = co_await stream->read_async(buffer, 1 + std::rand() % sizeof(buffer));
+    if (0 == readed) {
+      co_return result;
+    }
+
+    result.insert(result.end(), buffer, buffer + readed);
+  }
+}
+
+class file_stream_test_env {
+public:
+  file_stream_test_env()
+  : folder_(vds::filename::current_process().contains_folder(), "test_file_stream"),
+    logger_(test_config::instance().log_level(), test_config::instance().modules()) {
+    this->folder_.delete_folder(true);
+    this->folder_.create();
+
+    this->registrator_.add(this->logger_);
+    this->registrator_.add(this->mt_service_);
+
+    this->sp_ = this->registrator_.build();
+    this->registrator_.start();
+  }
+
+  ~file_stream_test_env() {
+    this->registrator_.shutdown();
+    this->folder_.delete_folder(true);
+  }
+
+  const vds::service_provider * sp() const {
+    return this->sp_;
+  }
+
+  vds::filename file(const std::string & name) const {
+    return vds::filename(this->folder_, name);
+  }
+
+private:
+  vds::foldername folder_;
+  vds::service_registrator registrator_;
+  vds::console_logger logger_;
+  vds::mt_service mt_service_;
+  const vds::service_provider * sp_;
+};
+
+TEST(core_tests, test_file_stream) {
+  file_stream_test_env env;
+
+  std::vector<uint8_t> data(3 * 1024 * 1024 + 1234);
+  for (auto & p : data) {
+    p = static_cast<uint8_t>(std::rand());
+  }
+
+  const struct {
+    size_t buffer_size;
+    bool direct_io;
+    bool background;
+  } modes[] = {
+    { 4 * 1024, false, false },
+    { 1024 * 1024, false, false },
+    { 1024 * 1024, false, true },
+    { 1024 * 1024, true, true }
+  };
+
+  for (const auto & mode : modes) {
+    const auto sp = mode.background ? env.sp() : nullptr;
+    const auto fn = env.file("data.bin");
+
+    write_file(sp, fn, data, mode.buffer_size, mode.direct_io).get();
+    GTEST_ASSERT_EQ(vds::file::length(fn), data.size());
+
+    const auto result = read_file(sp, fn, mode.buffer_size, mode.direct_io).get();
+    GTEST_ASSERT_EQ(result.size(), data.size());
+    GTEST_ASSERT_EQ(0, memcmp(result.data(), data.data(), data.size()));
+  }
+}
+
+TEST(core_tests, DISABLED_benchmark_file_stream) {
+  file_stream_test_env env;
+
+  std::vector<uint8_t> data(BENCHMARK_FILE_SIZE);
+  for (auto & p : data) {
+    p = static_cast<uint8_t>(std::rand());
+  }
+
+  const struct {
+    size_t buffer_size;
+    bool direct_io;
+    bool background;
+  } modes[] = {
+    { 4 * 1024, false, false },
+    { 1024 * 1024, false, false },
+    { 1024 * 1024, false, true },
+    { 8 * 1024 * 1024, false, true },
+    { 8 * 1024 * 1024, true, true }
+  };
+
+  for (const auto & mode : modes) {
+    const auto sp = mode.background ? env.sp() : nullptr;
+    const auto fn = env.file("benchmark.bin");
+
+    auto start = std::chrono::steady_clock::now();
+    write_file(sp, fn, data, mode.buffer_size, mode.direct_io).get();
+    const auto write_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    const auto result = read_file(sp, fn, mode.buffer_size, mode.direct_io).get();
+    const auto read_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    GTEST_ASSERT_EQ(result.size(), data.size());
+
+    std::cout
+      << "buffer " << mode.buffer_size / 1024 << " KB"
+      << (mode.direct_io ? ", direct I/O" : "")
+      << (mode.background ? ", double buffering" : "")
+      << ": write " << (write_ms ? BENCHMARK_FILE_SIZE / 1024 / 1024 * 1000 / write_ms : 0) << " MB/s"
+      << ", read " << (read_ms ? BENCHMARK_FILE_SIZE / 1024 / 1024 * 1000 / read_ms : 0) << " MB/s\n";
+
+    vds::file::delete_file(fn);
+  }
+}
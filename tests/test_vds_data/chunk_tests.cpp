@@ -158,3 +158,46 @@ TEST(chunk_tests, test_chunks_storage) {
         }
     }
 }
+
+TEST(chunk_tests, test_chunk_decoder) {
+    const uint16_t horcrux_count = 16;
+    const uint16_t min_horcrux = 8;
+
+    //Several tiles with the odd tail
+    const size_t size = 3 * vds::chunk_decoder<uint16_t>::TILE_SIZE + 2 * (std::rand() % 1000) + 1;
+
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = uint8_t(0xFF & std::rand());
+    }
+
+    std::vector<vds::const_data_buffer> horcruxes;
+    for (uint16_t replica = 0; replica < horcrux_count; ++replica) {
+        vds::chunk_generator<uint16_t> generator(min_horcrux, replica);
+        vds::binary_serializer s;
+        generator.write(s, data.data(), size);
+        horcruxes.push_back(s.move_data());
+    }
+
+    //The horcruxes arrive in any order
+    vds::chunk_decoder<uint16_t> decoder(min_horcrux);
+    for (uint16_t i = 0; i < horcrux_count && !decoder.is_ready(); ++i) {
+        const uint16_t replica = (7 * i + 3) % horcrux_count;
+        ASSERT_TRUE(decoder.add(replica, horcruxes[replica]));
+        ASSERT_FALSE(decoder.add(replica, horcruxes[replica]));
+    }
+    ASSERT_TRUE(decoder.is_ready());
+    ASSERT_FALSE(decoder.add(0, horcruxes[0]));
+    ASSERT_EQ(size, decoder.data_size());
+
+    auto result = std::make_shared<vds::collect_data<uint8_t>>();
+    decoder.restore(result).get();
+    const auto restored = result->move_data();
+
+    ASSERT_EQ(size, restored.size());
+    for (size_t i = 0; i < size; ++i) {
+      if (data[i] != restored[i]) {
+        FAIL() << "data[" << i << "](" << (int)data[i] << ") != restored[" << i << "](" << (int)restored[i] << ")";
+      }
+    }
+}
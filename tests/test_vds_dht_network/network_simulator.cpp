@@ -0,0 +1,636 @@
+#include "stdafx.h"
+#include "network_simulator.h"
+#include "db_model.h"
+#include "udp_socket.h"
+#include "../../libs/vds_dht_network/private/dht_session.h"
+#include "../../libs/vds_dht_network/private/dht_network_client_p.h"
+#include "dht_network.h"
+#include "messages/sync_messages.h"
+#include "chunk_dbo.h"
+#include "test_log.h"
+
+network_simulator::network_simulator(uint32_t seed)
+: random_(seed),
+  now_(0),
+  event_index_(0),
+  default_link_{ std::chrono::milliseconds(50), std::chrono::milliseconds(10), 0.0, 0 },
+  is_started_(false),
+  is_converged_(false),
+  converged_time_(0),
+  converged_virtual_time_(0) {
+}
+
+void network_simulator::default_link(const sim_link_t & link) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->default_link_ = link;
+}
+
+void network_simulator::link(size_t source, size_t target, const sim_link_t & link) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->links_[std::make_tuple(source, target)] = link;
+}
+
+void network_simulator::add_nodes(size_t count, size_t connections) {
+  for (size_t i = 0; i < count; ++i) {
+    size_t index;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      index = this->nodes_.size();
+      this->nodes_.push_back(node_t { std::make_unique<sim_node>(this, index), true, sim_node_statistic{} });
+      this->addresses_[this->nodes_[index].node_->address()] = index;
+    }
+
+    this->nodes_[index].node_->start();
+
+    std::set<size_t> partners;
+    while (partners.size() < std::min(connections, index)) {
+      partners.emplace(std::uniform_int_distribution<size_t>(0, index - 1)(this->random_));
+    }
+
+    for (const auto partner : partners) {
+      this->connect(partner, index);
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (this->is_started_) {
+      this->start_jobs_locked(index);
+    }
+  }
+}
+
+void network_simulator::connect(size_t node1, size_t node2) {
+  vds::const_data_buffer session_key;
+  session_key.resize(32);
+  vds::crypto_service::rand_bytes(session_key.data(), session_key.size());
+
+  auto & server1 = this->node(node1);
+  auto & server2 = this->node(node2);
+
+  server1.add_session(std::make_shared<vds::dht::network::dht_session>(
+    server1.sp_,
+    server2.address(),
+    server1.node_id(),
+    server2.node_id(),
+    session_key));
+
+  server2.add_session(std::make_shared<vds::dht::network::dht_session>(
+    server2.sp_,
+    server1.address(),
+    server2.node_id(),
+    server1.node_id(),
+    session_key));
+}
+
+void network_simulator::job(const std::string & name, sim_time_t period) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  vds_assert(!this->is_started_);
+  this->jobs_.push_back(job_t { name, period });
+}
+
+void network_simulator::churn(const std::list<sim_churn_event_t> & script) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  for (const auto & event : script) {
+    this->schedule_locked(event.time, [this, event]() {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      this->nodes_[event.node].is_online_ = event.is_online;
+    });
+  }
+}
+
+void network_simulator::on_message(const message_handler_t & handler) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->message_handler_ = handler;
+}
+
+sim_node & network_simulator::node(size_t index) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return *this->nodes_[index].node_;
+}
+
+size_t network_simulator::node_count() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->nodes_.size();
+}
+
+sim_time_t network_simulator::now() const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->now_;
+}
+
+bool network_simulator::run(
+  const std::function<bool(void)> & is_converged,
+  sim_time_t max_time,
+  sim_time_t check_period) {
+
+  sim_time_t deadline;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    if (!this->is_started_) {
+      this->is_started_ = true;
+      this->start_time_ = std::chrono::steady_clock::now();
+      for (size_t index = 0; index < this->nodes_.size(); ++index) {
+        this->start_jobs_locked(index);
+      }
+    }
+
+    deadline = this->now_ + max_time;
+  }
+
+  auto next_check = this->now();
+  for (;;) {
+    if (next_check <= this->now()) {
+      if (is_converged()) {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->is_converged_ = true;
+        this->converged_time_ = std::chrono::steady_clock::now() - this->start_time_;
+        this->converged_virtual_time_ = this->now_;
+        return true;
+      }
+
+      next_check = this->now() + check_period;
+    }
+
+    std::function<void(void)> handler;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex_);
+      auto p = this->events_.begin();
+      if (this->events_.end() == p || deadline < std::get<0>(p->first)) {
+        this->now_ = deadline;
+        return false;
+      }
+
+      this->now_ = std::get<0>(p->first);
+      handler = std::move(p->second);
+      this->events_.erase(p);
+    }
+
+    //The node sends the datagrams while the handler is running, so the mutex is not locked
+    handler();
+  }
+}
+
+void network_simulator::stop() {
+  for (auto & node : this->nodes_) {
+    node.node_->stop();
+  }
+}
+
+void network_simulator::schedule_locked(sim_time_t time, const std::function<void(void)>& handler) {
+  //The events of the same time are processed in the order they have been scheduled
+  this->events_.emplace(std::make_tuple(time, this->event_index_++), handler);
+}
+
+void network_simulator::start_jobs_locked(size_t node) {
+  for (const auto & job : this->jobs_) {
+    //The nodes do not run the jobs at the same time
+    const auto offset = sim_time_t(std::uniform_int_distribution<int64_t>(0, job.period_.count() - 1)(this->random_));
+    this->schedule_locked(this->now_ + offset, [this, node, job]() {
+      this->run_job(node, job);
+    });
+  }
+}
+
+void network_simulator::run_job(size_t node, const job_t & job) {
+  sim_node * target;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->schedule_locked(this->now_ + job.period_, [this, node, job]() {
+      this->run_job(node, job);
+    });
+
+    if (!this->nodes_[node].is_online_) {
+      return;
+    }
+
+    target = this->nodes_[node].node_.get();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto is_succeeded = target->run_job(job.name_);
+  const auto cpu_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->nodes_[node].statistic_.cpu_time_ += cpu_time;
+  if (!is_succeeded) {
+    ++this->nodes_[node].statistic_.errors_;
+  }
+}
+
+void network_simulator::send(size_t source, const vds::udp_datagram& datagram) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  auto & source_node = this->nodes_[source];
+  ++source_node.statistic_.sent_datagrams_;
+  source_node.statistic_.sent_bytes_ += datagram.data_size();
+
+  const auto p = this->addresses_.find(datagram.address());
+  if (this->addresses_.end() == p || !source_node.is_online_) {
+    ++source_node.statistic_.dropped_datagrams_;
+    return;
+  }
+
+  const auto target = p->second;
+  const auto link_id = std::make_tuple(source, target);
+  const auto link = this->links_.find(link_id);
+  const auto & config = (this->links_.end() == link) ? this->default_link_ : link->second;
+
+  if (0.0 < config.loss && std::uniform_real_distribution<double>(0.0, 1.0)(this->random_) < config.loss) {
+    ++source_node.statistic_.dropped_datagrams_;
+    return;
+  }
+
+  //The datagram waits for the previous ones on the link
+  auto departure = this->now_;
+  if (0 != config.bytes_per_second) {
+    auto & busy = this->link_busy_[link_id];
+    departure = std::max(departure, busy) + sim_time_t(datagram.data_size() * 1000000 / config.bytes_per_second);
+    busy = departure;
+  }
+
+  auto arrival = departure + config.latency;
+  if (0 < config.jitter.count()) {
+    arrival += sim_time_t(std::uniform_int_distribution<int64_t>(0, config.jitter.count())(this->random_));
+  }
+
+  this->schedule_locked(
+    arrival,
+    [this, source, target, data = vds::const_data_buffer(datagram.data(), datagram.data_size())]() {
+    this->deliver(source, target, data);
+  });
+}
+
+void network_simulator::deliver(size_t source, size_t target, const vds::const_data_buffer& datagram) {
+  sim_node * target_node;
+  vds::network_address source_address;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto & node = this->nodes_[target];
+    if (!node.is_online_) {
+      ++this->nodes_[source].statistic_.dropped_datagrams_;
+      return;
+    }
+
+    ++node.statistic_.received_datagrams_;
+    node.statistic_.received_bytes_ += datagram.size();
+
+    target_node = node.node_.get();
+    source_address = this->nodes_[source].node_->address();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto is_succeeded = target_node->process_datagram(datagram, source_address);
+  const auto cpu_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->nodes_[target].statistic_.cpu_time_ += cpu_time;
+  if (!is_succeeded) {
+    ++this->nodes_[target].statistic_.errors_;
+  }
+}
+
+void network_simulator::message_received(
+  size_t node,
+  const vds::dht::network::imessage_map::message_info_t& message_info) {
+
+  message_handler_t handler;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    ++this->nodes_[node].statistic_.messages_;
+    ++this->message_types_[message_info.message_type()];
+    handler = this->message_handler_;
+  }
+
+  if (handler) {
+    handler(node, message_info);
+  }
+}
+
+sim_node_statistic network_simulator::get_statistic(size_t node) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->nodes_[node].statistic_;
+}
+
+void network_simulator::print_report(std::ostream& out) const {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+
+  sim_node_statistic total {};
+  std::list<std::tuple<std::string, std::map<std::string, std::string>>> table;
+  for (size_t index = 0; index < this->nodes_.size(); ++index) {
+    const auto & statistic = this->nodes_[index].statistic_;
+    total.sent_datagrams_ += statistic.sent_datagrams_;
+    total.sent_bytes_ += statistic.sent_bytes_;
+    total.received_datagrams_ += statistic.received_datagrams_;
+    total.received_bytes_ += statistic.received_bytes_;
+    total.dropped_datagrams_ += statistic.dropped_datagrams_;
+    total.messages_ += statistic.messages_;
+    total.cpu_time_ += statistic.cpu_time_;
+    total.errors_ += statistic.errors_;
+
+    std::map<std::string, std::string> columns;
+    columns["Sent"] = std::to_string(statistic.sent_datagrams_);
+    columns["Sent bytes"] = std::to_string(statistic.sent_bytes_);
+    columns["Received"] = std::to_string(statistic.received_datagrams_);
+    columns["Received bytes"] = std::to_string(statistic.received_bytes_);
+    columns["Dropped"] = std::to_string(statistic.dropped_datagrams_);
+    columns["Messages"] = std::to_string(statistic.messages_);
+    columns["CPU ms"] = std::to_string(statistic.cpu_time_.count() / 1000);
+    columns["Errors"] = std::to_string(statistic.errors_);
+    table.push_back(std::make_tuple(std::to_string(index), columns));
+  }
+
+  out
+    << this->nodes_.size() << " nodes, virtual time "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(this->now_).count() << " ms, ";
+  if (this->is_converged_) {
+    out
+      << "converged in " << std::chrono::duration_cast<std::chrono::milliseconds>(this->converged_time_).count()
+      << " ms of real time, " << std::chrono::duration_cast<std::chrono::milliseconds>(this->converged_virtual_time_).count()
+      << " ms of virtual time\n";
+  }
+  else {
+    out << "not converged\n";
+  }
+
+  out
+    << total.sent_datagrams_ << " datagrams, "
+    << total.sent_bytes_ << " bytes, "
+    << total.dropped_datagrams_ << " dropped, "
+    << total.messages_ << " messages, "
+    << total.errors_ << " errors, "
+    << total.cpu_time_.count() / 1000 << " ms CPU";
+  if (!this->nodes_.empty()) {
+    out
+      << ", per node "
+      << total.sent_datagrams_ / this->nodes_.size() << " datagrams, "
+      << total.sent_bytes_ / this->nodes_.size() << " bytes, "
+      << total.cpu_time_.count() / 1000 / this->nodes_.size() << " ms CPU";
+  }
+  out << "\n";
+
+  for (const auto & p : this->message_types_) {
+    out << std::to_string(p.first) << ": " << p.second << "\n";
+  }
+
+  print_table(out, table);
+}
+
+sim_transport::sim_transport(network_simulator* simulator, size_t index)
+: simulator_(simulator), index_(index) {
+}
+
+void sim_transport::start(
+  const vds::service_provider * /*sp*/,
+  const std::shared_ptr<vds::certificate> & /*node_cert*/,
+  const std::shared_ptr<vds::asymmetric_private_key> & /*node_key*/,
+  uint16_t /*port*/) {
+}
+
+void sim_transport::stop() {
+}
+
+vds::async_task<void> sim_transport::write_async(
+  const vds::udp_datagram& datagram,
+  vds::dht::network::traffic_class_t /*traffic_class*/) {
+  this->simulator_->send(this->index_, datagram);
+  co_return;
+}
+
+vds::async_task<void> sim_transport::try_handshake(const std::string& /*address*/) {
+  co_return;
+}
+
+sim_server::sim_server(
+  network_simulator * simulator,
+  size_t index,
+  const vds::network_address & address)
+: sp_(nullptr),
+  simulator_(simulator),
+  index_(index),
+  transport_(new sim_transport(simulator, index)),
+  address_(address) {
+}
+
+void sim_server::register_services(vds::service_registrator& registrator) {
+  registrator.add_service<vds::db_model>(&this->db_model_);
+  this->client_.register_services(registrator);
+  registrator.add_service<vds::dht::network::imessage_map>(this);
+}
+
+void sim_server::start(const vds::service_provider * sp) {
+  this->sp_ = sp;
+  this->db_model_.start_in_memory(sp);
+  this->client_.start(sp, this->transport_, 0);
+}
+
+void sim_server::stop() {
+  this->client_.stop();
+  this->db_model_.stop();
+}
+
+vds::async_task<void> sim_server::prepare_to_stop() {
+  co_return;
+}
+
+vds::async_task<void> sim_server::process_datagram(
+  const vds::const_data_buffer& datagram,
+  const vds::network_address & source_address) {
+
+  auto p = this->sessions_.find(source_address);
+  if (this->sessions_.end() == p) {
+    co_return;
+  }
+
+  co_await p->second->process_datagram(this->transport_, datagram);
+}
+
+void sim_server::add_session(const std::shared_ptr<vds::dht::network::dht_session>& session) {
+  this->sessions_.emplace(session->address(), session);
+
+  (*this->sp_->get<vds::dht::network::client>())->add_session(session, 0);
+}
+
+const vds::network_address& sim_server::address() const {
+  return this->address_;
+}
+
+#define route_client(message_type)\
+  case vds::dht::network::message_type_t::message_type: {\
+      co_return co_await this->sp_->get<vds::db_model>()->async_transaction([sp = this->sp_, message_info](vds::database_transaction & t) {\
+        vds::binary_deserializer s(message_info.message_data());\
+        auto message = vds::message_deserialize<vds::dht::messages::message_type>(s);\
+        (*sp->get<vds::dht::network::client>())->apply_message(\
+         t,\
+         message,\
+         message_info).get();\
+        return true;\
+      });\
+      break;\
+    }
+
+#define route_client_wait(message_type)\
+  case vds::dht::network::message_type_t::message_type: {\
+      vds::binary_deserializer s(message_info.message_data());\
+      auto message = vds::message_deserialize<vds::dht::messages::message_type>(s);\
+      co_return co_await (*this->sp_->get<vds::dht::network::client>())->apply_message(\
+        message,\
+        message_info);\
+      break;\
+    }
+
+vds::async_task<void> sim_server::process_message(const message_info_t& message_info) {
+  if (vds::dht::network::message_type_t::sync_message_batch == message_info.message_type()) {
+    //The messages are counted one by one whatever the way they have been packed
+    vds::binary_deserializer s(message_info.message_data());
+    const auto batch = vds::message_deserialize<vds::dht::messages::sync_message_batch>(s);
+    for (const auto & item : batch.messages) {
+      this->simulator_->message_received(
+        this->index_,
+        message_info_t(
+          message_info.session(),
+          static_cast<vds::dht::network::message_type_t>(item.message_type),
+          item.message_data,
+          message_info.source_node(),
+          message_info.hops()));
+    }
+  }
+  else {
+    this->simulator_->message_received(this->index_, message_info);
+  }
+
+  switch (message_info.message_type()) {
+    route_client(sync_new_election_request)
+    route_client(sync_new_election_response)
+
+    route_client(sync_add_message_request)
+
+    route_client(sync_leader_broadcast_request)
+    route_client(sync_leader_broadcast_response)
+
+    route_client(sync_replica_operations_request)
+    route_client(sync_replica_operations_response)
+
+    route_client(sync_looking_storage_request)
+    route_client(sync_looking_storage_response)
+
+    route_client(sync_snapshot_request)
+    route_client(sync_snapshot_response)
+
+    route_client(sync_offer_send_replica_operation_request)
+    route_client(sync_offer_remove_replica_operation_request)
+
+    route_client(sync_replica_request)
+    route_client(sync_replica_data)
+
+    route_client(sync_replica_query_operations_request)
+    route_client(sync_message_batch)
+    route_client(sync_replica_map_digest)
+    route_client(sync_replica_map_entries)
+    route_client(sync_replica_piece_request)
+
+    route_client_wait(dht_find_node)
+    route_client_wait(dht_find_node_response)
+    route_client_wait(dht_ping)
+    route_client_wait(dht_pong)
+
+  default: {
+      throw std::runtime_error("Invalid command");
+    }
+  }
+  co_return;
+}
+
+vds::async_task<void> sim_server::on_new_session(const vds::const_data_buffer& /*partner_id*/) {
+  throw vds::vds_exceptions::invalid_operation();
+}
+
+sim_node::sim_node(network_simulator * simulator, size_t index)
+: sp_(nullptr),
+  index_(index),
+  logger_(
+    test_config::instance().log_level(),
+    test_config::instance().modules()),
+  server_(simulator, index, vds::network_address(AF_INET, "localhost", static_cast<uint16_t>(index))) {
+}
+
+void sim_node::start() {
+  //Only the replica files are on the disk
+  auto folder = vds::foldername(
+    vds::foldername(vds::filename::current_process().contains_folder(), "simulator"),
+    std::to_string(this->index_));
+  folder.delete_folder(true);
+  folder.create();
+
+  this->task_manager_.disable_timers();
+
+  this->registrator_.add(this->logger_);
+  this->registrator_.add(this->mt_service_);
+  this->registrator_.add(this->task_manager_);
+  this->registrator_.add(this->server_);
+
+  this->registrator_.current_user(folder);
+  this->registrator_.local_machine(folder);
+
+  this->sp_ = this->registrator_.build();
+  this->registrator_.start();
+}
+
+void sim_node::stop() {
+  this->registrator_.shutdown();
+}
+
+const vds::const_data_buffer& sim_node::node_id() const {
+  return (*this->sp_->get<vds::dht::network::client>())->current_node_id();
+}
+
+const vds::network_address& sim_node::address() const {
+  return this->server_.address();
+}
+
+void sim_node::add_session(const std::shared_ptr<vds::dht::network::dht_session>& session) {
+  this->server_.add_session(session);
+}
+
+void sim_node::add_sync_entry(const vds::const_data_buffer& object_data) {
+  this->sp_->get<vds::db_model>()->async_transaction([sp = this->sp_, object_data](vds::database_transaction & t) {
+    auto client = sp->get<vds::dht::network::client>();
+    const auto object_id = vds::hash::signature(vds::hash::sha256(), object_data);
+    (*client)->save_data(sp, t, object_id, object_data);
+    vds::orm::chunk_dbo t1;
+    t.execute(
+      t1.insert(
+        t1.object_id = object_id,
+        t1.last_sync = std::chrono::system_clock::now() - std::chrono::hours(24)
+      ));
+    (*client)->add_sync_entry(t, object_id, object_data.size()).get();
+  }).get();
+}
+
+bool sim_node::process_datagram(
+  const vds::const_data_buffer& datagram,
+  const vds::network_address & source_address) {
+  try {
+    this->server_.process_datagram(datagram, source_address).get();
+    return true;
+  }
+  catch (const std::exception & ex) {
+    this->sp_->get<vds::logger>()->warning("sim", "Node %s failed to process datagram: %s", std::to_string(this->index_).c_str(), ex.what());
+    return false;
+  }
+  catch (...) {
+    return false;
+  }
+}
+
+bool sim_node::run_job(const std::string & name) {
+  try {
+    (*this->sp_->get<vds::dht::network::client>())->maintenance().run(name).get();
+    return true;
+  }
+  catch (const std::exception & ex) {
+    this->sp_->get<vds::logger>()->warning("sim", "Node %s failed job %s: %s", std::to_string(this->index_).c_str(), name.c_str(), ex.what());
+    return false;
+  }
+  catch (...) {
+    return false;
+  }
+}
@@ -0,0 +1,243 @@
+#ifndef __TEST_VDS_DHT_NETWORK_NETWORK_SIMULATOR_H_
+#define __TEST_VDS_DHT_NETWORK_NETWORK_SIMULATOR_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#include <random>
+#include "db_model.h"
+#include "iudp_transport.h"
+#include "network_address.h"
+#include "dht_network.h"
+#include "imessage_map.h"
+
+namespace vds {
+  class udp_datagram;
+}
+
+class network_simulator;
+
+typedef std::chrono::microseconds sim_time_t;
+
+struct sim_link_t {
+  sim_time_t latency;
+  //Uniformly distributed extra delay
+  sim_time_t jitter;
+  //Probability to lose the datagram
+  double loss;
+  //Zero if not limited
+  uint64_t bytes_per_second;
+};
+
+struct sim_churn_event_t {
+  sim_time_t time;
+  size_t node;
+  bool is_online;
+};
+
+struct sim_node_statistic {
+  uint64_t sent_datagrams_;
+  uint64_t sent_bytes_;
+  uint64_t received_datagrams_;
+  uint64_t received_bytes_;
+  uint64_t dropped_datagrams_;
+  uint64_t messages_;
+  //The datagrams and the jobs failed with an exception
+  uint64_t errors_;
+  //Time in the handlers of the node, the simulator runs one node at a time
+  std::chrono::microseconds cpu_time_;
+};
+
+class sim_transport : public vds::dht::network::iudp_transport {
+public:
+  sim_transport(network_simulator * simulator, size_t index);
+
+  void start(
+    const vds::service_provider * sp,
+    const std::shared_ptr<vds::certificate> & node_cert,
+    const std::shared_ptr<vds::asymmetric_private_key> & node_key,
+    uint16_t port) override;
+
+  void stop() override;
+
+  vds::async_task<void> write_async(
+    const vds::udp_datagram& datagram,
+    vds::dht::network::traffic_class_t traffic_class) override;
+  vds::async_task<void> try_handshake(const std::string& address) override;
+
+  vds::async_task<void> on_timer() override {
+    co_return;
+  }
+
+  //The bandwidth is limited by the simulated links
+  void traffic_limits(vds::dht::network::traffic_class_t, uint64_t, uint64_t) override {
+  }
+
+  void peer_traffic_limits(uint64_t, uint64_t) override {
+  }
+
+private:
+  network_simulator * simulator_;
+  size_t index_;
+};
+
+class sim_server : public vds::iservice_factory, protected vds::dht::network::imessage_map {
+public:
+  sim_server(
+    network_simulator * simulator,
+    size_t index,
+    const vds::network_address & address);
+
+  void register_services(vds::service_registrator &) override;
+  void start(const vds::service_provider *) override;
+  void stop() override;
+  vds::async_task<void> prepare_to_stop() override;
+
+  vds::async_task<void> process_datagram(
+    const vds::const_data_buffer& datagram,
+    const vds::network_address & source_address);
+
+  void add_session(const std::shared_ptr<vds::dht::network::dht_session> & session);
+
+  const vds::network_address & address() const;
+
+  vds::async_task<void> process_message(const message_info_t& message_info) override;
+  vds::async_task<void> on_new_session(const vds::const_data_buffer& partner_id) override;
+
+private:
+  const vds::service_provider * sp_;
+  network_simulator * simulator_;
+  size_t index_;
+  vds::db_model db_model_;
+  vds::dht::network::service client_;
+
+  std::shared_ptr<vds::dht::network::iudp_transport> transport_;
+  std::map<vds::network_address, std::shared_ptr<vds::dht::network::dht_session>> sessions_;
+  vds::network_address address_;
+};
+
+class sim_node {
+public:
+  sim_node(network_simulator * simulator, size_t index);
+
+  void start();
+  void stop();
+
+  const vds::const_data_buffer & node_id() const;
+  const vds::network_address & address() const;
+
+  void add_session(const std::shared_ptr<vds::dht::network::dht_session> & session);
+
+  void add_sync_entry(const vds::const_data_buffer& object_data);
+
+  //false if the datagram handler failed
+  bool process_datagram(
+    const vds::const_data_buffer& datagram,
+    const vds::network_address & source_address);
+
+  //Maintenance job of the client, the timers of the node are disabled
+  bool run_job(const std::string & name);
+
+  vds::service_provider * sp_;
+
+private:
+  size_t index_;
+  vds::service_registrator registrator_;
+  vds::file_logger logger_;
+  vds::mt_service mt_service_;
+  vds::task_manager task_manager_;
+  sim_server server_;
+};
+
+/**
+ * \brief Discrete event simulation of many dht::network::client instances in one process.
+ * The datagrams are delivered in the order of the virtual time by the link latency, jitter, loss and bandwidth,
+ * the maintenance jobs of the nodes are executed by the virtual timers, the nodes go offline and back by the churn script.
+ * The schedule is defined by the seed. The node keys are generated for every run.
+ * Only the delivery and the jobs are virtual, the timeouts inside the node use the real clock,
+ * so the report gives the real time of the convergence next to the virtual one.
+ */
+class network_simulator {
+public:
+  typedef std::function<void(size_t node, const vds::dht::network::imessage_map::message_info_t & message_info)> message_handler_t;
+
+  explicit network_simulator(uint32_t seed);
+
+  void default_link(const sim_link_t & link);
+  void link(size_t source, size_t target, const sim_link_t & link);
+
+  //Each new node has sessions with the random existing nodes, the rest are found by the route job
+  void add_nodes(size_t count, size_t connections);
+  void connect(size_t node1, size_t node2);
+
+  void job(const std::string & name, sim_time_t period);
+  void churn(const std::list<sim_churn_event_t> & script);
+  void on_message(const message_handler_t & handler);
+
+  sim_node & node(size_t index);
+  size_t node_count() const;
+  sim_time_t now() const;
+
+  /**
+   * \brief Process the events until is_converged returns true.
+   * \param check_period virtual time between the is_converged calls
+   * \return false if the network is not converged in max_time
+   */
+  bool run(
+    const std::function<bool(void)> & is_converged,
+    sim_time_t max_time,
+    sim_time_t check_period = std::chrono::seconds(1));
+
+  void stop();
+
+  void send(size_t source, const vds::udp_datagram & datagram);
+  void message_received(size_t node, const vds::dht::network::imessage_map::message_info_t & message_info);
+
+  sim_node_statistic get_statistic(size_t node) const;
+  void print_report(std::ostream & out) const;
+
+private:
+  struct node_t {
+    std::unique_ptr<sim_node> node_;
+    bool is_online_;
+    sim_node_statistic statistic_;
+  };
+
+  struct job_t {
+    std::string name_;
+    sim_time_t period_;
+  };
+
+  mutable std::mutex mutex_;
+  std::mt19937 random_;
+  sim_time_t now_;
+  uint64_t event_index_;
+  std::map<std::tuple<sim_time_t, uint64_t>, std::function<void(void)>> events_;
+
+  sim_link_t default_link_;
+  std::map<std::tuple<size_t, size_t>, sim_link_t> links_;
+  std::map<std::tuple<size_t, size_t>, sim_time_t> link_busy_;
+
+  std::vector<node_t> nodes_;
+  std::map<vds::network_address, size_t> addresses_;
+
+  std::list<job_t> jobs_;
+  bool is_started_;
+
+  message_handler_t message_handler_;
+  std::map<vds::dht::network::message_type_t, uint64_t> message_types_;
+
+  bool is_converged_;
+  std::chrono::steady_clock::time_point start_time_;
+  std::chrono::steady_clock::duration converged_time_;
+  sim_time_t converged_virtual_time_;
+
+  void schedule_locked(sim_time_t time, const std::function<void(void)> & handler);
+  void start_jobs_locked(size_t node);
+  void run_job(size_t node, const job_t & job);
+  void deliver(size_t source, size_t target, const vds::const_data_buffer & datagram);
+};
+
+#endif //__TEST_VDS_DHT_NETWORK_NETWORK_SIMULATOR_H_
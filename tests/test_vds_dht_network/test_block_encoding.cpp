@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "crypto_service.h"
+#include "asymmetriccrypto.h"
+#include "mt_service.h"
+#include "transaction_block_builder.h"
+#include "transaction_block.h"
+#include "payment_transaction.h"
+#include "messages/transaction_log_messages.h"
+
+#define BENCHMARK_BLOCK_COUNT 1000
+
+static void check_block_encoding(const vds::service_provider * sp, size_t block_count, bool benchmark) {
+  auto private_key = std::make_shared<vds::asymmetric_private_key>(
+    vds::asymmetric_private_key::generate(vds::asymmetric_crypto::rsa4096()));
+  vds::asymmetric_public_key public_key(*private_key);
+
+  vds::certificate::create_options options;
+  options.country = "RU";
+  options.organization = "Test Org";
+  options.name = "Write Cert";
+  auto cert = std::make_shared<vds::certificate>(vds::certificate::create_new(public_key, *private_key, options));
+
+  //Payments refer to the few sources as the real wallets do
+  std::vector<vds::const_data_buffer> sources;
+  for (int i = 0; i < 4; ++i) {
+    sources.push_back(vds::hash::signature(vds::hash::sha256(), vds::const_data_buffer(&i, sizeof(i))));
+  }
+
+  size_t canonical_size = 0;
+  size_t compact_size = 0;
+  for (size_t i = 0; i < block_count; ++i) {
+    auto builder = vds::transactions::transaction_block_builder::create_root_block(sp);
+
+    for (size_t j = 0; j < 8; ++j) {
+      vds::transactions::payment_transaction payment;
+      payment.source_transaction = sources[(i + j) % sources.size()];
+      payment.target_user = "user" + std::to_string(j % 3);
+      payment.value = i * j;
+      builder.add(payment);
+    }
+
+    const auto data = builder.sign(sp, cert, private_key);
+    const auto compact = vds::transactions::transaction_block::pack(data);
+
+    ASSERT_TRUE(vds::transactions::transaction_block::is_compact(compact));
+    ASSERT_FALSE(vds::transactions::transaction_block::is_compact(data));
+    ASSERT_TRUE(compact.size() < data.size());
+
+    ASSERT_TRUE(vds::transactions::transaction_block::unpack(compact) == data);
+    ASSERT_TRUE(vds::transactions::transaction_block::unpack(data) == data);
+    ASSERT_TRUE(vds::transactions::transaction_block::pack(compact) == compact);
+
+    vds::transactions::transaction_block block(data);
+    vds::transactions::transaction_block compact_block(compact);
+    ASSERT_TRUE(block.id() == compact_block.id());
+    ASSERT_TRUE(block.block_messages() == compact_block.block_messages());
+    ASSERT_TRUE(compact_block.validate(*cert));
+
+    canonical_size += data.size();
+    compact_size += compact.size();
+  }
+
+  if (benchmark) {
+    std::cout
+      << "canonical: " << canonical_size / block_count << " bytes/block\n"
+      << "compact: " << compact_size / block_count << " bytes/block\n";
+  }
+}
+
+static void test_block_encoding(size_t block_count, bool benchmark) {
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+
+  auto sp = registrator.build();
+  registrator.start();
+
+  check_block_encoding(sp, block_count, benchmark);
+
+  registrator.shutdown();
+}
+
+TEST(test_vds_dht_network, test_block_encoding) {
+  test_block_encoding(16, false);
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_block_encoding) {
+  test_block_encoding(BENCHMARK_BLOCK_COUNT, true);
+}
+
+TEST(test_vds_dht_network, test_log_request_formats) {
+  const vds::const_data_buffer transaction_id("transaction", 11);
+  const vds::const_data_buffer source_node("node", 4);
+
+  //The request of an old peer has no formats
+  vds::binary_serializer s;
+  s << transaction_id << source_node;
+  const auto old_data = s.move_data();
+  vds::binary_deserializer old_stream(old_data);
+  const auto old_request = vds::message_deserialize<vds::dht::messages::transaction_log_request>(old_stream);
+  ASSERT_TRUE(old_request.transaction_id == transaction_id);
+  ASSERT_FALSE(old_request.record_formats.compact);
+
+  const auto data = vds::message_serialize(
+    vds::message_create<vds::dht::messages::transaction_log_request>(
+      transaction_id,
+      source_node,
+      vds::dht::messages::transaction_log_request::record_formats_t{ true }));
+  vds::binary_deserializer stream(data);
+  const auto request = vds::message_deserialize<vds::dht::messages::transaction_log_request>(stream);
+  ASSERT_TRUE(request.source_node == source_node);
+  ASSERT_TRUE(request.record_formats.compact);
+}
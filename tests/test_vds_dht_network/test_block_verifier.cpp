@@ -0,0 +1,216 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "crypto_service.h"
+#include "asymmetriccrypto.h"
+#include "mt_service.h"
+#include "transaction_block_builder.h"
+#include "transaction_block_verifier.h"
+#include "payment_transaction.h"
+#include "db_model.h"
+#include "messages/transaction_log_messages.h"
+#include "../../libs/vds_log_sync/include/sync_process.h"
+
+#define BENCHMARK_BLOCK_COUNT 5000
+
+static std::shared_ptr<vds::certificate> create_cert(
+  const vds::asymmetric_private_key & private_key,
+  const std::string & name) {
+
+  vds::asymmetric_public_key public_key(private_key);
+
+  vds::certificate::create_options options;
+  options.country = "RU";
+  options.organization = "Test Org";
+  options.name = name;
+
+  return std::make_shared<vds::certificate>(vds::certificate::create_new(public_key, private_key, options));
+}
+
+static std::vector<vds::transactions::transaction_block_verifier::request_t> create_blocks(
+  const vds::service_provider * sp,
+  const std::shared_ptr<vds::certificate> & write_cert,
+  const std::shared_ptr<vds::asymmetric_private_key> & write_private_key,
+  const std::shared_ptr<vds::certificate> & verify_cert,
+  size_t count) {
+
+  std::vector<vds::transactions::transaction_block_verifier::request_t> result;
+  for (size_t i = 0; i < count; ++i) {
+    auto builder = vds::transactions::transaction_block_builder::create_root_block(sp);
+
+    vds::transactions::payment_transaction payment;
+    payment.target_user = "user" + std::to_string(i);
+    payment.value = i;
+    builder.add(payment);
+
+    result.push_back(vds::transactions::transaction_block_verifier::request_t{
+      std::make_shared<vds::transactions::transaction_block>(builder.sign(sp, write_cert, write_private_key)),
+      verify_cert });
+  }
+
+  return result;
+}
+
+static void verify_blocks(const vds::service_provider * sp, size_t block_count, bool benchmark) {
+  auto private_key = std::make_shared<vds::asymmetric_private_key>(
+    vds::asymmetric_private_key::generate(vds::asymmetric_crypto::rsa4096()));
+  auto cert = create_cert(*private_key, "Write Cert");
+
+  auto other_private_key = vds::asymmetric_private_key::generate(vds::asymmetric_crypto::rsa4096());
+  auto other_cert = create_cert(other_private_key, "Other Cert");
+
+  auto blocks = create_blocks(sp, cert, private_key, cert, block_count);
+
+  //One by one as it was done before
+  auto start = std::chrono::steady_clock::now();
+  for (auto & request : blocks) {
+    ASSERT_TRUE(request.block->validate(*request.write_cert));
+  }
+  const auto sequential_time = std::chrono::steady_clock::now() - start;
+
+  vds::transactions::transaction_block_verifier verifier;
+
+  start = std::chrono::steady_clock::now();
+  auto result = verifier.verify_batch(sp, blocks).get();
+  const auto batch_time = std::chrono::steady_clock::now() - start;
+
+  GTEST_ASSERT_EQ(result.size(), blocks.size());
+  for (const auto r : result) {
+    ASSERT_TRUE(r);
+  }
+  GTEST_ASSERT_EQ(verifier.cache_size(), blocks.size());
+
+  //The apply stage gets the cached result
+  start = std::chrono::steady_clock::now();
+  for (auto & request : blocks) {
+    ASSERT_TRUE(verifier.verify(*request.block, *request.write_cert));
+  }
+  const auto cached_time = std::chrono::steady_clock::now() - start;
+
+  //Wrong certificate
+  for (auto & request : blocks) {
+    request.write_cert = other_cert;
+  }
+  result = verifier.verify_batch(sp, blocks).get();
+  for (const auto r : result) {
+    ASSERT_FALSE(r);
+  }
+
+  if (benchmark) {
+    const auto blocks_per_second = [block_count](std::chrono::steady_clock::duration time) {
+      const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time).count();
+      return (0 == ms) ? block_count * 1000 : block_count * 1000 / ms;
+    };
+
+    std::cout
+      << "sequential: " << blocks_per_second(sequential_time) << " blocks/sec\n"
+      << "batch: " << blocks_per_second(batch_time) << " blocks/sec\n"
+      << "cached: " << blocks_per_second(cached_time) << " blocks/sec\n";
+  }
+}
+
+static void test_block_verifier(size_t block_count, bool benchmark) {
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+
+  auto sp = registrator.build();
+  registrator.start();
+
+  verify_blocks(sp, block_count, benchmark);
+
+  registrator.shutdown();
+}
+
+TEST(test_vds_dht_network, test_block_verifier) {
+  test_block_verifier(16, false);
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_block_verifier) {
+  test_block_verifier(BENCHMARK_BLOCK_COUNT, true);
+}
+
+TEST(test_vds_dht_network, test_log_record_batches) {
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+  vds::db_model db_model;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+  registrator.add_service<vds::db_model>(&db_model);
+
+  auto sp = registrator.build();
+  registrator.start();
+  db_model.start_in_memory(sp);
+
+  auto private_key = std::make_shared<vds::asymmetric_private_key>(
+    vds::asymmetric_private_key::generate(vds::asymmetric_crypto::rsa4096()));
+  auto cert = create_cert(*private_key, "Write Cert");
+
+  const size_t record_count = 64;
+  std::vector<vds::dht::messages::transaction_log_record> records;
+  for (size_t i = 0; i < record_count; ++i) {
+    auto builder = vds::transactions::transaction_block_builder::create_root_block(sp);
+
+    vds::transactions::payment_transaction payment;
+    payment.target_user = "user" + std::to_string(i);
+    payment.value = i;
+    builder.add(payment);
+
+    vds::dht::messages::transaction_log_record record;
+    record.data = builder.sign(sp, cert, private_key);
+    record.record_id = vds::transactions::transaction_block(record.data).id();
+    records.push_back(record);
+  }
+
+  //The records arrive from several sessions at once, none of them waits for the verification
+  vds::transaction_log::sync_process process(sp);
+  std::vector<std::thread> threads;
+  for (size_t thread_index = 0; thread_index < 4; ++thread_index) {
+    threads.emplace_back([&process, &records, thread_index]() {
+      for (size_t i = thread_index; i < records.size(); i += 4) {
+        process.process_record(
+          records[i],
+          vds::dht::network::imessage_map::message_info_t(
+            nullptr,
+            vds::dht::network::message_type_t::transaction_log_record,
+            vds::message_serialize(records[i]),
+            vds::const_data_buffer("node", 4),
+            0));
+      }
+    });
+  }
+  for (auto & thread : threads) {
+    thread.join();
+  }
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+  while (process.get_verify_statistic().applied < record_count && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  const auto statistic = process.get_verify_statistic();
+  GTEST_ASSERT_EQ(statistic.applied, record_count);
+  GTEST_ASSERT_EQ(statistic.verified, record_count);
+  GTEST_ASSERT_LT(statistic.batches, record_count);
+  GTEST_ASSERT_LT(1, statistic.max_batch_size);
+
+  db_model.stop();
+  registrator.shutdown();
+}
@@ -157,7 +157,8 @@ TEST(test_vds_dht_network, test_data_exchange) {
 
 vds::async_task<void> mock_dg_transport::write_async(
     
-    const vds::udp_datagram &data) {
+    const vds::udp_datagram &data,
+    vds::dht::network::traffic_class_t /*traffic_class*/) {
   return this->s_.process_datagram(
       this->shared_from_this(),
       vds::const_data_buffer(data.data(), data.data_size()));
@@ -12,7 +12,8 @@ public:
   }
   vds::async_task<void> write_async(
       
-      const vds::udp_datagram & data);
+      const vds::udp_datagram & data,
+      vds::dht::network::traffic_class_t traffic_class);
 
 private:
   mock_session & s_;
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "test_sync_process.h"
+#include "db_model.h"
+#include "well_known_node_dbo.h"
+#include "../../libs/vds_dht_network/private/dht_session.h"
+#include "../../libs/vds_dht_network/private/dht_network_client_p.h"
+
+TEST(test_vds_dht_network, test_maintenance_scheduler) {
+  auto hab = std::make_shared<transport_hab>();
+  auto server = std::make_shared<test_server>(
+    vds::network_address(AF_INET, "localhost", 1010), hab);
+  server->start(hab, 1010);
+
+  vds::dht::network::maintenance_scheduler scheduler(server->sp_);
+
+  //The job is not executed in parallel with itself
+  bool is_nested_executed = true;
+  scheduler.add_job(
+    "slow",
+    std::chrono::hours(1),
+    std::chrono::seconds(0),
+    std::chrono::milliseconds(1),
+    [&scheduler, &is_nested_executed](const std::chrono::steady_clock::time_point & deadline) -> vds::async_task<size_t> {
+    is_nested_executed = scheduler.run("slow").get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    co_return 7;
+  });
+
+  scheduler.add_transaction_job(
+    "db",
+    std::chrono::hours(1),
+    std::chrono::seconds(0),
+    std::chrono::seconds(10),
+    [](vds::database_transaction & t, const std::chrono::steady_clock::time_point & deadline) -> vds::async_task<size_t> {
+    vds::orm::well_known_node_dbo t1;
+    t.execute(t1.insert(t1.address = std::string("udp://localhost:1"), t1.last_connect = std::chrono::system_clock::now()));
+    co_return 0;
+  });
+
+  scheduler.add_job(
+    "failed",
+    std::chrono::hours(1),
+    std::chrono::seconds(0),
+    std::chrono::seconds(10),
+    [](const std::chrono::steady_clock::time_point & deadline) -> vds::async_task<size_t> {
+    throw std::runtime_error("test");
+  });
+
+  ASSERT_TRUE(scheduler.run("slow").get());
+  ASSERT_FALSE(is_nested_executed);
+  ASSERT_TRUE(scheduler.run("db").get());
+  ASSERT_TRUE(scheduler.run("failed").get());
+
+  vds::maintenance_statistic statistic;
+  scheduler.get_statistic(statistic);
+
+  const auto & slow = statistic.jobs_["slow"];
+  GTEST_ASSERT_EQ(slow.runs_, 1);
+  GTEST_ASSERT_EQ(slow.skipped_, 1);
+  GTEST_ASSERT_EQ(slow.overruns_, 1);
+  GTEST_ASSERT_EQ(slow.backlog_, 7);
+  ASSERT_FALSE(slow.is_running_);
+  ASSERT_TRUE(slow.last_duration_ms_ >= 20);
+
+  const auto & db = statistic.jobs_["db"];
+  GTEST_ASSERT_EQ(db.runs_, 1);
+  GTEST_ASSERT_EQ(db.errors_, 0);
+  GTEST_ASSERT_EQ(db.overruns_, 0);
+
+  bool is_committed = false;
+  server->sp_->get<vds::db_model>()->async_read_transaction([&is_committed](vds::database_read_transaction & t) {
+    vds::orm::well_known_node_dbo t1;
+    auto st = t.get_reader(t1.select(t1.address).where(t1.address == "udp://localhost:1"));
+    is_committed = st.execute();
+  }).get();
+  ASSERT_TRUE(is_committed);
+
+  GTEST_ASSERT_EQ(statistic.jobs_["failed"].errors_, 1);
+
+  server->stop();
+}
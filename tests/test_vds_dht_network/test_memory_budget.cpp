@@ -0,0 +1,54 @@
+#include "stdafx.h"
+#include "memory_budget.h"
+
+TEST(test_vds_dht_network, test_memory_budget) {
+  vds::dht::network::memory_budget budget(100);
+
+  auto first = budget.acquire(60).get();
+  GTEST_ASSERT_EQ(first->size(), 60);
+
+  vds::memory_budget_statistic statistic;
+
+  //The tasks hold the result, so the leases are released with them
+  {
+    //The budget is exhausted
+    auto second_task = budget.acquire(60);
+    GTEST_ASSERT_EQ(second_task.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    //The small requests do not pass the waiting one
+    GTEST_ASSERT_TRUE(nullptr == budget.try_acquire(10));
+    auto third_task = budget.acquire(10);
+    GTEST_ASSERT_EQ(third_task.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    budget.get_statistic(statistic);
+    GTEST_ASSERT_EQ(statistic.used_, 60);
+    GTEST_ASSERT_EQ(statistic.waiting_, 2);
+    GTEST_ASSERT_EQ(statistic.rejected_, 1);
+
+    //Both waiting requests fit when the first is released
+    first.reset();
+    auto second = second_task.get();
+    auto third = third_task.get();
+    GTEST_ASSERT_EQ(second->size(), 60);
+    GTEST_ASSERT_EQ(third->size(), 10);
+
+    budget.get_statistic(statistic);
+    GTEST_ASSERT_EQ(statistic.used_, 70);
+    GTEST_ASSERT_EQ(statistic.waiting_, 0);
+    GTEST_ASSERT_EQ(statistic.granted_, 3);
+    GTEST_ASSERT_EQ(statistic.queued_, 2);
+
+    second.reset();
+    third.reset();
+  }
+
+  //The request larger than the limit gets the whole budget
+  auto large = budget.acquire(1000).get();
+  GTEST_ASSERT_EQ(large->size(), 100);
+  GTEST_ASSERT_TRUE(nullptr == budget.try_acquire(1));
+  large.reset();
+
+  budget.get_statistic(statistic);
+  GTEST_ASSERT_EQ(statistic.used_, 0);
+  GTEST_ASSERT_EQ(statistic.peak_, 100);
+}
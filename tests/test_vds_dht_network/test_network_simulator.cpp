@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "network_simulator.h"
+#include "hash.h"
+#include "messages/sync_messages.h"
+
+#define BENCHMARK_NODE_COUNT 300
+
+static void test_network_simulator(size_t node_count, bool benchmark) {
+#ifdef _WIN32
+  //Initialize Winsock
+  WSADATA wsaData;
+  if (NO_ERROR != WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+    auto error = WSAGetLastError();
+    throw std::system_error(error, std::system_category(), "Initiates Winsock");
+  }
+#endif
+
+  network_simulator simulator(75);
+  simulator.default_link(sim_link_t {
+    std::chrono::milliseconds(20),
+    std::chrono::milliseconds(5),
+    0.01,
+    1024 * 1024 });
+  simulator.job("route", std::chrono::seconds(60));
+  simulator.job("sync", std::chrono::seconds(10));
+  simulator.add_nodes(node_count, 4);
+
+  //One of the nodes is away for a while
+  simulator.churn({
+    sim_churn_event_t { std::chrono::seconds(30), node_count / 2, false },
+    sim_churn_event_t { std::chrono::seconds(90), node_count / 2, true }
+  });
+
+  vds::const_data_buffer object_data;
+  object_data.resize(400000);
+  for (size_t i = 0; i < object_data.size(); ++i) {
+    object_data[i] = std::rand();
+  }
+  const auto object_id = vds::hash::signature(vds::hash::sha256(), object_data);
+
+  //All replicas have to be placed
+  std::mutex replicas_mutex;
+  std::set<std::tuple<vds::const_data_buffer, uint16_t>> replicas;
+  simulator.on_message([&object_id, &replicas_mutex, &replicas](
+    size_t /*node*/,
+    const vds::dht::network::imessage_map::message_info_t & message_info) {
+    if (vds::dht::network::message_type_t::sync_replica_operations_request == message_info.message_type()) {
+      vds::binary_deserializer s(message_info.message_data());
+      const auto message = vds::message_deserialize<vds::dht::messages::sync_replica_operations_request>(s);
+      if (message.object_id == object_id
+        && vds::orm::sync_message_dbo::message_type_t::add_replica == message.message_type) {
+        std::lock_guard<std::mutex> lock(replicas_mutex);
+        replicas.emplace(message.member_node, message.replica);
+      }
+    }
+  });
+
+  simulator.node(0).add_sync_entry(object_data);
+
+  const auto is_converged = simulator.run(
+    [&replicas_mutex, &replicas]() {
+      std::lock_guard<std::mutex> lock(replicas_mutex);
+      return replicas.size() >= vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES;
+    },
+    std::chrono::minutes(30));
+
+  //The statistic of the nodes explains the failure as well
+  if (benchmark || !is_converged) {
+    simulator.print_report(std::cout);
+  }
+
+  simulator.stop();
+
+  GTEST_ASSERT_TRUE(is_converged);
+  GTEST_ASSERT_LT(0, simulator.get_statistic(0).sent_datagrams_);
+  for (size_t node = 0; node < simulator.node_count(); ++node) {
+    GTEST_ASSERT_EQ(0, simulator.get_statistic(node).errors_);
+  }
+}
+
+TEST(test_vds_dht_network, test_network_simulator) {
+  test_network_simulator(20, false);
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_network_simulator) {
+  test_network_simulator(BENCHMARK_NODE_COUNT, true);
+}
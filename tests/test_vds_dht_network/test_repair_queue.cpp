@@ -0,0 +1,130 @@
+#include "stdafx.h"
+#include "dht_network.h"
+#include "../../libs/vds_dht_network/private/repair_queue.h"
+
+#define BENCHMARK_OBJECT_COUNT 1000000
+
+//Replicas of the object are placed on the nodes, the failed node loses all its replicas
+struct simulated_object_t {
+  std::map<uint16_t, std::set<size_t /*node*/>> replica_nodes;
+};
+
+static void test_repair_queue(
+  size_t object_count,
+  size_t node_count,
+  size_t failed_count,
+  size_t max_parallel,
+  bool benchmark) {
+
+  const uint64_t replica_size = vds::dht::network::service::BLOCK_SIZE / vds::dht::network::service::MIN_DISTRIBUTED_PIECES;
+
+  std::vector<simulated_object_t> objects(object_count);
+  for (auto & object : objects) {
+    for (uint16_t replica = 0; replica < vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
+      object.replica_nodes[replica].emplace(std::rand() % node_count);
+    }
+  }
+
+  //Node failure
+  std::set<size_t> failed_nodes;
+  while (failed_nodes.size() < failed_count) {
+    failed_nodes.emplace(std::rand() % node_count);
+  }
+
+  for (auto & object : objects) {
+    for (auto p = object.replica_nodes.begin(); p != object.replica_nodes.end();) {
+      for (auto node : failed_nodes) {
+        p->second.erase(node);
+      }
+      if (p->second.empty()) {
+        p = object.replica_nodes.erase(p);
+      }
+      else {
+        ++p;
+      }
+    }
+  }
+
+  vds::dht::network::repair_queue queue;
+  queue.limits(std::numeric_limits<uint32_t>::max(), max_parallel);
+
+  const auto start = std::chrono::steady_clock::now();
+  auto now = start;
+  size_t ticks = 0;
+  uint64_t repaired_objects = 0;
+  for (;;) {
+    queue.start_tick(now);
+
+    size_t degraded_count = 0;
+    for (size_t i = 0; i < objects.size(); ++i) {
+      const auto & object = objects[i];
+      if (object.replica_nodes.size() < vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES) {
+        ++degraded_count;
+        vds::const_data_buffer object_id(&i, sizeof(i));
+        queue.push(
+          object_id,
+          vds::dht::network::repair_queue::redundancy_margin(object.replica_nodes.size()),
+          (vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES - object.replica_nodes.size()) * replica_size);
+      }
+    }
+
+    if (0 == degraded_count) {
+      queue.finish_tick(0, std::chrono::system_clock::now());
+      break;
+    }
+
+    //The objects at risk are repaired first
+    int last_margin = std::numeric_limits<int>::min();
+    size_t started = 0;
+    vds::dht::network::repair_queue::entry_t entry;
+    while (queue.pop(entry)) {
+      GTEST_ASSERT_LE(last_margin, entry.margin);
+      last_margin = entry.margin;
+      ++started;
+
+      size_t index;
+      memcpy(&index, entry.object_id.data(), sizeof(index));
+      auto & object = objects[index];
+      for (uint16_t replica = 0; replica < vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
+        if (object.replica_nodes.end() == object.replica_nodes.find(replica)) {
+          size_t node;
+          do {
+            node = std::rand() % node_count;
+          } while (failed_nodes.end() != failed_nodes.find(node));
+          object.replica_nodes[replica].emplace(node);
+        }
+      }
+    }
+
+    GTEST_ASSERT_EQ(started, std::min(max_parallel, degraded_count));
+    repaired_objects += started;
+    queue.finish_tick(degraded_count, std::chrono::system_clock::now());
+
+    ++ticks;
+    now += std::chrono::seconds(60);
+  }
+
+  const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  vds::repair_statistic statistic;
+  queue.get_statistic(statistic);
+  GTEST_ASSERT_EQ(statistic.repaired_objects_, repaired_objects);
+  GTEST_ASSERT_EQ(statistic.degraded_objects_, 0);
+  GTEST_ASSERT_EQ(statistic.degraded_time_ms_, 0);
+
+  if (benchmark) {
+    std::cout
+      << failed_count << " of " << node_count << " nodes failed, "
+      << repaired_objects << " of " << object_count << " objects repaired in "
+      << ticks << " ticks, " << duration << " ms, "
+      << (0 == duration ? 0 : repaired_objects * 1000 / duration) << " objects per second\n";
+  }
+}
+
+TEST(test_vds_dht_network, test_repair_queue) {
+  test_repair_queue(1000, 20, 3, 64, false);
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_repair_queue) {
+  test_repair_queue(BENCHMARK_OBJECT_COUNT, 100, 5, 10000, true);
+}
@@ -0,0 +1,159 @@
+#include "stdafx.h"
+#include "dht_network.h"
+#include "hash.h"
+#include "messages/sync_messages.h"
+#include "../../libs/vds_dht_network/private/replica_map_digest.h"
+
+#define BENCHMARK_OBJECT_COUNT 100000
+
+struct reconciliation_result_t {
+  size_t messages;
+  size_t bytes;
+  std::set<vds::const_data_buffer> different_objects;
+};
+
+//The messages between two nodes as sync_process exchanges them
+static reconciliation_result_t reconcile(
+  const vds::dht::network::replica_map_digest & node1,
+  const vds::dht::network::replica_map_digest & node2) {
+
+  reconciliation_result_t result { 0, 0 };
+
+  const vds::dht::network::replica_map_digest * nodes[] = { &node1, &node2 };
+  std::list<std::tuple<size_t /*target*/, vds::dht::messages::sync_replica_map_digest>> digests;
+  std::list<std::tuple<size_t /*target*/, vds::dht::messages::sync_replica_map_entries>> entries;
+
+  vds::dht::messages::sync_replica_map_digest root;
+  root.ranges.push_back(node1.root());
+  digests.push_back(std::make_tuple(1, root));
+
+  while (!digests.empty()) {
+    const auto target = std::get<0>(digests.front());
+    const auto message = std::get<1>(digests.front());
+    digests.pop_front();
+
+    ++result.messages;
+    result.bytes += vds::message_serialize(message).size();
+
+    std::list<vds::dht::network::replica_map_digest::range_t> children;
+    std::list<vds::dht::network::replica_map_digest::range_t> leaves;
+    nodes[target]->compare(message.ranges, children, leaves);
+
+    if (!children.empty()) {
+      vds::dht::messages::sync_replica_map_digest response;
+      response.ranges = children;
+      digests.push_back(std::make_tuple(1 - target, response));
+    }
+
+    for (const auto & leaf : leaves) {
+      vds::dht::messages::sync_replica_map_entries response;
+      response.prefix = leaf.prefix;
+      response.bits = leaf.bits;
+      response.entries = nodes[target]->get_entries(leaf.prefix, leaf.bits);
+      entries.push_back(std::make_tuple(1 - target, response));
+    }
+  }
+
+  for (const auto & p : entries) {
+    const auto & message = std::get<1>(p);
+
+    ++result.messages;
+    result.bytes += vds::message_serialize(message).size();
+
+    for (const auto & object_id : nodes[std::get<0>(p)]->difference(message.prefix, message.bits, message.entries)) {
+      result.different_objects.emplace(object_id);
+    }
+  }
+
+  return result;
+}
+
+static void test_replica_map_digest(size_t object_count, size_t difference_count, bool benchmark) {
+  std::vector<vds::const_data_buffer> nodes;
+  for (int i = 0; i < 10; ++i) {
+    nodes.push_back(vds::hash::signature(vds::hash::sha256(), &i, sizeof(i)));
+  }
+
+  std::vector<vds::const_data_buffer> objects;
+  for (size_t i = 0; i < object_count; ++i) {
+    objects.push_back(vds::hash::signature(vds::hash::sha256(), &i, sizeof(i)));
+  }
+
+  std::set<vds::const_data_buffer> changed_objects;
+  while (changed_objects.size() < difference_count) {
+    changed_objects.emplace(objects[std::rand() % object_count]);
+  }
+
+  vds::dht::network::replica_map_digest node1;
+  vds::dht::network::replica_map_digest node2;
+  size_t full_map_size = 0;
+  for (size_t i = 0; i < object_count; ++i) {
+    const auto & object_id = objects[i];
+    for (uint16_t replica = 0; replica < vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES; ++replica) {
+      const auto & node = nodes[(i + replica) % nodes.size()];
+      node1.add(object_id, replica, node);
+      full_map_size += object_id.size() + sizeof(replica) + node.size();
+
+      if (changed_objects.end() == changed_objects.find(object_id)) {
+        node2.add(object_id, replica, node);
+      }
+      else if (0 == replica % 2) {
+        //Lost replica on the second node, moved replica on the first one
+        node2.add(object_id, replica, nodes[(i + replica + 1) % nodes.size()]);
+      }
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto result = reconcile(node1, node2);
+  const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+  GTEST_ASSERT_EQ(result.different_objects, changed_objects);
+
+  //Equal maps are reconciled by the root hash
+  const auto equal_result = reconcile(node1, node1);
+  GTEST_ASSERT_EQ(equal_result.messages, 1);
+  GTEST_ASSERT_TRUE(equal_result.different_objects.empty());
+
+  //The incremental update gives the same ranges as the map loaded again
+  auto updated = node1;
+  for (size_t i = 0; i < object_count; ++i) {
+    const auto & object_id = objects[i];
+    if (changed_objects.end() != changed_objects.find(object_id)) {
+      updated.remove(object_id);
+      for (uint16_t replica = 0; replica < vds::dht::network::service::GENERATE_DISTRIBUTED_PIECES; replica += 2) {
+        updated.add(object_id, replica, nodes[(i + replica + 1) % nodes.size()]);
+      }
+    }
+  }
+  GTEST_ASSERT_EQ(updated.size(), node2.size());
+  GTEST_ASSERT_EQ(updated.root().hash, node2.root().hash);
+  GTEST_ASSERT_TRUE(reconcile(updated, node2).different_objects.empty());
+
+  //The cost depends on the difference
+  if (difference_count * 10 <= object_count) {
+    GTEST_ASSERT_LT(result.bytes, full_map_size);
+  }
+
+  std::cout
+    << difference_count << " of " << object_count << " objects different, "
+    << result.messages << " messages, "
+    << result.bytes << " bytes exchanged, full replica map "
+    << full_map_size << " bytes";
+  if (benchmark) {
+    std::cout << ", " << duration << " ms";
+  }
+  std::cout << "\n";
+}
+
+TEST(test_vds_dht_network, test_replica_map_digest) {
+  test_replica_map_digest(1000, 0, false);
+  test_replica_map_digest(1000, 10, false);
+  test_replica_map_digest(1000, 1000, false);
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_replica_map_digest) {
+  for (size_t difference_count = 1; difference_count <= 10000; difference_count *= 10) {
+    test_replica_map_digest(BENCHMARK_OBJECT_COUNT, difference_count, true);
+  }
+}
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+#include "test_sync_process.h"
+#include "db_model.h"
+#include "device_record_dbo.h"
+#include "../../libs/vds_dht_network/private/dht_session.h"
+#include "../../libs/vds_dht_network/private/dht_network_client_p.h"
+
+#define REPLICA_COUNT 20
+#define REPLICA_SIZE 1024
+
+static void save_replicas(const vds::service_provider * sp) {
+  sp->get<vds::db_model>()->async_transaction([sp](vds::database_transaction & t) {
+    for (size_t i = 0; i < REPLICA_COUNT; ++i) {
+      vds::const_data_buffer replica_data;
+      replica_data.resize(REPLICA_SIZE);
+      vds::crypto_service::rand_bytes(replica_data.data(), replica_data.size());
+
+      const auto replica_hash = vds::hash::signature(vds::hash::sha256(), replica_data);
+      vds::dht::network::_client::save_data(sp, t, replica_hash, replica_data);
+    }
+  }).get();
+}
+
+//Overwrite the file of any replica with random data
+static vds::const_data_buffer corrupt_replica(const vds::service_provider * sp) {
+  vds::const_data_buffer data_hash;
+  std::string local_path;
+  sp->get<vds::db_model>()->async_read_transaction([sp, &data_hash, &local_path](vds::database_read_transaction & t) {
+    vds::orm::device_record_dbo t1;
+    auto st = t.get_reader(
+      t1.select(t1.data_hash, t1.local_path)
+      .where(t1.node_id == sp->get<vds::dht::network::client>()->current_node_id()));
+    if (st.execute()) {
+      data_hash = t1.data_hash.get(st);
+      local_path = t1.local_path.get(st);
+    }
+  }).get();
+
+  vds::const_data_buffer garbage;
+  garbage.resize(REPLICA_SIZE);
+  vds::crypto_service::rand_bytes(garbage.data(), garbage.size());
+
+  vds::file f(vds::filename(local_path), vds::file::file_mode::truncate);
+  f.write(garbage);
+  f.close();
+
+  return data_hash;
+}
+
+static bool replica_exists(const vds::service_provider * sp, const vds::const_data_buffer & data_hash) {
+  bool result = false;
+  sp->get<vds::db_model>()->async_read_transaction([sp, &data_hash, &result](vds::database_read_transaction & t) {
+    vds::orm::device_record_dbo t1;
+    auto st = t.get_reader(
+      t1.select(t1.data_size)
+      .where(t1.node_id == sp->get<vds::dht::network::client>()->current_node_id() && t1.data_hash == data_hash));
+    result = st.execute();
+  }).get();
+
+  return result;
+}
+
+TEST(test_vds_dht_network, test_replica_scrubber) {
+  auto hab = std::make_shared<transport_hab>();
+  auto server = std::make_shared<test_server>(
+    vds::network_address(AF_INET, "localhost", 1010), hab);
+  server->start(hab, 1010);
+
+  auto & client = *server->sp_->get<vds::dht::network::client>();
+  client->storage_layout(vds::dht::network::_client::storage_layout_t::file_per_replica);
+
+  save_replicas(server->sp_);
+  const auto corrupted_hash = corrupt_replica(server->sp_);
+
+  //The budget is exceeded by the first replica, but it is checked anyway
+  auto & scrubber = client->scrubber();
+  GTEST_ASSERT_EQ(scrubber.scrub(1).get(), 1);
+
+  vds::scrub_statistic statistic;
+  do {
+    GTEST_ASSERT_EQ(scrubber.scrub(4 * REPLICA_SIZE).get(), 4);
+    scrubber.get_statistic(statistic);
+  } while (statistic.verified_count_ + statistic.corrupted_count_ < REPLICA_COUNT);
+
+  GTEST_ASSERT_EQ(statistic.corrupted_count_, 1);
+  GTEST_ASSERT_EQ(statistic.verified_count_, REPLICA_COUNT - 1);
+  GTEST_ASSERT_EQ(statistic.verified_bytes_, (REPLICA_COUNT - 1) * REPLICA_SIZE);
+
+  ASSERT_FALSE(replica_exists(server->sp_, corrupted_hash));
+
+  server->stop();
+}
@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "dht_network.h"
+#include "../../libs/vds_dht_network/private/replica_source_selector.h"
+
+#define NODE_COUNT 12
+#define NEEDED_REPLICAS 8
+
+TEST(test_vds_dht_network, test_replica_source_selector) {
+  const uint64_t replica_size = vds::dht::network::service::BLOCK_SIZE / vds::dht::network::service::MIN_DISTRIBUTED_PIECES;
+
+  //Node i holds replica i, the odd nodes are slow
+  std::vector<vds::const_data_buffer> nodes;
+  std::map<vds::const_data_buffer, std::set<uint16_t>> holders;
+  for (uint16_t i = 0; i < NODE_COUNT; ++i) {
+    nodes.push_back(vds::const_data_buffer(&i, sizeof(i)));
+    holders[nodes[i]].emplace(i);
+  }
+
+  vds::dht::network::replica_source_selector selector;
+  auto now = std::chrono::steady_clock::now();
+
+  for (uint16_t i = 0; i < NODE_COUNT; ++i) {
+    selector.ping_sent(nodes[i], now);
+  }
+  for (int step = 0; step < 100; ++step) {
+    for (uint16_t i = 0; i < NODE_COUNT; ++i) {
+      selector.ping_sent(nodes[i], now);
+      selector.pong_received(nodes[i], now + std::chrono::milliseconds((0 == i % 2) ? 10 : 1000));
+    }
+  }
+
+  //The fast nodes are asked first
+  const auto plan = selector.plan(holders, replica_size);
+  GTEST_ASSERT_EQ(plan.size(), NODE_COUNT);
+  size_t index = 0;
+  for (const auto & request : plan) {
+    uint16_t node;
+    memcpy(&node, request.node.data(), sizeof(node));
+    if (index < NODE_COUNT / 2) {
+      GTEST_ASSERT_EQ(node % 2, 0);
+    }
+    ++index;
+  }
+
+  const vds::const_data_buffer object_id("object", 6);
+  std::list<vds::dht::network::replica_source_selector::request_t> requests;
+  GTEST_ASSERT_TRUE(selector.start(object_id, NEEDED_REPLICAS, plan, replica_size, requests, now));
+  GTEST_ASSERT_EQ(requests.size(), NEEDED_REPLICAS);
+
+  //The restore in progress is not started again
+  std::list<vds::dht::network::replica_source_selector::request_t> duplicate_requests;
+  GTEST_ASSERT_FALSE(selector.start(object_id, NEEDED_REPLICAS, plan, replica_size, duplicate_requests, now));
+  GTEST_ASSERT_TRUE(duplicate_requests.empty());
+
+  //The fast nodes answer at once, the slow ones never
+  size_t received = 0;
+  for (const auto & request : requests) {
+    if (0 == request.replica % 2) {
+      selector.received(request.node, object_id, request.replica, replica_size, now + std::chrono::milliseconds(50));
+      ++received;
+    }
+  }
+  GTEST_ASSERT_TRUE(selector.hedge(now + std::chrono::milliseconds(100)).empty());
+
+  //The slow requests are hedged by the rest sources after the deadline
+  now += std::chrono::minutes(1);
+  const auto hedged = selector.hedge(now);
+  GTEST_ASSERT_EQ(hedged.size(), NEEDED_REPLICAS - received);
+  for (const auto & request : hedged) {
+    GTEST_ASSERT_EQ(request.first, object_id);
+    selector.received(request.second.node, object_id, request.second.replica, replica_size, now + std::chrono::milliseconds(50));
+  }
+
+  GTEST_ASSERT_EQ(selector.pending_restores(), 0);
+
+  vds::replica_source_statistic statistic;
+  selector.get_statistic(statistic);
+  GTEST_ASSERT_EQ(statistic.completed_restores_, 1);
+  GTEST_ASSERT_EQ(statistic.hedged_requests_, NEEDED_REPLICAS - received);
+  GTEST_ASSERT_EQ(statistic.peers_.size(), NODE_COUNT);
+}
@@ -0,0 +1,287 @@
+#include "stdafx.h"
+#include "test_storage_allocator.h"
+#include "test_sync_process.h"
+#include "db_model.h"
+#include "mt_service.h"
+#include "crypto_service.h"
+#include "device_record_dbo.h"
+#include "replica_segment_dbo.h"
+#include "../../libs/vds_dht_network/private/dht_network_client_p.h"
+#include "../../libs/vds_dht_network/private/segment_store.h"
+
+#define TEST_SEGMENT_SIZE 4096
+#define TEST_REPLICA_SIZE 1024
+
+TEST(test_vds_dht_network, test_segment_store) {
+  auto hab = std::make_shared<transport_hab>();
+  auto server = std::make_shared<test_server>(
+    vds::network_address(AF_INET, "localhost", 1002), hab);
+  server->start(hab, 1002);
+
+  (*server->sp_->get<vds::dht::network::client>())->storage_layout(
+    vds::dht::network::_client::storage_layout_t::segments);
+
+  save_replicas(server->sp_, REPLICA_COUNT, 1024);
+  check_storage_usage(server->sp_, REPLICA_COUNT, 1024);
+  read_replicas(server->sp_, REPLICA_COUNT);
+
+  server->stop();
+}
+
+TEST(test_vds_dht_network, test_file_per_replica) {
+  auto hab = std::make_shared<transport_hab>();
+  auto server = std::make_shared<test_server>(
+    vds::network_address(AF_INET, "localhost", 1005), hab);
+  server->start(hab, 1005);
+
+  (*server->sp_->get<vds::dht::network::client>())->storage_layout(
+    vds::dht::network::_client::storage_layout_t::file_per_replica);
+
+  save_replicas(server->sp_, REPLICA_COUNT, 1024);
+  check_storage_usage(server->sp_, REPLICA_COUNT, 1024);
+  read_replicas(server->sp_, REPLICA_COUNT);
+
+  server->stop();
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_storage_layout) {
+  const vds::dht::network::_client::storage_layout_t layouts[] = {
+    vds::dht::network::_client::storage_layout_t::file_per_replica,
+    vds::dht::network::_client::storage_layout_t::segments
+  };
+
+  uint16_t port = 1003;
+  for (auto layout : layouts) {
+    auto hab = std::make_shared<transport_hab>();
+    auto server = std::make_shared<test_server>(
+      vds::network_address(AF_INET, "localhost", port), hab);
+    server->start(hab, port);
+    ++port;
+
+    (*server->sp_->get<vds::dht::network::client>())->storage_layout(layout);
+
+    auto start = std::chrono::steady_clock::now();
+    save_replicas(server->sp_, BENCHMARK_REPLICA_COUNT, 1024);
+    const auto save_time = std::chrono::steady_clock::now() - start;
+
+    //The second pass uses cached hash verification
+    start = std::chrono::steady_clock::now();
+    read_replicas(server->sp_, BENCHMARK_REPLICA_COUNT);
+    const auto read_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    read_replicas(server->sp_, BENCHMARK_REPLICA_COUNT);
+    const auto verified_read_time = std::chrono::steady_clock::now() - start;
+
+    std::cout
+      << ((vds::dht::network::_client::storage_layout_t::segments == layout) ? "segments" : "file per replica")
+      << ": save " << std::chrono::duration_cast<std::chrono::milliseconds>(save_time).count()
+      << " ms, read " << std::chrono::duration_cast<std::chrono::milliseconds>(read_time).count()
+      << " ms, verified read " << std::chrono::duration_cast<std::chrono::milliseconds>(verified_read_time).count()
+      << " ms\n";
+
+    server->stop();
+  }
+}
+
+//Run the handler with the segment store on the in-memory database
+static void run_segment_store(
+  const std::string & test_name,
+  const std::function<void(vds::db_model & db_model, vds::dht::network::segment_store & store, const std::string & storage_path)> & handler) {
+
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+  vds::db_model db_model;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+  registrator.add_service<vds::db_model>(&db_model);
+
+  auto sp = registrator.build();
+  registrator.start();
+  db_model.start_in_memory(sp);
+
+  auto folder = vds::foldername(
+    vds::foldername(vds::filename::current_process().contains_folder(), "segments"),
+    test_name);
+  folder.delete_folder(true);
+  folder.create();
+
+  {
+    vds::dht::network::segment_store store;
+    store.segment_size(TEST_SEGMENT_SIZE);
+
+    handler(db_model, store, folder.full_name());
+  }
+
+  db_model.stop();
+  registrator.shutdown();
+}
+
+static vds::const_data_buffer random_replica() {
+  vds::const_data_buffer result;
+  result.resize(TEST_REPLICA_SIZE);
+  vds::crypto_service::rand_bytes(result.data(), result.size());
+  return result;
+}
+
+struct test_segment_t {
+  std::string local_path_;
+  int64_t data_size_;
+  int64_t live_size_;
+  vds::orm::replica_segment_dbo::state_t state_;
+};
+
+static std::vector<test_segment_t> load_segments(vds::db_model & db_model) {
+  std::vector<test_segment_t> result;
+  db_model.async_read_transaction([&result](vds::database_read_transaction & t) {
+    vds::orm::replica_segment_dbo t1;
+    auto st = t.get_reader(
+      t1.select(t1.local_path, t1.data_size, t1.live_size, t1.state)
+      .order_by(t1.local_path));
+    while (st.execute()) {
+      result.push_back(test_segment_t{
+        t1.local_path.get(st),
+        t1.data_size.get(st),
+        t1.live_size.get(st),
+        t1.state.get(st) });
+    }
+  }).get();
+  return result;
+}
+
+TEST(test_vds_dht_network, test_segment_store_delete) {
+  run_segment_store("delete", [](vds::db_model & db_model, vds::dht::network::segment_store & store, const std::string & storage_path) {
+    std::vector<vds::dht::network::segment_store::location_t> locations;
+    db_model.async_transaction([&](vds::database_transaction & t) {
+      locations.push_back(store.write(t, storage_path, random_replica()));
+      locations.push_back(store.write(t, storage_path, random_replica()));
+    }).get();
+
+    GTEST_ASSERT_EQ(locations[0].local_path, locations[1].local_path);
+    GTEST_ASSERT_EQ(locations[1].data_offset, TEST_REPLICA_SIZE);
+
+    //The data of the rolled back transaction is cut off
+    bool is_rolled_back = false;
+    try {
+      db_model.async_transaction([&](vds::database_transaction & t) {
+        store.write(t, storage_path, random_replica());
+        throw std::runtime_error("Test error");
+      }).get();
+    }
+    catch (const std::runtime_error &) {
+      is_rolled_back = true;
+    }
+
+    GTEST_ASSERT_TRUE(is_rolled_back);
+    GTEST_ASSERT_EQ(vds::file::length(vds::filename(locations[0].local_path)), 2U * TEST_REPLICA_SIZE);
+
+    db_model.async_transaction([&](vds::database_transaction & t) {
+      vds::dht::network::segment_store::release(t, locations[0].local_path, TEST_REPLICA_SIZE);
+      locations.push_back(store.write(t, storage_path, random_replica()));
+    }).get();
+
+    GTEST_ASSERT_EQ(locations[2].local_path, locations[0].local_path);
+    GTEST_ASSERT_EQ(locations[2].data_offset, 2 * TEST_REPLICA_SIZE);
+
+    const auto segments = load_segments(db_model);
+    GTEST_ASSERT_EQ(segments.size(), 1U);
+    GTEST_ASSERT_EQ(segments[0].data_size_, 3 * TEST_REPLICA_SIZE);
+    GTEST_ASSERT_EQ(segments[0].live_size_, 2 * TEST_REPLICA_SIZE);
+    GTEST_ASSERT_EQ(segments[0].state_, vds::orm::replica_segment_dbo::state_t::active);
+  });
+}
+
+TEST(test_vds_dht_network, test_segment_store_compaction) {
+  run_segment_store("compaction", [](vds::db_model & db_model, vds::dht::network::segment_store & store, const std::string & storage_path) {
+    const vds::const_data_buffer node_id("test node", 9);
+
+    struct replica_t {
+      vds::const_data_buffer data_hash;
+      vds::const_data_buffer data;
+      std::string local_path;
+    };
+    std::vector<replica_t> replicas;
+
+    //Two segments: the first one is sealed, the second one is active
+    db_model.async_transaction([&](vds::database_transaction & t) {
+      vds::orm::device_record_dbo t1;
+      for (size_t i = 0; i < 2 * TEST_SEGMENT_SIZE / TEST_REPLICA_SIZE; ++i) {
+        auto data = random_replica();
+        const auto data_hash = vds::hash::signature(vds::hash::sha256(), data);
+        const auto location = store.write(t, storage_path, data);
+
+        t.execute(t1.insert(
+          t1.node_id = node_id,
+          t1.storage_path = storage_path,
+          t1.local_path = location.local_path,
+          t1.data_hash = data_hash,
+          t1.data_offset = location.data_offset,
+          t1.data_size = data.size()));
+
+        replicas.push_back(replica_t{ data_hash, data, location.local_path });
+      }
+    }).get();
+
+    const auto sealed_path = replicas[0].local_path;
+    auto segments = load_segments(db_model);
+    GTEST_ASSERT_EQ(segments.size(), 2U);
+
+    //Delete all replicas of the sealed segment except the last one
+    db_model.async_transaction([&](vds::database_transaction & t) {
+      vds::orm::device_record_dbo t1;
+      for (size_t i = 0; i < TEST_SEGMENT_SIZE / TEST_REPLICA_SIZE - 1; ++i) {
+        vds::dht::network::segment_store::release(t, sealed_path, TEST_REPLICA_SIZE);
+        t.execute(t1.delete_if(t1.node_id == node_id && t1.data_hash == replicas[i].data_hash));
+      }
+
+      store.compact(t, node_id);
+    }).get();
+
+    segments = load_segments(db_model);
+    for (const auto & segment : segments) {
+      if (segment.local_path_ == sealed_path) {
+        GTEST_ASSERT_EQ(segment.state_, vds::orm::replica_segment_dbo::state_t::compacted);
+        GTEST_ASSERT_EQ(segment.live_size_, 0);
+      }
+    }
+
+    //The live replicas are readable from the new location
+    size_t count = 0;
+    db_model.async_read_transaction([&](vds::database_read_transaction & t) {
+      vds::orm::device_record_dbo t1;
+      auto st = t.get_reader(
+        t1.select(t1.data_hash, t1.local_path, t1.data_offset, t1.data_size)
+        .where(t1.node_id == node_id));
+      while (st.execute()) {
+        GTEST_ASSERT_NE(t1.local_path.get(st), sealed_path);
+
+        const auto data = vds::dht::network::segment_store::read(
+          vds::filename(t1.local_path.get(st)),
+          t1.data_offset.get(st),
+          t1.data_size.get(st));
+        GTEST_ASSERT_EQ(vds::hash::signature(vds::hash::sha256(), data), t1.data_hash.get(st));
+        ++count;
+      }
+    }).get();
+    GTEST_ASSERT_EQ(count, TEST_SEGMENT_SIZE / TEST_REPLICA_SIZE + 1U);
+
+    //The compacted segment is removed by the next call
+    GTEST_ASSERT_TRUE(vds::file::exists(vds::filename(sealed_path)));
+    db_model.async_transaction([&](vds::database_transaction & t) {
+      store.compact(t, node_id);
+    }).get();
+
+    GTEST_ASSERT_FALSE(vds::file::exists(vds::filename(sealed_path)));
+    segments = load_segments(db_model);
+    for (const auto & segment : segments) {
+      GTEST_ASSERT_NE(segment.local_path_, sealed_path);
+    }
+  });
+}
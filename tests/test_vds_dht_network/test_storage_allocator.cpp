@@ -0,0 +1,303 @@
+#include "stdafx.h"
+#include "test_storage_allocator.h"
+#include "test_sync_process.h"
+#include "db_model.h"
+#include "mt_service.h"
+#include "crypto_service.h"
+#include "asymmetriccrypto.h"
+#include "udp_socket.h"
+#include "device_config_dbo.h"
+#include "device_record_dbo.h"
+#include "../../libs/vds_dht_network/private/dht_session.h"
+#include "../../libs/vds_dht_network/private/dht_network_client_p.h"
+#include "../../libs/vds_dht_network/private/storage_allocator.h"
+
+#define BATCH_SIZE 1000
+
+void save_replicas(
+  const vds::service_provider * sp,
+  size_t replica_count,
+  size_t replica_size) {
+
+  for (size_t batch = 0; batch < replica_count; batch += BATCH_SIZE) {
+    sp->get<vds::db_model>()->async_transaction([sp, batch, replica_count, replica_size](vds::database_transaction & t) {
+      for (size_t i = batch; i < batch + BATCH_SIZE && i < replica_count; ++i) {
+        vds::const_data_buffer replica_data;
+        replica_data.resize(replica_size);
+        vds::crypto_service::rand_bytes(replica_data.data(), replica_data.size());
+
+        const auto replica_hash = vds::hash::signature(vds::hash::sha256(), replica_data);
+        vds::dht::network::_client::save_data(sp, t, replica_hash, replica_data);
+      }
+    }).get();
+  }
+}
+
+void check_storage_usage(
+  const vds::service_provider * sp,
+  size_t replica_count,
+  size_t replica_size) {
+
+  sp->get<vds::db_model>()->async_read_transaction([sp, replica_count, replica_size](vds::database_read_transaction & t) {
+    const auto node_id = sp->get<vds::dht::network::client>()->current_node_id();
+
+    int64_t used_size = 0;
+    vds::orm::device_config_dbo t1;
+    auto st = t.get_reader(t1.select(t1.used_size).where(t1.node_id == node_id));
+    while (st.execute()) {
+      used_size += t1.used_size.get(st);
+    }
+
+    int64_t data_size = 0;
+    vds::orm::device_record_dbo t2;
+    st = t.get_reader(t2.select(t2.data_size).where(t2.node_id == node_id));
+    while (st.execute()) {
+      data_size += t2.data_size.get(st);
+    }
+
+    GTEST_ASSERT_EQ(used_size, data_size);
+    GTEST_ASSERT_EQ(used_size, static_cast<int64_t>(replica_count * replica_size));
+  }).get();
+}
+
+void read_replicas(
+  const vds::service_provider * sp,
+  size_t replica_count) {
+
+  sp->get<vds::db_model>()->async_read_transaction([sp, replica_count](vds::database_read_transaction & t) {
+    const auto node_id = sp->get<vds::dht::network::client>()->current_node_id();
+
+    size_t count = 0;
+    vds::orm::device_record_dbo t1;
+    auto st = t.get_reader(
+      t1.select(t1.data_hash, t1.local_path, t1.data_offset, t1.data_size)
+      .where(t1.node_id == node_id));
+    while (st.execute()) {
+      const auto data_hash = t1.data_hash.get(st);
+      const auto data = (*sp->get<vds::dht::network::client>())->read_data(
+        data_hash,
+        vds::filename(t1.local_path.get(st)),
+        t1.data_offset.get(st),
+        t1.data_size.get(st));
+      GTEST_ASSERT_EQ(static_cast<int64_t>(data.size()), t1.data_size.get(st));
+      GTEST_ASSERT_EQ(vds::hash::signature(vds::hash::sha256(), data), data_hash);
+      ++count;
+    }
+
+    GTEST_ASSERT_EQ(count, replica_count);
+  }).get();
+}
+
+TEST(test_vds_dht_network, test_storage_usage) {
+  auto hab = std::make_shared<transport_hab>();
+  auto server = std::make_shared<test_server>(
+    vds::network_address(AF_INET, "localhost", 1000), hab);
+  server->start(hab, 1000);
+
+  save_replicas(server->sp_, REPLICA_COUNT, 1024);
+  check_storage_usage(server->sp_, REPLICA_COUNT, 1024);
+
+  server->stop();
+}
+
+TEST(test_vds_dht_network, DISABLED_benchmark_save_replicas) {
+  auto hab = std::make_shared<transport_hab>();
+  auto server = std::make_shared<test_server>(
+    vds::network_address(AF_INET, "localhost", 1001), hab);
+  server->start(hab, 1001);
+
+  const auto start = std::chrono::steady_clock::now();
+  save_replicas(server->sp_, BENCHMARK_REPLICA_COUNT, 1024);
+  std::cout
+    << BENCHMARK_REPLICA_COUNT << " replicas saved in "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+    << " ms\n";
+
+  check_storage_usage(server->sp_, BENCHMARK_REPLICA_COUNT, 1024);
+
+  server->stop();
+}
+
+struct test_device_t {
+  std::string local_path_;
+  int64_t reserved_size_;
+  int64_t used_size_;
+};
+
+//Load the devices into the allocator and return the storages chosen for the allocations
+static std::vector<std::string> allocate_storages(
+  vds::dht::network::storage_allocator::placement_policy_t policy,
+  const std::vector<test_device_t> & devices,
+  size_t count,
+  uint64_t size) {
+
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+  vds::db_model db_model;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+  registrator.add_service<vds::db_model>(&db_model);
+
+  auto sp = registrator.build();
+  registrator.start();
+  db_model.start_in_memory(sp);
+
+  const vds::const_data_buffer node_id("test node", 9);
+
+  vds::dht::network::storage_allocator allocator;
+  allocator.placement_policy(policy);
+
+  std::vector<std::string> result;
+  db_model.async_transaction([&](vds::database_transaction & t) {
+    vds::orm::device_config_dbo t1;
+    for (const auto & device : devices) {
+      t.execute(t1.insert(
+        t1.node_id = node_id,
+        t1.local_path = device.local_path_,
+        t1.owner_id = "owner",
+        t1.name = device.local_path_,
+        t1.reserved_size = device.reserved_size_,
+        t1.used_size = device.used_size_,
+        t1.cert = node_id,
+        t1.private_key = node_id));
+    }
+
+    allocator.load(t, node_id);
+    for (size_t i = 0; i < count; ++i) {
+      result.push_back(allocator.allocate(t, size));
+    }
+  }).get();
+
+  db_model.stop();
+  registrator.shutdown();
+
+  return result;
+}
+
+static const std::vector<test_device_t> & test_devices() {
+  static const std::vector<test_device_t> result {
+    { "a", 1000, 600 },
+    { "b", 1000, 200 },
+    { "c", 1000, 0 }
+  };
+  return result;
+}
+
+TEST(test_vds_dht_network, test_storage_allocator_most_free) {
+  const auto storages = allocate_storages(
+    vds::dht::network::storage_allocator::placement_policy_t::most_free,
+    test_devices(),
+    5,
+    300);
+
+  const std::vector<std::string> expected { "c", "b", "c", "b", "a" };
+  GTEST_ASSERT_EQ(storages, expected);
+}
+
+TEST(test_vds_dht_network, test_storage_allocator_round_robin) {
+  const auto storages = allocate_storages(
+    vds::dht::network::storage_allocator::placement_policy_t::round_robin,
+    test_devices(),
+    6,
+    300);
+
+  //The device without space is skipped
+  const std::vector<std::string> expected { "a", "b", "c", "b", "c", "c" };
+  GTEST_ASSERT_EQ(storages, expected);
+}
+
+TEST(test_vds_dht_network, test_storage_allocator_fill_first) {
+  const auto storages = allocate_storages(
+    vds::dht::network::storage_allocator::placement_policy_t::fill_first,
+    test_devices(),
+    6,
+    300);
+
+  const std::vector<std::string> expected { "a", "b", "b", "c", "c", "c" };
+  GTEST_ASSERT_EQ(storages, expected);
+}
+
+static bool is_rolled_back(
+  vds::db_model & db_model,
+  const std::function<void(vds::database_transaction & t)> & handler) {
+  try {
+    db_model.async_transaction(handler).get();
+    return false;
+  }
+  catch (const std::runtime_error &) {
+    return true;
+  }
+}
+
+TEST(test_vds_dht_network, test_storage_allocator_rollback) {
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+  vds::db_model db_model;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+  registrator.add_service<vds::db_model>(&db_model);
+
+  auto sp = registrator.build();
+  registrator.start();
+  db_model.start_in_memory(sp);
+
+  const vds::const_data_buffer node_id("test node", 9);
+
+  vds::dht::network::storage_allocator allocator;
+  db_model.async_transaction([&](vds::database_transaction & t) {
+    vds::orm::device_config_dbo t1;
+    t.execute(t1.insert(
+      t1.node_id = node_id,
+      t1.local_path = "a",
+      t1.owner_id = "owner",
+      t1.name = "a",
+      t1.reserved_size = 1000,
+      t1.used_size = 0,
+      t1.cert = node_id,
+      t1.private_key = node_id));
+
+    allocator.load(t, node_id);
+  }).get();
+
+  //The reservation of the rolled back transaction is returned
+  GTEST_ASSERT_TRUE(is_rolled_back(db_model, [&](vds::database_transaction & t) {
+    GTEST_ASSERT_EQ(allocator.allocate(t, 800), "a");
+    throw std::runtime_error("Test error");
+  }));
+
+  db_model.async_transaction([&](vds::database_transaction & t) {
+    GTEST_ASSERT_EQ(allocator.allocate(t, 800), "a");
+  }).get();
+
+  //The space is released only after the commit
+  GTEST_ASSERT_TRUE(is_rolled_back(db_model, [&](vds::database_transaction & t) {
+    allocator.release(t, "a", 800);
+    throw std::runtime_error("Test error");
+  }));
+
+  db_model.async_transaction([&](vds::database_transaction & t) {
+    GTEST_ASSERT_EQ(allocator.allocate(t, 800), "");
+    allocator.release(t, "a", 800);
+  }).get();
+
+  db_model.async_transaction([&](vds::database_transaction & t) {
+    GTEST_ASSERT_EQ(allocator.allocate(t, 800), "a");
+  }).get();
+
+  db_model.stop();
+  registrator.shutdown();
+}
@@ -0,0 +1,33 @@
+#ifndef __TEST_VDS_DHT_NETWORK_TEST_STORAGE_ALLOCATOR_H_
+#define __TEST_VDS_DHT_NETWORK_TEST_STORAGE_ALLOCATOR_H_
+
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+
+#define REPLICA_COUNT 2000
+#define BENCHMARK_REPLICA_COUNT 100000
+
+namespace vds {
+  class service_provider;
+}
+
+//Save the random replicas with the current storage layout of the node
+void save_replicas(
+  const vds::service_provider * sp,
+  size_t replica_count,
+  size_t replica_size);
+
+//The used size of the devices is equal to the size of the saved replicas
+void check_storage_usage(
+  const vds::service_provider * sp,
+  size_t replica_count,
+  size_t replica_size);
+
+//Read all replicas back and check their hashes
+void read_replicas(
+  const vds::service_provider * sp,
+  size_t replica_count);
+
+#endif //__TEST_VDS_DHT_NETWORK_TEST_STORAGE_ALLOCATOR_H_
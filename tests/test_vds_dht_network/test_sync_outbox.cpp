@@ -0,0 +1,158 @@
+#include "stdafx.h"
+#include "dht_network.h"
+#include "db_model.h"
+#include "mt_service.h"
+#include "crypto_service.h"
+#include "well_known_node_dbo.h"
+#include "messages/sync_messages.h"
+#include "../../libs/vds_dht_network/private/sync_outbox.h"
+
+#define OBJECT_COUNT 100
+#define NODE_COUNT 5
+
+//Run the handler on the in-memory database
+static void run_in_memory(const std::function<void(vds::db_model & db_model)> & handler) {
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+  vds::crypto_service crypto_service;
+  vds::db_model db_model;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(crypto_service);
+  registrator.add_service<vds::db_model>(&db_model);
+
+  auto sp = registrator.build();
+  registrator.start();
+  db_model.start_in_memory(sp);
+
+  handler(db_model);
+
+  db_model.stop();
+  registrator.shutdown();
+}
+
+TEST(test_vds_dht_network, test_sync_outbox) {
+  GTEST_ASSERT_TRUE(vds::dht::network::sync_outbox::is_sync_message(vds::dht::network::message_type_t::sync_leader_broadcast_request));
+  GTEST_ASSERT_FALSE(vds::dht::network::sync_outbox::is_sync_message(vds::dht::network::message_type_t::sync_replica_data));
+  GTEST_ASSERT_FALSE(vds::dht::network::sync_outbox::is_sync_message(vds::dht::network::message_type_t::sync_message_batch));
+
+  std::vector<vds::const_data_buffer> nodes;
+  for (size_t i = 0; i < NODE_COUNT; ++i) {
+    nodes.push_back(vds::const_data_buffer(&i, sizeof(i)));
+  }
+
+  vds::dht::network::sync_outbox outbox;
+
+  //Out of a transaction the message is sent at once
+  const auto message = vds::message_serialize(vds::message_create<vds::dht::messages::sync_new_election_request>(
+    nodes[0], (uint64_t)1, (uint64_t)1, nodes[0]));
+  GTEST_ASSERT_FALSE(outbox.add(nullptr, nodes[1], vds::dht::network::message_type_t::sync_new_election_request, message));
+
+  run_in_memory([&outbox, &nodes, &message](vds::db_model & db_model) {
+    std::map<vds::const_data_buffer, std::list<vds::dht::network::sync_outbox::message_t>> messages;
+    db_model.async_transaction([&outbox, &nodes, &message, &messages](vds::database_transaction & t) {
+      GTEST_ASSERT_TRUE(outbox.begin(&t));
+      GTEST_ASSERT_FALSE(outbox.begin(&t));
+
+      //Heartbeats of every object to every member
+      for (size_t object = 0; object < OBJECT_COUNT; ++object) {
+        const auto object_id = vds::const_data_buffer(&object, sizeof(object));
+        for (const auto & node : nodes) {
+          GTEST_ASSERT_TRUE(outbox.add(
+            &t,
+            node,
+            vds::dht::network::message_type_t::sync_leader_broadcast_request,
+            vds::message_serialize(vds::message_create<vds::dht::messages::sync_new_election_request>(
+              object_id, (uint64_t)1, (uint64_t)1, node))));
+        }
+      }
+
+      //The responses of the part rolled back alone are dropped
+      const auto mark = outbox.mark(&t);
+      GTEST_ASSERT_TRUE(outbox.add(&t, nodes[1], vds::dht::network::message_type_t::sync_new_election_request, message));
+      outbox.rollback_to(&t, mark);
+      GTEST_ASSERT_EQ(outbox.mark(&t), mark);
+
+      t.on_commit([&outbox, &messages, scope = &t]() {
+        messages = outbox.end(scope);
+      });
+    }).get();
+
+    GTEST_ASSERT_EQ(messages.size(), NODE_COUNT);
+    for (const auto & node : messages) {
+      GTEST_ASSERT_EQ(node.second.size(), OBJECT_COUNT);
+      outbox.sent(node.second.size());
+    }
+
+    //The messages of the rolled back transaction are dropped
+    bool is_rolled_back = false;
+    try {
+      db_model.async_transaction([&outbox, &nodes, &message](vds::database_transaction & t) {
+        GTEST_ASSERT_TRUE(outbox.begin(&t));
+        t.on_rollback([&outbox, scope = &t]() {
+          outbox.discard(scope);
+        });
+        GTEST_ASSERT_TRUE(outbox.add(&t, nodes[1], vds::dht::network::message_type_t::sync_new_election_request, message));
+        throw std::runtime_error("Test error");
+      }).get();
+    }
+    catch (const std::runtime_error &) {
+      is_rolled_back = true;
+    }
+    GTEST_ASSERT_TRUE(is_rolled_back);
+  });
+
+  outbox.finish_tick();
+
+  vds::sync_message_statistic statistic;
+  outbox.get_statistic(statistic);
+  GTEST_ASSERT_EQ(statistic.tick_messages_, OBJECT_COUNT * NODE_COUNT + 3);
+  GTEST_ASSERT_EQ(statistic.tick_objects_, OBJECT_COUNT);
+  GTEST_ASSERT_EQ(statistic.tick_datagrams_, NODE_COUNT);
+}
+
+TEST(test_vds_dht_network, test_transaction_savepoint) {
+  run_in_memory([](vds::db_model & db_model) {
+    bool is_undone = false;
+    bool is_committed = false;
+    db_model.async_transaction([&is_undone, &is_committed](vds::database_transaction & t) {
+      vds::orm::well_known_node_dbo t1;
+      t.execute(t1.insert(t1.address = "udp://first", t1.last_connect = std::chrono::system_clock::now()));
+
+      bool is_failed = false;
+      try {
+        t.savepoint([&t, &t1, &is_undone, &is_committed]() {
+          t.execute(t1.insert(t1.address = "udp://second", t1.last_connect = std::chrono::system_clock::now()));
+          t.on_rollback([&is_undone]() { is_undone = true; });
+          t.on_commit([&is_committed]() { is_committed = true; });
+          throw std::runtime_error("Test error");
+        });
+      }
+      catch (const std::runtime_error &) {
+        is_failed = true;
+      }
+      GTEST_ASSERT_TRUE(is_failed);
+      GTEST_ASSERT_TRUE(is_undone);
+    }).get();
+
+    //Only the changes of the failed part are rolled back
+    GTEST_ASSERT_FALSE(is_committed);
+
+    std::set<std::string> addresses;
+    db_model.async_read_transaction([&addresses](vds::database_read_transaction & t) {
+      vds::orm::well_known_node_dbo t1;
+      auto st = t.get_reader(t1.select(t1.address));
+      while (st.execute()) {
+        addresses.emplace(t1.address.get(st));
+      }
+    }).get();
+
+    GTEST_ASSERT_EQ(addresses.count("udp://first"), 1U);
+    GTEST_ASSERT_EQ(addresses.count("udp://second"), 0U);
+  });
+}
@@ -92,6 +92,9 @@ TEST(test_vds_dht_network, test_sync_process) {
       case vds::dht::network::message_type_t::sync_replica_operations_response:
       case vds::dht::network::message_type_t::sync_replica_data:
       case vds::dht::network::message_type_t::sync_add_message_request:
+      case vds::dht::network::message_type_t::sync_replica_map_digest:
+      case vds::dht::network::message_type_t::sync_replica_map_entries:
+      case vds::dht::network::message_type_t::sync_replica_piece_request:
       {
         break;
       }
@@ -350,8 +353,26 @@ vds::async_task<void> mock_server::process_message(
   
   const message_info_t& message_info) {
 
-  static_cast<mock_transport *>(this->transport_.get())->hab()->register_message(
-    this->sp_->get<vds::dht::network::client>()->current_node_id(), message_info);
+  auto hab = static_cast<mock_transport *>(this->transport_.get())->hab();
+  if (vds::dht::network::message_type_t::sync_message_batch == message_info.message_type()) {
+    //The test checks the sync messages, not the way they have been packed
+    vds::binary_deserializer s(message_info.message_data());
+    const auto batch = vds::message_deserialize<vds::dht::messages::sync_message_batch>(s);
+    for (const auto & item : batch.messages) {
+      hab->register_message(
+        this->sp_->get<vds::dht::network::client>()->current_node_id(),
+        message_info_t(
+          message_info.session(),
+          static_cast<vds::dht::network::message_type_t>(item.message_type),
+          item.message_data,
+          message_info.source_node(),
+          message_info.hops()));
+    }
+  }
+  else {
+    hab->register_message(
+      this->sp_->get<vds::dht::network::client>()->current_node_id(), message_info);
+  }
 
   switch (message_info.message_type()) {
     route_client(sync_new_election_request)
@@ -378,6 +399,10 @@ vds::async_task<void> mock_server::process_message(
       route_client(sync_replica_data)
 
       route_client(sync_replica_query_operations_request)
+      route_client(sync_message_batch)
+      route_client(sync_replica_map_digest)
+      route_client(sync_replica_map_entries)
+      route_client(sync_replica_piece_request)
 
       route_client_wait(dht_find_node)
       route_client_wait(dht_find_node_response)
@@ -402,7 +427,7 @@ void mock_server::add_sync_entry(
   this->sp_->get<vds::db_model>()->async_transaction([sp = this->sp_, object_data](vds::database_transaction & t) {
     auto client = sp->get<vds::dht::network::client>();
     const auto object_id = vds::hash::signature(vds::hash::sha256(), object_data);
-    auto fn = (*client)->save_data(sp, t, object_id, object_data);
+    (*client)->save_data(sp, t, object_id, object_data);
     vds::orm::chunk_dbo t1;
     t.execute(
       t1.insert(
@@ -455,7 +480,8 @@ void mock_transport::stop() {
 }
 
 vds::async_task<void> mock_transport::write_async(
-  const vds::udp_datagram& datagram) {
+  const vds::udp_datagram& datagram,
+  vds::dht::network::traffic_class_t /*traffic_class*/) {
   return this->hab_->write_async(datagram, this->node_id_, this->owner_->address());
 }
 
@@ -71,13 +71,21 @@ public:
 
   void stop() override;
 
-  vds::async_task<void> write_async(const vds::udp_datagram& datagram) override;
+  vds::async_task<void> write_async(
+    const vds::udp_datagram& datagram,
+    vds::dht::network::traffic_class_t traffic_class) override;
   vds::async_task<void> try_handshake( const std::string& address) override;
 
   vds::async_task<void> on_timer() override {
     co_return;
   }
 
+  void traffic_limits(vds::dht::network::traffic_class_t, uint64_t, uint64_t) override {
+  }
+
+  void peer_traffic_limits(uint64_t, uint64_t) override {
+  }
+
   const vds::const_data_buffer & node_id() const {
     return this->node_id_;
   }
@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "dht_network.h"
+#include "../../libs/vds_dht_network/private/traffic_shaper.h"
+
+#define DATAGRAM_SIZE 1000
+#define PEER_BYTES_PER_SECOND 10000
+
+TEST(test_vds_dht_network, test_traffic_shaper) {
+  vds::dht::network::traffic_shaper shaper;
+  shaper.peer_limits(PEER_BYTES_PER_SECOND, PEER_BYTES_PER_SECOND);
+
+  const auto peer = vds::network_address::ip4("127.0.0.1", 8050);
+  const auto other_peer = vds::network_address::ip4("127.0.0.1", 8051);
+
+  //The buckets are full after the long idle time
+  const auto now = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+
+  std::list<std::string> sent;
+  std::list<vds::dht::network::traffic_shaper::send_handler_t> ready;
+  const auto submit = [&](
+    const vds::network_address & address,
+    vds::dht::network::traffic_class_t traffic_class,
+    const std::string & name,
+    const std::chrono::steady_clock::time_point & time) {
+    shaper.submit(address, traffic_class, DATAGRAM_SIZE, [&sent, name]() { sent.push_back(name); }, ready, time);
+  };
+  const auto invoke_ready = [&]() {
+    for (const auto & handler : ready) {
+      handler();
+    }
+    ready.clear();
+  };
+
+  //One second of the peer bandwidth is sent at once, the rest is queued
+  for (int i = 0; i < 20; ++i) {
+    submit(peer, vds::dht::network::traffic_class_t::background, "background", now);
+  }
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent.size(), PEER_BYTES_PER_SECOND / DATAGRAM_SIZE);
+  GTEST_ASSERT_EQ(shaper.queue_size(), 20 - PEER_BYTES_PER_SECOND / DATAGRAM_SIZE);
+
+  for (int i = 0; i < 5; ++i) {
+    submit(peer, vds::dht::network::traffic_class_t::user, "user", now);
+  }
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent.size(), PEER_BYTES_PER_SECOND / DATAGRAM_SIZE);
+
+  //The control datagram is never queued
+  sent.clear();
+  submit(peer, vds::dht::network::traffic_class_t::control, "control", now);
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent, std::list<std::string>({ "control" }));
+
+  //The other peer has its own bucket
+  sent.clear();
+  submit(other_peer, vds::dht::network::traffic_class_t::background, "other", now);
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent, std::list<std::string>({ "other" }));
+
+  //The user restore is before the background repair of the same peer
+  sent.clear();
+  shaper.pump(ready, now + std::chrono::milliseconds(200));
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent, std::list<std::string>({ "user" }));
+
+  sent.clear();
+  shaper.pump(ready, now + std::chrono::seconds(10));
+  shaper.pump(ready, now + std::chrono::seconds(20));
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent.size(), 4 + 20 - PEER_BYTES_PER_SECOND / DATAGRAM_SIZE);
+  GTEST_ASSERT_EQ(sent.front(), "user");
+  GTEST_ASSERT_EQ(sent.back(), "background");
+  GTEST_ASSERT_EQ(shaper.queue_size(), 0);
+
+  vds::session_statistic statistic;
+  shaper.get_statistic(statistic);
+  GTEST_ASSERT_EQ(statistic.traffic_classes_.size(), vds::dht::network::traffic_shaper::CLASS_COUNT);
+  for (const auto & traffic_class : statistic.traffic_classes_) {
+    if ("control" == traffic_class.name_) {
+      GTEST_ASSERT_EQ(traffic_class.sent_, 1);
+      GTEST_ASSERT_EQ(traffic_class.throttled_, 0);
+    }
+    else if ("user" == traffic_class.name_) {
+      GTEST_ASSERT_EQ(traffic_class.sent_, 5);
+      GTEST_ASSERT_EQ(traffic_class.throttled_, 5);
+    }
+    else if ("background" == traffic_class.name_) {
+      GTEST_ASSERT_EQ(traffic_class.sent_, 21);
+      GTEST_ASSERT_EQ(traffic_class.throttled_, 20 - PEER_BYTES_PER_SECOND / DATAGRAM_SIZE);
+    }
+  }
+
+  vds::session_statistic::session_info peer_statistic { peer.to_string() };
+  shaper.get_peer_statistic(peer, peer_statistic);
+  GTEST_ASSERT_EQ(peer_statistic.queued_, 0);
+  GTEST_ASSERT_EQ(peer_statistic.sent_bytes_, 26 * DATAGRAM_SIZE);
+  GTEST_ASSERT_EQ(peer_statistic.throttled_, 5 + 20 - PEER_BYTES_PER_SECOND / DATAGRAM_SIZE);
+
+  //The class limit is applied to all peers
+  shaper.peer_limits(0, 0);
+  shaper.class_limits(vds::dht::network::traffic_class_t::background, 2 * DATAGRAM_SIZE, 2 * DATAGRAM_SIZE);
+  const auto later = now + std::chrono::minutes(1);
+  sent.clear();
+  for (int i = 0; i < 5; ++i) {
+    submit(peer, vds::dht::network::traffic_class_t::background, "background", later);
+  }
+  submit(other_peer, vds::dht::network::traffic_class_t::user, "user", later);
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent, std::list<std::string>({ "background", "background", "user" }));
+  GTEST_ASSERT_EQ(shaper.queue_size(), 3);
+
+  //The datagram over the queue limit is dropped
+  GTEST_ASSERT_FALSE(shaper.submit(
+    peer,
+    vds::dht::network::traffic_class_t::background,
+    vds::dht::network::traffic_shaper::MAX_QUEUE_BYTES,
+    [&sent]() { sent.push_back("dropped"); },
+    ready,
+    later));
+  GTEST_ASSERT_EQ(shaper.queue_size(), 3);
+
+  statistic.traffic_classes_.clear();
+  shaper.get_statistic(statistic);
+  for (const auto & traffic_class : statistic.traffic_classes_) {
+    GTEST_ASSERT_EQ(traffic_class.dropped_, ("background" == traffic_class.name_) ? 1 : 0);
+  }
+
+  sent.clear();
+  shaper.pump(ready, later + std::chrono::seconds(10));
+  shaper.pump(ready, later + std::chrono::seconds(20));
+  invoke_ready();
+  GTEST_ASSERT_EQ(sent, std::list<std::string>({ "background", "background", "background" }));
+}
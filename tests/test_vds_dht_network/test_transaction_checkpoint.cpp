@@ -0,0 +1,256 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "crypto_service.h"
+#include "server.h"
+#include "cert_control.h"
+#include "user_manager.h"
+#include "db_model.h"
+#include "user_wallet.h"
+#include "member_user.h"
+#include "transaction_log_record_dbo.h"
+#include "transaction_log_checkpoint_dbo.h"
+#include "transaction_record_state.h"
+
+//Balances are compared without zero ones, rollbacks keep empty sources
+static std::map<std::string, std::map<vds::const_data_buffer, int64_t>> non_zero_balance(
+  const vds::transactions::transaction_record_state & state) {
+
+  std::map<std::string, std::map<vds::const_data_buffer, int64_t>> result;
+  for (const auto & account : state.account_state()) {
+    for (const auto & balance : account.second.balance_) {
+      if (0 != balance.second) {
+        result[account.first][balance.first] = balance.second;
+      }
+    }
+  }
+
+  return result;
+}
+
+//Applies all blocks from the root block without checkpoints
+static vds::transactions::transaction_record_state replay(
+  vds::database_read_transaction & t,
+  const std::set<vds::const_data_buffer> & ancestors) {
+
+  std::map<uint64_t/*order_no*/, std::map<vds::const_data_buffer/*log_id*/, vds::const_data_buffer/*data*/>> blocks;
+  std::set<vds::const_data_buffer> not_processed(ancestors);
+  std::set<vds::const_data_buffer> processed;
+
+  while (!not_processed.empty()) {
+    auto p = *not_processed.begin();
+    not_processed.erase(not_processed.begin());
+    processed.emplace(p);
+
+    vds::orm::transaction_log_record_dbo t1;
+    auto st = t.get_reader(
+      t1.select(t1.data, t1.order_no)
+      .where(t1.id == p));
+    if (!st.execute()) {
+      throw std::runtime_error("Invalid data");
+    }
+
+    const auto data = t1.data.get(st);
+    blocks[t1.order_no.get(st)][p] = data;
+
+    for (const auto & ancestor : vds::transactions::transaction_block(data).ancestors()) {
+      if (processed.end() == processed.find(ancestor)) {
+        not_processed.emplace(ancestor);
+      }
+    }
+  }
+
+  vds::transactions::transaction_record_state result;
+  for (const auto & order : blocks) {
+    for (const auto & p : order.second) {
+      result.apply(vds::transactions::transaction_block(p.second));
+    }
+  }
+
+  return result;
+}
+
+static void check_state(
+  vds::database_read_transaction & t,
+  const std::set<vds::const_data_buffer> & ancestors) {
+
+  const auto state = vds::transactions::transaction_record_state::load(t, ancestors);
+  const auto expected = replay(t, ancestors);
+
+  ASSERT_TRUE(non_zero_balance(state) == non_zero_balance(expected));
+}
+
+//Root pays 1 to User1 in every block of the chain
+static void test_payment_chain(
+  const std::string & folder_name,
+  size_t block_count,
+  const std::function<void(
+    vds::database_read_transaction & t,
+    const std::list<vds::const_data_buffer> & blocks,
+    const std::string & user1)> & check) {
+
+  auto folder = vds::foldername(vds::foldername(vds::filename::current_process().contains_folder(), folder_name));
+  folder.delete_folder(true);
+  folder.create();
+
+  vds::service_registrator registrator;
+
+  vds::console_logger logger(
+    test_config::instance().log_level(),
+    test_config::instance().modules());
+  vds::mt_service mt_service;
+
+  vds::task_manager task_manager;
+  task_manager.disable_timers();
+
+  vds::crypto_service crypto_service;
+  vds::server server;
+
+  registrator.add(logger);
+  registrator.add(mt_service);
+  registrator.add(task_manager);
+  registrator.add(crypto_service);
+  registrator.add(server);
+
+  registrator.current_user(folder);
+  registrator.local_machine(folder);
+
+  auto sp = registrator.build();
+  registrator.start();
+
+  std::string root_user_name = "root";
+  std::string root_password = "123123";
+
+  vds::cert_control::private_info_t private_info;
+  private_info.genereate_all();
+  vds::cert_control::genereate_all(root_user_name, root_password, private_info);
+
+  std::make_shared<vds::user_manager>(sp)->reset(root_user_name, root_password, private_info);
+
+  auto root_user_mng = std::make_shared<vds::user_manager>(sp);
+  sp->get<vds::db_model>()->async_transaction([root_user_mng, root_user_name, root_password](vds::database_transaction & t) {
+    root_user_mng->load(t, root_user_name, root_password);
+  }).get();
+
+  auto user_request = vds::user_manager::create_register_request(sp, "User1", "user1@domain.ru", "1234567");
+  ASSERT_TRUE(root_user_mng->approve_join_request(user_request).get());
+
+  auto user1_mng = std::make_shared<vds::user_manager>(sp);
+  sp->get<vds::db_model>()->async_transaction([user1_mng](vds::database_transaction & t) {
+    user1_mng->load(t, "user1@domain.ru", "1234567");
+  }).get();
+
+  std::list<vds::const_data_buffer> blocks;
+  for (size_t i = 0; i < block_count; ++i) {
+    sp->get<vds::db_model>()->async_transaction([sp, root_user_mng, user1_mng, &blocks](vds::database_transaction & t) {
+      auto balance = vds::user_wallet::get_balance(t);
+      const auto & root_balance = balance.account_state().at(root_user_mng->get_current_user().user_certificate()->subject());
+
+      vds::const_data_buffer source;
+      for (const auto & p : root_balance.balance_) {
+        if (0 < p.second) {
+          source = p.first;
+          break;
+        }
+      }
+
+      vds::transactions::transaction_block_builder transaction_log(sp, t);
+      vds::user_wallet::transfer(transaction_log, source, user1_mng->get_current_user(), 1);
+      blocks.push_back(transaction_log.save(
+        sp,
+        t,
+        root_user_mng->get_current_user().user_certificate(),
+        root_user_mng->get_current_user().private_key()));
+    }).get();
+  }
+
+  //The votes of User1 make the chain final
+  sp->get<vds::db_model>()->async_transaction([sp, root_user_mng, user1_mng](vds::database_transaction & t) {
+    auto balance = vds::user_wallet::get_balance(t);
+    const auto & user1_balance = balance.account_state().at(user1_mng->get_current_user().user_certificate()->subject());
+
+    vds::const_data_buffer source;
+    for (const auto & p : user1_balance.balance_) {
+      if (0 < p.second) {
+        source = p.first;
+        break;
+      }
+    }
+
+    vds::transactions::transaction_block_builder transaction_log(sp, t);
+    vds::user_wallet::transfer(transaction_log, source, root_user_mng->get_current_user(), 1);
+    transaction_log.save(
+      sp,
+      t,
+      user1_mng->get_current_user().user_certificate(),
+      user1_mng->get_current_user().private_key());
+  }).get();
+
+  const auto user1 = user1_mng->get_current_user().user_certificate()->subject();
+  sp->get<vds::db_model>()->async_read_transaction([&check, &blocks, &user1](vds::database_read_transaction & t) {
+    check(t, blocks, user1);
+  }).get();
+
+  registrator.shutdown();
+}
+
+TEST(test_vds_dht_network, test_transaction_checkpoint) {
+  //The chain over several checkpoints
+  test_payment_chain(
+    "test_transaction_checkpoint",
+    3 * vds::transactions::transaction_record_state::CHECKPOINT_INTERVAL,
+    [](vds::database_read_transaction & t, const std::list<vds::const_data_buffer> & blocks, const std::string & /*user1*/) {
+    //Checkpoints are taken for final blocks only
+    vds::orm::transaction_log_checkpoint_dbo t1;
+    vds::orm::transaction_log_record_dbo t2;
+    auto st = t.get_reader(
+      t1.select(t1.order_no, t2.consensus)
+      .inner_join(t2, t2.id == t1.id)
+      .order_by(t1.order_no));
+    size_t checkpoint_count = 0;
+    int64_t last_order_no = 0;
+    while (st.execute()) {
+      ASSERT_TRUE(t2.consensus.get(st));
+      if (0 < checkpoint_count) {
+        ASSERT_GE(t1.order_no.get(st) - last_order_no, static_cast<int64_t>(vds::transactions::transaction_record_state::CHECKPOINT_INTERVAL));
+      }
+      last_order_no = t1.order_no.get(st);
+      ++checkpoint_count;
+    }
+    ASSERT_GE(checkpoint_count, 3U);
+
+    for (const auto & block_id : blocks) {
+      check_state(t, std::set<vds::const_data_buffer>{ block_id });
+    }
+
+    std::set<vds::const_data_buffer> leafs;
+    st = t.get_reader(t2.select(t2.id).where(t2.state == vds::orm::transaction_log_record_dbo::state_t::leaf));
+    while (st.execute()) {
+      leafs.emplace(t2.id.get(st));
+    }
+    check_state(t, leafs);
+  });
+}
+
+TEST(test_vds_dht_network, test_transaction_checkpoint_payment) {
+  //The checkpoint and the later payments to the same account are in the ancestry,
+  //the checkpoint state is not applied twice
+  test_payment_chain(
+    "test_transaction_checkpoint_payment",
+    vds::transactions::transaction_record_state::CHECKPOINT_INTERVAL + 2,
+    [](vds::database_read_transaction & t, const std::list<vds::const_data_buffer> & blocks, const std::string & user1) {
+    int64_t payments = 0;
+    for (const auto & block_id : blocks) {
+      ++payments;
+      const auto state = vds::transactions::transaction_record_state::load(t, std::set<vds::const_data_buffer>{ block_id });
+
+      int64_t balance = 0;
+      for (const auto & p : state.account_state().at(user1).balance_) {
+        balance += p.second;
+      }
+      ASSERT_EQ(balance, payments);
+    }
+  });
+}
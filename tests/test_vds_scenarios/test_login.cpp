@@ -0,0 +1,46 @@
+/*
+Copyright (c) 2017, Vadim Malyshev, lboss75@gmail.com
+All rights reserved
+*/
+#include "stdafx.h"
+#include "test_vds.h"
+#include "vds_mock.h"
+#include "db_model.h"
+#include "user_manager.h"
+#include "transaction_log_notifier.h"
+
+TEST(test_vds, test_pending_login)
+{
+  vds_mock mock;
+  mock.start(6);
+
+  //Waiting to sync logs
+  mock.sync_wait();
+
+  auto sp = mock.get_sp(0);
+  auto db = sp->get<vds::db_model>();
+  auto notifier = sp->get<vds::transactions::transaction_log_notifier>();
+
+  auto user_mng = std::make_shared<vds::user_manager>(sp);
+  db->async_transaction([user_mng](vds::database_transaction &t) {
+    user_mng->load(t, "unknown user", "unknown password");
+  }).get();
+
+  const auto update_count = user_mng->update_count();
+  const auto generation = notifier->generation();
+  const auto start = std::chrono::steady_clock::now();
+
+  const auto state = user_mng->wait_login_state(std::chrono::seconds(5)).get();
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const auto updates = user_mng->update_count() - update_count;
+  const auto generations = notifier->generation() - generation;
+
+  mock.stop();
+
+  ASSERT_EQ(state, vds::user_manager::login_state_t::waiting);
+  ASSERT_GE(elapsed, std::chrono::seconds(4));
+
+  //The pending login reads the log once and after every new block only
+  ASSERT_LE(updates, 1 + generations);
+}
@@ -14,14 +14,49 @@ function humanFileSize(bytes, si) {
     return bytes.toFixed(1) + ' ' + units[u];
 }
 
+var feed_page_size = 100;
+//The next page is loaded when the feed is scrolled to the end
+var feed_next_page = null;
+//The pages of the previously opened feed are dropped
+var feed_generation = 0;
+
 function load_channel(session_id, channel_id, channel_name) {
+    ++feed_generation;
+    feed_next_page = null;
+    $('#feed_records')
+        .empty()
+        .off('scroll.feed')
+        .on('scroll.feed', load_next_feed_page);
+    load_channel_page(session_id, channel_id, -1);
+}
+
+function load_next_feed_page() {
+    var feed = $('#feed_records');
+    if (!feed_next_page
+        || feed.scrollTop() + feed.innerHeight() < feed.prop('scrollHeight') - feed.innerHeight()) {
+        return;
+    }
+
+    var page = feed_next_page;
+    feed_next_page = null;
+    load_channel_page(page.session_id, page.channel_id, page.after);
+}
+
+function load_channel_page(session_id, channel_id, after) {
+    var generation = feed_generation;
     $.ajax({
         url: '/api/channel_feed?session='
             + encodeURIComponent(session_id)
             + "&channel_id="
-            + encodeURIComponent(channel_id),
+            + encodeURIComponent(channel_id)
+            + "&limit="
+            + feed_page_size
+            + (after < 0 ? "" : "&after=" + after),
         success: function (data) {
-            $('#feed_records').empty();
+            if (generation != feed_generation) {
+                return;
+            }
+
             $.each(data,
                 function() {
                     var files = $('<ul class="list-group" />'); 
@@ -57,6 +92,20 @@ function load_channel(session_id, channel_id, channel_name) {
                                     .append(files)));
                 }
             );
+
+            if (data.length >= feed_page_size) {
+                feed_next_page = {
+                    session_id: session_id,
+                    channel_id: channel_id,
+                    after: data[data.length - 1].order_no
+                };
+
+                //The page does not fill the feed, so it cannot be scrolled
+                var feed = $('#feed_records');
+                if (feed.prop('scrollHeight') <= feed.innerHeight()) {
+                    load_next_feed_page();
+                }
+            }
         }
     });
 }